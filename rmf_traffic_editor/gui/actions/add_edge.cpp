@@ -41,6 +41,7 @@ AddEdgeCommand::~AddEdgeCommand()
 void AddEdgeCommand::redo()
 {
   _building->levels[_level_idx].vertices = _final_snapshot;
+  _building->levels[_level_idx].vertices_changed();
   if (_type != Edge::LANE)
   {
     _building->add_edge(
@@ -64,6 +65,7 @@ void AddEdgeCommand::undo()
   //Just use snapshots to keep things simpler
   _building->levels[_level_idx].edges = _edge_snapshot;
   _building->levels[_level_idx].vertices = _vert_snapshot;
+  _building->levels[_level_idx].vertices_changed();
 }
 
 int AddEdgeCommand::set_first_point(double x, double y)
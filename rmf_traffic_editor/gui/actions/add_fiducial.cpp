@@ -53,6 +53,7 @@ void AddFiducialCommand::undo()
   _building->levels[_level_idx].fiducials.erase(
     _building->levels[_level_idx].fiducials.begin() + index_to_remove
   );
+  _building->invalidate_transform(_level_idx);
 }
 
 void AddFiducialCommand::redo()
@@ -35,9 +35,11 @@ AddPolygonCommand::~AddPolygonCommand()
 void AddPolygonCommand::undo()
 {
   _building->levels[_level_idx].polygons = _previous_polygons;
+  _building->levels[_level_idx].polygons_changed();
 }
 
 void AddPolygonCommand::redo()
 {
   _building->levels[_level_idx].polygons.push_back(_to_add);
+  _building->levels[_level_idx].polygons_changed();
 }
@@ -28,11 +28,11 @@ AddPropertyCommand::AddPropertyCommand(
   _level_idx = level_idx;
   _vert_id = -1;
 
-  for (size_t i = 0; i < building->levels[level_idx].vertices.size(); i++)
-  {
-    if (building->levels[level_idx].vertices[i].selected)
-      _vert_id = i;
-  }
+  // the last selected vertex, as before the selection was indexed
+  const std::set<int>& selected_vertices =
+    building->levels[level_idx].selection().vertices;
+  if (!selected_vertices.empty())
+    _vert_id = *selected_vertices.rbegin();
 }
 
 AddPropertyCommand::~AddPropertyCommand()
@@ -51,6 +51,7 @@ void AddPropertyCommand::redo()
     return;
 
   _building->levels[_level_idx].vertices[_vert_id].params[_prop] = _val;
+  _building->levels[_level_idx].vertices_changed();
 }
 
 void AddPropertyCommand::undo()
@@ -60,4 +61,5 @@ void AddPropertyCommand::undo()
     return;
 
   _building->levels[_level_idx].vertices[_vert_id].params.erase(_prop);
+  _building->levels[_level_idx].vertices_changed();
 }
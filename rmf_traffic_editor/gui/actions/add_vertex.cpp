@@ -44,6 +44,7 @@ void AddVertexCommand::undo()
     {
       _building->levels[_level_idx].vertices.erase(
         _building->levels[_level_idx].vertices.begin() + i);
+      _building->levels[_level_idx].vertices_changed();
       break;
     }
   }
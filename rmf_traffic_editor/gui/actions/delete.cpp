@@ -36,6 +36,7 @@ void DeleteCommand::undo()
       _building->levels[_level_idx].vertices.begin() + _vertex_idx[i],
       _vertices[i]);
   }
+  _building->levels[_level_idx].vertices_changed();
 
   for (size_t i = 0; i < _edges.size(); i++)
   {
@@ -57,6 +58,8 @@ void DeleteCommand::undo()
       _building->levels[_level_idx].fiducials.begin() + _fiducial_idx[i],
       _fiducials[i]);
   }
+  if (!_fiducials.empty())
+    _building->invalidate_transform(_level_idx);
 
   for (size_t i = 0; i < _polygons.size(); i++)
   {
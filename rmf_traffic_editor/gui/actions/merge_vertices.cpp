@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "merge_vertices.h"
+
+MergeVerticesCommand::MergeVerticesCommand(
+  Building* building,
+  int level_idx,
+  double tolerance)
+: _building(building),
+  _level_idx(level_idx),
+  _tolerance(tolerance)
+{
+  setText(QString("Merge vertices within %1 m").arg(_tolerance));
+}
+
+void MergeVerticesCommand::redo()
+{
+  Level& level = _building->levels[_level_idx];
+  _vertices = level.vertices;
+  _edges = level.edges;
+  _polygons = level.polygons;
+  setObsolete(level.merge_duplicate_vertices(_tolerance) == 0);
+}
+
+void MergeVerticesCommand::undo()
+{
+  Level& level = _building->levels[_level_idx];
+  level.vertices = _vertices;
+  level.edges = _edges;
+  level.polygons = _polygons;
+  level.vertices_changed();
+  level.polygons_changed();
+}
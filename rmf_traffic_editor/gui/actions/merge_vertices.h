@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__MERGE_VERTICES_H_
+#define ACTIONS__MERGE_VERTICES_H_
+
+#include <vector>
+
+#include <QUndoCommand>
+
+#include "building.h"
+
+/// Merges the vertices of a level that are within a tolerance of each
+/// other, using Level::merge_duplicate_vertices(). Merging renumbers the
+/// vertices and can remove edges and polygons, so undo puts back copies
+/// of all three taken just before. If nothing was merged the command
+/// marks itself obsolete, so QUndoStack::push() drops it.
+class MergeVerticesCommand : public QUndoCommand
+{
+public:
+  /// `tolerance` is in meters
+  MergeVerticesCommand(Building* building, int level_idx, double tolerance);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  Building* _building;
+  int _level_idx;
+  double _tolerance;
+  std::vector<Vertex> _vertices;
+  std::vector<Edge> _edges;
+  std::vector<Polygon> _polygons;
+};
+
+#endif  // ACTIONS__MERGE_VERTICES_H_
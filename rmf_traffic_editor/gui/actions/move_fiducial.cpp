@@ -41,6 +41,7 @@ void MoveFiducialCommand::undo()
     _building->levels[_level_id].fiducials[_fiducial_id];
   fiducial.x = _original_x;
   fiducial.y = _original_y;
+  _building->invalidate_transform(_level_id);
 }
 
 void MoveFiducialCommand::redo()
@@ -49,6 +50,7 @@ void MoveFiducialCommand::redo()
     _building->levels[_level_id].fiducials[_fiducial_id];
   fiducial.x = _final_x;
   fiducial.y = _final_y;
+  _building->invalidate_transform(_level_id);
 }
 
 void MoveFiducialCommand::set_final_destination(double x, double y)
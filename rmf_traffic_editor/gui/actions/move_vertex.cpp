@@ -44,13 +44,11 @@ void MoveVertexCommand::undo()
 {
   //Use ID because in future if we want to support photoshop style selective
   //undo-redos it will be consistent even after deletion of intermediate vertices.
-  for (Vertex& vert: _building->levels[_level_idx].vertices)
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
   {
-    if (vert.uuid == _to_move.uuid)
-    {
-      vert.x = _to_move.x;
-      vert.y = _to_move.y;
-    }
+    if (level.vertices[i].uuid == _to_move.uuid)
+      level.move_vertex(static_cast<int>(i), _to_move.x, _to_move.y);
   }
 }
 
@@ -58,12 +56,10 @@ void MoveVertexCommand::redo()
 {
   //Use ID because in future if we want to support photoshop style selective
   //undo-redos it will be consistent even after deletion of intermediate vertices.
-  for (Vertex& vert: _building->levels[_level_idx].vertices)
+  Level& level = _building->levels[_level_idx];
+  for (std::size_t i = 0; i < level.vertices.size(); i++)
   {
-    if (vert.uuid == _to_move.uuid)
-    {
-      vert.x = _x;
-      vert.y = _y;
-    }
+    if (level.vertices[i].uuid == _to_move.uuid)
+      level.move_vertex(static_cast<int>(i), _x, _y);
   }
 }
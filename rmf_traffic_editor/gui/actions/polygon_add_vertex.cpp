@@ -18,10 +18,14 @@
 #include "polygon_add_vertex.h"
 
 PolygonAddVertCommand::PolygonAddVertCommand(
+  Building* building,
+  int level_idx,
   Polygon* polygon,
   int position,
   int vert_id)
 {
+  _building = building;
+  _level_idx = level_idx;
   _polygon = polygon;
   _old_vertices = polygon->vertices;
   _position = position;
@@ -36,6 +40,7 @@ PolygonAddVertCommand::~PolygonAddVertCommand()
 void PolygonAddVertCommand::undo()
 {
   _polygon->vertices.erase(_polygon->vertices.begin() + _position);
+  _building->levels[_level_idx].polygons_changed();
 }
 
 void PolygonAddVertCommand::redo()
@@ -43,4 +48,5 @@ void PolygonAddVertCommand::redo()
   _polygon->vertices.insert(
     _polygon->vertices.begin() + _position,
     _vert_id);
+  _building->levels[_level_idx].polygons_changed();
 }
\ No newline at end of file
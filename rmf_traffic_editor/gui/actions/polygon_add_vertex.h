@@ -19,6 +19,7 @@
 #define _POLYGON_ADD_H_
 
 #include <QUndoCommand>
+#include "building.h"
 #include "polygon.h"
 
 class PolygonAddVertCommand : public QUndoCommand
@@ -26,6 +27,8 @@ class PolygonAddVertCommand : public QUndoCommand
 
 public:
   PolygonAddVertCommand(
+    Building* building,
+    int level_idx,
     Polygon* polygon,
     int position,
     int vert_id);
@@ -33,6 +36,8 @@ public:
   void undo() override;
   void redo() override;
 private:
+  Building* _building;
+  int _level_idx;
   Polygon* _polygon;
   int _vert_id;
   int _position;
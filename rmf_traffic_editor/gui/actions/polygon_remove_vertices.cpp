@@ -17,9 +17,13 @@
 
 #include "polygon_remove_vertices.h"
 PolygonRemoveVertCommand::PolygonRemoveVertCommand(
+  Building* building,
+  int level_idx,
   Polygon* polygon,
   int vert_id)
 {
+  _building = building;
+  _level_idx = level_idx;
   _polygon = polygon;
   _vert_id = vert_id;
   _old_vertices = polygon->vertices;
@@ -32,9 +36,11 @@ PolygonRemoveVertCommand::~PolygonRemoveVertCommand()
 void PolygonRemoveVertCommand::undo()
 {
   _polygon->vertices = _old_vertices;
+  _building->levels[_level_idx].polygons_changed();
 }
 
 void PolygonRemoveVertCommand::redo()
 {
   _polygon->remove_vertex(_vert_id);
+  _building->levels[_level_idx].polygons_changed();
 }
@@ -19,6 +19,7 @@
 #define _POLYGON_REMOVE_H_
 
 #include <QUndoCommand>
+#include "building.h"
 #include "polygon.h"
 
 class PolygonRemoveVertCommand : public QUndoCommand
@@ -26,12 +27,16 @@ class PolygonRemoveVertCommand : public QUndoCommand
 
 public:
   PolygonRemoveVertCommand(
+    Building* building,
+    int level_idx,
     Polygon* polygon,
     int vert_id);
   virtual ~PolygonRemoveVertCommand();
   void undo() override;
   void redo() override;
 private:
+  Building* _building;
+  int _level_idx;
   Polygon* _polygon;
   int _vert_id;
   std::vector<int> _old_vertices;
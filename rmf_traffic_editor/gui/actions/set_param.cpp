@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "set_param.h"
+
+namespace {
+
+template<typename T>
+void save_params(
+  const std::vector<T>& items,
+  const std::vector<int>& indices,
+  const std::string& name,
+  std::vector<Param>& saved)
+{
+  const ParamKey key(name);
+  for (const int i : indices)
+  {
+    const auto it = items[i].params.find(key);
+    saved.push_back(it == items[i].params.end() ? Param() : it->second);
+  }
+}
+
+template<typename T>
+void restore_params(
+  std::vector<T>& items,
+  const std::vector<int>& indices,
+  const std::string& name,
+  const std::vector<Param>& saved)
+{
+  const ParamKey key(name);
+  for (std::size_t i = 0; i < indices.size(); i++)
+  {
+    auto it = items[indices[i]].params.find(key);
+    if (it != items[indices[i]].params.end())
+      it->second = saved[i];
+  }
+}
+
+template<typename T>
+void set_params(
+  std::vector<T>& items,
+  const std::vector<int>& indices,
+  const std::string& name,
+  const std::string& value)
+{
+  for (const int i : indices)
+    items[i].set_param(name, value);
+}
+
+}  // namespace
+
+SetParamCommand::SetParamCommand(
+  Building* building,
+  int level_idx,
+  Level::ItemType type,
+  const std::vector<int>& indices,
+  const std::string& name,
+  const std::string& value)
+: _building(building),
+  _level_idx(level_idx),
+  _type(type),
+  _indices(indices),
+  _name(name),
+  _value(value)
+{
+  const Level& level = _building->levels[_level_idx];
+  switch (_type)
+  {
+    case Level::VERTEX:
+      save_params(level.vertices, _indices, _name, _original_params);
+      break;
+    case Level::EDGE:
+      save_params(level.edges, _indices, _name, _original_params);
+      break;
+    case Level::POLYGON:
+      save_params(level.polygons, _indices, _name, _original_params);
+      break;
+    case Level::MODEL:
+      for (const int i : _indices)
+      {
+        const Model& m = level.models[i];
+        _original_models.push_back({m.instance_name, m.state.z, m.is_static});
+      }
+      break;
+    default:
+      break;
+  }
+
+  setText(
+    QString("Set %1 of %2 items").arg(
+      QString::fromStdString(_name),
+      QString::number(_indices.size())));
+}
+
+void SetParamCommand::undo()
+{
+  Level& level = _building->levels[_level_idx];
+  switch (_type)
+  {
+    case Level::VERTEX:
+      restore_params(level.vertices, _indices, _name, _original_params);
+      level.vertices_changed();
+      break;
+    case Level::EDGE:
+      restore_params(level.edges, _indices, _name, _original_params);
+      break;
+    case Level::POLYGON:
+      restore_params(level.polygons, _indices, _name, _original_params);
+      break;
+    case Level::MODEL:
+      for (std::size_t i = 0; i < _indices.size(); i++)
+      {
+        Model& m = level.models[_indices[i]];
+        m.instance_name = _original_models[i].instance_name;
+        m.state.z = _original_models[i].elevation;
+        m.is_static = _original_models[i].is_static;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void SetParamCommand::redo()
+{
+  Level& level = _building->levels[_level_idx];
+  switch (_type)
+  {
+    case Level::VERTEX:
+      set_params(level.vertices, _indices, _name, _value);
+      level.vertices_changed();
+      break;
+    case Level::EDGE:
+      set_params(level.edges, _indices, _name, _value);
+      break;
+    case Level::POLYGON:
+      set_params(level.polygons, _indices, _name, _value);
+      break;
+    case Level::MODEL:
+      set_params(level.models, _indices, _name, _value);
+      break;
+    default:
+      break;
+  }
+}
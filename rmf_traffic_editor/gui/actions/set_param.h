@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__SET_PARAM_H_
+#define ACTIONS__SET_PARAM_H_
+
+#include <string>
+#include <vector>
+
+#include <QUndoCommand>
+
+#include "building.h"
+#include "param.h"
+
+/// Sets one param of several vertices, edges, polygons or models of a
+/// level to the same value, as one step. Items that don't have the param
+/// are left alone, as with their set_param(). For models, the param is
+/// one of the fields Model::set_param() understands.
+class SetParamCommand : public QUndoCommand
+{
+public:
+  SetParamCommand(
+    Building* building,
+    int level_idx,
+    Level::ItemType type,
+    const std::vector<int>& indices,
+    const std::string& name,
+    const std::string& value);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  struct ModelFields
+  {
+    std::string instance_name;
+    double elevation;
+    bool is_static;
+  };
+
+  Building* _building;
+  int _level_idx;
+  Level::ItemType _type;
+  std::vector<int> _indices;
+  std::string _name, _value;
+
+  // what each item had before, for undo
+  std::vector<Param> _original_params;
+  std::vector<ModelFields> _original_models;
+};
+
+#endif  // ACTIONS__SET_PARAM_H_
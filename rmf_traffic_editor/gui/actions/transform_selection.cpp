@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "transform_selection.h"
+
+TransformSelectionCommand::TransformSelectionCommand(
+  Building* building,
+  int level_idx)
+: _building(building),
+  _level_idx(level_idx)
+{
+  const Level& level = _building->levels[_level_idx];
+  const Level::Selection& selection = level.selection();
+  _vertices.assign(selection.vertices.begin(), selection.vertices.end());
+  _models.assign(selection.models.begin(), selection.models.end());
+  _fiducials.assign(selection.fiducials.begin(), selection.fiducials.end());
+  for (const auto& f : selection.features)
+    _features.push_back({f.first, f.second});
+
+  setText(
+    QString("Transform %1 items").arg(
+      _vertices.size() + _models.size() + _fiducials.size() +
+      _features.size()));
+}
+
+bool TransformSelectionCommand::empty() const
+{
+  return _vertices.empty() && _models.empty() && _fiducials.empty() &&
+    _features.empty();
+}
+
+QPointF TransformSelectionCommand::center() const
+{
+  const Level& level = _building->levels[_level_idx];
+  const double mpp = level.drawing_meters_per_pixel;
+  QPointF sum;
+  for (const int i : _vertices)
+    sum += QPointF(level.vertices[i].x, level.vertices[i].y);
+  for (const int i : _models)
+    sum += QPointF(level.models[i].state.x, level.models[i].state.y);
+  for (const int i : _fiducials)
+    sum += QPointF(level.fiducials[i].x, level.fiducials[i].y);
+  for (const FeatureRef& f : _features)
+  {
+    if (f.layer_idx == 0)
+      sum += level.floorplan_features[f.feature_idx].qpoint();
+    else
+    {
+      const Layer& layer = level.layers[f.layer_idx - 1];
+      sum += layer.transform.forwards(
+        layer.features[f.feature_idx].qpoint()) / mpp;
+    }
+  }
+
+  const std::size_t n = _vertices.size() + _models.size() +
+    _fiducials.size() + _features.size();
+  return n ? sum / static_cast<double>(n) : sum;
+}
+
+void TransformSelectionCommand::set_transform(const Transform& transform)
+{
+  _transform = transform;
+}
+
+void TransformSelectionCommand::undo()
+{
+  apply(false);
+}
+
+void TransformSelectionCommand::redo()
+{
+  apply(true);
+}
+
+void TransformSelectionCommand::apply(const bool forwards)
+{
+  Level& level = _building->levels[_level_idx];
+  auto move = [this, forwards](const QPointF& p)
+    {
+      return forwards ? _transform.forwards(p) : _transform.backwards(p);
+    };
+
+  for (const int i : _vertices)
+  {
+    const Vertex& v = level.vertices[i];
+    const QPointF p = move(QPointF(v.x, v.y));
+    level.move_vertex(i, p.x(), p.y());
+  }
+
+  const double yaw = forwards ? _transform.yaw() : -_transform.yaw();
+  for (const int i : _models)
+  {
+    ModelState& state = level.models[i].state;
+    const QPointF p = move(QPointF(state.x, state.y));
+    state.x = p.x();
+    state.y = p.y();
+    state.yaw += yaw;
+  }
+
+  for (const int i : _fiducials)
+  {
+    Fiducial& fiducial = level.fiducials[i];
+    const QPointF p = move(QPointF(fiducial.x, fiducial.y));
+    fiducial.x = p.x();
+    fiducial.y = p.y();
+  }
+  if (!_fiducials.empty())
+    _building->invalidate_transform(_level_idx);
+
+  // layer features are stored in the pixels of their layer's image
+  const double mpp = level.drawing_meters_per_pixel;
+  for (const FeatureRef& f : _features)
+  {
+    if (f.layer_idx == 0)
+    {
+      Feature& feature = level.floorplan_features[f.feature_idx];
+      const QPointF p = move(feature.qpoint());
+      feature.set_x(p.x());
+      feature.set_y(p.y());
+    }
+    else
+    {
+      Layer& layer = level.layers[f.layer_idx - 1];
+      Feature& feature = layer.features[f.feature_idx];
+      const QPointF p = move(layer.transform.forwards(feature.qpoint()) / mpp);
+      const QPointF q = layer.transform.backwards(p * mpp);
+      feature.set_x(q.x());
+      feature.set_y(q.y());
+    }
+  }
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ACTIONS__TRANSFORM_SELECTION_H_
+#define ACTIONS__TRANSFORM_SELECTION_H_
+
+#include <vector>
+
+#include <QPointF>
+#include <QUndoCommand>
+
+#include "building.h"
+#include "transform.hpp"
+
+/// Moves, rotates and scales the selected vertices, models, fiducials and
+/// features of a level as one step. Only their indices and the transform
+/// are kept, since undo can run the transform backwards; models also turn
+/// by its yaw.
+class TransformSelectionCommand : public QUndoCommand
+{
+public:
+  /// Remembers what is currently selected on the level
+  TransformSelectionCommand(Building* building, int level_idx);
+
+  bool empty() const;
+
+  /// The mean position of the selected items, in level pixels
+  QPointF center() const;
+
+  /// The transform is in level pixels
+  void set_transform(const Transform& transform);
+
+  void undo() override;
+  void redo() override;
+
+private:
+  struct FeatureRef
+  {
+    int layer_idx;  // 0 for the floorplan, as in MoveFeatureCommand
+    int feature_idx;
+  };
+
+  Building* _building;
+  int _level_idx;
+  Transform _transform;
+  std::vector<int> _vertices, _models, _fiducials;
+  std::vector<FeatureRef> _features;
+
+  void apply(const bool forwards);
+};
+
+#endif  // ACTIONS__TRANSFORM_SELECTION_H_
@@ -19,9 +19,12 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <yaml-cpp/yaml.h>
 
 #include <QFileInfo>
+#include <QGraphicsItemGroup>
+#include <QGraphicsScene>
 #include <QDir>
 #include <QThread>
 #include <QtConcurrent/QtConcurrent>
@@ -50,7 +53,7 @@ Building::~Building()
 ///
 /// This function replaces the contents of this object with what is
 /// in the YAML file.
-bool Building::load(const string& _filename)
+bool Building::load(const string& _filename, const LoadMode mode)
 {
   printf("Building::load(%s)\n", _filename.c_str());
   filename = _filename;
@@ -75,15 +78,19 @@ bool Building::load(const string& _filename)
     return false;
   }
 
-  // change directory to the path of the file, so that we can correctly open
-  // relative paths recorded in the file
-
-  QString dir(QFileInfo(QString::fromStdString(filename)).absolutePath());
-  qDebug("changing directory to [%s]", qUtf8Printable(dir));
-  if (!QDir::setCurrent(dir))
+  // Relative paths recorded in the file are relative to the file itself.
+  // We resolve them against its directory explicitly, so that several
+  // buildings can be loaded concurrently, but the editor still changes
+  // directory to it for the benefit of file dialogs and the like.
+  const QDir dir(QFileInfo(QString::fromStdString(filename)).absolutePath());
+  if (mode == LOAD_EDITOR)
   {
-    printf("couldn't change directory\n");
-    return false;
+    qDebug("changing directory to [%s]", qUtf8Printable(dir.path()));
+    if (!QDir::setCurrent(dir.path()))
+    {
+      printf("couldn't change directory\n");
+      return false;
+    }
   }
 
   if (y["name"])
@@ -118,13 +125,46 @@ bool Building::load(const string& _filename)
   for (YAML::const_iterator it = yl.begin(); it != yl.end(); ++it)
   {
     Level level;
-    level.from_yaml(it->first.as<string>(), it->second);
+    level.from_yaml(it->first.as<string>(), it->second, dir);
     levels.push_back(level);
   }
 
+  // decode every drawing and layer image of every level in parallel, then
+  // build their pixmaps back here on the GUI thread
+  vector<std::pair<Level*, QImage>> drawings;
+  for (auto& level : levels)
+    drawings.push_back(make_pair(&level, QImage()));
+
+  QtConcurrent::blockingMap(
+    drawings,
+    [&](auto& drawing) { drawing.first->decode_drawing(drawing.second, dir); });
+
+  vector<Layer*> layers;
+  for (auto& level : levels)
+  {
+    for (auto& layer : level.layers)
+      layers.push_back(&layer);
+  }
+
   QtConcurrent::blockingMap(
-    levels,
-    [&](auto& level) { level.load_drawing(); });
+    layers,
+    [&](Layer* layer) { layer->decode_image(dir); });
+
+  if (mode == LOAD_EDITOR)
+  {
+    for (auto& drawing : drawings)
+    {
+      if (!drawing.second.isNull())
+        drawing.first->floorplan_pixmap = QPixmap::fromImage(drawing.second);
+    }
+
+    for (Layer* layer : layers)
+    {
+      if (!layer->image.isNull() || layer->tile_source)
+        layer->colorize_image();
+    }
+  }
+  drawings.clear();
 
   // now that all images are loaded, we can calculate scale for annotated
   // measurement lanes
@@ -158,6 +198,54 @@ bool Building::load(const string& _filename)
   return true;
 }
 
+void Building::validate(vector<string>& problems) const
+{
+  if (!reference_level_name.empty() &&
+    find_level_idx(reference_level_name) < 0)
+    problems.push_back(
+      "reference level [" + reference_level_name + "] does not exist");
+
+  for (const auto& level : levels)
+  {
+    const string prefix = "level [" + level.name + "]: ";
+
+    // headless loads have no pixmaps, so go by the size the drawing had
+    if (!level.drawing_filename.empty() &&
+      (level.drawing_width <= 0 || level.drawing_height <= 0))
+      problems.push_back(
+        prefix + "unable to read drawing " + level.drawing_filename);
+
+    std::set<string> layer_names;
+    for (const auto& layer : level.layers)
+    {
+      if (!layer_names.insert(layer.name).second)
+        problems.push_back(prefix + "duplicate layer name " + layer.name);
+      if (layer.image.isNull() && !layer.tile_source)
+        problems.push_back(
+          prefix + "unable to read layer image " + layer.filename);
+    }
+
+    const int num_vertices = static_cast<int>(level.vertices.size());
+    for (std::size_t i = 0; i < level.edges.size(); i++)
+    {
+      const Edge& e = level.edges[i];
+      if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+        e.end_idx < 0 || e.end_idx >= num_vertices)
+        problems.push_back(
+          prefix + "edge " + std::to_string(i) +
+          " refers to a nonexistent vertex");
+    }
+  }
+
+  for (const auto& lift : lifts)
+  {
+    if (find_level_idx(lift.reference_floor_name) < 0)
+      problems.push_back(
+        "lift [" + lift.name + "]: reference level [" +
+        lift.reference_floor_name + "] does not exist");
+  }
+}
+
 bool Building::save()
 {
   printf("Building::save_yaml(%s)\n", filename.c_str());
@@ -217,6 +305,7 @@ QUuid Building::add_fiducial(int level_index, double x, double y)
   if (level_index >= static_cast<int>(levels.size()))
     return NULL;
   levels[level_index].fiducials.push_back(Fiducial(x, y));
+  invalidate_transform(level_index);
   return levels[level_index].fiducials.rbegin()->uuid;
 }
 
@@ -309,8 +398,11 @@ bool Building::delete_selected(const int level_index)
   if (level_index >= static_cast<int>(levels.size()))
     return false;
 
+  const std::size_t num_fiducials = levels[level_index].fiducials.size();
   if (!levels[level_index].delete_selected())
     return false;
+  if (levels[level_index].fiducials.size() != num_fiducials)
+    invalidate_transform(level_index);
 
   return true;
 }
@@ -374,51 +466,111 @@ void Building::add_level(const Level& new_level)
 
 void Building::draw_lifts(QGraphicsScene* scene, const int level_idx)
 {
-  const Level& level = levels[level_idx];
-  for (const auto& lift : lifts)
+  // forget the graphics of lifts and levels that are gone
+  auto& entries = lift_graphics.entries;
+  for (auto it = entries.begin(); it != entries.end(); )
   {
-    // find the level index referenced by the lift
-    int reference_floor_idx = -1;
-    for (std::size_t i = 0; i < levels.size(); i++)
+    if (it->first.first < static_cast<int>(lifts.size()) &&
+      it->first.second < static_cast<int>(levels.size()))
     {
-      if (levels[i].name == lift.reference_floor_name)
-      {
-        reference_floor_idx = static_cast<int>(i);
-        break;
-      }
+      ++it;
+      continue;
     }
+    delete it->second.group;
+    it = entries.erase(it);
+  }
+
+  const Level& level = levels[level_idx];
+  for (std::size_t i = 0; i < lifts.size(); i++)
+  {
+    const Lift& lift = lifts[i];
+
+    // find the level index referenced by the lift
+    const int reference_floor_idx = find_level_idx(lift.reference_floor_name);
 
     Transform t;
     if (reference_floor_idx >= 0)
       t = get_transform(reference_floor_idx, level_idx);
 
-    lift.draw(
-      scene,
+    const std::size_t signature = lift.graphics_signature(
       level.drawing_meters_per_pixel,
       level.name,
       level.elevation,
-      true,
       t.scale,
       t.dx,
       t.dy);
+
+    const auto key = std::make_pair(static_cast<int>(i), level_idx);
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.signature != signature)
+    {
+      LiftGraphicsCache::Entry entry;
+      entry.signature = signature;
+      entry.group = lift.create_graphics(
+        level.drawing_meters_per_pixel,
+        level.name,
+        level.elevation,
+        true,
+        t.scale,
+        t.dx,
+        t.dy);
+      if (it != entries.end())
+      {
+        delete it->second.group;
+        it->second = entry;
+      }
+      else
+        it = entries.insert(std::make_pair(key, entry)).first;
+    }
+
+    QGraphicsItemGroup* group = it->second.group;
+    if (group && group->scene() != scene)
+    {
+      if (group->scene())
+        group->scene()->removeItem(group);
+      scene->addItem(group);
+    }
+  }
+}
+
+void Building::detach_scene_items(QGraphicsScene* scene)
+{
+  for (auto& entry : lift_graphics.entries)
+  {
+    QGraphicsItemGroup* group = entry.second.group;
+    if (group && group->scene() == scene)
+      scene->removeItem(group);
   }
 }
 
+Building::LiftGraphicsCache& Building::LiftGraphicsCache::operator=(
+  const LiftGraphicsCache&)
+{
+  clear();
+  return *this;
+}
+
+Building::LiftGraphicsCache::~LiftGraphicsCache()
+{
+  clear();
+}
+
+void Building::LiftGraphicsCache::clear()
+{
+  // deleting an item also takes it out of its scene
+  for (auto& entry : entries)
+    delete entry.second.group;
+  entries.clear();
+}
+
 bool Building::transform_between_levels(
   const std::string& from_level_name,
   const QPointF& from_point,
   const std::string& to_level_name,
   QPointF& to_point)
 {
-  int from_level_idx = -1;
-  int to_level_idx = -1;
-  for (std::size_t i = 0; i < levels.size(); i++)
-  {
-    if (levels[i].name == from_level_name)
-      from_level_idx = i;
-    if (levels[i].name == to_level_name)
-      to_level_idx = i;
-  }
+  const int from_level_idx = find_level_idx(from_level_name);
+  const int to_level_idx = find_level_idx(to_level_name);
   if (from_level_idx < 0 || to_level_idx < 0)
   {
     to_point = from_point;
@@ -454,9 +606,178 @@ bool Building::transform_between_levels(
   return true;
 }
 
+bool Building::transform_between_levels(
+  const int from_level_idx,
+  const vector<QPointF>& from_points,
+  const int to_level_idx,
+  vector<QPointF>& to_points)
+{
+  to_points.resize(from_points.size());
+  if (from_level_idx < 0 ||
+    from_level_idx >= static_cast<int>(levels.size()) ||
+    to_level_idx < 0 ||
+    to_level_idx >= static_cast<int>(levels.size()))
+  {
+    std::copy(from_points.begin(), from_points.end(), to_points.begin());
+    return false;
+  }
+
+  apply_transform(
+    get_transform(from_level_idx, to_level_idx),
+    from_points.data(),
+    to_points.data(),
+    from_points.size());
+  return true;
+}
+
+bool Building::transform_selection_between_levels(
+  const int from_level_idx,
+  const int to_level_idx,
+  vector<QPointF>& to_points)
+{
+  to_points.clear();
+  if (from_level_idx < 0 || from_level_idx >= static_cast<int>(levels.size()))
+    return false;
+
+  const Level& level = levels[from_level_idx];
+  vector<Level::SelectedItem> selected;
+  get_selected_items(from_level_idx, selected);
+
+  vector<QPointF> from_points;
+  from_points.reserve(selected.size());
+  for (const auto& item : selected)
+  {
+    if (item.vertex_idx >= 0)
+    {
+      const Vertex& v = level.vertices[item.vertex_idx];
+      from_points.push_back(QPointF(v.x, v.y));
+    }
+    else if (item.fiducial_idx >= 0)
+    {
+      const Fiducial& f = level.fiducials[item.fiducial_idx];
+      from_points.push_back(QPointF(f.x, f.y));
+    }
+    else if (item.model_idx >= 0)
+    {
+      const Model& m = level.models[item.model_idx];
+      from_points.push_back(QPointF(m.state.x, m.state.y));
+    }
+  }
+
+  return transform_between_levels(
+    from_level_idx,
+    from_points,
+    to_level_idx,
+    to_points);
+}
+
+void Building::apply_transform(
+  const Transform& t,
+  const QPointF* in,
+  QPointF* out,
+  const std::size_t count)
+{
+  // simple enough for the compiler to vectorize
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const double x = in[i].x();
+    const double y = in[i].y();
+    out[i].rx() = t.scale * x + t.dx;
+    out[i].ry() = t.scale * y + t.dy;
+  }
+}
+
+Building::TransformTable Building::transform_table()
+{
+  TransformTable table;
+  table.to_reference.reserve(levels.size());
+  table.anchored.reserve(levels.size());
+  for (std::size_t i = 0; i < levels.size(); i++)
+  {
+    const ReferenceTransform& rt = get_reference_transform(i);
+    table.to_reference.push_back(rt.transform);
+    table.anchored.push_back(rt.anchored);
+  }
+
+  // the workers can't compute transforms themselves, so precompute the
+  // pairs that can't go through the reference level
+  const int num_levels = static_cast<int>(levels.size());
+  for (int i = 0; i < num_levels; i++)
+  {
+    if (table.anchored[i])
+      continue;
+    for (int j = 0; j < num_levels; j++)
+    {
+      if (i == j)
+        continue;
+      table.direct[make_pair(i, j)] = get_transform(i, j);
+      table.direct[make_pair(j, i)] = get_transform(j, i);
+    }
+  }
+  return table;
+}
+
+Building::Transform Building::TransformTable::get(
+  const int from_level_idx,
+  const int to_level_idx) const
+{
+  if (from_level_idx == to_level_idx ||
+    from_level_idx < 0 || from_level_idx >= num_levels() ||
+    to_level_idx < 0 || to_level_idx >= num_levels())
+    return Transform();
+  if (!anchored[from_level_idx] || !anchored[to_level_idx])
+  {
+    auto it = direct.find(make_pair(from_level_idx, to_level_idx));
+    return it != direct.end() ? it->second : Transform();
+  }
+  return compose_transforms(
+    to_reference[from_level_idx],
+    to_reference[to_level_idx]);
+}
+
+bool Building::TransformTable::transform_between_levels(
+  const int from_level_idx,
+  const vector<QPointF>& from_points,
+  const int to_level_idx,
+  vector<QPointF>& to_points) const
+{
+  to_points.resize(from_points.size());
+  if (from_level_idx < 0 || from_level_idx >= num_levels() ||
+    to_level_idx < 0 || to_level_idx >= num_levels())
+  {
+    std::copy(from_points.begin(), from_points.end(), to_points.begin());
+    return false;
+  }
+
+  apply_transform(
+    get(from_level_idx, to_level_idx),
+    from_points.data(),
+    to_points.data(),
+    from_points.size());
+  return true;
+}
+
 void Building::clear_transform_cache()
 {
-  transforms.clear();
+  reference_transforms.clear();
+  reference_transforms_ref_idx = -1;
+  direct_transforms.clear();
+}
+
+void Building::invalidate_transform(const int level_idx)
+{
+  if (level_idx == reference_transforms_ref_idx)
+  {
+    // everything is expressed relative to this level
+    clear_transform_cache();
+    return;
+  }
+  if (level_idx >= 0 &&
+    level_idx < static_cast<int>(reference_transforms.size()))
+    reference_transforms[level_idx].valid = false;
+
+  // the level's fiducials may now anchor it, or no longer do
+  direct_transforms.clear();
 }
 
 Building::Transform Building::compute_transform(
@@ -541,28 +862,81 @@ Building::Transform Building::compute_transform(
   return t;
 }
 
-Building::Transform Building::get_transform(
+int Building::count_common_fiducials(
   const int from_level_idx,
-  const int to_level_idx)
+  const int to_level_idx) const
 {
-  // this operation is a bit "heavy" so we'll cache the transformations
-  // as they are computed
-  LevelPair level_pair;
-  level_pair.from_idx = from_level_idx;
-  level_pair.to_idx = to_level_idx;
+  int count = 0;
+  for (const Fiducial& f0 : levels[from_level_idx].fiducials)
+  {
+    for (const Fiducial& f1 : levels[to_level_idx].fiducials)
+    {
+      if (f0.name == f1.name)
+      {
+        count++;
+        break;
+      }
+    }
+  }
+  return count;
+}
 
-  TransformMap::iterator transform_it = transforms.find(level_pair);
-  Transform t;
+const Building::ReferenceTransform& Building::get_reference_transform(
+  const int level_idx)
+{
+  const int ref_idx = get_reference_level_idx();
+  if (ref_idx != reference_transforms_ref_idx)
+  {
+    clear_transform_cache();
+    reference_transforms_ref_idx = ref_idx;
+  }
+  if (reference_transforms.size() != levels.size())
+    reference_transforms.resize(levels.size());
 
-  if (transform_it == transforms.end())
+  // computing a transform is a bit "heavy" so we'll cache them as needed
+  ReferenceTransform& rt = reference_transforms[level_idx];
+  if (!rt.valid)
   {
-    // the transform wasn't in the cache, so we need to compute it
-    t = compute_transform(from_level_idx, to_level_idx);
-    transforms[level_pair] = t;
+    rt.transform = compute_transform(level_idx, ref_idx);
+    rt.anchored = level_idx == ref_idx ||
+      count_common_fiducials(level_idx, ref_idx) >= 2;
+    rt.valid = true;
   }
-  else
-    t = transform_it->second;
+  return rt;
+}
 
+Building::Transform Building::get_transform(
+  const int from_level_idx,
+  const int to_level_idx)
+{
+  if (from_level_idx == to_level_idx)
+    return Transform();
+
+  const ReferenceTransform from_ref = get_reference_transform(from_level_idx);
+  const ReferenceTransform to_ref = get_reference_transform(to_level_idx);
+  if (from_ref.anchored && to_ref.anchored)
+    return compose_transforms(from_ref.transform, to_ref.transform);
+
+  // the reference level can't relate these two, but they may still share
+  // fiducials with each other
+  const auto key = make_pair(from_level_idx, to_level_idx);
+  auto it = direct_transforms.find(key);
+  if (it == direct_transforms.end())
+    it = direct_transforms.emplace(
+      key, compute_transform(from_level_idx, to_level_idx)).first;
+  return it->second;
+}
+
+Building::Transform Building::compose_transforms(
+  const Transform& from_ref,
+  const Transform& to_ref)
+{
+  // go from the source level up to the reference level, then back down
+  // to the destination level
+  Transform t;
+  t.scale = from_ref.scale / to_ref.scale;
+  t.dx = (from_ref.dx - to_ref.dx) / to_ref.scale;
+  t.dy = (from_ref.dy - to_ref.dy) / to_ref.scale;
   return t;
 }
 
@@ -572,13 +946,6 @@ void Building::calculate_all_transforms()
     return;// let's not crash
 
   clear_transform_cache();
-  for (std::size_t i = 0; i < levels.size(); i++)
-  {
-    for (std::size_t j = 0; j < levels.size(); j++)
-    {
-      get_transform(i, j);
-    }
-  }
 
   // set drawing scale using this data
   const int ref_idx = get_reference_level_idx();
@@ -587,9 +954,12 @@ void Building::calculate_all_transforms()
   {
     if (i != get_reference_level_idx())
     {
+      // a level that can't be related to the reference level keeps its
+      // own scale rather than taking the reference's
+      if (!get_reference_transform(i).anchored)
+        continue;
       Transform t = get_transform(ref_idx, i);
-      if (levels[i].fiducials.size() >= 2)
-        levels[i].drawing_meters_per_pixel = ref_scale / t.scale;
+      levels[i].drawing_meters_per_pixel = ref_scale / t.scale;
     }
   }
 }
@@ -598,12 +968,27 @@ int Building::get_reference_level_idx()
 {
   if (reference_level_name.empty())
     return 0;
+  const int level_idx = find_level_idx(reference_level_name);
+  return level_idx >= 0 ? level_idx : 0;
+}
+
+int Building::find_level_idx(const std::string& level_name) const
+{
+  auto it = level_name_idx.find(level_name);
+  if (it != level_name_idx.end() &&
+    it->second < static_cast<int>(levels.size()) &&
+    levels[it->second].name == level_name)
+    return it->second;
+
+  // levels have been added, renamed or reloaded since the index was built
+  level_name_idx.clear();
   for (std::size_t i = 0; i < levels.size(); i++)
-  {
-    if (levels[i].name == reference_level_name)
-      return static_cast<int>(i);
-  }
-  return 0;
+    level_name_idx.emplace(levels[i].name, static_cast<int>(i));
+
+  it = level_name_idx.find(level_name);
+  if (it == level_name_idx.end())
+    return -1;
+  return it->second;
 }
 
 void Building::clear_scene()
@@ -715,12 +1100,10 @@ void Building::draw(
 
 Polygon* Building::get_selected_polygon(const int level_idx)
 {
-  for (std::size_t i = 0; i < levels[level_idx].polygons.size(); i++)
-  {
-    if (levels[level_idx].polygons[i].selected)
-      return &levels[level_idx].polygons[i];// abomination
-  }
-  return nullptr;
+  const std::set<int>& selected = levels[level_idx].selection().polygons;
+  if (selected.empty())
+    return nullptr;
+  return &levels[level_idx].polygons[*selected.begin()];// abomination
 }
 
 Polygon::EdgeDragPolygon Building::polygon_edge_drag_press(
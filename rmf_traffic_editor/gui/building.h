@@ -19,10 +19,14 @@
 #define BUILDING_H
 
 
+class QGraphicsItemGroup;
 class QGraphicsScene;
 
+#include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <unordered_map>
 #include <vector>
 #include <yaml-cpp/yaml.h>
 
@@ -52,8 +56,22 @@ public:
   bool set_filename(const std::string& _filename);
   std::string get_filename() { return filename; }
 
-  bool load(const std::string& filename);
+  /// LOAD_HEADLESS leaves out everything only the editor needs: it doesn't
+  /// change the working directory or build any pixmaps, which only the GUI
+  /// thread may do, so buildings can be loaded from worker threads.
+  enum LoadMode
+  {
+    LOAD_EDITOR,
+    LOAD_HEADLESS
+  };
+
+  bool load(const std::string& filename, const LoadMode mode = LOAD_EDITOR);
   bool save();
+
+  /// Check for problems that would make the building unusable downstream
+  /// (unreadable images, dangling references, duplicate names) and append
+  /// a human-readable description of each one to `problems`.
+  void validate(std::vector<std::string>& problems) const;
   void clear();  // clear all internal data structures
 
   bool export_features(
@@ -110,8 +128,17 @@ public:
     const int model_idx,
     const double yaw);
 
+  /// Add the lifts to the scene. Their graphics persist across redraws,
+  /// one group per (lift, level), and are only rebuilt when the lift's
+  /// geometry, the doors it opens on that level or the level's transform
+  /// change.
   void draw_lifts(QGraphicsScene* scene, const int level_idx);
 
+  /// Take the items that persist across redraws out of the scene, so
+  /// clearing it doesn't destroy them. Call this right before
+  /// QGraphicsScene::clear().
+  void detach_scene_items(QGraphicsScene* scene);
+
   bool transform_between_levels(
     const std::string& from_level_name,
     const QPointF& from_point,
@@ -124,18 +151,29 @@ public:
     const int to_level_idx,
     QPointF& to_point);
 
-  void clear_transform_cache();
+  /// Reproject many points from one level to another. The transform is
+  /// resolved once for the whole batch. `to_points` is resized to match.
+  bool transform_between_levels(
+    const int from_level_idx,
+    const std::vector<QPointF>& from_points,
+    const int to_level_idx,
+    std::vector<QPointF>& to_points);
 
-  struct LevelPair
-  {
-    int from_idx = -1;
-    int to_idx = -1;
+  /// Reproject the selected vertices, fiducials and models of one level
+  /// onto another, in the order returned by get_selected_items(). Other
+  /// selected items (edges, polygons, ...) have no single position and
+  /// are skipped.
+  bool transform_selection_between_levels(
+    const int from_level_idx,
+    const int to_level_idx,
+    std::vector<QPointF>& to_points);
 
-    bool operator<(const LevelPair& rhs) const
-    {
-      return std::tie(from_idx, to_idx) < std::tie(rhs.from_idx, rhs.to_idx);
-    }
-  };
+  void clear_transform_cache();
+
+  /// Forget the cached transform from this level to the reference level.
+  /// Call this whenever the fiducials of the level change. Invalidating
+  /// the reference level invalidates every level.
+  void invalidate_transform(const int level_idx);
 
   // to apply transform: first scale, then translate
   struct Transform
@@ -144,13 +182,48 @@ public:
     double dx = 0.0;
     double dy = 0.0;
   };
-  typedef std::map<LevelPair, Transform> TransformMap;
-  TransformMap transforms;
+
+  /// Apply `t` to `count` points. `in` and `out` may be the same array.
+  static void apply_transform(
+    const Transform& t,
+    const QPointF* in,
+    QPointF* out,
+    const std::size_t count);
+
+  /// A snapshot of every level's transform to the reference level, plus
+  /// the direct transforms of levels the reference level can't anchor. It
+  /// doesn't refer back to the Building, so it can be handed to worker
+  /// threads while the GUI thread keeps editing.
+  class TransformTable
+  {
+  public:
+    int num_levels() const { return static_cast<int>(to_reference.size()); }
+
+    Transform get(const int from_level_idx, const int to_level_idx) const;
+
+    bool transform_between_levels(
+      const int from_level_idx,
+      const std::vector<QPointF>& from_points,
+      const int to_level_idx,
+      std::vector<QPointF>& to_points) const;
+
+  private:
+    friend class Building;
+    std::vector<Transform> to_reference;
+    std::vector<bool> anchored;
+    std::map<std::pair<int, int>, Transform> direct;
+  };
+
+  /// Resolve any missing transforms and return a snapshot of all of them.
+  /// Must be called from the thread that owns the Building.
+  TransformTable transform_table();
 
   Transform compute_transform(
     const int from_level_idx,
     const int to_level_idx);
 
+  /// Composes the cached transforms of both levels to the reference level,
+  /// computing (only) whichever of those are missing or invalidated.
   Transform get_transform(
     const int from_level_idx,
     const int to_level_idx);
@@ -159,6 +232,9 @@ public:
 
   int get_reference_level_idx();
 
+  /// Returns the index of the level with this name, or -1 if none.
+  int find_level_idx(const std::string& level_name) const;
+
   void clear_scene();
 
   double level_meters_per_pixel(const std::string& level_name) const;
@@ -193,6 +269,57 @@ public:
 
 private:
   std::string filename;
+
+  // the transform from each level to the reference level, built lazily.
+  // A level is anchored if it shares at least two fiducials with the
+  // reference level; otherwise its transform to the reference is the
+  // default one and can't be composed with.
+  struct ReferenceTransform
+  {
+    Transform transform;
+    bool anchored = false;
+    bool valid = false;
+  };
+  std::vector<ReferenceTransform> reference_transforms;
+  int reference_transforms_ref_idx = -1;
+
+  // transforms between levels computed from their own common fiducials,
+  // for pairs where at least one level isn't anchored
+  std::map<std::pair<int, int>, Transform> direct_transforms;
+
+  const ReferenceTransform& get_reference_transform(const int level_idx);
+
+  int count_common_fiducials(
+    const int from_level_idx,
+    const int to_level_idx) const;
+
+  static Transform compose_transforms(
+    const Transform& from_ref,
+    const Transform& to_ref);
+
+  // Owns the lift graphics that aren't in a scene. The items belong to
+  // one scene, so copies of a building start without any.
+  class LiftGraphicsCache
+  {
+  public:
+    LiftGraphicsCache() {}
+    LiftGraphicsCache(const LiftGraphicsCache&) {}
+    LiftGraphicsCache& operator=(const LiftGraphicsCache&);
+    ~LiftGraphicsCache();
+
+    void clear();
+
+    struct Entry
+    {
+      std::size_t signature = 0;
+      QGraphicsItemGroup* group = nullptr;  // null if it doesn't stop here
+    };
+    std::map<std::pair<int, int>, Entry> entries;  // by (lift, level)
+  };
+  LiftGraphicsCache lift_graphics;
+
+  // rebuilt on demand when a lookup finds it stale
+  mutable std::unordered_map<std::string, int> level_name_idx;
 };
 
 #endif
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "bvh.h"
+
+using std::size_t;
+using std::vector;
+
+namespace {
+
+// small enough that a leaf is about as cheap to test as a node
+const size_t max_leaf_size = 4;
+
+}  // namespace
+
+bool Bvh::Box::contains(const QPointF& p) const
+{
+  return p.x() >= min_x && p.x() <= max_x &&
+    p.y() >= min_y && p.y() <= max_y;
+}
+
+bool Bvh::Box::intersects(const Box& b) const
+{
+  return b.min_x <= max_x && b.max_x >= min_x &&
+    b.min_y <= max_y && b.max_y >= min_y;
+}
+
+double Bvh::Box::distance(const QPointF& p) const
+{
+  const double dx = std::max(std::max(min_x - p.x(), p.x() - max_x), 0.0);
+  const double dy = std::max(std::max(min_y - p.y(), p.y() - max_y), 0.0);
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+void Bvh::build(const vector<Box>& _boxes)
+{
+  boxes = _boxes;
+  nodes.clear();
+  items.resize(boxes.size());
+  for (size_t i = 0; i < boxes.size(); i++)
+    items[i] = static_cast<int>(i);
+  if (!boxes.empty())
+    build(0, boxes.size());
+}
+
+void Bvh::build(const size_t begin, const size_t end)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  Box box{inf, inf, -inf, -inf};
+  Box centers{inf, inf, -inf, -inf};
+  for (size_t i = begin; i < end; i++)
+  {
+    const Box& b = boxes[items[i]];
+    box.min_x = std::min(box.min_x, b.min_x);
+    box.min_y = std::min(box.min_y, b.min_y);
+    box.max_x = std::max(box.max_x, b.max_x);
+    box.max_y = std::max(box.max_y, b.max_y);
+    const double cx = b.min_x + b.max_x;
+    const double cy = b.min_y + b.max_y;
+    centers.min_x = std::min(centers.min_x, cx);
+    centers.min_y = std::min(centers.min_y, cy);
+    centers.max_x = std::max(centers.max_x, cx);
+    centers.max_y = std::max(centers.max_y, cy);
+  }
+
+  const size_t node_idx = nodes.size();
+  nodes.push_back(Node{box, 0, static_cast<int>(begin), 0});
+  if (end - begin <= max_leaf_size)
+  {
+    nodes[node_idx].count = static_cast<int>(end - begin);
+    nodes[node_idx].skip = static_cast<int>(nodes.size());
+    return;
+  }
+
+  // split at the median center along the longer side
+  const bool split_x =
+    centers.max_x - centers.min_x >= centers.max_y - centers.min_y;
+  const size_t mid = begin + (end - begin) / 2;
+  std::nth_element(
+    items.begin() + begin,
+    items.begin() + mid,
+    items.begin() + end,
+    [this, split_x](const int a, const int b)
+    {
+      const Box& ba = boxes[a];
+      const Box& bb = boxes[b];
+      if (split_x)
+        return ba.min_x + ba.max_x < bb.min_x + bb.max_x;
+      return ba.min_y + ba.max_y < bb.min_y + bb.max_y;
+    });
+
+  build(begin, mid);
+  build(mid, end);
+  nodes[node_idx].skip = static_cast<int>(nodes.size());
+}
+
+void Bvh::clear()
+{
+  boxes.clear();
+  nodes.clear();
+  items.clear();
+}
+
+void Bvh::for_each_containing(
+  const QPointF& p,
+  const std::function<void(int)>& f) const
+{
+  size_t i = 0;
+  while (i < nodes.size())
+  {
+    const Node& node = nodes[i];
+    if (!node.box.contains(p))
+    {
+      i = node.skip;
+      continue;
+    }
+    for (int j = node.first; j < node.first + node.count; j++)
+    {
+      if (boxes[items[j]].contains(p))
+        f(items[j]);
+    }
+    i++;
+  }
+}
+
+void Bvh::for_each_intersecting(
+  const Box& box,
+  const std::function<void(int)>& f) const
+{
+  size_t i = 0;
+  while (i < nodes.size())
+  {
+    const Node& node = nodes[i];
+    if (!node.box.intersects(box))
+    {
+      i = node.skip;
+      continue;
+    }
+    for (int j = node.first; j < node.first + node.count; j++)
+    {
+      if (boxes[items[j]].intersects(box))
+        f(items[j]);
+    }
+    i++;
+  }
+}
+
+int Bvh::nearest(
+  const QPointF& p,
+  const std::function<double(int)>& distance) const
+{
+  int best = -1;
+  double best_distance = std::numeric_limits<double>::infinity();
+  if (nodes.empty())
+    return best;
+
+  // visit the nearer child first, so the other one can usually be skipped
+  vector<int> stack(1, 0);
+  while (!stack.empty())
+  {
+    const Node& node = nodes[stack.back()];
+    const int node_idx = stack.back();
+    stack.pop_back();
+    // a box at the same distance may still hold an earlier item
+    if (node.box.distance(p) > best_distance)
+      continue;
+
+    if (node.count > 0)
+    {
+      for (int j = node.first; j < node.first + node.count; j++)
+      {
+        const double d = distance(items[j]);
+        if (d < best_distance || (d == best_distance && items[j] < best))
+        {
+          best = items[j];
+          best_distance = d;
+        }
+      }
+      continue;
+    }
+
+    const int a = node_idx + 1;
+    const int b = nodes[a].skip;
+    if (nodes[a].box.distance(p) <= nodes[b].box.distance(p))
+    {
+      stack.push_back(b);
+      stack.push_back(a);
+    }
+    else
+    {
+      stack.push_back(a);
+      stack.push_back(b);
+    }
+  }
+  return best;
+}
+
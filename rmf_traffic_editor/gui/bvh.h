@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <QPointF>
+
+
+/// A bounding volume hierarchy over a set of axis-aligned boxes, which
+/// are referred to by their index in the vector it was built from. Used
+/// for picking and region queries that would otherwise test every item of
+/// a level.
+class Bvh
+{
+public:
+  struct Box
+  {
+    double min_x, min_y, max_x, max_y;
+
+    bool contains(const QPointF& p) const;
+    bool intersects(const Box& b) const;
+    double distance(const QPointF& p) const;
+  };
+
+  void build(const std::vector<Box>& boxes);
+  void clear();
+  bool empty() const { return nodes.empty(); }
+
+  /// Calls f with the index of every box that contains `p`, in no
+  /// particular order
+  void for_each_containing(
+    const QPointF& p,
+    const std::function<void(int)>& f) const;
+
+  /// Calls f with the index of every box that overlaps `box`, in no
+  /// particular order
+  void for_each_intersecting(
+    const Box& box,
+    const std::function<void(int)>& f) const;
+
+  /// The index of the item nearest to `p` as measured by `distance`,
+  /// which must be no less than the distance to the item's box, or -1 if
+  /// there are none. The lowest index wins ties.
+  int nearest(
+    const QPointF& p,
+    const std::function<double(int)>& distance) const;
+
+private:
+  // Nodes are stored depth-first: a node's first child directly follows
+  // it, and `skip` is the index just past its subtree.
+  struct Node
+  {
+    Box box;
+    int skip;
+    int first;  // into items, for leaves
+    int count;  // zero for inner nodes
+  };
+  std::vector<Box> boxes;
+  std::vector<Node> nodes;
+  std::vector<int> items;  // indices of boxes, grouped by leaf
+
+  void build(const std::size_t begin, const std::size_t end);
+};
+
+#endif
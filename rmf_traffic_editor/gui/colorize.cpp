@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "colorize.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace colorize {
+
+static inline uint32_t colorize_pixel(const uint8_t in, const uint32_t color)
+{
+  if (in < occupied_threshold)
+    return color;
+  else if (in > free_threshold)
+    return 0;
+  return (static_cast<uint32_t>(unknown_alpha) << 24) |
+         (static_cast<uint32_t>(in) << 16) |
+         (static_cast<uint32_t>(in) << 8) |
+         static_cast<uint32_t>(in);
+}
+
+void grayscale_row_to_argb(
+  const uint8_t* in,
+  uint32_t* out,
+  const int width,
+  const uint32_t color,
+  const bool solid)
+{
+  if (solid)
+  {
+    for (int i = 0; i < width; i++)
+      out[i] = color;
+    return;
+  }
+
+  int i = 0;
+
+#if defined(__SSE2__)
+  // SSE2 only has signed byte comparisons, so bias everything by 0x80 to
+  // turn the unsigned threshold tests into signed ones.
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i occupied = _mm_set1_epi8(
+    static_cast<char>(occupied_threshold ^ 0x80));
+  const __m128i free = _mm_set1_epi8(
+    static_cast<char>(free_threshold ^ 0x80));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi32(
+    static_cast<int>(static_cast<uint32_t>(unknown_alpha) << 24));
+  const __m128i color_v = _mm_set1_epi32(static_cast<int>(color));
+
+  for (; i + 16 <= width; i += 16)
+  {
+    const __m128i px =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i biased = _mm_xor_si128(px, bias);
+    const __m128i is_occupied = _mm_cmplt_epi8(biased, occupied);
+    const __m128i is_free = _mm_cmpgt_epi8(biased, free);
+
+    // widen 16 bytes to 4x4 32-bit lanes: gray values and both masks
+    const __m128i px_lo16 = _mm_unpacklo_epi8(px, zero);
+    const __m128i px_hi16 = _mm_unpackhi_epi8(px, zero);
+    const __m128i occ_lo16 = _mm_unpacklo_epi8(is_occupied, is_occupied);
+    const __m128i occ_hi16 = _mm_unpackhi_epi8(is_occupied, is_occupied);
+    const __m128i free_lo16 = _mm_unpacklo_epi8(is_free, is_free);
+    const __m128i free_hi16 = _mm_unpackhi_epi8(is_free, is_free);
+
+    const __m128i gray[4] = {
+      _mm_unpacklo_epi16(px_lo16, zero),
+      _mm_unpackhi_epi16(px_lo16, zero),
+      _mm_unpacklo_epi16(px_hi16, zero),
+      _mm_unpackhi_epi16(px_hi16, zero)
+    };
+    const __m128i occ[4] = {
+      _mm_unpacklo_epi16(occ_lo16, occ_lo16),
+      _mm_unpackhi_epi16(occ_lo16, occ_lo16),
+      _mm_unpacklo_epi16(occ_hi16, occ_hi16),
+      _mm_unpackhi_epi16(occ_hi16, occ_hi16)
+    };
+    const __m128i fr[4] = {
+      _mm_unpacklo_epi16(free_lo16, free_lo16),
+      _mm_unpackhi_epi16(free_lo16, free_lo16),
+      _mm_unpacklo_epi16(free_hi16, free_hi16),
+      _mm_unpackhi_epi16(free_hi16, free_hi16)
+    };
+
+    for (int j = 0; j < 4; j++)
+    {
+      // replicate gray into R, G and B and add the "unknown" alpha
+      __m128i v = _mm_or_si128(
+        _mm_or_si128(gray[j], _mm_slli_epi32(gray[j], 8)),
+        _mm_or_si128(_mm_slli_epi32(gray[j], 16), alpha));
+
+      // free pixels are fully transparent
+      v = _mm_andnot_si128(fr[j], v);
+
+      // occupied pixels take the layer color
+      v = _mm_or_si128(
+        _mm_and_si128(occ[j], color_v),
+        _mm_andnot_si128(occ[j], v));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4 * j), v);
+    }
+  }
+#endif
+
+  for (; i < width; i++)
+    out[i] = colorize_pixel(in[i], color);
+}
+
+void grayscale_to_argb(
+  const uint8_t* in,
+  const int in_stride,
+  uint32_t* out,
+  const int out_stride,
+  const int width,
+  const int height,
+  const uint32_t color)
+{
+  if (width <= 0 || height <= 0)
+    return;
+
+  for (int row_idx = 0; row_idx < height; row_idx++)
+  {
+    const uint8_t* in_row = in + row_idx * in_stride;
+    uint32_t* out_row = reinterpret_cast<uint32_t*>(
+      reinterpret_cast<uint8_t*>(out) + row_idx * out_stride);
+
+    grayscale_row_to_argb(
+      in_row,
+      out_row,
+      width,
+      color,
+      row_idx == 0 || row_idx == height - 1);
+
+    // draw bold first/last columns the requested color on the image,
+    // so it's easier to see what's going on with its transform
+    out_row[0] = color;
+    out_row[width - 1] = color;
+  }
+}
+
+}  // namespace colorize
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef COLORIZE_H
+#define COLORIZE_H
+
+#include <cstdint>
+
+namespace colorize {
+
+/// Grayscale occupancy values below this are drawn in the layer color
+const uint8_t occupied_threshold = 100;
+
+/// Grayscale occupancy values above this are drawn fully transparent
+const uint8_t free_threshold = 200;
+
+/// Alpha applied to the "unknown" band between the two thresholds
+const uint8_t unknown_alpha = 50;
+
+/// Colorize one row of an 8-bit grayscale occupancy image into 32-bit
+/// ARGB pixels (the QRgb / QImage::Format_ARGB32 layout). Dark pixels become
+/// `color` (which carries the layer alpha), light pixels become transparent,
+/// and everything in between is kept as translucent gray. If `solid` is
+/// true the entire row is filled with `color`, which is used to outline the
+/// first and last rows of the image.
+///
+/// This uses SSE2 when the compiler targets it (always true on x86_64) and
+/// falls back to a scalar loop elsewhere.
+void grayscale_row_to_argb(
+  const uint8_t* in,
+  uint32_t* out,
+  const int width,
+  const uint32_t color,
+  const bool solid = false);
+
+/// Colorize a full image, row by row. Strides are in bytes.
+void grayscale_to_argb(
+  const uint8_t* in,
+  const int in_stride,
+  uint32_t* out,
+  const int out_stride,
+  const int width,
+  const int height,
+  const uint32_t color);
+
+}  // namespace colorize
+
+#endif
@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <utility>
+
+#include <QElapsedTimer>
+#include <QGraphicsLineItem>
+#include <QGraphicsScene>
+#include <QPen>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include "building.h"
+#include "congestion_estimator.h"
+
+using std::vector;
+
+
+namespace {
+
+// one step of a precomputed route: a lane (by its building-wide index)
+// or a lift ride (lane == -1), and how long it takes
+struct Hop
+{
+  int lane;
+  double duration;
+};
+
+// a robot on a lane from t0 to t1
+struct Interval
+{
+  int lane;
+  double t0;
+  double t1;
+};
+
+// running totals over a share of the samples, one per worker
+struct Totals
+{
+  vector<double> traversals;
+  vector<double> occupancy;
+  vector<double> contention;
+  vector<double> waits;
+  int num_tasks = 0;
+  int num_failed_tasks = 0;
+  double duration = 0.0;
+
+  explicit Totals(const std::size_t num_lanes)
+  : traversals(num_lanes, 0.0),
+    occupancy(num_lanes, 0.0),
+    contention(num_lanes, 0.0),
+    waits(num_lanes, 0.0)
+  {
+  }
+};
+
+}  // namespace
+
+CongestionEstimator::Result CongestionEstimator::estimate(
+  const NavGraph& nav_graph,
+  const Building& building,
+  const bool human_lanes,
+  const int graph_idx,
+  const TaskMix& mix)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  Result result;
+  result.graph_idx = graph_idx;
+  result.human_lanes = human_lanes;
+
+  // Lanes are numbered across the building by offsetting each level's
+  // edge indices, so per-lane totals can live in flat arrays.
+  const int num_levels = static_cast<int>(building.levels.size());
+  vector<int> lane_base(num_levels + 1, 0);
+  for (int i = 0; i < num_levels; i++)
+    lane_base[i + 1] =
+      lane_base[i] + static_cast<int>(building.levels[i].edges.size());
+  const std::size_t num_lanes = lane_base[num_levels];
+
+  // collect the task vertices that are actually on this graph
+  const Edge::Type lane_type = human_lanes ? Edge::HUMAN_LANE : Edge::LANE;
+  vector<NavGraph::Node> task_vertices;
+  vector<int> pickups, dropoffs, chargers, parking, named;
+  for (int i = 0; i < num_levels; i++)
+  {
+    const Level& level = building.levels[i];
+    const int num_vertices = static_cast<int>(level.vertices.size());
+    vector<char> on_graph(num_vertices, 0);
+    for (const Edge& e : level.edges)
+    {
+      if (e.type != lane_type || e.get_graph_idx() != graph_idx)
+        continue;
+      if (e.start_idx >= 0 && e.start_idx < num_vertices)
+        on_graph[e.start_idx] = 1;
+      if (e.end_idx >= 0 && e.end_idx < num_vertices)
+        on_graph[e.end_idx] = 1;
+    }
+
+    for (int j = 0; j < num_vertices; j++)
+    {
+      const Vertex& v = level.vertices[j];
+      if (!on_graph[j])
+        continue;
+      const int idx = static_cast<int>(task_vertices.size());
+      bool is_task_vertex = true;
+      if (!v.pickup_dispenser().empty())
+        pickups.push_back(idx);
+      else if (!v.dropoff_ingestor().empty())
+        dropoffs.push_back(idx);
+      else if (v.is_charger())
+        chargers.push_back(idx);
+      else if (v.is_parking_point())
+        parking.push_back(idx);
+      else if (!v.name.empty())
+        named.push_back(idx);
+      else
+        is_task_vertex = false;
+
+      if (is_task_vertex)
+      {
+        NavGraph::Node node;
+        node.level_idx = i;
+        node.vertex_idx = j;
+        task_vertices.push_back(node);
+      }
+    }
+  }
+
+  if (pickups.empty() || dropoffs.empty())
+  {
+    pickups = named;
+    dropoffs = named;
+  }
+  vector<int> homes = chargers;
+  homes.insert(homes.end(), parking.begin(), parking.end());
+  if (homes.empty())
+    homes = pickups;
+
+  const int num_task_vertices = static_cast<int>(task_vertices.size());
+  result.num_task_vertices = num_task_vertices;
+  if (homes.empty() || pickups.empty())
+  {
+    result.elapsed_ms = timer.nsecsElapsed() / 1e6;
+    return result;
+  }
+
+  // Routes between every pair of task vertices, one search per source.
+  // Pair (from, to) is at paths[from * num_task_vertices + to].
+  const std::size_t num_pairs =
+    static_cast<std::size_t>(num_task_vertices) * num_task_vertices;
+  vector<vector<Hop>> paths(num_pairs);
+  vector<char> reachable(num_pairs, 0);
+  vector<int> sources(num_task_vertices);
+  std::iota(sources.begin(), sources.end(), 0);
+
+  QtConcurrent::blockingMap(
+    sources,
+    [&](const int from)
+    {
+      NavGraph::Workspace workspace;
+      vector<NavGraph::Route> routes;
+      nav_graph.find_routes(
+        task_vertices[from],
+        task_vertices,
+        human_lanes,
+        graph_idx,
+        workspace,
+        routes);
+
+      for (int to = 0; to < num_task_vertices; to++)
+      {
+        const NavGraph::Route& route = routes[to];
+        const std::size_t pair =
+          static_cast<std::size_t>(from) * num_task_vertices + to;
+        if (!route.found)
+          continue;
+        reachable[pair] = 1;
+        vector<Hop>& hops = paths[pair];
+        hops.reserve(route.edges.size());
+        for (std::size_t k = 0; k < route.edges.size(); k++)
+        {
+          Hop hop;
+          hop.lane = route.edges[k] < 0 ? -1 :
+            lane_base[route.nodes[k].level_idx] + route.edges[k];
+          hop.duration =
+            (route.costs[k + 1] - route.costs[k]) / mix.robot_speed;
+          hops.push_back(hop);
+        }
+      }
+    });
+
+  // Replay the samples in a few chunks, each with its own totals. Every
+  // sample seeds its own generator, so the estimate doesn't depend on how
+  // the samples are split between threads.
+  const int num_chunks =
+    std::max(1, std::min(mix.num_samples, QThread::idealThreadCount()));
+  vector<Totals> chunk_totals(num_chunks, Totals(num_lanes));
+  vector<int> chunks(num_chunks);
+  std::iota(chunks.begin(), chunks.end(), 0);
+
+  const double total_weight =
+    mix.delivery_weight + mix.charging_weight + mix.parking_weight;
+
+  QtConcurrent::blockingMap(
+    chunks,
+    [&](const int chunk)
+    {
+      Totals& totals = chunk_totals[chunk];
+      vector<Interval> intervals;
+      vector<Interval> grouped;
+      vector<int> lane_count(num_lanes, 0);
+      vector<int> used_lanes;
+      vector<std::pair<double, int>> events;
+
+      for (int sample = chunk; sample < mix.num_samples;
+        sample += num_chunks)
+      {
+        std::mt19937 rng(mix.seed * 1000003u + sample);
+        auto pick = [&rng](const vector<int>& choices)
+          {
+            return choices[std::uniform_int_distribution<std::size_t>(
+                0, choices.size() - 1)(rng)];
+          };
+        std::uniform_real_distribution<double> task_type(0.0, total_weight);
+
+        intervals.clear();
+        double sample_duration = 0.0;
+        for (int robot = 0; robot < mix.num_robots; robot++)
+        {
+          int at = pick(homes);
+          double t = 0.0;
+
+          // Returns false if there is no route. Otherwise the robot takes
+          // it, and then waits at the destination for the dwell time.
+          auto go_to = [&](const int to)
+            {
+              const std::size_t pair =
+                static_cast<std::size_t>(at) * num_task_vertices + to;
+              if (!reachable[pair])
+                return false;
+              for (const Hop& hop : paths[pair])
+              {
+                if (hop.lane >= 0)
+                  intervals.push_back(
+                    Interval{hop.lane, t, t + hop.duration});
+                t += hop.duration;
+              }
+              at = to;
+              t += mix.dwell_time;
+              return true;
+            };
+
+          for (int task = 0; task < mix.tasks_per_robot; task++)
+          {
+            const double r = task_type(rng);
+            bool ok = true;
+            if (r < mix.delivery_weight)
+              ok = go_to(pick(pickups)) && go_to(pick(dropoffs));
+            else if (r < mix.delivery_weight + mix.charging_weight &&
+              !chargers.empty())
+              ok = go_to(pick(chargers));
+            else if (!parking.empty())
+              ok = go_to(pick(parking));
+            else
+              ok = go_to(pick(homes));
+
+            totals.num_tasks++;
+            if (!ok)
+              totals.num_failed_tasks++;
+          }
+          sample_duration = std::max(sample_duration, t);
+        }
+
+        if (sample_duration <= 0.0)
+          continue;
+        totals.duration += sample_duration;
+
+        // Group the intervals by lane, with a counting sort over just the
+        // lanes that were used; a comparison sort would dominate the run.
+        used_lanes.clear();
+        for (const Interval& interval : intervals)
+        {
+          if (lane_count[interval.lane]++ == 0)
+            used_lanes.push_back(interval.lane);
+        }
+        int offset = 0;
+        for (const int lane : used_lanes)
+        {
+          const int count = lane_count[lane];
+          lane_count[lane] = offset;
+          offset += count;
+        }
+        grouped.resize(intervals.size());
+        for (const Interval& interval : intervals)
+          grouped[lane_count[interval.lane]++] = interval;
+
+        // sweep over each lane's intervals to find how long it was busy,
+        // how long it was shared, and how often someone had to wait
+        std::size_t begin = 0;
+        for (const int lane : used_lanes)
+        {
+          const std::size_t end = lane_count[lane];
+          lane_count[lane] = 0;
+          events.clear();
+          for (std::size_t k = begin; k < end; k++)
+          {
+            events.push_back(std::make_pair(grouped[k].t0, 1));
+            events.push_back(std::make_pair(grouped[k].t1, -1));
+          }
+          // at equal times, robots leave before others enter
+          std::sort(events.begin(), events.end());
+
+          double busy = 0.0;
+          double shared = 0.0;
+          int waits = 0;
+          int count = 0;
+          for (std::size_t k = 0; k < events.size(); k++)
+          {
+            if (k > 0)
+            {
+              const double dt = events[k].first - events[k - 1].first;
+              if (count >= 1)
+                busy += dt;
+              if (count >= 2)
+                shared += dt;
+            }
+            if (events[k].second > 0 && count > 0)
+              waits++;
+            count += events[k].second;
+          }
+
+          totals.traversals[lane] += end - begin;
+          totals.occupancy[lane] += busy / sample_duration;
+          totals.contention[lane] += shared / sample_duration;
+          totals.waits[lane] += waits;
+          begin = end;
+        }
+      }
+    });
+
+  // combine the chunks and keep the lanes that were used
+  Totals& totals = chunk_totals[0];
+  for (int chunk = 1; chunk < num_chunks; chunk++)
+  {
+    const Totals& other = chunk_totals[chunk];
+    for (std::size_t lane = 0; lane < num_lanes; lane++)
+    {
+      totals.traversals[lane] += other.traversals[lane];
+      totals.occupancy[lane] += other.occupancy[lane];
+      totals.contention[lane] += other.contention[lane];
+      totals.waits[lane] += other.waits[lane];
+    }
+    totals.num_tasks += other.num_tasks;
+    totals.num_failed_tasks += other.num_failed_tasks;
+    totals.duration += other.duration;
+  }
+
+  const double num_samples = std::max(1, mix.num_samples);
+  for (int i = 0; i < num_levels; i++)
+  {
+    for (int lane = lane_base[i]; lane < lane_base[i + 1]; lane++)
+    {
+      if (totals.traversals[lane] == 0.0)
+        continue;
+      LaneStats stats;
+      stats.level_idx = i;
+      stats.edge_idx = lane - lane_base[i];
+      stats.traversals = totals.traversals[lane] / num_samples;
+      stats.occupancy = totals.occupancy[lane] / num_samples;
+      stats.contention = totals.contention[lane] / num_samples;
+      stats.waits = totals.waits[lane] / num_samples;
+      result.max_occupancy = std::max(result.max_occupancy, stats.occupancy);
+      result.lanes.push_back(stats);
+    }
+  }
+
+  result.valid = true;
+  result.num_tasks = totals.num_tasks;
+  result.num_failed_tasks = totals.num_failed_tasks;
+  result.mean_duration = totals.duration / num_samples;
+  result.elapsed_ms = timer.nsecsElapsed() / 1e6;
+  return result;
+}
+
+void CongestionEstimator::draw(
+  QGraphicsScene* scene,
+  const Result& result,
+  const Level& level,
+  const int level_idx)
+{
+  if (!result.valid || result.max_occupancy <= 0.0)
+    return;
+
+  const double width = 0.6 / level.drawing_meters_per_pixel;
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  const int num_edges = static_cast<int>(level.edges.size());
+
+  for (const LaneStats& stats : result.lanes)
+  {
+    if (stats.level_idx != level_idx || stats.edge_idx >= num_edges)
+      continue;
+    const Edge& e = level.edges[stats.edge_idx];
+    if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+      e.end_idx < 0 || e.end_idx >= num_vertices)
+      continue;
+
+    // green -> yellow -> red as the lane gets busier
+    const double heat = stats.occupancy / result.max_occupancy;
+    const QColor color = QColor::fromRgbF(
+      std::min(1.0, 2.0 * heat),
+      std::min(1.0, 2.0 * (1.0 - heat)),
+      0.0,
+      0.7);
+
+    const Vertex& start = level.vertices[e.start_idx];
+    const Vertex& end = level.vertices[e.end_idx];
+    QGraphicsLineItem* item = scene->addLine(
+      start.x, start.y, end.x, end.y,
+      QPen(color, width, Qt::SolidLine, Qt::RoundCap));
+    item->setToolTip(
+      QString("lane %1: %2 traversals, busy %3% of the time, "
+      "shared %4% of the time, %5 waits (per sample)")
+      .arg(stats.edge_idx)
+      .arg(stats.traversals, 0, 'f', 1)
+      .arg(100.0 * stats.occupancy, 0, 'f', 1)
+      .arg(100.0 * stats.contention, 0, 'f', 1)
+      .arg(stats.waits, 0, 'f', 1));
+    item->setZValue(240.0);
+  }
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef CONGESTION_ESTIMATOR_H
+#define CONGESTION_ESTIMATOR_H
+
+#include <vector>
+
+#include "nav_graph.h"
+
+class Building;
+class Level;
+class QGraphicsScene;
+
+
+/// Estimates where robots of one fleet would crowd each other, by running
+/// many randomized samples of a synthetic task mix over a lane graph.
+///
+/// Tasks run between the task vertices of the graph: deliveries from a
+/// pickup_dispenser vertex to a dropoff_ingestor vertex, and trips to
+/// chargers and parking spots. Buildings without dispensers or ingestors
+/// get deliveries between named vertices instead. Each robot starts at a
+/// random charger or parking spot, and follows the shortest route of
+/// each trip at a constant speed.
+///
+/// Robots don't react to each other, so this measures exposure, not
+/// delay: how often and how long robots would want the same lane at the
+/// same time. That is enough to find the lanes where they would queue.
+///
+/// The routes between every pair of task vertices are found once per
+/// estimate, one Dijkstra search per vertex, and the samples then only
+/// replay them. Both steps run in parallel.
+class CongestionEstimator
+{
+public:
+  struct TaskMix
+  {
+    int num_robots = 10;
+    int tasks_per_robot = 10;
+    int num_samples = 64;
+
+    // relative frequencies of the task types
+    double delivery_weight = 1.0;
+    double charging_weight = 0.1;
+    double parking_weight = 0.2;
+
+    double robot_speed = 0.5;  // m/s
+    double dwell_time = 30.0;  // seconds spent at each task vertex
+    unsigned int seed = 1;  // the same seed gives the same estimate
+  };
+
+  struct LaneStats
+  {
+    int level_idx = -1;
+    int edge_idx = -1;
+    double traversals = 0.0;  // per sample
+    double occupancy = 0.0;  // fraction of the time anyone is on it
+    double contention = 0.0;  // fraction of the time two or more are
+    double waits = 0.0;  // per sample, robots entering it while occupied
+  };
+
+  struct Result
+  {
+    bool valid = false;
+    int graph_idx = 0;
+    bool human_lanes = false;
+
+    std::vector<LaneStats> lanes;  // only lanes that were used
+    double max_occupancy = 0.0;
+
+    int num_task_vertices = 0;
+    int num_tasks = 0;  // over all samples
+    int num_failed_tasks = 0;  // tasks with a trip that had no route
+    double mean_duration = 0.0;  // seconds until the last robot is done
+    double elapsed_ms = 0.0;
+  };
+
+  /// Run the estimate over the current state of `nav_graph`, which must
+  /// have been updated from `building`.
+  static Result estimate(
+    const NavGraph& nav_graph,
+    const Building& building,
+    const bool human_lanes,
+    const int graph_idx,
+    const TaskMix& mix);
+
+  /// Draw the lanes of one level colored by how busy they are, from green
+  /// (rarely used) to red (the busiest lane in the building)
+  static void draw(
+    QGraphicsScene* scene,
+    const Result& result,
+    const Level& level,
+    const int level_idx);
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <traffic_editor/crowd_sim/condition_program.h>
+
+#include <algorithm>
+
+using namespace crowd_sim;
+
+const std::size_t ConditionProgram::block_size;
+
+//===========================================================
+ConditionProgram::ConditionProgram()
+: _code({{OpCode::FALSE_CONST, 0.0}}),
+  _stack_depth(1)
+{
+}
+
+//===========================================================
+ConditionProgram ConditionProgram::compile(const Condition& root)
+{
+  ConditionProgram program;
+  program._code.clear();
+  program._compile(root);
+
+  std::size_t depth = 0;
+  program._stack_depth = 0;
+  for (const Instruction& instruction : program._code)
+  {
+    switch (instruction.op)
+    {
+      case OpCode::AND:
+      case OpCode::OR:
+        depth--;
+        break;
+      case OpCode::NOT:
+        break;
+      default:
+        depth++;
+        break;
+    }
+    program._stack_depth = std::max(program._stack_depth, depth);
+  }
+  return program;
+}
+
+//===========================================================
+void ConditionProgram::_compile(const Condition& condition)
+{
+  switch (condition.get_type())
+  {
+    case Condition::GOAL:
+    case Condition::TIMER:
+    {
+      const LeafCondition* leaf =
+        dynamic_cast<const LeafCondition*>(&condition);
+      if (!leaf)
+        break;
+      const OpCode op = condition.get_type() == Condition::GOAL ?
+        OpCode::GOAL : OpCode::TIMER;
+      _code.push_back({op, leaf->get_value()});
+      return;
+    }
+    case Condition::AND:
+    case Condition::OR:
+    case Condition::NOT:
+    {
+      const BoolCondition* b = dynamic_cast<const BoolCondition*>(&condition);
+      if (!b)
+        break;
+      const ConditionPtr c1 = b->get_condition(1);
+      if (!c1)
+        break;
+      if (condition.get_type() == Condition::NOT)
+      {
+        _compile(*c1);
+        _code.push_back({OpCode::NOT, 0.0});
+        return;
+      }
+      const ConditionPtr c2 = b->get_condition(2);
+      if (!c2)
+        break;
+      _compile(*c1);
+      _compile(*c2);
+      _code.push_back(
+        {condition.get_type() == Condition::AND ? OpCode::AND : OpCode::OR,
+          0.0});
+      return;
+    }
+    default:
+      break;
+  }
+  _code.push_back({OpCode::FALSE_CONST, 0.0});
+}
+
+//===========================================================
+bool ConditionProgram::evaluate(
+  const double goal_distance,
+  const double state_time) const
+{
+  std::uint8_t small_stack[16];
+  std::vector<std::uint8_t> large_stack;
+  std::uint8_t* stack = small_stack;
+  if (_stack_depth > 16)
+  {
+    large_stack.resize(_stack_depth);
+    stack = large_stack.data();
+  }
+
+  std::size_t top = 0;  // the next free slot
+  for (const Instruction& instruction : _code)
+  {
+    switch (instruction.op)
+    {
+      case OpCode::FALSE_CONST:
+        stack[top++] = 0;
+        break;
+      case OpCode::GOAL:
+        stack[top++] = goal_distance <= instruction.value;
+        break;
+      case OpCode::TIMER:
+        stack[top++] = state_time >= instruction.value;
+        break;
+      case OpCode::AND:
+        top--;
+        stack[top - 1] &= stack[top];
+        break;
+      case OpCode::OR:
+        top--;
+        stack[top - 1] |= stack[top];
+        break;
+      case OpCode::NOT:
+        stack[top - 1] ^= 1;
+        break;
+    }
+  }
+  return stack[0] != 0;
+}
+
+//===========================================================
+void ConditionProgram::evaluate(
+  const ConditionInputs& inputs,
+  std::uint8_t* results) const
+{
+  // one row of the stack per level, each holding a block of agents
+  std::uint8_t small_stack[4 * block_size];
+  std::vector<std::uint8_t> large_stack;
+  std::uint8_t* stack = small_stack;
+  if (_stack_depth > 4)
+  {
+    large_stack.resize(_stack_depth * block_size);
+    stack = large_stack.data();
+  }
+
+  for (std::size_t base = 0; base < inputs.count; base += block_size)
+  {
+    const std::size_t n = std::min(block_size, inputs.count - base);
+    const double* goal_distance = inputs.goal_distance + base;
+    const double* state_time = inputs.state_time + base;
+
+    std::uint8_t* top = stack;  // the next free row
+    for (const Instruction& instruction : _code)
+    {
+      const double value = instruction.value;
+      switch (instruction.op)
+      {
+        case OpCode::FALSE_CONST:
+          std::fill(top, top + n, 0);
+          top += block_size;
+          break;
+        case OpCode::GOAL:
+          for (std::size_t i = 0; i < n; i++)
+            top[i] = goal_distance[i] <= value;
+          top += block_size;
+          break;
+        case OpCode::TIMER:
+          for (std::size_t i = 0; i < n; i++)
+            top[i] = state_time[i] >= value;
+          top += block_size;
+          break;
+        case OpCode::AND:
+        {
+          top -= block_size;
+          std::uint8_t* a = top - block_size;
+          for (std::size_t i = 0; i < n; i++)
+            a[i] &= top[i];
+          break;
+        }
+        case OpCode::OR:
+        {
+          top -= block_size;
+          std::uint8_t* a = top - block_size;
+          for (std::size_t i = 0; i < n; i++)
+            a[i] |= top[i];
+          break;
+        }
+        case OpCode::NOT:
+        {
+          std::uint8_t* a = top - block_size;
+          for (std::size_t i = 0; i < n; i++)
+            a[i] ^= 1;
+          break;
+        }
+      }
+    }
+    std::copy(stack, stack + n, results + base);
+  }
+}
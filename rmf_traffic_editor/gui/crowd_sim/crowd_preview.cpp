@@ -0,0 +1,687 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <string>
+
+#include <QGraphicsPathItem>
+#include <QGraphicsScene>
+#include <QPainterPath>
+#include <QPen>
+#include <QtConcurrent>
+
+#include "crowd_preview.h"
+
+using namespace crowd_sim;
+using std::size_t;
+using std::string;
+using std::vector;
+
+TRAFFIC_EDITOR_SIMULATION_PLUGIN(CrowdPreview)
+
+namespace {
+
+// extra room agents try to keep around themselves, in meters
+const double personal_space = 0.3;
+
+// how close to a lane vertex counts as having passed it, in meters
+const double waypoint_tolerance = 0.3;
+
+const int agents_per_chunk = 256;
+
+double norm(const double x, const double y)
+{
+  return std::sqrt(x * x + y * y);
+}
+
+}  // namespace
+
+//=================================================
+void CrowdPreview::load(const YAML::Node&)
+{
+  // everything comes from the building's parsed crowd_sim configuration
+}
+
+//=================================================
+void CrowdPreview::reset(Building& building)
+{
+  _agents.clear();
+  _profiles.clear();
+  _states.clear();
+  _goal_vertices.clear();
+  _next_hop.clear();
+  _goal_load.clear();
+  _vertex_x.clear();
+  _vertex_y.clear();
+  _time_since_update = 0.0;
+  _rng.seed(1);  // every reset replays the same preview
+
+  if (building.levels.empty() || !building.crowd_sim_impl)
+  {
+    _publish();
+    return;
+  }
+
+  const Level& level = building.levels[0];
+  const CrowdSimImplementation& impl = *building.crowd_sim_impl;
+  _meters_per_pixel = level.drawing_meters_per_pixel;
+  _update_time_step = impl.get_update_time_step();
+
+  _build_lane_graph(level);
+  _build_goals(level);
+
+  std::map<string, int> profile_idx;
+  for (const AgentProfile& p : impl.get_agent_profiles())
+  {
+    Profile profile;
+    if (p.pref_speed > 0.0)
+      profile.pref_speed = p.pref_speed;
+    profile.max_speed = std::max(p.max_speed, profile.pref_speed);
+    profile.max_accel = p.max_accel;
+    if (p.r > 0.0)
+      profile.radius = p.r;
+    profile.max_neighbors = p.max_neighbors;
+    profile_idx[p.profile_name] = static_cast<int>(_profiles.size());
+    _profiles.push_back(profile);
+  }
+
+  std::map<string, int> state_idx;
+  std::map<size_t, const GoalSet*> goal_sets;
+  const vector<GoalSet> all_goal_sets = impl.get_goal_sets();
+  for (const GoalSet& goal_set : all_goal_sets)
+    goal_sets[goal_set.get_goal_set_id()] = &goal_set;
+
+  // goal areas to the goals they contain
+  std::map<string, vector<int>> area_goals;
+  for (size_t i = 0; i < _goal_vertices.size(); i++)
+  {
+    const auto it =
+      level.vertices[_goal_vertices[i]].params.find("human_goal_set_name");
+    area_goals[it->second.value_string()].push_back(static_cast<int>(i));
+  }
+
+  for (const State& s : impl.get_states())
+  {
+    AgentState state;
+    state.is_final = s.get_final_state();
+    const auto goal_set_it = goal_sets.find(s.get_goal_set_id());
+    if (s.get_goal_set_id() >= 0 && goal_set_it != goal_sets.end())
+    {
+      state.capacity =
+        std::max<size_t>(1, goal_set_it->second->get_capacity());
+      for (const string& area : goal_set_it->second->get_goal_areas())
+      {
+        const vector<int>& goals = area_goals[area];
+        state.goals.insert(state.goals.end(), goals.begin(), goals.end());
+      }
+    }
+    state_idx[s.get_name()] = static_cast<int>(_states.size());
+    _states.push_back(state);
+  }
+
+  for (const Transition& t : impl.get_transitions())
+  {
+    const auto from_it = state_idx.find(t.get_from_state());
+    if (from_it == state_idx.end() || !t.get_condition())
+      continue;
+
+    StateTransition transition;
+    transition.condition = ConditionProgram::compile(*t.get_condition());
+    double total_weight = 0.0;
+    for (const auto& to_state : t.get_to_state())
+    {
+      const auto to_it = state_idx.find(to_state.first);
+      if (to_it == state_idx.end() || to_state.second <= 0.0)
+        continue;
+      total_weight += to_state.second;
+      transition.to_states.push_back(to_it->second);
+      transition.cumulative_weights.push_back(total_weight);
+    }
+    if (!transition.to_states.empty())
+      _states[from_it->second].transitions.push_back(transition);
+  }
+
+  // the spawn points are in meters with y pointing up, like the world
+  // the crowd_sim configuration is exported to
+  std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+  for (const AgentGroup& group : impl.get_agent_groups())
+  {
+    if (group.is_external_group() || !group.is_valid())
+      continue;
+    const auto p_it = profile_idx.find(group.get_agent_profile());
+    const auto s_it = state_idx.find(group.get_initial_state());
+    if (p_it == profile_idx.end() || s_it == state_idx.end())
+      continue;
+
+    const std::pair<double, double> spawn_point = group.get_spawn_point();
+    for (int i = 0; i < group.get_spawn_number(); i++)
+    {
+      Agent agent;
+      agent.x = spawn_point.first + jitter(_rng);
+      agent.y = -spawn_point.second + jitter(_rng);
+      agent.profile = p_it->second;
+      _enter_state(agent, s_it->second);
+      _agents.push_back(agent);
+    }
+  }
+  _new_velocities.resize(_agents.size());
+
+  _chunks.clear();
+  for (size_t i = 0; i < _agents.size(); i += agents_per_chunk)
+    _chunks.emplace_back(
+      static_cast<int>(i),
+      static_cast<int>(std::min(i + agents_per_chunk, _agents.size())));
+
+  _cell_size = 0.0;
+  for (const Profile& profile : _profiles)
+    _cell_size = std::max(_cell_size, 2 * profile.radius + personal_space);
+  if (_cell_size <= 0.0)
+    _cell_size = 1.0;
+
+  printf("crowd preview: %d agents, %d goals, %d lane vertices\n",
+    static_cast<int>(_agents.size()),
+    static_cast<int>(_goal_vertices.size()),
+    static_cast<int>(_vertex_x.size()));
+
+  _publish();
+}
+
+//=================================================
+void CrowdPreview::_build_lane_graph(const Level& level)
+{
+  const size_t num_vertices = level.vertices.size();
+  _vertex_x.resize(num_vertices);
+  _vertex_y.resize(num_vertices);
+  for (size_t i = 0; i < num_vertices; i++)
+  {
+    _vertex_x[i] = level.vertices[i].x * _meters_per_pixel;
+    _vertex_y[i] = level.vertices[i].y * _meters_per_pixel;
+  }
+
+  // people walk human lanes both ways
+  _offsets.assign(num_vertices + 1, 0);
+  for (const Edge& edge : level.edges)
+  {
+    if (edge.type != Edge::HUMAN_LANE)
+      continue;
+    _offsets[edge.start_idx + 1]++;
+    _offsets[edge.end_idx + 1]++;
+  }
+  for (size_t i = 0; i < num_vertices; i++)
+    _offsets[i + 1] += _offsets[i];
+
+  _targets.resize(_offsets.back());
+  _lengths.resize(_offsets.back());
+  vector<int> fill(_offsets.begin(), _offsets.end() - 1);
+  for (const Edge& edge : level.edges)
+  {
+    if (edge.type != Edge::HUMAN_LANE)
+      continue;
+    const double length = norm(
+      _vertex_x[edge.end_idx] - _vertex_x[edge.start_idx],
+      _vertex_y[edge.end_idx] - _vertex_y[edge.start_idx]);
+    _targets[fill[edge.start_idx]] = edge.end_idx;
+    _lengths[fill[edge.start_idx]++] = length;
+    _targets[fill[edge.end_idx]] = edge.start_idx;
+    _lengths[fill[edge.end_idx]++] = length;
+  }
+}
+
+//=================================================
+void CrowdPreview::_build_goals(const Level& level)
+{
+  for (const int i : level.vertices_with_param("human_goal_set_name"))
+  {
+    if (level.vertices[i].params.at("human_goal_set_name").type() ==
+      Param::STRING)
+      _goal_vertices.push_back(i);
+  }
+  _goal_load.assign(_goal_vertices.size(), 0);
+
+  // one Dijkstra search out of every goal gives every vertex its next hop
+  // toward that goal, so agents never search while walking
+  const int num_vertices = static_cast<int>(_vertex_x.size());
+  typedef std::pair<double, int> QueueItem;
+  _next_hop.resize(_goal_vertices.size());
+  for (size_t g = 0; g < _goal_vertices.size(); g++)
+  {
+    vector<int>& next_hop = _next_hop[g];
+    next_hop.assign(num_vertices, -1);
+    vector<double> cost(num_vertices, std::numeric_limits<double>::max());
+
+    std::priority_queue<QueueItem, vector<QueueItem>,
+      std::greater<QueueItem>> queue;
+    const int goal = _goal_vertices[g];
+    cost[goal] = 0.0;
+    next_hop[goal] = goal;
+    queue.push(QueueItem(0.0, goal));
+    while (!queue.empty())
+    {
+      const QueueItem item = queue.top();
+      queue.pop();
+      const int v = item.second;
+      if (item.first > cost[v])
+        continue;
+      for (int i = _offsets[v]; i < _offsets[v + 1]; i++)
+      {
+        const int u = _targets[i];
+        const double c = cost[v] + _lengths[i];
+        if (c < cost[u])
+        {
+          cost[u] = c;
+          next_hop[u] = v;
+          queue.push(QueueItem(c, u));
+        }
+      }
+    }
+  }
+}
+
+//=================================================
+void CrowdPreview::_enter_state(Agent& agent, const int state)
+{
+  if (agent.goal >= 0)
+    _goal_load[agent.goal]--;
+
+  agent.state = state;
+  agent.state_time = 0.0;
+  agent.goal = -1;
+  agent.waypoint = -1;
+
+  const AgentState& s = _states[state];
+  if (s.goals.empty())
+    return;
+
+  // a random goal that isn't full yet, or any goal if they all are
+  vector<int> open_goals;
+  for (const int goal : s.goals)
+  {
+    if (_goal_load[goal] < s.capacity)
+      open_goals.push_back(goal);
+  }
+  const vector<int>& candidates = open_goals.empty() ? s.goals : open_goals;
+  std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+  agent.goal = candidates[pick(_rng)];
+  _goal_load[agent.goal]++;
+  agent.waypoint = _nearest_vertex(agent, agent.goal);
+}
+
+//=================================================
+int CrowdPreview::_nearest_vertex(const Agent& agent, const int goal) const
+{
+  const vector<int>& next_hop = _next_hop[goal];
+  int nearest = -1;
+  double nearest_dist = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < next_hop.size(); i++)
+  {
+    if (next_hop[i] < 0)
+      continue;
+    const double dist = norm(_vertex_x[i] - agent.x, _vertex_y[i] - agent.y);
+    if (dist < nearest_dist)
+    {
+      nearest = static_cast<int>(i);
+      nearest_dist = dist;
+    }
+  }
+  return nearest;
+}
+
+//=================================================
+void CrowdPreview::tick(Building&)
+{
+  _time_since_update += tick_period;
+  if (_time_since_update + 1e-9 < _update_time_step)
+    return;
+  _time_since_update = 0.0;
+
+  _update();
+  _publish();
+}
+
+//=================================================
+void CrowdPreview::_update()
+{
+  if (_agents.empty())
+    return;
+
+  _hash_agents();
+
+  // every agent reads the old positions and velocities and writes only
+  // its own new velocity, so the chunks can run in any order
+  QtConcurrent::blockingMap(
+    _chunks,
+    [this](const std::pair<int, int>& chunk)
+    {
+      for (int i = chunk.first; i < chunk.second; i++)
+        _steer(i);
+    });
+
+  QtConcurrent::blockingMap(
+    _chunks,
+    [this](const std::pair<int, int>& chunk)
+    {
+      for (int i = chunk.first; i < chunk.second; i++)
+      {
+        _agents[i].vx = _new_velocities[i].first;
+        _agents[i].vy = _new_velocities[i].second;
+        _move(_agents[i]);
+      }
+    });
+
+  _evaluate_transitions();
+
+  // transitions pick goals against the shared goal loads, so they are
+  // taken one agent at a time; they are cheap next to the steering
+  for (size_t i = 0; i < _agents.size(); i++)
+  {
+    if (_fired[i] < 0)
+      continue;
+    Agent& agent = _agents[i];
+    const StateTransition& t = _states[agent.state].transitions[_fired[i]];
+    std::uniform_real_distribution<double> pick(
+      0.0, t.cumulative_weights.back());
+    const double r = pick(_rng);
+    size_t j = 0;
+    while (j + 1 < t.to_states.size() && r > t.cumulative_weights[j])
+      j++;
+    _enter_state(agent, t.to_states[j]);
+  }
+}
+
+//=================================================
+void CrowdPreview::_evaluate_transitions()
+{
+  const size_t num_agents = _agents.size();
+  const size_t num_states = _states.size();
+
+  // counting sort of the agents by state
+  _state_start.assign(num_states + 1, 0);
+  for (Agent& agent : _agents)
+  {
+    agent.state_time += _update_time_step;
+    _state_start[agent.state + 1]++;
+  }
+  for (size_t s = 0; s < num_states; s++)
+    _state_start[s + 1] += _state_start[s];
+
+  _state_agents.resize(num_agents);
+  vector<int> fill(_state_start.begin(), _state_start.end() - 1);
+  for (size_t i = 0; i < num_agents; i++)
+    _state_agents[fill[_agents[i].state]++] = static_cast<int>(i);
+
+  _goal_distance.resize(num_agents);
+  _state_time.resize(num_agents);
+  for (size_t i = 0; i < num_agents; i++)
+  {
+    const Agent& agent = _agents[_state_agents[i]];
+    _state_time[i] = agent.state_time;
+    _goal_distance[i] = std::numeric_limits<double>::infinity();
+    if (agent.goal >= 0)
+    {
+      const int goal_vertex = _goal_vertices[agent.goal];
+      _goal_distance[i] = norm(
+        _vertex_x[goal_vertex] - agent.x,
+        _vertex_y[goal_vertex] - agent.y);
+    }
+  }
+
+  // an agent takes the first of its state's transitions that holds, so
+  // go through them last to first and let the earlier ones overwrite
+  _condition_results.resize(num_agents);
+  _fired.assign(num_agents, -1);
+  for (size_t s = 0; s < num_states; s++)
+  {
+    const vector<StateTransition>& transitions = _states[s].transitions;
+    const size_t begin = _state_start[s];
+    const size_t count = _state_start[s + 1] - begin;
+    if (transitions.empty() || count == 0)
+      continue;
+
+    ConditionInputs inputs;
+    inputs.goal_distance = _goal_distance.data() + begin;
+    inputs.state_time = _state_time.data() + begin;
+    inputs.count = count;
+    std::uint8_t* results = _condition_results.data() + begin;
+    for (size_t t = transitions.size(); t-- > 0; )
+    {
+      transitions[t].condition.evaluate(inputs, results);
+      for (size_t i = 0; i < count; i++)
+      {
+        if (results[i])
+          _fired[_state_agents[begin + i]] = static_cast<int>(t);
+      }
+    }
+  }
+}
+
+//=================================================
+std::uint32_t CrowdPreview::_bucket(const int cell_x, const int cell_y) const
+{
+  const std::uint32_t h =
+    static_cast<std::uint32_t>(cell_x) * 73856093u ^
+    static_cast<std::uint32_t>(cell_y) * 19349663u;
+  return h & _bucket_mask;
+}
+
+//=================================================
+void CrowdPreview::_hash_agents()
+{
+  // a power of two at least twice the number of agents keeps buckets
+  // short without a table proportional to the floor area
+  std::uint32_t num_buckets = 1;
+  while (num_buckets < 2 * _agents.size())
+    num_buckets <<= 1;
+  _bucket_mask = num_buckets - 1;
+
+  // counting sort of the agents by bucket
+  _bucket_start.assign(num_buckets + 1, 0);
+  vector<std::uint32_t> agent_bucket(_agents.size());
+  for (size_t i = 0; i < _agents.size(); i++)
+  {
+    agent_bucket[i] = _bucket(
+      static_cast<int>(std::floor(_agents[i].x / _cell_size)),
+      static_cast<int>(std::floor(_agents[i].y / _cell_size)));
+    _bucket_start[agent_bucket[i] + 1]++;
+  }
+  for (std::uint32_t b = 0; b < num_buckets; b++)
+    _bucket_start[b + 1] += _bucket_start[b];
+
+  _bucket_agents.resize(_agents.size());
+  vector<int> fill(_bucket_start.begin(), _bucket_start.end() - 1);
+  for (size_t i = 0; i < _agents.size(); i++)
+    _bucket_agents[fill[agent_bucket[i]]++] = static_cast<int>(i);
+}
+
+//=================================================
+void CrowdPreview::_steer(const int agent_idx)
+{
+  const Agent& agent = _agents[agent_idx];
+  const Profile& profile = _profiles[agent.profile];
+
+  // preferred velocity: toward the next waypoint, slowing down to stop on
+  // the goal itself
+  double pref_x = 0.0, pref_y = 0.0;
+  if (agent.goal >= 0)
+  {
+    const int goal_vertex = _goal_vertices[agent.goal];
+    const int target = agent.waypoint >= 0 ? agent.waypoint : goal_vertex;
+    const double dx = _vertex_x[target] - agent.x;
+    const double dy = _vertex_y[target] - agent.y;
+    const double dist = norm(dx, dy);
+    if (dist > 1e-6)
+    {
+      double speed = profile.pref_speed;
+      if (target == goal_vertex)
+        speed = std::min(speed, dist / _update_time_step);
+      pref_x = dx / dist * speed;
+      pref_y = dy / dist * speed;
+    }
+  }
+
+  // push away from every neighbor that is too close, harder the closer
+  double push_x = 0.0, push_y = 0.0;
+  size_t num_neighbors = 0;
+  const int cell_x = static_cast<int>(std::floor(agent.x / _cell_size));
+  const int cell_y = static_cast<int>(std::floor(agent.y / _cell_size));
+  std::uint32_t visited[9];
+  int num_visited = 0;
+  for (int cy = cell_y - 1; cy <= cell_y + 1; cy++)
+  {
+    for (int cx = cell_x - 1; cx <= cell_x + 1; cx++)
+    {
+      // neighboring cells can share a bucket; only look through it once
+      const std::uint32_t b = _bucket(cx, cy);
+      if (std::find(visited, visited + num_visited, b) !=
+        visited + num_visited)
+        continue;
+      visited[num_visited++] = b;
+
+      for (int i = _bucket_start[b]; i < _bucket_start[b + 1]; i++)
+      {
+        const int other_idx = _bucket_agents[i];
+        if (other_idx == agent_idx || num_neighbors >= profile.max_neighbors)
+          continue;
+        const Agent& other = _agents[other_idx];
+        const double range = profile.radius +
+          _profiles[other.profile].radius + personal_space;
+        const double dx = agent.x - other.x;
+        const double dy = agent.y - other.y;
+        const double dist = norm(dx, dy);
+        if (dist >= range)
+          continue;  // also skips other cells that share the bucket
+
+        num_neighbors++;
+        const double strength = (range - dist) / range;
+        if (dist > 1e-6)
+        {
+          push_x += dx / dist * strength;
+          push_y += dy / dist * strength;
+        }
+        else
+        {
+          // exactly on top of each other; split them apart by index
+          push_x += agent_idx < other_idx ? strength : -strength;
+        }
+      }
+    }
+  }
+
+  double vx = pref_x + push_x * profile.pref_speed;
+  double vy = pref_y + push_y * profile.pref_speed;
+  const double speed = norm(vx, vy);
+  if (speed > profile.max_speed)
+  {
+    vx *= profile.max_speed / speed;
+    vy *= profile.max_speed / speed;
+  }
+
+  if (profile.max_accel > 0.0)
+  {
+    const double max_dv = profile.max_accel * _update_time_step;
+    const double dvx = vx - agent.vx;
+    const double dvy = vy - agent.vy;
+    const double dv = norm(dvx, dvy);
+    if (dv > max_dv)
+    {
+      vx = agent.vx + dvx * max_dv / dv;
+      vy = agent.vy + dvy * max_dv / dv;
+    }
+  }
+
+  _new_velocities[agent_idx] = std::make_pair(vx, vy);
+}
+
+//=================================================
+void CrowdPreview::_move(Agent& agent)
+{
+  agent.x += agent.vx * _update_time_step;
+  agent.y += agent.vy * _update_time_step;
+
+  if (agent.goal < 0 || agent.waypoint < 0)
+    return;
+
+  // move on to the next lane vertex once this one is close enough
+  const int goal_vertex = _goal_vertices[agent.goal];
+  while (agent.waypoint != goal_vertex &&
+    norm(_vertex_x[agent.waypoint] - agent.x,
+    _vertex_y[agent.waypoint] - agent.y) < waypoint_tolerance)
+  {
+    agent.waypoint = _next_hop[agent.goal][agent.waypoint];
+  }
+}
+
+//=================================================
+void CrowdPreview::_publish()
+{
+  std::lock_guard<std::mutex> lock(_snapshot_mutex);
+  _snapshot.resize(_agents.size());
+  _snapshot_radii.resize(_agents.size());
+  for (size_t i = 0; i < _agents.size(); i++)
+  {
+    _snapshot[i] = QPointF(
+      _agents[i].x / _meters_per_pixel,
+      _agents[i].y / _meters_per_pixel);
+    _snapshot_radii[i] = _profiles[_agents[i].profile].radius /
+      _meters_per_pixel;
+  }
+  _snapshot_level_idx = 0;
+  _snapshot_version++;
+}
+
+//=================================================
+void CrowdPreview::scene_update(
+  QGraphicsScene* scene,
+  Building&,
+  const int level_idx)
+{
+  QPainterPath path;
+  {
+    std::lock_guard<std::mutex> lock(_snapshot_mutex);
+    if (_item && _drawn_version == _snapshot_version)
+      return;
+    _drawn_version = _snapshot_version;
+
+    if (level_idx == _snapshot_level_idx)
+    {
+      for (size_t i = 0; i < _snapshot.size(); i++)
+        path.addEllipse(_snapshot[i], _snapshot_radii[i], _snapshot_radii[i]);
+    }
+  }
+
+  // one path item for all agents draws thousands of them much faster
+  // than an item each
+  if (!_item)
+  {
+    _item = scene->addPath(
+      QPainterPath(),
+      QPen(Qt::NoPen),
+      QBrush(QColor::fromRgbF(1.0, 0.5, 0.0, 0.8)));
+    _item->setZValue(250.0);
+  }
+  _item->setPath(path);
+}
+
+//=================================================
+void CrowdPreview::scene_clear()
+{
+  _item = nullptr;
+}
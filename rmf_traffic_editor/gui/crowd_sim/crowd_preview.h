@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef CROWD_SIM_CROWD_PREVIEW__H
+#define CROWD_SIM_CROWD_PREVIEW__H
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <QPointF>
+
+#include <traffic_editor/crowd_sim/condition_program.h>
+
+#include "plugins/simulation.h"
+
+class QGraphicsPathItem;
+
+
+/// A quick preview of the crowd_sim configuration of a building, as a
+/// simulation plugin, so it can be tried out without exporting a world.
+///
+/// Agents spawn from the agent groups, walk the human lanes of the first
+/// level (the one the crowd_sim navmesh is built from) toward the
+/// vertices of their state's goal set, and move between states as the
+/// transition conditions say. They keep apart with a simple separation
+/// force, using a spatial hash to find their neighbors, and are updated
+/// in parallel. This is not Menge, just close enough to see whether the
+/// configuration does what was intended.
+///
+/// Agents aren't models, so they are drawn by scene_update() rather than
+/// through the building.
+class CrowdPreview : public Simulation
+{
+public:
+  void load(const YAML::Node& config_data) override;
+  void tick(Building& building) override;
+  void reset(Building& building) override;
+
+  void scene_update(
+    QGraphicsScene* scene,
+    Building& building,
+    const int level_idx) override;
+
+  void scene_clear() override;
+
+private:
+  struct Profile
+  {
+    double pref_speed = 1.34;  // m/s
+    double max_speed = 2.0;
+    double max_accel = 0.0;  // m/s^2, zero means unlimited
+    double radius = 0.25;  // m
+    std::size_t max_neighbors = 10;
+  };
+
+  struct StateTransition
+  {
+    crowd_sim::ConditionProgram condition;
+    std::vector<int> to_states;
+    std::vector<double> cumulative_weights;
+  };
+
+  struct AgentState
+  {
+    bool is_final = true;
+    std::vector<int> goals;  // indices into _goal_vertices
+    std::size_t capacity = 1;  // agents per goal
+    std::vector<StateTransition> transitions;
+  };
+
+  struct Agent
+  {
+    double x = 0.0, y = 0.0;  // meters, in the level's drawing axes
+    double vx = 0.0, vy = 0.0;
+    int profile = 0;
+    int state = -1;
+    int goal = -1;  // index into _goal_vertices
+    int waypoint = -1;  // lane vertex it is walking to, or -1
+    double state_time = 0.0;
+  };
+
+  // lane graph of the human lanes, with vertex positions in meters
+  std::vector<double> _vertex_x, _vertex_y;
+  std::vector<int> _offsets, _targets;
+  std::vector<double> _lengths;
+
+  // for every goal, the next vertex on the shortest way there from each
+  // vertex, or -1 where the goal can't be reached
+  std::vector<int> _goal_vertices;
+  std::vector<std::vector<int>> _next_hop;
+  std::vector<std::size_t> _goal_load;  // agents heading to each goal
+
+  std::vector<Profile> _profiles;
+  std::vector<AgentState> _states;
+  std::vector<Agent> _agents;
+  std::vector<std::pair<double, double>> _new_velocities;
+
+  // spatial hash of the agents: the agents in bucket b are
+  // _bucket_agents[_bucket_start[b]] ... _bucket_agents[_bucket_start[b+1]-1]
+  double _cell_size = 1.0;
+  std::uint32_t _bucket_mask = 0;
+  std::vector<int> _bucket_start, _bucket_agents;
+
+  std::vector<std::pair<int, int>> _chunks;  // agent ranges for workers
+
+  // the agents sorted by state, and what the conditions look at packed in
+  // the same order, so each state's transitions run over one slice
+  std::vector<int> _state_start, _state_agents;
+  std::vector<double> _goal_distance, _state_time;
+  std::vector<std::uint8_t> _condition_results;
+  std::vector<int> _fired;  // per agent, the transition to take or -1
+
+  double _meters_per_pixel = 0.05;
+  double _update_time_step = 0.1;
+  double _time_since_update = 0.0;
+  std::mt19937 _rng;
+
+  // what scene_update() draws, written by tick()
+  std::mutex _snapshot_mutex;
+  std::vector<QPointF> _snapshot;  // pixels
+  std::vector<double> _snapshot_radii;  // pixels
+  int _snapshot_level_idx = -1;
+  std::uint64_t _snapshot_version = 0;
+
+  // only touched on the GUI thread
+  QGraphicsPathItem* _item = nullptr;
+  std::uint64_t _drawn_version = 0;
+
+  void _build_lane_graph(const Level& level);
+  void _build_goals(const Level& level);
+  void _update();
+  void _hash_agents();
+  std::uint32_t _bucket(const int cell_x, const int cell_y) const;
+  void _steer(const int agent_idx);
+  void _move(Agent& agent);
+  void _enter_state(Agent& agent, const int state);
+  void _evaluate_transitions();
+  int _nearest_vertex(const Agent& agent, const int goal) const;
+  void _publish();
+};
+
+#endif
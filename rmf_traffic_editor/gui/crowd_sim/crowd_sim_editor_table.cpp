@@ -164,20 +164,19 @@ void CrowdSimEditorTable::update()
 void CrowdSimEditorTable::update_goal_area()
 {
   _goal_areas_cache.clear();
-  for (auto level : _building.levels)
+  for (const auto& level : _building.levels)
   {
-    auto vertex_list = level.vertices;
-    for (auto vertex : vertex_list)
+    for (const int vertex_idx :
+      level.vertices_with_param("human_goal_set_name"))
     {
-      if (vertex.params.find("human_goal_set_name") == vertex.params.end() )
-        continue;
-      auto param = vertex.params["human_goal_set_name"];
-      if (param.type != param.STRING)
+      const Param& param =
+        level.vertices[vertex_idx].params.at("human_goal_set_name");
+      if (param.type() != Param::STRING)
       {
         std::cout << "Error param type for human_goal_set_name." << std::endl;
         return;
       }
-      _goal_areas_cache.insert(param.value_string);
+      _goal_areas_cache.insert(param.value_string());
     }
   }
   _impl->set_goal_areas(_goal_areas_cache);
@@ -199,15 +198,13 @@ void CrowdSimEditorTable::update_external_agent_from_spawn_point()
 {
   std::vector<std::string> spawn_point_name;
 
-  for (auto level : _building.levels)
+  for (const auto& level : _building.levels)
   {
-    for (auto vertex : level.vertices)
+    for (const int vertex_idx : level.vertices_with_param("spawn_robot_name"))
     {
-      if (vertex.params.find("spawn_robot_name") != vertex.params.end())
-      {
-        spawn_point_name.emplace_back(
-          vertex.params["spawn_robot_name"].value_string);
-      }
+      spawn_point_name.emplace_back(
+        level.vertices[vertex_idx].params.at("spawn_robot_name")
+        .value_string());
     }
   }
 
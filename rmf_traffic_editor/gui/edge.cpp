@@ -69,7 +69,7 @@ YAML::Node Edge::to_yaml() const
 
   YAML::Node params_node(YAML::NodeType::Map);
   for (const auto& param : params)
-    params_node[param.first] = param.second.to_yaml();
+    params_node[param.first.str()] = param.second.to_yaml();
   y.push_back(params_node);
   y.SetStyle(YAML::EmitterStyle::Flow);
   return y;
@@ -77,10 +77,11 @@ YAML::Node Edge::to_yaml() const
 
 bool Edge::is_bidirectional() const
 {
-  auto it = params.find("bidirectional");
-  if (it == params.end() || it->second.type != Param::BOOL)
+  static const ParamKey key("bidirectional");
+  auto it = params.find(key);
+  if (it == params.end() || it->second.type() != Param::BOOL)
     return false;
-  return it->second.value_bool;
+  return it->second.value_bool();
 }
 
 void Edge::set_param(const std::string& name, const std::string& value)
@@ -101,7 +102,7 @@ void Edge::create_param_if_needed(
   const T& param_value)
 {
   auto it = params.find(name);
-  if (it == params.end() || it->second.type != param_type)
+  if (it == params.end() || it->second.type() != param_type)
     params[name] = param_value;
 }
 
@@ -111,7 +112,7 @@ void Edge::create_required_parameters()
   if (type == MEAS)
   {
     auto it = params.find("distance");
-    if (it == params.end() || it->second.type != Param::DOUBLE)
+    if (it == params.end() || it->second.type() != Param::DOUBLE)
       params["distance"] = Param(1.0);
   }
   else if (type == WALL)
@@ -185,18 +186,20 @@ int Edge::get_graph_idx() const
 {
   if (type != LANE && type != HUMAN_LANE)
     return 0;// for now, only lanes have indices defined
-  auto it = params.find("graph_idx");
-  if (it == params.end() || it->second.type != Param::INT)
+  static const ParamKey key("graph_idx");
+  auto it = params.find(key);
+  if (it == params.end() || it->second.type() != Param::INT)
     return 0;// shouldn't get here
-  return it->second.value_int;
+  return it->second.value_int();
 }
 
 double Edge::get_width() const
 {
   if (type != HUMAN_LANE)
     return -1.0;
-  auto it = params.find("width");
-  if (it == params.end() || it->second.type != Param::DOUBLE)
+  static const ParamKey key("width");
+  auto it = params.find(key);
+  if (it == params.end() || it->second.type() != Param::DOUBLE)
     return -1.0;// shouldn't get here
-  return it->second.value_double;
+  return it->second.value_double();
 }
@@ -23,7 +23,7 @@
 
 #include <yaml-cpp/yaml.h>
 
-#include "param.h"
+#include "param_map.h"
 #include <QString>
 
 
@@ -48,7 +48,7 @@ public:
   Edge(const int _start_idx, const int _end_idx, const Type _type);
   ~Edge();
 
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   void from_yaml(const YAML::Node& data, const Type edge_type);
   YAML::Node to_yaml() const;
@@ -43,8 +43,11 @@
 #include "actions/add_polygon.h"
 #include "actions/add_vertex.h"
 #include "actions/delete.h"
+#include "actions/merge_vertices.h"
 #include "actions/polygon_add_vertex.h"
 #include "actions/polygon_remove_vertices.h"
+#include "actions/set_param.h"
+#include "actions/transform_selection.h"
 
 #include "add_param_dialog.h"
 #include "building_dialog.h"
@@ -85,6 +88,17 @@ Editor::Editor()
   map_view->setStyleSheet(
     "QToolTip { color: #000000; background-color: #ffff88; border: 0px; }");
 
+  // summaries that stay in the status bar whatever the tools show there
+  lane_graph_issues_label = new QLabel(this);
+  lane_graph_issues_label->setToolTip(
+    "Hover over the red markers on the map for details");
+  statusBar()->addPermanentWidget(lane_graph_issues_label);
+  congestion_label = new QLabel(this);
+  congestion_label->setToolTip(
+    "Hover over the lanes on the map for details");
+  congestion_label->hide();
+  statusBar()->addPermanentWidget(congestion_label);
+
   QVBoxLayout* left_layout = new QVBoxLayout;
   left_layout->addWidget(map_view);
 
@@ -209,6 +223,37 @@ Editor::Editor()
   right_tab_widget->addTab(traffic_table, "traffic");
   right_tab_widget->addTab(crowd_sim_table, "crowd_sim");
 
+  entity_browser = new EntityBrowser;
+  connect(
+    entity_browser,
+    &EntityBrowser::entity_clicked,
+    this,
+    &Editor::entity_browser_clicked);
+  right_tab_widget->addTab(entity_browser, "entities");
+  connect(
+    right_tab_widget,
+    &QTabWidget::currentChanged,
+    [this](int)
+    {
+      // it is only kept up to date while it's showing
+      if (right_tab_widget->currentWidget() == entity_browser &&
+        level_idx < static_cast<int>(building.levels.size()))
+      {
+        entity_browser->update(building, level_idx);
+      }
+    });
+
+  // the commands don't say what they touched, and can be undone after
+  // switching levels, so any step of the stack may have edited any level
+  connect(
+    &undo_stack,
+    &QUndoStack::indexChanged,
+    [this](int)
+    {
+      for (auto& level : building.levels)
+        level.changed();
+    });
+
   property_editor = new QTableWidget;
   property_editor->setStyleSheet(
     "QTableWidget { background-color: #e0e0e0; color: black; gridline-color: #606060; } QLineEdit { background:white; }");
@@ -328,6 +373,10 @@ Editor::Editor()
     "Rotate all models...",
     this,
     &Editor::edit_rotate_all_models);
+  edit_menu->addAction(
+    "&Transform selection...",
+    this,
+    &Editor::edit_transform_selection);
   edit_menu->addSeparator();
 
   edit_menu->addAction(
@@ -342,6 +391,22 @@ Editor::Editor()
     this,
     &Editor::edit_align_colinear,
     QKeySequence(Qt::Key_Slash));
+  edit_menu->addAction(
+    "&Merge duplicate vertices...",
+    this,
+    &Editor::edit_merge_vertices);
+  edit_menu->addSeparator();
+
+  snap_to_vertices_action = edit_menu->addAction("Snap to &vertices");
+  snap_to_vertices_action->setCheckable(true);
+  snap_to_vertices_action->setChecked(true);
+  snap_to_edges_action = edit_menu->addAction("Snap to &edges");
+  snap_to_edges_action->setCheckable(true);
+  snap_to_grid_action = edit_menu->addAction(
+    "Snap to &grid...",
+    this,
+    &Editor::edit_snap_to_grid);
+  snap_to_grid_action->setCheckable(true);
   edit_menu->addSeparator();
 
   edit_menu->addAction("&Preferences...", this, &Editor::edit_preferences);
@@ -352,10 +417,74 @@ Editor::Editor()
     view_menu->addAction("&Models", this, &Editor::view_models);
   view_models_action->setCheckable(true);
   view_models_action->setChecked(true);
+  view_lane_graph_issues_action = view_menu->addAction(
+    "&Lane graph issues",
+    this,
+    &Editor::view_lane_graph_issues);
+  view_lane_graph_issues_action->setCheckable(true);
+  view_lane_graph_issues_action->setChecked(
+    rendering_options.show_lane_graph_issues);
+  view_congestion_action = view_menu->addAction(
+    "Lane &congestion estimate",
+    this,
+    &Editor::view_congestion);
+  view_congestion_action->setCheckable(true);
+  view_congestion_action->setChecked(rendering_options.show_congestion);
+  view_navmesh_action = view_menu->addAction(
+    "Crowd sim &navmesh",
+    this,
+    &Editor::view_navmesh);
+  view_navmesh_action->setCheckable(true);
+  view_navmesh_action->setChecked(rendering_options.show_navmesh);
+  view_menu->addSeparator();
+
+  view_menu->addAction(
+    "Route &start at selected vertex",
+    this,
+    &Editor::view_route_start);
+  view_menu->addAction(
+    "Route &goal at selected vertex",
+    this,
+    &Editor::view_route_goal);
+  view_menu->addAction("&Clear route", this, &Editor::view_route_clear);
   view_menu->addSeparator();
 
   view_menu->addAction("&Reset zoom level", this, &Editor::zoom_reset);
 
+  // SIMULATION MENU
+  QMenu* sim_menu = menuBar()->addMenu("&Simulation");
+  sim_play_pause_action = sim_menu->addAction(
+    "&Play",
+    this,
+    &Editor::sim_play_pause,
+    QKeySequence(Qt::CTRL + Qt::Key_Space));
+  sim_menu->addAction(
+    "S&tep",
+    this,
+    &Editor::sim_step,
+    QKeySequence(Qt::CTRL + Qt::Key_Period));
+  sim_menu->addAction("&Reset", this, &Editor::sim_reset);
+  sim_menu->addAction("&Stop", this, &Editor::sim_stop);
+  sim_menu->addSeparator();
+
+  QActionGroup* sim_speed_group = new QActionGroup(this);
+  const std::vector<std::pair<QString, double>> sim_speeds = {
+    {"Real time", 1.0},
+    {"2x real time", 2.0},
+    {"10x real time", 10.0},
+    {"As fast as possible", 0.0}};
+  for (const auto& sim_speed : sim_speeds)
+  {
+    const double speed = sim_speed.second;
+    QAction* action = sim_menu->addAction(
+      sim_speed.first,
+      this,
+      [this, speed]() { sim_set_speed(speed); });
+    action->setCheckable(true);
+    action->setChecked(speed == sim_thread.get_speed());
+    sim_speed_group->addAction(action);
+  }
+
   // HELP MENU
   QMenu* help_menu = menuBar()->addMenu("&Help");
 
@@ -435,10 +564,29 @@ Editor::Editor()
 
   load_model_names();
   level_table->setCurrentCell(level_idx, 0);
+
+  sim_thread.load_plugins();
+  scene_update_timer = new QTimer(this);
+  connect(
+    scene_update_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::scene_update_timer_timeout);
+
+  congestion_timer = new QTimer(this);
+  congestion_timer->setSingleShot(true);
+  congestion_timer->setInterval(500);
+  connect(
+    congestion_timer,
+    &QTimer::timeout,
+    this,
+    &Editor::estimate_congestion);
 }
 
 Editor::~Editor()
 {
+  // the plugins must be done with the building before it goes away
+  sim_thread.stop();
 }
 
 void Editor::load_model_names()
@@ -541,6 +689,9 @@ bool Editor::load_building(const QString& filename)
     return false;
 
   level_idx = 0;
+  route_start = NavGraph::Node();
+  route_goal = NavGraph::Node();
+  sim_stop();
 
   if (!building.levels.empty())
   {
@@ -643,6 +794,9 @@ void Editor::building_new()
 
   building.clear();
   building.set_filename(file_info.absoluteFilePath().toStdString());
+  route_start = NavGraph::Node();
+  route_goal = NavGraph::Node();
+  sim_stop();
   QString dir_path = file_info.dir().path();
   QDir::setCurrent(dir_path);
 
@@ -767,6 +921,72 @@ void Editor::edit_rotate_all_models()
   setWindowModified(true);
 }
 
+void Editor::edit_transform_selection()
+{
+  Level* level = active_level();
+  if (!level)
+    return;
+
+  TransformSelectionCommand* command =
+    new TransformSelectionCommand(&building, level_idx);
+  if (command->empty())
+  {
+    delete command;
+    QMessageBox::information(
+      this,
+      "Transform selection",
+      "Select some vertices, models, fiducials or features first.");
+    return;
+  }
+
+  QDialog dialog(this);
+  dialog.setWindowTitle("Transform selection");
+  QFormLayout* form = new QFormLayout(&dialog);
+  QLineEdit* right_edit = new QLineEdit("0", &dialog);
+  QLineEdit* up_edit = new QLineEdit("0", &dialog);
+  QLineEdit* rotate_edit = new QLineEdit("0", &dialog);
+  QLineEdit* scale_edit = new QLineEdit("1", &dialog);
+  form->addRow("Move right (m):", right_edit);
+  form->addRow("Move up (m):", up_edit);
+  form->addRow("Rotate (degrees):", rotate_edit);
+  form->addRow("Scale:", scale_edit);
+  QDialogButtonBox* buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+  form->addRow(buttons);
+  if (dialog.exec() != QDialog::Accepted)
+  {
+    delete command;
+    return;
+  }
+
+  const double scale = scale_edit->text().toDouble();
+  if (scale <= 0.0)
+  {
+    delete command;
+    QMessageBox::warning(this, "Transform selection", "Scale must be > 0");
+    return;
+  }
+
+  // rotate and scale about the middle of the selection, then move it
+  Transform transform;
+  transform.setYaw(rotate_edit->text().toDouble() * M_PI / 180.0);
+  transform.setScale(scale);
+  const QPointF center = command->center();
+  const double mpp = level->drawing_meters_per_pixel;
+  transform.setTranslation(
+    center - transform.forwards(center) +
+    QPointF(
+      right_edit->text().toDouble() / mpp,
+      -up_edit->text().toDouble() / mpp));
+  command->set_transform(transform);
+
+  undo_stack.push(command);
+  create_scene();
+  setWindowModified(true);
+}
+
 void Editor::edit_optimize_layer_transforms()
 {
   printf("Editor::edit_optimize_layer_transforms()\n");
@@ -785,12 +1005,347 @@ void Editor::edit_align_colinear()
   create_scene();
 }
 
+void Editor::edit_merge_vertices()
+{
+  if (!active_level())
+    return;
+
+  bool ok = false;
+  const double tolerance = QInputDialog::getDouble(
+    this,
+    "Merge duplicate vertices",
+    "Merge vertices closer than (m):",
+    merge_vertices_tolerance,
+    0.001,
+    10.0,
+    3,
+    &ok);
+  if (!ok)
+    return;
+  merge_vertices_tolerance = tolerance;
+
+  // push() deletes the command if it didn't merge anything
+  const std::size_t num_vertices = building.levels[level_idx].vertices.size();
+  undo_stack.push(new MergeVerticesCommand(&building, level_idx, tolerance));
+  const std::size_t num_merged =
+    num_vertices - building.levels[level_idx].vertices.size();
+  if (!num_merged)
+  {
+    statusBar()->showMessage(
+      QString("no vertices are closer than %1 m").arg(tolerance));
+    return;
+  }
+
+  selected_polygon = nullptr;
+  create_scene();
+  update_property_editor();
+  setWindowModified(true);
+  statusBar()->showMessage(QString("merged %1 vertices").arg(num_merged));
+}
+
+void Editor::edit_snap_to_grid()
+{
+  if (!snap_to_grid_action->isChecked())
+    return;
+
+  bool ok = false;
+  const double spacing = QInputDialog::getDouble(
+    this,
+    "Snap to grid",
+    "Grid spacing (m):",
+    snap_grid_spacing,
+    0.01,
+    100.0,
+    2,
+    &ok);
+  if (!ok)
+  {
+    snap_to_grid_action->setChecked(false);
+    return;
+  }
+  snap_grid_spacing = spacing;
+}
+
 void Editor::view_models()
 {
   rendering_options.show_models = view_models_action->isChecked();
   create_scene();
 }
 
+void Editor::view_lane_graph_issues()
+{
+  rendering_options.show_lane_graph_issues =
+    view_lane_graph_issues_action->isChecked();
+  create_scene();
+}
+
+void Editor::view_navmesh()
+{
+  rendering_options.show_navmesh = view_navmesh_action->isChecked();
+  if (!rendering_options.show_navmesh)
+    navmesh_preview.clear();
+  create_scene();
+}
+
+bool Editor::selected_route_node(NavGraph::Node& node)
+{
+  const Level* level = active_level();
+  if (!level)
+    return false;
+  const std::set<int>& selected_vertices = level->selection().vertices;
+  if (!selected_vertices.empty())
+  {
+    node.level_idx = level_idx;
+    node.vertex_idx = *selected_vertices.begin();
+    return true;
+  }
+  statusBar()->showMessage("Select a vertex first");
+  return false;
+}
+
+void Editor::view_route_start()
+{
+  if (selected_route_node(route_start))
+    create_scene();
+}
+
+void Editor::view_route_goal()
+{
+  if (selected_route_node(route_goal))
+    create_scene();
+}
+
+void Editor::view_route_clear()
+{
+  route_start = NavGraph::Node();
+  route_goal = NavGraph::Node();
+  create_scene();
+}
+
+void Editor::draw_route()
+{
+  if (!route_start.is_valid() || !route_goal.is_valid())
+    return;
+
+  const int graph_idx = rendering_options.active_traffic_map_idx;
+  const NavGraph::Route route = nav_graph.find_route(
+    route_start,
+    route_goal,
+    false,
+    graph_idx);
+
+  if (level_idx < static_cast<int>(building.levels.size()))
+    NavGraph::draw_route(scene, route, building.levels[level_idx], level_idx);
+
+  if (route.found)
+    statusBar()->showMessage(
+      QString("route on lane graph %1: %2 m through %3 vertices")
+      .arg(graph_idx)
+      .arg(route.length, 0, 'f', 1)
+      .arg(route.nodes.size()));
+  else
+    statusBar()->showMessage(
+      QString("no route on lane graph %1 from the start to the goal")
+      .arg(graph_idx));
+}
+
+void Editor::view_congestion()
+{
+  if (view_congestion_action->isChecked())
+  {
+    bool ok = false;
+    const int num_robots = QInputDialog::getInt(
+      this,
+      "Lane congestion estimate",
+      "Number of robots in the fleet:",
+      congestion_mix.num_robots,
+      1,
+      1000,
+      1,
+      &ok);
+    if (!ok)
+    {
+      view_congestion_action->setChecked(false);
+      return;
+    }
+    congestion_mix.num_robots = num_robots;
+    rendering_options.show_congestion = true;
+    estimate_congestion();
+    return;
+  }
+  rendering_options.show_congestion = false;
+  congestion_timer->stop();
+  congestion_label->hide();
+  create_scene();
+}
+
+void Editor::sim_reset()
+{
+  if (sim_thread.num_plugins() == 0)
+    statusBar()->showMessage(
+      "No simulation plugins were found. Add the directories they are in "
+      "to RMF_TRAFFIC_EDITOR_PLUGIN_PATH.");
+
+  // plugins read their settings from the saved building file
+  YAML::Node config;
+  const std::string filename = building.get_filename();
+  if (!filename.empty() && QFileInfo::exists(QString::fromStdString(filename)))
+  {
+    try
+    {
+      config = YAML::LoadFile(filename);
+    }
+    catch (const YAML::Exception& e)
+    {
+      qWarning("couldn't read simulation settings from %s: %s",
+        filename.c_str(),
+        e.what());
+    }
+  }
+
+  sim_thread.reset(building, config);
+  sim_play_pause_action->setText("&Play");
+  sim_active = true;
+  sim_frame = nullptr;
+  scene_update_timer->start(33);  // about 30 fps
+  scene_update_timer_timeout();
+}
+
+void Editor::sim_play_pause()
+{
+  if (!sim_active)
+    sim_reset();
+
+  const bool running = !sim_thread.is_running();
+  sim_thread.set_running(running);
+  sim_play_pause_action->setText(running ? "&Pause" : "&Play");
+}
+
+void Editor::sim_step()
+{
+  if (!sim_active)
+    sim_reset();
+
+  sim_thread.step(1);
+}
+
+void Editor::sim_stop()
+{
+  if (!sim_active)
+    return;
+
+  sim_thread.set_running(false);
+  sim_play_pause_action->setText("&Play");
+  scene_update_timer->stop();
+  sim_active = false;
+  sim_frame = nullptr;
+  create_scene();  // put the models back where they were edited
+}
+
+void Editor::sim_set_speed(const double speed)
+{
+  sim_thread.set_speed(speed);
+}
+
+void Editor::scene_update_timer_timeout()
+{
+  const SimThread::Frame* frame = sim_thread.take_frame();
+  if (frame)
+  {
+    sim_frame = frame;
+    draw_sim_frame();
+    statusBar()->showMessage(
+      QString("simulation time %1 s").arg(frame->sim_time, 0, 'f', 2));
+  }
+
+  if (level_idx < static_cast<int>(building.levels.size()))
+    sim_thread.scene_update(scene, building, level_idx);
+}
+
+void Editor::draw_sim_frame()
+{
+  if (!sim_active || !sim_frame)
+    return;
+
+  // Only the scene items move; the building keeps the edited poses. A
+  // level whose models were added or removed since the last reset is
+  // left alone, since its models no longer line up with the frame.
+  if (level_idx + 1 >= static_cast<int>(sim_frame->level_offsets.size()) ||
+    level_idx >= static_cast<int>(building.levels.size()))
+    return;
+
+  const std::size_t begin = sim_frame->level_offsets[level_idx];
+  const std::size_t end = sim_frame->level_offsets[level_idx + 1];
+  std::vector<Model>& models = building.levels[level_idx].models;
+  if (models.size() != end - begin)
+    return;
+
+  for (std::size_t i = 0; i < models.size(); i++)
+    models[i].set_scene_pose(sim_frame->model_states[begin + i]);
+}
+
+void Editor::estimate_congestion()
+{
+  congestion_timer->stop();
+  if (!rendering_options.show_congestion)
+    return;
+
+  const int graph_idx = rendering_options.active_traffic_map_idx;
+  nav_graph.update(building);
+  congestion = CongestionEstimator::estimate(
+    nav_graph,
+    building,
+    false,
+    graph_idx,
+    congestion_mix);
+  congestion_stale = false;
+  printf("estimated congestion on lane graph %d in %.1f ms\n",
+    graph_idx,
+    congestion.elapsed_ms);
+
+  if (!congestion.valid)
+  {
+    congestion_label->setText(
+      QString("no congestion estimate for lane graph %1").arg(graph_idx));
+    congestion_label->setToolTip(
+      "It has no chargers, parking spots or named vertices to run tasks "
+      "between");
+  }
+  else
+  {
+    congestion_label->setText(
+      QString("congestion of %1 robots on lane graph %2: "
+      "%3 of %4 tasks without a route")
+      .arg(congestion_mix.num_robots)
+      .arg(graph_idx)
+      .arg(congestion.num_failed_tasks)
+      .arg(congestion.num_tasks));
+    congestion_label->setToolTip(
+      "Hover over the lanes on the map for details");
+  }
+  congestion_label->show();
+  create_scene();
+}
+
+void Editor::draw_congestion()
+{
+  if (!rendering_options.show_congestion)
+    return;
+
+  const int graph_idx = rendering_options.active_traffic_map_idx;
+  if (congestion_stale || congestion.graph_idx != graph_idx)
+    congestion_timer->start();  // restarts it if it is already running
+
+  // an estimate of another traffic map would be misleading
+  if (congestion.graph_idx == graph_idx &&
+    level_idx < static_cast<int>(building.levels.size()))
+    CongestionEstimator::draw(
+      scene,
+      congestion,
+      building.levels[level_idx],
+      level_idx);
+}
+
 void Editor::zoom_reset()
 {
   const double viewport_scale = 1.0;
@@ -941,17 +1496,27 @@ void Editor::keyPressEvent(QKeyEvent* e)
       tool_button_group->button(TOOL_EDIT_POLYGON)->click();
       break;
     case Qt::Key_B:
-      for (auto& edge : building.levels[level_idx].edges)
+    {
+      Level& level = building.levels[level_idx];
+      bool found_lane = false;
+      for (const int edge_idx : level.selection().edges)
       {
-        if (edge.type == Edge::LANE && edge.selected)
+        Edge& edge = level.edges[edge_idx];
+        if (edge.type == Edge::LANE)
         {
           // toggle bidirectional flag
           edge.set_param("bidirectional",
             edge.is_bidirectional() ? "false" : "true");
-          create_scene();
+          found_lane = true;
         }
       }
+      if (found_lane)
+      {
+        level.changed();
+        create_scene();
+      }
       break;
+    }
     case Qt::Key_0: number_key_pressed(0); break;
     case Qt::Key_1: number_key_pressed(1); break;
     case Qt::Key_2: number_key_pressed(2); break;
@@ -1075,75 +1640,41 @@ void Editor::update_property_editor()
   if (building.levels.empty())
     return;
 
-  for (const auto& p : building.levels[level_idx].polygons)
-  {
-    if (p.selected)
-    {
-      populate_property_editor(p);
-      return;
-    }
-  }
-
-  for (const auto& e : building.levels[level_idx].edges)
-  {
-    if (e.selected)
-    {
-      populate_property_editor(e);
-      return;  // stop after finding the first one
-    }
-  }
-
-  for (const auto& m : building.levels[level_idx].models)
-  {
-    if (m.selected)
-    {
-      populate_property_editor(m);
-      return;  // stop after finding the first one
-    }
-  }
-
-  for (size_t i = 0; i < building.levels[level_idx].vertices.size(); i++)
-  {
-    const Vertex& v = building.levels[level_idx].vertices[i];
-    if (v.selected)
-    {
-      populate_property_editor(v, i);
-      return;  // stop after finding the first one
-    }
-  }
-
-  for (const auto& feature : building.levels[level_idx].floorplan_features)
-  {
-    if (feature.selected())
-    {
-      populate_property_editor(feature);
-      return;
-    }
-  }
-
-  for (const auto& layer : building.levels[level_idx].layers)
-  {
-    for (const auto& feature : layer.features)
-    {
-      if (feature.selected())
-      {
-        populate_property_editor(feature);
-        return;
-      }
-    }
-  }
-
-  for (const auto& f : building.levels[level_idx].fiducials)
-  {
-    if (f.selected)
-    {
-      populate_property_editor(f);
-      return;  // stop after finding the first one
-    }
+  const Level& level = building.levels[level_idx];
+  const Level::Selection& selection = level.selection();
+
+  // several of a kind are edited together, otherwise show the first one
+  if (selection.polygons.size() > 1)
+    populate_property_editor(Level::POLYGON, selection.polygons);
+  else if (!selection.polygons.empty())
+    populate_property_editor(level.polygons[*selection.polygons.begin()]);
+  else if (selection.edges.size() > 1)
+    populate_property_editor(Level::EDGE, selection.edges);
+  else if (!selection.edges.empty())
+    populate_property_editor(level.edges[*selection.edges.begin()]);
+  else if (selection.models.size() > 1)
+    populate_property_editor(Level::MODEL, selection.models);
+  else if (!selection.models.empty())
+    populate_property_editor(level.models[*selection.models.begin()]);
+  else if (selection.vertices.size() > 1)
+    populate_property_editor(Level::VERTEX, selection.vertices);
+  else if (!selection.vertices.empty())
+  {
+    const int i = *selection.vertices.begin();
+    populate_property_editor(level.vertices[i], i);
+  }
+  else if (!selection.features.empty())
+  {
+    const auto& f = *selection.features.begin();
+    if (f.first == 0)
+      populate_property_editor(level.floorplan_features[f.second]);
+    else
+      populate_property_editor(level.layers[f.first - 1].features[f.second]);
   }
-
-  // if we get here, we never found anything :(
-  clear_property_editor();
+  else if (!selection.fiducials.empty())
+    populate_property_editor(level.fiducials[*selection.fiducials.begin()]);
+  else
+    clear_property_editor();
 }
 
 QTableWidgetItem* Editor::create_table_item(
@@ -1336,7 +1867,7 @@ void Editor::populate_property_editor(const Edge& edge)
   {
     property_editor_set_row(
       row,
-      QString::fromStdString(param.first),
+      QString::fromStdString(param.first.str()),
       param.second.to_qstring(),
       true);
     row++;
@@ -1369,7 +1900,7 @@ void Editor::populate_property_editor(const Vertex& vertex, const int index)
   {
     property_editor_set_row(
       row,
-      QString::fromStdString(param.first),
+      QString::fromStdString(param.first.str()),
       param.second.to_qstring(),
       true);
     row++;
@@ -1454,7 +1985,7 @@ void Editor::populate_property_editor(const Polygon& polygon)
   {
     property_editor_set_row(
       row,
-      QString::fromStdString(param.first),
+      QString::fromStdString(param.first.str()),
       param.second.to_qstring(),
       true);
     row++;
@@ -1463,6 +1994,110 @@ void Editor::populate_property_editor(const Polygon& polygon)
   property_editor->blockSignals(false);  // re-enable callbacks
 }
 
+namespace {
+
+// The params that all of the items have, each with their value if they
+// all agree on it, or blank if not
+template<typename T>
+std::vector<std::pair<QString, QString>> shared_params(
+  const std::vector<T>& items,
+  const std::set<int>& indices)
+{
+  std::vector<std::pair<QString, QString>> shared;
+  const T& first = items[*indices.begin()];
+  for (const auto& param : first.params)
+  {
+    const QString value = param.second.to_qstring();
+    bool all_have = true;
+    bool all_agree = true;
+    for (const int i : indices)
+    {
+      const auto it = items[i].params.find(param.first);
+      if (it == items[i].params.end())
+      {
+        all_have = false;
+        break;
+      }
+      all_agree = all_agree && it->second.to_qstring() == value;
+    }
+    if (all_have)
+    {
+      shared.push_back(
+        std::make_pair(
+          QString::fromStdString(param.first.str()),
+          all_agree ? value : QString()));
+    }
+  }
+  return shared;
+}
+
+}  // namespace
+
+void Editor::populate_property_editor(
+  const Level::ItemType type,
+  const std::set<int>& indices)
+{
+  const Level& level = building.levels[level_idx];
+  std::vector<std::pair<QString, QString>> rows;
+  QString kind;
+  switch (type)
+  {
+    case Level::VERTEX:
+      rows = shared_params(level.vertices, indices);
+      kind = "vertices";
+      break;
+    case Level::EDGE:
+      rows = shared_params(level.edges, indices);
+      kind = "edges";
+      break;
+    case Level::POLYGON:
+      rows = shared_params(level.polygons, indices);
+      kind = "polygons";
+      break;
+    case Level::MODEL:
+    {
+      // the same fields as a single model, blank where they differ
+      const Model& first = level.models[*indices.begin()];
+      bool same_elevation = true;
+      bool same_static = true;
+      for (const int i : indices)
+      {
+        same_elevation = same_elevation &&
+          level.models[i].state.z == first.state.z;
+        same_static = same_static &&
+          level.models[i].is_static == first.is_static;
+      }
+      rows.push_back(
+        std::make_pair(
+          QString("elevation"),
+          same_elevation ? QString::number(first.state.z) : QString()));
+      rows.push_back(
+        std::make_pair(
+          QString("static"),
+          !same_static ? QString() :
+          first.is_static ? QString("true") : QString("false")));
+      kind = "models";
+      break;
+    }
+    default:
+      return;
+  }
+
+  property_editor->blockSignals(true);  // otherwise we get tons of callbacks
+  property_editor->setRowCount(1 + rows.size());
+  property_editor_set_row(
+    0,
+    "selected",
+    QString("%1 %2").arg(indices.size()).arg(kind));
+  int row = 1;
+  for (const auto& r : rows)
+  {
+    property_editor_set_row(row, r.first, r.second, true);
+    row++;
+  }
+  property_editor->blockSignals(false);  // re-enable callbacks
+}
+
 void Editor::populate_property_editor(const Layer& layer)
 {
   Level* level = active_level();
@@ -1486,77 +2121,158 @@ void Editor::property_editor_cell_changed(int row, int column)
   printf("property_editor_cell_changed(%d, %d) = param %s\n",
     row, column, name.c_str());
 
-  for (auto& v : building.levels[level_idx].vertices)
+  // the same order as update_property_editor() shows them in
+  Level& level = building.levels[level_idx];
+  const Level::Selection& selection = level.selection();
+  level.changed();
+
+  if (selection.polygons.size() > 1)
+    set_param_of_selected(Level::POLYGON, selection.polygons, name, value);
+  else if (!selection.polygons.empty())
+  {
+    level.polygons[*selection.polygons.begin()].set_param(name, value);
+    setWindowModified(true);
+  }
+  else if (selection.edges.size() > 1)
+    set_param_of_selected(Level::EDGE, selection.edges, name, value);
+  else if (!selection.edges.empty())
+  {
+    level.edges[*selection.edges.begin()].set_param(name, value);
+    create_scene();
+    setWindowModified(true);
+  }
+  else if (selection.models.size() > 1)
+    set_param_of_selected(Level::MODEL, selection.models, name, value);
+  else if (!selection.models.empty())
+  {
+    level.models[*selection.models.begin()].set_param(name, value);
+    setWindowModified(true);
+  }
+  else if (selection.vertices.size() > 1)
+    set_param_of_selected(Level::VERTEX, selection.vertices, name, value);
+  else if (!selection.vertices.empty())
   {
-    if (!v.selected)
-      continue;
+    Vertex& v = level.vertices[*selection.vertices.begin()];
     if (name == "name")
       v.name = value;
     else if (name == "x (pixels)")
+    {
       v.x = stof(value);
+      level.vertices_changed();
+    }
     else if (name == "y (pixels)")
+    {
       v.y = stof(value);
+      level.vertices_changed();
+    }
     else
+    {
       v.set_param(name, value);
+      level.vertices_changed();
+    }
     create_scene();
     setWindowModified(true);
-    return;  // stop after finding the first one
-  }
-
-  for (auto& e : building.levels[level_idx].edges)
-  {
-    if (!e.selected)
-      continue;
-    e.set_param(name, value);
-    create_scene();
-    setWindowModified(true);
-    return;  // stop after finding the first one
   }
-
-  for (auto& f : building.levels[level_idx].fiducials)
+  else if (!selection.fiducials.empty())
   {
-    if (!f.selected)
-      continue;
     if (name == "name")
-      f.name = value;
+    {
+      level.fiducials[*selection.fiducials.begin()].name = value;
+      building.invalidate_transform(level_idx);
+    }
     create_scene();
     setWindowModified(true);
-    return;  // stop after finding the first one
   }
+}
 
-  for (auto& p : building.levels[level_idx].polygons)
-  {
-    if (!p.selected)
-      continue;
-    p.set_param(name, value);
-    setWindowModified(true);
-    return;  // stop after finding the first one
-  }
+void Editor::set_param_of_selected(
+  const Level::ItemType type,
+  const std::set<int>& indices,
+  const std::string& name,
+  const std::string& value)
+{
+  // left blank because the selected items differ: leave them alone
+  if (value.empty())
+    return;
 
-  for (auto& m : building.levels[level_idx].models)
-  {
-    if (!m.selected)
-      continue;
-    m.set_param(name, value);
-    setWindowModified(true);
-    return; // stop after finding the first one
-  }
+  undo_stack.push(
+    new SetParamCommand(
+      &building,
+      level_idx,
+      type,
+      std::vector<int>(indices.begin(), indices.end()),
+      name,
+      value));
+  create_scene();
+  setWindowModified(true);
 }
 
 bool Editor::create_scene()
 {
+  building.detach_scene_items(scene);  // the lifts are kept for next time
   scene->clear();  // destroys the mouse_motion_* items if they are there
   building.clear_scene();  // forget all pointers to the graphics items
+  sim_thread.scene_clear();
   mouse_motion_line = nullptr;
   mouse_motion_model = nullptr;
   mouse_motion_ellipse = nullptr;
   mouse_motion_polygon = nullptr;
+  mouse_snap_marker = nullptr;
 
   building.draw(scene, level_idx, editor_models, rendering_options);
 
+  if (rendering_options.show_navmesh)
+  {
+    navmesh_preview.update(building, level_idx);
+    navmesh_preview.draw(scene, rendering_options);
+  }
+
+  // Dragging a vertex redraws on every mouse move, so the lanes are only
+  // checked again once it is dropped. Until then the last issues found
+  // are drawn.
+  if (mouse_vertex_idx < 0)
+    update_lane_graph_issues();
+  if (rendering_options.show_lane_graph_issues &&
+    level_idx < static_cast<int>(building.levels.size()))
+    lane_graph_validator.draw(scene, building.levels[level_idx], level_idx);
+
+  // The route preview and the congestion heatmap share one nav graph,
+  // which only rebuilds the levels whose lanes changed since last time.
+  if ((route_start.is_valid() && route_goal.is_valid()) ||
+    rendering_options.show_congestion)
+  {
+    if (nav_graph.update(building))
+      congestion_stale = true;
+  }
+  draw_congestion();
+  draw_route();
+  draw_sim_frame();
+
+  // Like the lane graph issues, the rows are collected again once a
+  // dragged vertex is dropped; until then they only show its new position.
+  if (entity_browser && entity_browser->isVisible())
+  {
+    if (mouse_vertex_idx < 0)
+      entity_browser->update(building, level_idx);
+    else
+      entity_browser->redraw();
+  }
+
   return true;
 }
 
+void Editor::update_lane_graph_issues()
+{
+  // this only re-analyzes the levels that changed since the last time
+  lane_graph_validator.update(building);
+  const std::size_t num_issues = lane_graph_validator.num_issues();
+  if (num_issues)
+    lane_graph_issues_label->setText(
+      QString("%1 lane graph issue(s)").arg(num_issues));
+  else
+    lane_graph_issues_label->clear();
+}
+
 void Editor::draw_mouse_motion_line_item(
   const double mouse_x,
   const double mouse_y)
@@ -1616,6 +2332,12 @@ void Editor::remove_mouse_motion_item()
     delete mouse_motion_polygon;
     mouse_motion_polygon = nullptr;
   }
+  if (mouse_snap_marker)
+  {
+    scene->removeItem(mouse_snap_marker);
+    delete mouse_snap_marker;
+    mouse_snap_marker = nullptr;
+  }
   mouse_motion_editor_model = nullptr;
 
   mouse_vertex_idx = -1;
@@ -1633,26 +2355,93 @@ void Editor::mouse_select(
   QMouseEvent* e,
   const QPointF& p)
 {
-  if (type != MOUSE_PRESS)
-    return;
-  const QPoint p_global = mapToGlobal(e->pos());
-  const QPoint p_map = map_view->mapFromGlobal(p_global);
-  QGraphicsItem* item = map_view->itemAt(p_map);
+  Level& level = building.levels[level_idx];
+
+  if (type == MOUSE_PRESS)
+  {
+    const QPoint p_global = mapToGlobal(e->pos());
+    const QPoint p_map = map_view->mapFromGlobal(p_global);
+    QGraphicsItem* item = map_view->itemAt(p_map);
+
+    level.mouse_select_press(
+      p.x(),
+      p.y(),
+      item,
+      rendering_options,
+      e->modifiers());
 
-  building.levels[level_idx].mouse_select_press(
-    p.x(),
-    p.y(),
-    item,
-    rendering_options,
-    e->modifiers());
+    // todo: figure out something smarter than this abomination
+    selected_polygon = building.get_selected_polygon(level_idx);
 
-  // todo: figure out something smarter than this abomination
-  selected_polygon = building.get_selected_polygon(level_idx);
+    // todo: be smarter and go find the actual GraphicsItem to avoid
+    // a full repaint here?
+    create_scene();
+    update_property_editor();
 
-  // todo: be smarter and go find the actual GraphicsItem to avoid
-  // a full repaint here?
-  create_scene();
-  update_property_editor();
+    // dragging from here selects a region instead
+    mouse_select_pressed = (e->buttons() & Qt::LeftButton) != 0;
+    mouse_select_dragging = false;
+    mouse_select_lasso = (e->modifiers() & Qt::ControlModifier) != 0;
+    mouse_select_press_pos = e->pos();
+    mouse_select_region.clear();
+    mouse_select_region << p;
+  }
+  else if (type == MOUSE_MOVE)
+  {
+    if (!mouse_select_pressed || !(e->buttons() & Qt::LeftButton))
+      return;
+    if (!mouse_select_dragging)
+    {
+      const int distance =
+        (e->pos() - mouse_select_press_pos).manhattanLength();
+      if (distance < QApplication::startDragDistance())
+        return;
+      mouse_select_dragging = true;
+    }
+
+    if (mouse_select_lasso)
+      mouse_select_region << p;
+    else
+    {
+      const QPointF start = mouse_select_region.first();
+      mouse_select_region.clear();
+      mouse_select_region << start << QPointF(p.x(), start.y()) << p
+                          << QPointF(start.x(), p.y());
+    }
+
+    if (mouse_motion_polygon)
+      mouse_motion_polygon->setPolygon(mouse_select_region);
+    else
+    {
+      QPen pen(QColor::fromRgbF(0.0, 0.3, 1.0, 0.8), 1, Qt::DashLine);
+      pen.setCosmetic(true);
+      mouse_motion_polygon = scene->addPolygon(
+        mouse_select_region,
+        pen,
+        QBrush(QColor::fromRgbF(0.0, 0.3, 1.0, 0.1)));
+      mouse_motion_polygon->setZValue(300.0);
+    }
+  }
+  else if (type == MOUSE_RELEASE)
+  {
+    const bool dragged = mouse_select_pressed && mouse_select_dragging;
+    mouse_select_pressed = false;
+    mouse_select_dragging = false;
+    if (!dragged)
+      return;
+    remove_mouse_motion_item();
+
+    // the region replaces whatever the press selected, unless holding Shift
+    if (!(e->modifiers() & Qt::ShiftModifier))
+      level.clear_selection();
+    const std::size_t num_selected =
+      level.select_region(mouse_select_region, rendering_options);
+    printf("selected %zu items in the region\n", num_selected);
+
+    selected_polygon = building.get_selected_polygon(level_idx);
+    create_scene();
+    update_property_editor();
+  }
 }
 
 void Editor::mouse_add_vertex(
@@ -1660,17 +2449,41 @@ void Editor::mouse_add_vertex(
   QMouseEvent*,
   const QPointF& p)
 {
+  // Only a click within the merge tolerance of a vertex would add a
+  // duplicate of it. Further out, snapping to the vertex would stack a
+  // duplicate on top of it, so the new vertex snaps to anything else.
+  Level::Snap snap = snap_point(p);
+  bool duplicate = false;
+  if (snap.type == Level::SNAP_VERTEX)
+  {
+    const Level& level = building.levels[level_idx];
+    const double distance =
+      std::hypot(p.x() - snap.point.x(), p.y() - snap.point.y()) *
+      level.drawing_meters_per_pixel;
+    duplicate = distance <= merge_vertices_tolerance;
+    if (!duplicate)
+      snap = snap_point(p, Level::SNAP_VERTEX);
+  }
+
   if (t == MOUSE_PRESS)
   {
+    if (duplicate)
+    {
+      statusBar()->showMessage(
+        QString("vertex %1 is already there").arg(snap.idx));
+      return;
+    }
     undo_stack.push(
       new AddVertexCommand(
         &building,
         level_idx,
-        p.x(),
-        p.y()));
+        snap.point.x(),
+        snap.point.y()));
     setWindowModified(true);
     create_scene();
   }
+  else if (t == MOUSE_MOVE)
+    draw_snap_marker(snap);
 }
 
 void Editor::mouse_add_feature(
@@ -1865,10 +2678,10 @@ void Editor::mouse_move(
     else if (mouse_vertex_idx >= 0)
     {
       // we're dragging a vertex
-      Vertex& pt =
-        building.levels[level_idx].vertices[mouse_vertex_idx];
-      pt.x = p.x();
-      pt.y = p.y();
+      building.levels[level_idx].move_vertex(
+        mouse_vertex_idx,
+        p.x(),
+        p.y());
       latest_move_vertex->set_final_destination(p.x(), p.y());
       create_scene();
     }
@@ -1906,6 +2719,7 @@ void Editor::mouse_move(
         building.levels[level_idx].fiducials[mouse_fiducial_idx];
       f.x = p.x();
       f.y = p.y();
+      building.invalidate_transform(level_idx);
       latest_move_fiducial->set_final_destination(p.x(), p.y());
       printf("moved fiducial %d to (%.1f, %.1f)\n",
         mouse_fiducial_idx,
@@ -1923,12 +2737,18 @@ void Editor::mouse_add_edge(
   const Edge::Type& edge_type)
 {
   QPointF p_aligned(p);
+  Level::Snap snap;
   if (clicked_idx >= 0 && e->modifiers() & Qt::ShiftModifier)
   {
     const auto& start =
       building.levels[level_idx].vertices[clicked_idx];
     align_point(QPointF(start.x, start.y), p_aligned);
   }
+  else
+  {
+    snap = snap_point(p);
+    p_aligned = snap.point;
+  }
 
   if (t == MOUSE_PRESS)
   {
@@ -1994,6 +2814,7 @@ void Editor::mouse_add_edge(
   }
   else if (t == MOUSE_MOVE)
   {
+    draw_snap_marker(snap);
     if (clicked_idx < 0)
       return;
 
@@ -2153,6 +2974,73 @@ void Editor::align_point(const QPointF& start, QPointF& end)
     end.setY(start.y());
 }
 
+Level::Snap Editor::snap_point(const QPointF& p, const int skip_types)
+{
+  Level::Snap snap;
+  snap.point = p;
+  const Level* level = active_level();
+  if (!level)
+    return snap;
+
+  int snap_types = Level::SNAP_NONE;
+  if (snap_to_vertices_action->isChecked())
+    snap_types |= Level::SNAP_VERTEX;
+  if (snap_to_edges_action->isChecked())
+    snap_types |= Level::SNAP_EDGE;
+  if (snap_to_grid_action->isChecked())
+    snap_types |= Level::SNAP_GRID;
+  snap_types &= ~skip_types;
+  if (snap_types == Level::SNAP_NONE)
+    return snap;
+
+  // the same distance on screen at any zoom level
+  const double radius = 10.0 / map_view->transform().m11();
+  return level->snap(
+    p,
+    radius,
+    snap_types,
+    snap_grid_spacing,
+    rendering_options);
+}
+
+void Editor::draw_snap_marker(const Level::Snap& snap)
+{
+  if (snap.type == Level::SNAP_NONE)
+  {
+    if (mouse_snap_marker)
+      mouse_snap_marker->hide();
+    return;
+  }
+
+  QColor color;
+  switch (snap.type)
+  {
+    case Level::SNAP_VERTEX:
+      color = QColor::fromRgbF(1.0, 0.5, 0.0);
+      break;
+    case Level::SNAP_EDGE:
+      color = QColor::fromRgbF(0.0, 0.7, 0.0);
+      break;
+    default:
+      color = QColor::fromRgbF(0.4, 0.4, 0.4);
+      break;
+  }
+  QPen pen(color, 2);
+  pen.setCosmetic(true);
+
+  // a square a few pixels wide on screen, centered on the snapped point
+  if (!mouse_snap_marker)
+  {
+    mouse_snap_marker = scene->addRect(-5, -5, 10, 10, pen);
+    mouse_snap_marker->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+    mouse_snap_marker->setZValue(300);
+  }
+  else
+    mouse_snap_marker->setPen(pen);
+  mouse_snap_marker->setPos(snap.point);
+  mouse_snap_marker->show();
+}
+
 void Editor::mouse_rotate(
   const MouseType t, QMouseEvent* mouse_event, const QPointF& p)
 {
@@ -2274,8 +3162,8 @@ void Editor::mouse_add_polygon(
       if (clicked_idx < 0)
         return;// nothing to do. click wasn't on a vertex.
 
+      building.levels[level_idx].set_selected(Level::VERTEX, clicked_idx, true);
       Vertex* v = &building.levels[level_idx].vertices[clicked_idx];
-      v->selected = true;  // todo: colorize it?
 
       if (mouse_motion_polygon == nullptr)
       {
@@ -2394,7 +3282,7 @@ void Editor::mouse_edit_polygon(
         printf("removing vertex %d\n", ni.vertex_idx);
       }
       PolygonRemoveVertCommand* command = new PolygonRemoveVertCommand(
-        selected_polygon, ni.vertex_idx);
+        &building, level_idx, selected_polygon, ni.vertex_idx);
       undo_stack.push(command);
       setWindowModified(true);
       create_scene();
@@ -2450,6 +3338,8 @@ void Editor::mouse_edit_polygon(
       return;// Release vertex is already in the polygon. Don't do anything.
 
     PolygonAddVertCommand* command = new PolygonAddVertCommand(
+      &building,
+      level_idx,
       selected_polygon,
       mouse_edge_drag_polygon.movable_vertex,
       release_vertex_idx);
@@ -2478,9 +3368,11 @@ void Editor::mouse_edit_polygon(
 void Editor::number_key_pressed(const int n)
 {
   bool found_edge = false;
-  for (auto& edge : building.levels[level_idx].edges)
+  Level& level = building.levels[level_idx];
+  for (const int edge_idx : level.selection().edges)
   {
-    if (edge.selected && edge.type == Edge::LANE)
+    Edge& edge = level.edges[edge_idx];
+    if (edge.type == Edge::LANE)
     {
       edge.set_graph_idx(n);
       found_edge = true;
@@ -2488,12 +3380,18 @@ void Editor::number_key_pressed(const int n)
   }
   if (found_edge)
   {
+    level.changed();
     create_scene();
     update_property_editor();
   }
 
   rendering_options.active_traffic_map_idx = n;
   traffic_table->update(rendering_options);
+
+  // the route preview and congestion estimate follow the active traffic map
+  if ((route_start.is_valid() && route_goal.is_valid()) ||
+    rendering_options.show_congestion)
+    create_scene();
 }
 
 bool Editor::maybe_save()
@@ -2637,6 +3535,63 @@ void Editor::clear_current_tool_buffer()
     clicked_feature_id = QUuid();
 }
 
+void Editor::entity_browser_clicked(const int kind, const int index)
+{
+  Level* level = active_level();
+  if (!level)
+    return;
+
+  Level::ItemType type = Level::VERTEX;
+  QPointF p;
+  switch (kind)
+  {
+    case EntityTableModel::VERTICES:
+      if (index >= static_cast<int>(level->vertices.size()))
+        return;
+      p = QPointF(level->vertices[index].x, level->vertices[index].y);
+      break;
+    case EntityTableModel::LANES:
+    case EntityTableModel::DOORS:
+    {
+      if (index >= static_cast<int>(level->edges.size()))
+        return;
+      type = Level::EDGE;
+      const Edge& e = level->edges[index];
+      const int num_vertices = static_cast<int>(level->vertices.size());
+      if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+        e.end_idx < 0 || e.end_idx >= num_vertices)
+        return;
+      const Vertex& a = level->vertices[e.start_idx];
+      const Vertex& b = level->vertices[e.end_idx];
+      p = QPointF((a.x + b.x) / 2.0, (a.y + b.y) / 2.0);
+      break;
+    }
+    case EntityTableModel::MODELS:
+      if (index >= static_cast<int>(level->models.size()))
+        return;
+      type = Level::MODEL;
+      p = QPointF(
+        level->models[index].state.x,
+        level->models[index].state.y);
+      break;
+    case EntityTableModel::FIDUCIALS:
+      if (index >= static_cast<int>(level->fiducials.size()))
+        return;
+      type = Level::FIDUCIAL;
+      p = QPointF(level->fiducials[index].x, level->fiducials[index].y);
+      break;
+    default:
+      return;
+  }
+
+  level->clear_selection();
+  level->set_selected(type, index, true);
+  selected_polygon = nullptr;
+  map_view->centerOn(p);
+  create_scene();
+  update_property_editor();
+}
+
 void Editor::level_table_update_slot()
 {
   update_tables();
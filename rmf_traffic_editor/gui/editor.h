@@ -19,6 +19,7 @@
 #define EDITOR_H
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,7 @@
 #include <QGraphicsEllipseItem>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsPolygonItem>
+#include <QGraphicsRectItem>
 #include <QGraphicsScene>
 #include <QMainWindow>
 #include <QSettings>
@@ -38,8 +40,14 @@
 #include "actions/move_vertex.h"
 #include "actions/rotate_model.h"
 #include "building.h"
+#include "congestion_estimator.h"
 #include "editor_model.h"
+#include "entity_browser.h"
+#include "lane_graph_validator.h"
+#include "nav_graph.h"
+#include "navmesh_preview.h"
 #include "rendering_options.h"
+#include "sim_thread.h"
 
 #include "crowd_sim/crowd_sim_editor_table.h"
 
@@ -142,8 +150,11 @@ private:
   void edit_building_properties();
   void edit_project_properties();
   void edit_rotate_all_models();
+  void edit_transform_selection();
   void edit_optimize_layer_transforms();
   void edit_align_colinear();
+  void edit_merge_vertices();
+  void edit_snap_to_grid();
 
   void level_add();
   void level_edit();
@@ -154,6 +165,12 @@ private:
 
   void zoom_reset();
   void view_models();
+  void view_lane_graph_issues();
+  void view_congestion();
+  void view_navmesh();
+  void view_route_start();
+  void view_route_goal();
+  void view_route_clear();
 
   void help_about();
 
@@ -188,6 +205,45 @@ private:
   MapView* map_view = nullptr;
 
   QAction* view_models_action = nullptr;
+  QAction* view_lane_graph_issues_action = nullptr;
+  QAction* view_congestion_action = nullptr;
+  QAction* view_navmesh_action = nullptr;
+
+  // what the add vertex and add edge tools snap points to
+  QAction* snap_to_vertices_action = nullptr;
+  QAction* snap_to_edges_action = nullptr;
+  QAction* snap_to_grid_action = nullptr;
+  double snap_grid_spacing = 0.5;  // meters
+  double merge_vertices_tolerance = 0.05;  // meters
+
+  LaneGraphValidator lane_graph_validator;
+  // the issue count, kept apart from the tool hints in the status bar
+  QLabel* lane_graph_issues_label = nullptr;
+  void update_lane_graph_issues();
+
+  // crowd_sim navmesh of the active level, regenerated around whatever
+  // human lanes changed since the last redraw
+  NavmeshPreview navmesh_preview;
+
+  // shortest-route preview between two vertices, possibly on different
+  // levels, over the active traffic map's lanes
+  NavGraph nav_graph;
+  NavGraph::Node route_start;
+  NavGraph::Node route_goal;
+  bool selected_route_node(NavGraph::Node& node);
+  void draw_route();
+
+  // Lane utilization heatmap of the active traffic map. Changes to the
+  // lane graphs restart congestion_timer, and the estimate only reruns
+  // once they stop for a moment, so dragging lanes around doesn't wait on
+  // it. The last estimate is drawn until then.
+  CongestionEstimator::TaskMix congestion_mix;
+  CongestionEstimator::Result congestion;
+  bool congestion_stale = true;
+  QTimer* congestion_timer = nullptr;
+  QLabel* congestion_label = nullptr;
+  void estimate_congestion();
+  void draw_congestion();
 
   const QString tool_id_to_string(const int id);
   QButtonGroup* tool_button_group = nullptr;
@@ -210,6 +266,8 @@ private:
   LiftTable* lift_table = nullptr;
   TrafficTable* traffic_table = nullptr;
   CrowdSimEditorTable* crowd_sim_table = nullptr;
+  EntityBrowser* entity_browser = nullptr;
+  void entity_browser_clicked(const int kind, const int index);
 
   QTableWidget* property_editor = nullptr;
   void update_property_editor();
@@ -221,10 +279,18 @@ private:
   void populate_property_editor(const Fiducial& fiducial);
   void populate_property_editor(const Polygon& polygon);
   void populate_property_editor(const Layer& layer);
+  void populate_property_editor(
+    const Level::ItemType type,
+    const std::set<int>& indices);
 
   QTableWidgetItem* create_table_item(const QString& str,
     bool editable = false);
   void property_editor_cell_changed(int row, int column);
+  void set_param_of_selected(
+    const Level::ItemType type,
+    const std::set<int>& indices,
+    const std::string& name,
+    const std::string& value);
   void property_editor_set_row(
     const int row_idx,
     const QString& label,
@@ -246,20 +312,18 @@ private:
   void delete_param_button_clicked();
   void clear_current_tool_buffer(); // Necessary for tools like edge drawing that store temporary states
 
-#ifdef HAS_IGNITION_PLUGIN
-  QAction* sim_reset_action;
-  QAction* sim_play_pause_action;
+  SimThread sim_thread;
+  bool sim_active = false;  // show simulated poses instead of edited ones
+  const SimThread::Frame* sim_frame = nullptr;  // the newest one taken
+  QAction* sim_play_pause_action = nullptr;
+  QTimer* scene_update_timer = nullptr;
   void sim_reset();
   void sim_play_pause();
-  SimThread sim_thread;
-  QTimer* scene_update_timer;
+  void sim_step();
+  void sim_stop();
+  void sim_set_speed(const double speed);
   void scene_update_timer_timeout();
-#endif
-
-public:
-  void sim_tick();  // called by SimThread
-
-private:
+  void draw_sim_frame();
 
 #if defined(HAS_IGNITION_PLUGIN) && defined(HAS_OPENCV)
   QAction* record_start_stop_action;
@@ -280,6 +344,7 @@ private:
   QGraphicsEllipseItem* mouse_motion_ellipse = nullptr;
   QGraphicsPixmapItem* mouse_motion_model = nullptr;
   QGraphicsPolygonItem* mouse_motion_polygon = nullptr;
+  QGraphicsRectItem* mouse_snap_marker = nullptr;
 
   int mouse_model_idx = -1;
   int mouse_vertex_idx = -1;
@@ -290,6 +355,13 @@ private:
   //int mouse_motion_polygon_vertex_idx = -1;
   Polygon::EdgeDragPolygon mouse_edge_drag_polygon;
 
+  // rubber band (or, holding Ctrl when pressing, lasso) selection
+  QPolygonF mouse_select_region;
+  QPoint mouse_select_press_pos;
+  bool mouse_select_pressed = false;
+  bool mouse_select_dragging = false;
+  bool mouse_select_lasso = false;
+
   void draw_mouse_motion_line_item(const double mouse_x, const double mouse_y);
   void remove_mouse_motion_item();
 
@@ -324,6 +396,11 @@ private:
   double discretize_angle(const double& angle);
   void align_point(const QPointF& start, QPointF& end);
 
+  // where the add vertex and add edge tools put a point clicked at p,
+  // not snapping to the Level::SnapType bits in `skip_types`
+  Level::Snap snap_point(const QPointF& p, const int skip_types = 0);
+  void draw_snap_marker(const Level::Snap& snap);
+
   void mouse_select(const MouseType t, QMouseEvent* e, const QPointF& p);
   void mouse_move(const MouseType t, QMouseEvent* e, const QPointF& p);
   void mouse_rotate(const MouseType t, QMouseEvent* e, const QPointF& p);
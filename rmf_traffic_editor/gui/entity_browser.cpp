@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <QtWidgets>
+
+#include "entity_browser.h"
+
+
+EntityBrowser::EntityBrowser(QWidget* parent)
+: QWidget(parent)
+{
+  model = new EntityTableModel(this);
+
+  kind_combo_box = new QComboBox;
+  kind_combo_box->addItem("vertices", EntityTableModel::VERTICES);
+  kind_combo_box->addItem("lanes", EntityTableModel::LANES);
+  kind_combo_box->addItem("doors", EntityTableModel::DOORS);
+  kind_combo_box->addItem("models", EntityTableModel::MODELS);
+  kind_combo_box->addItem("fiducials", EntityTableModel::FIDUCIALS);
+  connect(
+    kind_combo_box,
+    QOverload<int>::of(&QComboBox::currentIndexChanged),
+    [this](int)
+    {
+      model->set_kind(
+        static_cast<EntityTableModel::Kind>(
+          kind_combo_box->currentData().toInt()));
+      update_count_label();
+    });
+
+  name_line_edit = new QLineEdit;
+  name_line_edit->setPlaceholderText("name contains...");
+  name_line_edit->setClearButtonEnabled(true);
+  connect(
+    name_line_edit,
+    &QLineEdit::textChanged,
+    [this](const QString& text)
+    {
+      model->set_name_filter(text);
+      update_count_label();
+    });
+
+  param_line_edit = new QLineEdit;
+  param_line_edit->setPlaceholderText("param or param=value");
+  param_line_edit->setClearButtonEnabled(true);
+  connect(
+    param_line_edit,
+    &QLineEdit::editingFinished,
+    this,
+    &EntityBrowser::param_filter_changed);
+
+  count_label = new QLabel;
+
+  table_view = new QTableView;
+  table_view->setModel(model);
+  table_view->setSortingEnabled(true);
+  table_view->sortByColumn(EntityTableModel::INDEX, Qt::AscendingOrder);
+  table_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+  table_view->setSelectionMode(QAbstractItemView::SingleSelection);
+  table_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  table_view->verticalHeader()->setVisible(false);
+  // a fixed row height, so the view never has to measure rows it isn't
+  // showing
+  table_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  table_view->verticalHeader()->setDefaultSectionSize(
+    table_view->fontMetrics().height() + 6);
+  table_view->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft);
+  table_view->horizontalHeader()->setSectionResizeMode(
+    QHeaderView::Interactive);
+  table_view->horizontalHeader()->setStretchLastSection(true);
+  table_view->setStyleSheet(
+    "QTableView { background-color: #e0e0e0; color: black; } "
+    "QHeaderView::section { color: black; }");
+  connect(
+    table_view,
+    &QTableView::clicked,
+    [this](const QModelIndex& index)
+    {
+      const int entity_idx = model->entity_index(index.row());
+      if (entity_idx >= 0)
+        emit entity_clicked(model->kind(), entity_idx);
+    });
+
+  QHBoxLayout* filter_layout = new QHBoxLayout;
+  filter_layout->addWidget(kind_combo_box);
+  filter_layout->addWidget(name_line_edit);
+  filter_layout->addWidget(param_line_edit);
+
+  QVBoxLayout* layout = new QVBoxLayout;
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->addLayout(filter_layout);
+  layout->addWidget(table_view);
+  layout->addWidget(count_label);
+  setLayout(layout);
+  setMinimumSize(400, 200);
+  setSizePolicy(QSizePolicy::Fixed, QSizePolicy::MinimumExpanding);
+}
+
+void EntityBrowser::update(const Building& building, const int level_idx)
+{
+  const int entity_idx =
+    model->entity_index(table_view->currentIndex().row());
+  const int scroll_position = table_view->verticalScrollBar()->value();
+  model->update(building, level_idx);
+  restore_view(entity_idx, scroll_position);
+  update_count_label();
+}
+
+void EntityBrowser::redraw()
+{
+  model->redraw();
+}
+
+void EntityBrowser::refresh()
+{
+  const int entity_idx =
+    model->entity_index(table_view->currentIndex().row());
+  const int scroll_position = table_view->verticalScrollBar()->value();
+  model->refresh();
+  restore_view(entity_idx, scroll_position);
+  update_count_label();
+}
+
+void EntityBrowser::param_filter_changed()
+{
+  const QString text = param_line_edit->text().trimmed();
+  const int equals = text.indexOf('=');
+  const QString key = equals < 0 ? text : text.left(equals).trimmed();
+  const QString value = equals < 0 ? QString() : text.mid(equals + 1).trimmed();
+  model->set_param_filter(key.toStdString(), value.toStdString());
+  update_count_label();
+}
+
+void EntityBrowser::update_count_label()
+{
+  count_label->setText(
+    QString("%1 of %2 shown")
+    .arg(model->rowCount())
+    .arg(model->num_entities()));
+}
+
+void EntityBrowser::restore_view(
+  const int entity_idx,
+  const int scroll_position)
+{
+  table_view->verticalScrollBar()->setValue(scroll_position);
+  if (entity_idx < 0)
+    return;
+  const int row = model->row_of(entity_idx);
+  if (row >= 0)
+  {
+    table_view->selectionModel()->setCurrentIndex(
+      model->index(row, 0),
+      QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+  }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ENTITY_BROWSER_H
+#define ENTITY_BROWSER_H
+
+#include <QWidget>
+
+#include "entity_table_model.h"
+
+class Building;
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QTableView;
+
+
+/// A side panel listing the vertices, lanes, doors, models or fiducials
+/// of the current level, which can be sorted by any column, filtered by
+/// name, and searched by param: "is_charger" lists the vertices that have
+/// that param, and "is_charger=true" the ones that are chargers.
+class EntityBrowser : public QWidget
+{
+  Q_OBJECT
+
+public:
+  EntityBrowser(QWidget* parent = nullptr);
+
+  /// Call after the level changes; see EntityTableModel::update()
+  void update(const Building& building, const int level_idx);
+
+  /// Call while an entity is being dragged; see EntityTableModel::redraw()
+  void redraw();
+
+  /// Collect, filter and sort the entities again
+  void refresh();
+
+signals:
+  /// `kind` is an EntityTableModel::Kind, `index` is in its container
+  void entity_clicked(const int kind, const int index);
+
+private:
+  EntityTableModel* model = nullptr;
+  QComboBox* kind_combo_box = nullptr;
+  QLineEdit* name_line_edit = nullptr;
+  QLineEdit* param_line_edit = nullptr;
+  QLabel* count_label = nullptr;
+  QTableView* table_view = nullptr;
+
+  void param_filter_changed();
+  void update_count_label();
+
+  // put the view back where it was after the rows were collected again
+  void restore_view(const int entity_idx, const int scroll_position);
+};
+
+#endif
@@ -0,0 +1,423 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include "building.h"
+#include "entity_table_model.h"
+
+using std::vector;
+
+
+EntityTableModel::EntityTableModel(QObject* parent)
+: QAbstractTableModel(parent)
+{
+}
+
+void EntityTableModel::update(const Building& building, const int level_idx)
+{
+  const bool same_level = _building == &building && _level_idx == level_idx;
+  _building = &building;
+  _level_idx = level_idx;
+
+  const Level* l = level();
+  if (same_level && l && l->revision() == _revision &&
+    count_entities() == _num_entities)
+  {
+    redraw();
+    return;
+  }
+  refresh();
+}
+
+void EntityTableModel::redraw()
+{
+  if (!_rows.empty())
+    emit dataChanged(
+      index(0, 0),
+      index(static_cast<int>(_rows.size()) - 1, columnCount() - 1));
+}
+
+void EntityTableModel::refresh()
+{
+  beginResetModel();
+  collect();
+  sort_rows();
+  index_rows();
+  endResetModel();
+}
+
+void EntityTableModel::set_kind(const Kind kind)
+{
+  if (kind == _kind)
+    return;
+  _kind = kind;
+  refresh();
+}
+
+void EntityTableModel::set_name_filter(const QString& text)
+{
+  _name_filter = text;
+  refresh();
+}
+
+void EntityTableModel::set_param_filter(
+  const std::string& key,
+  const std::string& value)
+{
+  _param_key = key;
+  _param_value = value;
+  refresh();
+}
+
+int EntityTableModel::entity_index(const int row) const
+{
+  if (row < 0 || row >= static_cast<int>(_rows.size()))
+    return -1;
+  return _rows[row];
+}
+
+int EntityTableModel::row_of(const int entity_index) const
+{
+  if (entity_index < 0 || entity_index >= static_cast<int>(_row_of.size()))
+    return -1;
+  return _row_of[entity_index];
+}
+
+int EntityTableModel::num_entities() const
+{
+  return _num_entities;
+}
+
+int EntityTableModel::rowCount(const QModelIndex& parent) const
+{
+  return parent.isValid() ? 0 : static_cast<int>(_rows.size());
+}
+
+int EntityTableModel::columnCount(const QModelIndex& parent) const
+{
+  if (parent.isValid())
+    return 0;
+  return _param_key.empty() ? PARAM : PARAM + 1;
+}
+
+QVariant EntityTableModel::data(const QModelIndex& index, int role) const
+{
+  const Level* l = level();
+  if (!l || !index.isValid() || index.row() >= static_cast<int>(_rows.size()))
+    return QVariant();
+  const int i = _rows[index.row()];
+
+  if (role == Qt::TextAlignmentRole)
+  {
+    if (index.column() == INDEX || index.column() == X ||
+      index.column() == Y)
+      return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+    return QVariant();
+  }
+  if (role != Qt::DisplayRole)
+    return QVariant();
+
+  switch (index.column())
+  {
+    case INDEX: return i;
+    case NAME: return name(*l, i);
+    case X: return QString::number(position(*l, i).x(), 'f', 3);
+    case Y: return QString::number(position(*l, i).y(), 'f', 3);
+    case PARAM: return param_value(*l, i);
+    default: return QVariant();
+  }
+}
+
+QVariant EntityTableModel::headerData(
+  int section,
+  Qt::Orientation orientation,
+  int role) const
+{
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return QVariant();
+
+  switch (section)
+  {
+    case INDEX: return QString("index");
+    case NAME: return QString("name");
+    case X: return QString("x (m)");
+    case Y: return QString("y (m)");
+    case PARAM: return QString::fromStdString(_param_key);
+    default: return QVariant();
+  }
+}
+
+void EntityTableModel::sort(int column, Qt::SortOrder order)
+{
+  _sort_column = column;
+  _sort_order = order;
+  emit layoutAboutToBeChanged();
+  sort_rows();
+  index_rows();
+  emit layoutChanged();
+}
+
+const Level* EntityTableModel::level() const
+{
+  if (!_building || _level_idx < 0 ||
+    _level_idx >= static_cast<int>(_building->levels.size()))
+    return nullptr;
+  return &_building->levels[_level_idx];
+}
+
+int EntityTableModel::count_entities() const
+{
+  const Level* l = level();
+  if (!l)
+    return 0;
+  switch (_kind)
+  {
+    case VERTICES: return static_cast<int>(l->vertices.size());
+    case LANES:
+    case DOORS: return static_cast<int>(l->edges.size());
+    case MODELS: return static_cast<int>(l->models.size());
+    case FIDUCIALS: return static_cast<int>(l->fiducials.size());
+    default: return 0;
+  }
+}
+
+void EntityTableModel::collect()
+{
+  _rows.clear();
+  _num_entities = count_entities();
+  const Level* l = level();
+  if (!l)
+    return;
+  _revision = l->revision();
+
+  // the vertex param index answers this without looking at every vertex
+  const bool by_param = !_param_key.empty();
+  if (_kind == VERTICES && by_param)
+  {
+    _rows = _param_value.empty() ?
+      l->vertices_with_param(_param_key) :
+      l->vertices_with_param(_param_key, _param_value);
+  }
+  else
+  {
+    _rows.resize(_num_entities);
+    std::iota(_rows.begin(), _rows.end(), 0);
+  }
+
+  const Edge::Type edge_type = _kind == LANES ? Edge::LANE : Edge::DOOR;
+  const QString value = QString::fromStdString(_param_value);
+  const auto keep = [&](const int i)
+    {
+      if ((_kind == LANES || _kind == DOORS) && l->edges[i].type != edge_type)
+        return false;
+      if (by_param && _kind != VERTICES)
+      {
+        const ParamMap* p = params(*l, i);
+        if (!p)
+          return false;
+        const auto it = p->find(_param_key);
+        if (it == p->end())
+          return false;
+        if (!value.isEmpty() && it->second.to_qstring() != value)
+          return false;
+      }
+      return _name_filter.isEmpty() ||
+        name(*l, i).contains(_name_filter, Qt::CaseInsensitive);
+    };
+  _rows.erase(
+    std::remove_if(
+      _rows.begin(),
+      _rows.end(),
+      [&keep](const int i) { return !keep(i); }),
+    _rows.end());
+}
+
+void EntityTableModel::sort_rows()
+{
+  const Level* l = level();
+  if (!l || _sort_column < 0)
+    return;
+  const bool ascending = _sort_order == Qt::AscendingOrder;
+
+  // work out each key once, rather than in every comparison
+  if (_sort_column == NAME || _sort_column == PARAM)
+  {
+    vector<std::pair<QString, int>> keys(_rows.size());
+    for (std::size_t r = 0; r < _rows.size(); r++)
+    {
+      const int i = _rows[r];
+      keys[r].first =
+        _sort_column == NAME ? name(*l, i) : param_value(*l, i);
+      keys[r].second = i;
+    }
+    std::stable_sort(
+      keys.begin(),
+      keys.end(),
+      [ascending](const auto& a, const auto& b)
+      {
+        return ascending ? a.first < b.first : b.first < a.first;
+      });
+    for (std::size_t r = 0; r < keys.size(); r++)
+      _rows[r] = keys[r].second;
+  }
+  else
+  {
+    vector<std::pair<double, int>> keys(_rows.size());
+    for (std::size_t r = 0; r < _rows.size(); r++)
+    {
+      const int i = _rows[r];
+      if (_sort_column == X)
+        keys[r].first = position(*l, i).x();
+      else if (_sort_column == Y)
+        keys[r].first = position(*l, i).y();
+      else
+        keys[r].first = i;
+      keys[r].second = i;
+    }
+    std::stable_sort(
+      keys.begin(),
+      keys.end(),
+      [ascending](const auto& a, const auto& b)
+      {
+        return ascending ? a.first < b.first : b.first < a.first;
+      });
+    for (std::size_t r = 0; r < keys.size(); r++)
+      _rows[r] = keys[r].second;
+  }
+}
+
+void EntityTableModel::index_rows()
+{
+  _row_of.assign(_num_entities, -1);
+  for (std::size_t r = 0; r < _rows.size(); r++)
+  {
+    if (_rows[r] >= 0 && _rows[r] < _num_entities)
+      _row_of[_rows[r]] = static_cast<int>(r);
+  }
+}
+
+QString EntityTableModel::name(const Level& level, const int i) const
+{
+  switch (_kind)
+  {
+    case VERTICES:
+      if (i < static_cast<int>(level.vertices.size()))
+        return QString::fromStdString(level.vertices[i].name);
+      break;
+    case LANES:
+      if (i < static_cast<int>(level.edges.size()))
+      {
+        const Edge& e = level.edges[i];
+        return QString("%1 -> %2").arg(e.start_idx).arg(e.end_idx);
+      }
+      break;
+    case DOORS:
+      if (i < static_cast<int>(level.edges.size()))
+      {
+        static const ParamKey key("name");
+        const auto it = level.edges[i].params.find(key);
+        if (it != level.edges[i].params.end())
+          return QString::fromStdString(it->second.value_string());
+      }
+      break;
+    case MODELS:
+      if (i < static_cast<int>(level.models.size()))
+        return QString::fromStdString(level.models[i].instance_name);
+      break;
+    case FIDUCIALS:
+      if (i < static_cast<int>(level.fiducials.size()))
+        return QString::fromStdString(level.fiducials[i].name);
+      break;
+    default:
+      break;
+  }
+  return QString();
+}
+
+QPointF EntityTableModel::position(const Level& level, const int i) const
+{
+  QPointF p;
+  switch (_kind)
+  {
+    case VERTICES:
+      if (i < static_cast<int>(level.vertices.size()))
+        p = QPointF(level.vertices[i].x, level.vertices[i].y);
+      break;
+    case LANES:
+    case DOORS:
+    {
+      const int num_vertices = static_cast<int>(level.vertices.size());
+      if (i >= static_cast<int>(level.edges.size()))
+        break;
+      const Edge& e = level.edges[i];
+      if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+        e.end_idx < 0 || e.end_idx >= num_vertices)
+        break;
+      const Vertex& a = level.vertices[e.start_idx];
+      const Vertex& b = level.vertices[e.end_idx];
+      p = QPointF((a.x + b.x) / 2.0, (a.y + b.y) / 2.0);
+      break;
+    }
+    case MODELS:
+      if (i < static_cast<int>(level.models.size()))
+        p = QPointF(level.models[i].state.x, level.models[i].state.y);
+      break;
+    case FIDUCIALS:
+      if (i < static_cast<int>(level.fiducials.size()))
+        p = QPointF(level.fiducials[i].x, level.fiducials[i].y);
+      break;
+    default:
+      break;
+  }
+
+  // the same as the property editor shows: y is up
+  const double scale = level.drawing_meters_per_pixel;
+  return QPointF(p.x() * scale, -p.y() * scale);
+}
+
+const ParamMap* EntityTableModel::params(
+  const Level& level,
+  const int i) const
+{
+  switch (_kind)
+  {
+    case VERTICES:
+      if (i < static_cast<int>(level.vertices.size()))
+        return &level.vertices[i].params;
+      break;
+    case LANES:
+    case DOORS:
+      if (i < static_cast<int>(level.edges.size()))
+        return &level.edges[i].params;
+      break;
+    default:
+      break;
+  }
+  return nullptr;
+}
+
+QString EntityTableModel::param_value(const Level& level, const int i) const
+{
+  const ParamMap* p = params(level, i);
+  if (!p || _param_key.empty())
+    return QString();
+  const auto it = p->find(_param_key);
+  return it == p->end() ? QString() : it->second.to_qstring();
+}
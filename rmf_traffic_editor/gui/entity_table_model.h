@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef ENTITY_TABLE_MODEL_H
+#define ENTITY_TABLE_MODEL_H
+
+#include <string>
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QPointF>
+#include <QString>
+
+class Building;
+class Level;
+class ParamMap;
+
+
+/// One kind of entity of a level (vertices, lanes, doors, models or
+/// fiducials) as a table, for EntityBrowser. The model only holds the
+/// level indices of the rows that pass the filters, in sorted order, and
+/// reads everything else from the level when the view asks for it, so
+/// only the rows on screen are ever turned into text.
+class EntityTableModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  enum Kind
+  {
+    VERTICES = 0,
+    LANES,
+    DOORS,
+    MODELS,
+    FIDUCIALS
+  };
+
+  enum Column
+  {
+    INDEX = 0,
+    NAME,
+    X,
+    Y,
+    PARAM  // only while filtering by a param
+  };
+
+  EntityTableModel(QObject* parent = nullptr);
+
+  /// Show a level of the building after it may have changed. The rows are
+  /// only collected again if it is another level, or Level::revision()
+  /// says it was edited, since any edit can change which entities pass the
+  /// filters or where they sort; otherwise they are just redrawn.
+  void update(const Building& building, const int level_idx);
+
+  /// Redraw the rows with the current values of their entities, without
+  /// collecting them again. Cheaper than update() while an entity is being
+  /// dragged, but only right as long as no entity is added or removed.
+  void redraw();
+
+  /// Collect, filter and sort the rows again
+  void refresh();
+
+  void set_kind(const Kind kind);
+  Kind kind() const { return _kind; }
+
+  /// Only keep the entities whose name contains `text`, ignoring case
+  void set_name_filter(const QString& text);
+
+  /// Only keep the entities that have param `key`, and if `value` isn't
+  /// empty, where it is written as `value` (see Param::to_qstring()). The
+  /// param gets a column of its own. Models and fiducials have no params,
+  /// so none of them are kept while the key is set.
+  void set_param_filter(const std::string& key, const std::string& value);
+
+  /// The index of the entity shown in a row, in its container of the level
+  int entity_index(const int row) const;
+
+  /// The row showing an entity, or -1 if it is filtered out
+  int row_of(const int entity_index) const;
+
+  /// How many entities of this kind the level has, filtered or not
+  int num_entities() const;
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex& index, int role = Qt::DisplayRole)
+  const override;
+  QVariant headerData(
+    int section,
+    Qt::Orientation orientation,
+    int role = Qt::DisplayRole) const override;
+  void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+private:
+  const Building* _building = nullptr;
+  int _level_idx = -1;
+  int _num_entities = 0;  // when the rows were last collected
+  std::size_t _revision = 0;  // of the level when the rows were collected
+  Kind _kind = VERTICES;
+  QString _name_filter;
+  std::string _param_key;
+  std::string _param_value;
+  int _sort_column = -1;
+  Qt::SortOrder _sort_order = Qt::AscendingOrder;
+  std::vector<int> _rows;
+  std::vector<int> _row_of;  // by entity index, -1 if filtered out
+
+  const Level* level() const;
+  int count_entities() const;
+  void collect();
+  void sort_rows();
+  void index_rows();
+
+  // each returns nothing useful if the entity index is out of range
+  QString name(const Level& level, const int i) const;
+  QPointF position(const Level& level, const int i) const;  // meters
+  const ParamMap* params(const Level& level, const int i) const;
+  QString param_value(const Level& level, const int i) const;
+};
+
+#endif
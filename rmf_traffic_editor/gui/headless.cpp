@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+#include "building.h"
+#include "headless.h"
+
+using std::string;
+using std::vector;
+
+
+namespace {
+
+struct FileResult
+{
+  string filename;
+  bool loaded = false;
+  bool saved = false;
+  vector<string> problems;
+  double load_ms = 0;
+  double validate_ms = 0;
+  double save_ms = 0;
+};
+
+void process_file(FileResult& result, const HeadlessOptions& options)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  Building building;
+  result.loaded = building.load(result.filename, Building::LOAD_HEADLESS);
+  result.load_ms = timer.nsecsElapsed() / 1e6;
+  if (!result.loaded)
+    return;
+
+  timer.restart();
+  building.validate(result.problems);
+  result.validate_ms = timer.nsecsElapsed() / 1e6;
+
+  // don't write out anything we already know is broken
+  if (!options.save || !result.problems.empty())
+    return;
+
+  timer.restart();
+  result.saved = building.save();
+  result.save_ms = timer.nsecsElapsed() / 1e6;
+}
+
+}  // namespace
+
+int run_headless(
+  const QStringList& filenames,
+  const HeadlessOptions& options)
+{
+  if (filenames.isEmpty())
+  {
+    printf("no building files given\n");
+    return 1;
+  }
+
+  // report every file by its full path
+  vector<FileResult> results(filenames.size());
+  for (int i = 0; i < filenames.size(); i++)
+    results[i].filename =
+      QFileInfo(filenames[i]).absoluteFilePath().toStdString();
+
+  int num_threads = options.num_threads;
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min(num_threads, static_cast<int>(results.size()));
+
+  QElapsedTimer total_timer;
+  total_timer.start();
+
+  // each worker grabs the next unclaimed file until there are none left,
+  // so a few huge buildings don't hold up a thread with a fixed share
+  std::atomic<std::size_t> next_idx(0);
+  vector<std::thread> workers;
+  for (int i = 0; i < num_threads; i++)
+  {
+    workers.emplace_back(
+      [&]()
+      {
+        std::size_t idx;
+        while ((idx = next_idx++) < results.size())
+          process_file(results[idx], options);
+      });
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  const double total_s = total_timer.nsecsElapsed() / 1e9;
+
+  int num_failed = 0;
+  printf("\n");
+  for (const FileResult& r : results)
+  {
+    const bool ok =
+      r.loaded && r.problems.empty() && (r.saved || !options.save);
+    if (!ok)
+      num_failed++;
+
+    printf("%s  load %8.1f ms  validate %6.1f ms  save %6.1f ms  %s\n",
+      ok ? "  OK" : "FAIL",
+      r.load_ms,
+      r.validate_ms,
+      r.save_ms,
+      r.filename.c_str());
+
+    if (!r.loaded)
+      printf("        unable to load\n");
+    for (const string& problem : r.problems)
+      printf("        %s\n", problem.c_str());
+    if (options.save && r.loaded && r.problems.empty() && !r.saved)
+      printf("        unable to save\n");
+  }
+
+  printf(
+    "\nprocessed %d files in %.2f s on %d threads (%.1f files/s), "
+    "%d failed\n",
+    static_cast<int>(results.size()),
+    total_s,
+    num_threads,
+    total_s > 0 ? results.size() / total_s : 0.0,
+    num_failed);
+
+  return num_failed == 0 ? 0 : 1;
+}
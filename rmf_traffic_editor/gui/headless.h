@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QStringList>
+
+
+/// Options for processing buildings without the editor window
+struct HeadlessOptions
+{
+  bool save = false;  // re-save each building after it passes validation
+  int num_threads = 0;  // zero means one per core
+};
+
+/// Load, validate and optionally re-save every file in `filenames`,
+/// spreading the files across worker threads. Only the Building data model
+/// is used, never the Editor, so this works without a display. Prints the
+/// timings and problems found for each file and the overall throughput.
+/// Returns zero if every file loaded, validated and saved cleanly.
+int run_headless(
+  const QStringList& filenames,
+  const HeadlessOptions& options);
+
+#endif
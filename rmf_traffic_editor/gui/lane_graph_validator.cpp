@@ -0,0 +1,666 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <set>
+#include <unordered_map>
+
+#include <QGraphicsEllipseItem>
+#include <QGraphicsLineItem>
+#include <QGraphicsScene>
+#include <QPen>
+
+#include "building.h"
+#include "lane_graph_validator.h"
+
+using std::string;
+using std::vector;
+
+
+namespace {
+
+int find_root(vector<int>& parent, int i)
+{
+  while (parent[i] != i)
+  {
+    parent[i] = parent[parent[i]];  // path halving
+    i = parent[i];
+  }
+  return i;
+}
+
+void join(vector<int>& parent, const int a, const int b)
+{
+  const int root_a = find_root(parent, a);
+  const int root_b = find_root(parent, b);
+  if (root_a != root_b)
+    parent[root_b] = root_a;
+}
+
+string edge_name(const Edge& edge, const int edge_idx)
+{
+  auto it = edge.params.find("name");
+  if (it != edge.params.end() && !it->second.value_string().empty())
+    return it->second.value_string();
+  return std::to_string(edge_idx);
+}
+
+}  // namespace
+
+string LaneGraphValidator::graph_name(const GraphKey& graph)
+{
+  return (graph.first ? "human lane graph " : "lane graph ") +
+    std::to_string(graph.second);
+}
+
+bool LaneGraphValidator::update(const Building& building)
+{
+  bool changed = false;
+  level_results.resize(building.levels.size());
+  for (std::size_t i = 0; i < building.levels.size(); i++)
+  {
+    LevelResult& result = level_results[i];
+    const std::size_t fp = building.levels[i].lane_graph_fingerprint();
+    if (!result.valid || result.fingerprint != fp)
+    {
+      analyze_level(building.levels[i], static_cast<int>(i), result);
+      result.fingerprint = fp;
+      result.valid = true;
+      changed = true;
+    }
+  }
+
+  analyze_building(building);
+  return changed;
+}
+
+void LaneGraphValidator::clear()
+{
+  level_results.clear();
+  building_issues.clear();
+}
+
+vector<LaneGraphValidator::Issue> LaneGraphValidator::issues() const
+{
+  vector<Issue> all;
+  all.reserve(num_issues());
+  for (const LevelResult& result : level_results)
+    all.insert(all.end(), result.issues.begin(), result.issues.end());
+  all.insert(all.end(), building_issues.begin(), building_issues.end());
+  return all;
+}
+
+const vector<SegmentIntersector::EdgeCrossing>&
+LaneGraphValidator::crossings(const int level_idx) const
+{
+  static const vector<SegmentIntersector::EdgeCrossing> none;
+  if (level_idx < 0 || level_idx >= static_cast<int>(level_results.size()))
+    return none;
+  return level_results[level_idx].crossings;
+}
+
+std::size_t LaneGraphValidator::num_issues() const
+{
+  std::size_t n = building_issues.size();
+  for (const LevelResult& result : level_results)
+    n += result.issues.size();
+  return n;
+}
+
+void LaneGraphValidator::analyze_level(
+  const Level& level,
+  const int level_idx,
+  LevelResult& result)
+{
+  result.issues.clear();
+  result.components.clear();
+  result.lift_vertices.clear();
+  result.crossings.clear();
+
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  vector<const string*> lift_names(num_vertices, nullptr);
+  for (int i = 0; i < num_vertices; i++)
+  {
+    const Vertex& v = level.vertices[i];
+    auto it = v.params.find("lift_cabin");
+    if (it != v.params.end() && !it->second.value_string().empty())
+    {
+      lift_names[i] = &it->second.value_string();
+      result.lift_vertices.push_back(
+        std::make_pair(i, it->second.value_string()));
+    }
+  }
+
+  auto add_issue = [&](
+    const Issue::Type type,
+    const int vertex_idx,
+    const int edge_idx,
+    const int other_edge_idx,
+    const string& description)
+    {
+      Issue issue;
+      issue.type = type;
+      issue.level_idx = level_idx;
+      issue.vertex_idx = vertex_idx;
+      issue.edge_idx = edge_idx;
+      issue.other_edge_idx = other_edge_idx;
+      issue.description = description;
+      result.issues.push_back(issue);
+    };
+
+  auto segment = [&](const Edge& e)
+    {
+      const Vertex& start = level.vertices[e.start_idx];
+      const Vertex& end = level.vertices[e.end_idx];
+      return SegmentIntersector::Segment{start.x, start.y, end.x, end.y};
+    };
+
+  vector<int> lanes, doors;
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& e = level.edges[i];
+    if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+      e.end_idx < 0 || e.end_idx >= num_vertices ||
+      e.start_idx == e.end_idx)
+      continue;  // Building::validate() reports these
+
+    if (e.type == Edge::LANE || e.type == Edge::HUMAN_LANE)
+      lanes.push_back(static_cast<int>(i));
+    else if (e.type == Edge::DOOR)
+      doors.push_back(static_cast<int>(i));
+  }
+
+  // look up the lane parameters once, rather than in every inner loop
+  struct Lane
+  {
+    int start_idx;
+    int end_idx;
+    bool bidirectional;
+    int graph;  // index into graph_keys
+  };
+  vector<Lane> lane_info(lanes.size());
+  vector<GraphKey> graph_keys;
+  std::map<GraphKey, vector<int>> graphs;  // lanes (not edges) per graph
+  for (std::size_t i = 0; i < lanes.size(); i++)
+  {
+    const Edge& e = level.edges[lanes[i]];
+    const GraphKey key(e.type == Edge::HUMAN_LANE, e.get_graph_idx());
+    auto it = std::find(graph_keys.begin(), graph_keys.end(), key);
+    if (it == graph_keys.end())
+      it = graph_keys.insert(graph_keys.end(), key);
+    lane_info[i].start_idx = e.start_idx;
+    lane_info[i].end_idx = e.end_idx;
+    lane_info[i].bidirectional = e.is_bidirectional();
+    lane_info[i].graph = static_cast<int>(it - graph_keys.begin());
+    graphs[key].push_back(static_cast<int>(i));
+  }
+
+  // connectivity and vertex degrees, one graph at a time. The per-vertex
+  // buffers are allocated once and only the touched entries are reset.
+  vector<int> in_degree(num_vertices, 0);
+  vector<int> out_degree(num_vertices, 0);
+  vector<int> parent(num_vertices);
+  std::iota(parent.begin(), parent.end(), 0);
+  vector<char> touched_mask(num_vertices, 0);
+  vector<int> touched;
+
+  for (const auto& graph : graphs)
+  {
+    touched.clear();
+    for (const int lane_idx : graph.second)
+    {
+      const Lane& e = lane_info[lane_idx];
+      for (const int v : {e.start_idx, e.end_idx})
+      {
+        if (!touched_mask[v])
+        {
+          touched_mask[v] = 1;
+          touched.push_back(v);
+        }
+      }
+      out_degree[e.start_idx]++;
+      in_degree[e.end_idx]++;
+      if (e.bidirectional)
+      {
+        out_degree[e.end_idx]++;
+        in_degree[e.start_idx]++;
+      }
+      join(parent, e.start_idx, e.end_idx);
+    }
+
+    const string name = graph_name(graph.first);
+    std::unordered_map<int, std::size_t> root_components;
+    for (const int v : touched)
+    {
+      // robots routinely ride a lift in one direction only, so a cabin
+      // waypoint that can only be entered (or left) on one level is fine
+      if (!lift_names[v])
+      {
+        if (out_degree[v] == 0)
+          add_issue(
+            Issue::DEAD_END_VERTEX, v, -1, -1,
+            name + ": vertex " + std::to_string(v) +
+            " can be entered but not left");
+        else if (in_degree[v] == 0)
+          add_issue(
+            Issue::UNREACHABLE_VERTEX, v, -1, -1,
+            name + ": vertex " + std::to_string(v) +
+            " can be left but not reached");
+      }
+
+      const int root = find_root(parent, v);
+      auto it = root_components.find(root);
+      if (it == root_components.end())
+      {
+        Component component;
+        component.graph = graph.first;
+        component.vertex_idx = v;
+        it = root_components.emplace(root, result.components.size()).first;
+        result.components.push_back(component);
+      }
+      Component& component = result.components[it->second];
+      component.num_vertices++;
+      if (lift_names[v] &&
+        std::find(component.lifts.begin(), component.lifts.end(),
+        *lift_names[v]) == component.lifts.end())
+        component.lifts.push_back(*lift_names[v]);
+    }
+
+    for (const int v : touched)
+    {
+      in_degree[v] = 0;
+      out_degree[v] = 0;
+      parent[v] = v;
+      touched_mask[v] = 0;
+    }
+  }
+
+  // duplicate lanes: same graph and same pair of vertices. Two one-way
+  // lanes in opposite directions are not duplicates of each other. Only
+  // lanes sharing their lower vertex index can match, so bucket them by it
+  // (a counting sort) and compare within each small bucket.
+  vector<int> bucket_start(num_vertices + 1, 0);
+  for (const Lane& e : lane_info)
+    bucket_start[std::min(e.start_idx, e.end_idx) + 1]++;
+  std::partial_sum(
+    bucket_start.begin(), bucket_start.end(), bucket_start.begin());
+  vector<int> buckets(lane_info.size());
+  vector<int> fill(bucket_start.begin(), bucket_start.end() - 1);
+  for (std::size_t i = 0; i < lane_info.size(); i++)
+  {
+    const Lane& e = lane_info[i];
+    buckets[fill[std::min(e.start_idx, e.end_idx)]++] = static_cast<int>(i);
+  }
+
+  for (int v = 0; v < num_vertices; v++)
+  {
+    for (int j = bucket_start[v] + 1; j < bucket_start[v + 1]; j++)
+    {
+      const Lane& e = lane_info[buckets[j]];
+      for (int i = bucket_start[v]; i < j; i++)
+      {
+        const Lane& first = lane_info[buckets[i]];
+        if (first.graph != e.graph ||
+          std::max(first.start_idx, first.end_idx) !=
+          std::max(e.start_idx, e.end_idx))
+          continue;
+        if (first.bidirectional || e.bidirectional ||
+          first.start_idx == e.start_idx)
+        {
+          add_issue(
+            Issue::DUPLICATE_LANE, -1, lanes[buckets[j]], lanes[buckets[i]],
+            graph_name(graph_keys[e.graph]) + ": lanes " +
+            std::to_string(lanes[buckets[i]]) + " and " +
+            std::to_string(lanes[buckets[j]]) + " duplicate each other");
+          break;
+        }
+      }
+    }
+  }
+
+  // overlapping lanes, using a spatial index of just the lanes
+  typedef SegmentIntersector::Segment Segment;
+  vector<Segment> lane_segments;
+  lane_segments.reserve(lanes.size());
+  for (const int edge_idx : lanes)
+    lane_segments.push_back(segment(level.edges[edge_idx]));
+  SegmentIntersector lane_index(lane_segments);
+
+  for (std::size_t i = 0; i < lanes.size(); i++)
+  {
+    const Lane& a = lane_info[i];
+    lane_index.query(
+      lane_segments[i],
+      [&](const int j)
+      {
+        if (j <= static_cast<int>(i))
+          return;
+        const Lane& b = lane_info[j];
+        if (a.graph != b.graph)
+          return;
+        if (std::min(a.start_idx, a.end_idx) ==
+        std::min(b.start_idx, b.end_idx) &&
+        std::max(a.start_idx, a.end_idx) ==
+        std::max(b.start_idx, b.end_idx))
+          return;  // same vertices; a duplicate, or opposing one-way lanes
+        if (SegmentIntersector::segments_overlap(
+          lane_segments[i], lane_segments[j]))
+          add_issue(
+            Issue::OVERLAPPING_LANES, -1, lanes[i], lanes[j],
+            graph_name(graph_keys[a.graph]) + ": lanes " +
+            std::to_string(lanes[i]) + " and " + std::to_string(lanes[j]) +
+            " overlap");
+      });
+  }
+
+  // lanes crossing walls, doors and each other
+  result.crossings = SegmentIntersector::find_edge_crossings(level);
+  vector<char> door_linked(level.edges.size(), 0);
+  for (const auto& crossing : result.crossings)
+  {
+    const Edge& lane = level.edges[crossing.edge_idx];
+    const Edge& other = level.edges[crossing.other_edge_idx];
+    switch (crossing.type)
+    {
+      case SegmentIntersector::LANE_WALL:
+        add_issue(
+          Issue::LANE_CROSSES_WALL, -1,
+          crossing.edge_idx, crossing.other_edge_idx,
+          "lane " + std::to_string(crossing.edge_idx) + " crosses wall " +
+          std::to_string(crossing.other_edge_idx));
+        break;
+
+      case SegmentIntersector::LANE_LANE:
+      {
+        // lanes of different graphs may well cross; robots of the same
+        // fleet would need a vertex there to coordinate
+        if (lane.type != other.type ||
+          lane.get_graph_idx() != other.get_graph_idx())
+          break;
+        const GraphKey graph(
+          lane.type == Edge::HUMAN_LANE, lane.get_graph_idx());
+        add_issue(
+          Issue::LANES_CROSS, -1,
+          crossing.edge_idx, crossing.other_edge_idx,
+          graph_name(graph) + ": lanes " +
+          std::to_string(crossing.edge_idx) + " and " +
+          std::to_string(crossing.other_edge_idx) +
+          " cross without a shared vertex");
+        break;
+      }
+
+      case SegmentIntersector::LANE_DOOR:
+        door_linked[crossing.other_edge_idx] = 1;
+        break;
+    }
+  }
+
+  for (const int door_idx : doors)
+  {
+    if (!door_linked[door_idx])
+      add_issue(
+        Issue::UNLINKED_DOOR, -1, door_idx, -1,
+        "door " + edge_name(level.edges[door_idx], door_idx) +
+        " is not crossed by any lane");
+  }
+}
+
+void LaneGraphValidator::analyze_building(const Building& building)
+{
+  building_issues.clear();
+
+  auto add_issue = [&](
+    const Issue::Type type,
+    const int level_idx,
+    const int vertex_idx,
+    const string& description)
+    {
+      Issue issue;
+      issue.type = type;
+      issue.level_idx = level_idx;
+      issue.vertex_idx = vertex_idx;
+      issue.description = description;
+      building_issues.push_back(issue);
+    };
+
+  // Each level's components of each graph are nodes here, and components
+  // containing the cabin waypoints of the same lift are joined.
+  vector<std::pair<int, int>> nodes;  // (level_idx, component_idx)
+  vector<int> parent;
+  std::map<std::pair<GraphKey, string>, int> lift_nodes;
+  for (std::size_t i = 0; i < level_results.size(); i++)
+  {
+    LevelResult& result = level_results[i];
+    for (auto& issue : result.issues)
+      issue.level_idx = static_cast<int>(i);  // in case levels were reordered
+
+    for (std::size_t c = 0; c < result.components.size(); c++)
+    {
+      const int node = static_cast<int>(nodes.size());
+      nodes.push_back(std::make_pair(static_cast<int>(i), c));
+      parent.push_back(node);
+
+      const Component& component = result.components[c];
+      for (const string& lift : component.lifts)
+      {
+        auto it = lift_nodes.find(std::make_pair(component.graph, lift));
+        if (it == lift_nodes.end())
+          lift_nodes[std::make_pair(component.graph, lift)] = node;
+        else
+          join(parent, it->second, node);
+      }
+    }
+  }
+
+  // the largest connected group of each graph is the graph; anything
+  // else is disconnected from it
+  auto component_of = [&](const int node) -> const Component&
+    {
+      return level_results[nodes[node].first].components[nodes[node].second];
+    };
+
+  vector<int> group_size(nodes.size(), 0);
+  for (std::size_t n = 0; n < nodes.size(); n++)
+    group_size[find_root(parent, n)] += component_of(n).num_vertices;
+
+  std::map<GraphKey, int> largest_group;
+  for (std::size_t n = 0; n < nodes.size(); n++)
+  {
+    const int root = find_root(parent, n);
+    auto it = largest_group.find(component_of(n).graph);
+    if (it == largest_group.end())
+      largest_group[component_of(n).graph] = root;
+    else if (group_size[root] > group_size[it->second])
+      it->second = root;
+  }
+
+  for (std::size_t n = 0; n < nodes.size(); n++)
+  {
+    const Component& component = component_of(n);
+    if (find_root(parent, n) == largest_group[component.graph])
+      continue;
+    add_issue(
+      Issue::DISCONNECTED_COMPONENT,
+      nodes[n].first,
+      component.vertex_idx,
+      graph_name(component.graph) + ": " +
+      std::to_string(component.num_vertices) + " vertices around vertex " +
+      std::to_string(component.vertex_idx) +
+      " are not connected to the rest of the graph");
+  }
+
+  // lift links
+  std::set<string> lift_names;
+  for (const Lift& lift : building.lifts)
+    lift_names.insert(lift.name);
+
+  for (std::size_t i = 0; i < level_results.size(); i++)
+  {
+    for (const auto& lift_vertex : level_results[i].lift_vertices)
+    {
+      if (!lift_names.count(lift_vertex.second))
+        add_issue(
+          Issue::MISSING_LIFT_LINK,
+          static_cast<int>(i),
+          lift_vertex.first,
+          "vertex " + std::to_string(lift_vertex.first) +
+          " is a cabin waypoint of lift " + lift_vertex.second +
+          ", which does not exist");
+    }
+  }
+
+  for (const Lift& lift : building.lifts)
+  {
+    std::set<string> door_names;
+    for (const LiftDoor& door : lift.doors)
+      door_names.insert(door.name);
+
+    for (const auto& level_doors : lift.level_doors)
+    {
+      if (level_doors.second.empty())
+        continue;
+
+      const string& level_name = level_doors.first;
+      const int level_idx = building.find_level_idx(level_name);
+      if (level_idx < 0)
+      {
+        add_issue(
+          Issue::MISSING_LIFT_LINK, -1, -1,
+          "lift " + lift.name + " opens on level " + level_name +
+          ", which does not exist");
+        continue;
+      }
+
+      bool has_waypoint = false;
+      if (level_idx < static_cast<int>(level_results.size()))
+      {
+        for (const auto& lift_vertex : level_results[level_idx].lift_vertices)
+        {
+          if (lift_vertex.second == lift.name)
+            has_waypoint = true;
+        }
+      }
+      if (!has_waypoint)
+        add_issue(
+          Issue::MISSING_LIFT_LINK, level_idx, -1,
+          "lift " + lift.name + " opens on level " + level_name +
+          " but has no cabin waypoint there");
+
+      for (const string& door_name : level_doors.second)
+      {
+        if (!door_names.count(door_name))
+          add_issue(
+            Issue::MISSING_LIFT_LINK, level_idx, -1,
+            "lift " + lift.name + " opens door " + door_name +
+            " on level " + level_name + ", but has no such door");
+      }
+    }
+  }
+}
+
+void LaneGraphValidator::draw(
+  QGraphicsScene* scene,
+  const Level& level,
+  const int level_idx) const
+{
+  const double radius = 0.5 / level.drawing_meters_per_pixel;
+  const QColor color = QColor::fromRgbF(1.0, 0.0, 0.0, 0.6);
+  const QPen vertex_pen(color, radius / 4.0);
+  const QBrush vertex_brush(QColor::fromRgbF(1.0, 0.0, 0.0, 0.2));
+  const QPen edge_pen(color, radius / 2.0, Qt::SolidLine, Qt::RoundCap);
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  const int num_edges = static_cast<int>(level.edges.size());
+
+  auto draw_issue = [&](const Issue& issue)
+    {
+      const QString tooltip = QString::fromStdString(issue.description);
+      if (issue.vertex_idx >= 0 && issue.vertex_idx < num_vertices)
+      {
+        const Vertex& v = level.vertices[issue.vertex_idx];
+        QGraphicsEllipseItem* item = scene->addEllipse(
+          v.x - radius,
+          v.y - radius,
+          2 * radius,
+          2 * radius,
+          vertex_pen,
+          vertex_brush);
+        item->setToolTip(tooltip);
+        item->setZValue(250.0);
+      }
+
+      for (const int edge_idx : {issue.edge_idx, issue.other_edge_idx})
+      {
+        if (edge_idx < 0 || edge_idx >= num_edges)
+          continue;
+        const Edge& e = level.edges[edge_idx];
+        if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+          e.end_idx < 0 || e.end_idx >= num_vertices)
+          continue;
+        const Vertex& start = level.vertices[e.start_idx];
+        const Vertex& end = level.vertices[e.end_idx];
+        QGraphicsLineItem* item = scene->addLine(
+          start.x, start.y, end.x, end.y, edge_pen);
+        item->setToolTip(tooltip);
+        item->setZValue(250.0);
+      }
+    };
+
+  if (level_idx >= 0 && level_idx < static_cast<int>(level_results.size()))
+  {
+    const LevelResult& result = level_results[level_idx];
+    for (const Issue& issue : result.issues)
+      draw_issue(issue);
+
+    // mark every crossing point too: lanes through doors in green, lanes
+    // through walls in red and lanes crossing lanes in orange
+    const double crossing_radius = radius / 3.0;
+    for (const auto& crossing : result.crossings)
+    {
+      QColor crossing_color;
+      switch (crossing.type)
+      {
+        case SegmentIntersector::LANE_DOOR:
+          crossing_color = QColor::fromRgbF(0.0, 0.8, 0.0, 0.8);
+          break;
+        case SegmentIntersector::LANE_WALL:
+          crossing_color = QColor::fromRgbF(1.0, 0.0, 0.0, 0.8);
+          break;
+        case SegmentIntersector::LANE_LANE:
+        default:
+          crossing_color = QColor::fromRgbF(1.0, 0.5, 0.0, 0.8);
+          break;
+      }
+      QGraphicsEllipseItem* item = scene->addEllipse(
+        crossing.x - crossing_radius,
+        crossing.y - crossing_radius,
+        2 * crossing_radius,
+        2 * crossing_radius,
+        QPen(crossing_color, crossing_radius / 2.0),
+        QBrush(crossing_color));
+      item->setZValue(251.0);
+    }
+  }
+
+  for (const Issue& issue : building_issues)
+  {
+    if (issue.level_idx == level_idx)
+      draw_issue(issue);
+  }
+}
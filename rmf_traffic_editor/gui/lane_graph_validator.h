@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef LANE_GRAPH_VALIDATOR_H
+#define LANE_GRAPH_VALIDATOR_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "segment_intersector.h"
+
+class Building;
+class Level;
+class QGraphicsScene;
+
+
+/// Checks the lane graphs of a building for problems that would trip up
+/// fleet adapters: disconnected graphs, vertices that can be entered but
+/// not left (or vice versa), duplicated or overlapping lanes, lanes that
+/// cross walls or each other, doors that no lane passes through, and
+/// broken lift links.
+///
+/// Results are cached per level along with a fingerprint of the level's
+/// vertices and edges, so update() only re-analyzes levels that actually
+/// changed. The cross-level checks (graph connectivity through lifts, lift
+/// consistency) work on small per-level summaries and are always re-run.
+class LaneGraphValidator
+{
+public:
+  struct Issue
+  {
+    enum Type
+    {
+      DISCONNECTED_COMPONENT,
+      DEAD_END_VERTEX,
+      UNREACHABLE_VERTEX,
+      DUPLICATE_LANE,
+      OVERLAPPING_LANES,
+      LANE_CROSSES_WALL,
+      LANES_CROSS,
+      UNLINKED_DOOR,
+      MISSING_LIFT_LINK,
+    } type;
+
+    int level_idx = -1;
+    int vertex_idx = -1;  // set if the issue is about a vertex
+    int edge_idx = -1;  // set if the issue is about an edge
+    int other_edge_idx = -1;  // set if the issue is between two edges
+    std::string description;
+  };
+
+  /// Re-validate whatever changed since the last call. Returns true if
+  /// any level had to be re-analyzed.
+  bool update(const Building& building);
+
+  /// Drop all cached results, so the next update() re-analyzes everything
+  void clear();
+
+  /// Every issue found in the building, in level order
+  std::vector<Issue> issues() const;
+
+  std::size_t num_issues() const;
+
+  /// Every place a lane crosses a wall, door or other lane on a level, as
+  /// of the last update()
+  const std::vector<SegmentIntersector::EdgeCrossing>& crossings(
+    const int level_idx) const;
+
+  /// Highlight the issues on one level
+  void draw(
+    QGraphicsScene* scene,
+    const Level& level,
+    const int level_idx) const;
+
+private:
+  // lanes and human lanes with the same graph_idx are separate graphs
+  typedef std::pair<bool, int> GraphKey;  // (is human lane, graph_idx)
+
+  struct Component
+  {
+    GraphKey graph;
+    int num_vertices = 0;
+    int vertex_idx = -1;  // a representative vertex
+    std::vector<std::string> lifts;  // lift cabins within the component
+  };
+
+  struct LevelResult
+  {
+    std::size_t fingerprint = 0;
+    bool valid = false;
+    std::vector<Issue> issues;
+    std::vector<Component> components;
+    std::vector<std::pair<int, std::string>> lift_vertices;
+    std::vector<SegmentIntersector::EdgeCrossing> crossings;
+  };
+
+  std::vector<LevelResult> level_results;
+  std::vector<Issue> building_issues;
+
+  static void analyze_level(
+    const Level& level,
+    const int level_idx,
+    LevelResult& result);
+  void analyze_building(const Building& building);
+
+  static std::string graph_name(const GraphKey& graph);
+};
+
+#endif
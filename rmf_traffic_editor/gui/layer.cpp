@@ -21,7 +21,9 @@
 #include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
 #include <QTableWidget>
+#include "colorize.h"
 #include "layer.h"
+#include "layer_tile_item.h"
 using std::string;
 using std::vector;
 
@@ -33,7 +35,10 @@ Layer::~Layer()
 {
 }
 
-bool Layer::from_yaml(const std::string& _name, const YAML::Node& y)
+bool Layer::from_yaml(
+  const std::string& _name,
+  const YAML::Node& y,
+  const QDir& base_dir)
 {
   if (!y.IsMap())
     throw std::runtime_error("Layer::from_yaml() expected a map");
@@ -48,14 +53,13 @@ bool Layer::from_yaml(const std::string& _name, const YAML::Node& y)
     // handling of the base floorplan image
     transform.setScale(y["meters_per_pixel"].as<double>());
 
+    // we only need the image height here, which most formats can report
+    // from their header without decoding any pixels
     double image_height = 0;
-    QImageReader image_reader(QString::fromStdString(filename));
-    image_reader.setAutoTransform(true);
-
-    // we'll load this image here just for the purpose of getting its height
-    QImage img = image_reader.read();
-    if (!img.isNull())
-      image_height = img.size().height() * transform.scale();
+    const QSize image_size =
+      probe_image_size(base_dir.filePath(QString::fromStdString(filename)));
+    if (image_size.isValid())
+      image_height = image_size.height() * transform.scale();
 
     QPointF offset;
     if (y["rotation"]) // legacy key
@@ -99,28 +103,100 @@ bool Layer::from_yaml(const std::string& _name, const YAML::Node& y)
     }
   }
 
-  return load_image();
+  // the image itself is decoded later by decode_image(), which the
+  // Building schedules in parallel across all layers of all levels.
+  return true;
 }
 
-bool Layer::load_image()
+QSize Layer::probe_image_size(const QString& path)
 {
-  QImageReader image_reader(QString::fromStdString(filename));
+  QImageReader image_reader(path);
   image_reader.setAutoTransform(true);
+
+  QSize size = image_reader.size();
+  if (size.isValid())
+  {
+    // size() reports the stored orientation, before auto-transform
+    const QImageIOHandler::Transformations t = image_reader.transformation();
+    if (t & QImageIOHandler::TransformationRotate90)
+      size.transpose();
+    return size;
+  }
+
+  // This format can't report its size without decoding, so decode it now
+  // and keep the result around for decode_image(), rather than reading
+  // the whole file a second time.
   image = image_reader.read();
+  return image.size();
+}
+
+bool Layer::decode_image(const QDir& base_dir)
+{
+  const QString path = base_dir.filePath(QString::fromStdString(filename));
   if (image.isNull())
   {
-    qWarning("unable to read %s: %s",
-      qUtf8Printable(QString::fromStdString(filename)),
-      qUtf8Printable(image_reader.errorString()));
-    return false;
+    QImageReader image_reader(path);
+    image_reader.setAutoTransform(true);
+
+    // don't even try to decode giant images onto the heap
+    const QSize size = image_reader.size();
+    if (size.isValid() &&
+      static_cast<qint64>(size.width()) * size.height() >=
+      LayerTileSource::streaming_threshold_pixels)
+      return open_tile_source(path);
+
+    image = image_reader.read();
+    if (image.isNull())
+    {
+      qWarning("unable to read %s: %s",
+        qUtf8Printable(path),
+        qUtf8Printable(image_reader.errorString()));
+      return false;
+    }
+  }
+  else if (static_cast<qint64>(image.width()) * image.height() >=
+    LayerTileSource::streaming_threshold_pixels)
+  {
+    // this format couldn't report its size up front, so probe_image_size()
+    // already decoded it; hand that over rather than decoding it again
+    return open_tile_source(path);
   }
+
   image = image.convertToFormat(QImage::Format_Grayscale8);
-  colorize_image();
+  tile_source.reset();
+  clear_colorized();  // those were made from the previous image
   printf("successfully opened %s\n", filename.c_str());
 
   return true;
 }
 
+bool Layer::open_tile_source(const QString& path)
+{
+  tile_source = LayerTileSource::open(path.toStdString(), image);
+  image = QImage();
+  pixmap = QPixmap();
+  clear_colorized();
+  return tile_source != nullptr;
+}
+
+int Layer::image_height() const
+{
+  if (tile_source)
+    return tile_source->height();
+  return image.height();
+}
+
+bool Layer::load_image()
+{
+  // the filename may have changed; always re-read it
+  image = QImage();
+  tile_source.reset();
+  if (!decode_image())
+    return false;
+  colorize_image();
+  return true;
+}
+
 YAML::Node Layer::to_yaml() const
 {
   YAML::Node y;
@@ -148,10 +224,21 @@ void Layer::draw(
   if (!visible)
     return;
 
-  QGraphicsPixmapItem* item = scene->addPixmap(pixmap);
+  QGraphicsItem* item = nullptr;
+  if (tile_source)
+  {
+    item = new LayerTileItem(tile_source, color);
+    scene->addItem(item);
+    scene_item = nullptr;
+  }
+  else
+  {
+    QGraphicsPixmapItem* pixmap_item = scene->addPixmap(pixmap);
 
-  // Store for later use in getting coordinates back out
-  scene_item = item;
+    // Store for later use in getting coordinates back out
+    scene_item = pixmap_item;
+    item = pixmap_item;
+  }
 
   item->setPos(
     transform.translation().x() / level_meters_per_pixel,
@@ -294,30 +381,38 @@ void Layer::clear_selection()
 void Layer::colorize_image()
 {
   color.setAlphaF(0.5);
-  colorized_image = QImage(image.size(), QImage::Format_ARGB32);
-  for (int row_idx = 0; row_idx < image.height(); row_idx++)
-  {
-    const uint8_t* const in_row = (uint8_t*)image.scanLine(row_idx);
-    QRgb* out_row = (QRgb*)colorized_image.scanLine(row_idx);
 
-    for (int col_idx = 0; col_idx < image.width(); col_idx++)
-    {
-      const uint8_t in = in_row[col_idx];
-      if (in < 100 || row_idx == 0 || row_idx == image.height() - 1)
-        out_row[col_idx] = color.rgba();
-      else if (in > 200)
-        out_row[col_idx] = qRgba(0, 0, 0, 0);
-      else
-        out_row[col_idx] = qRgba(in, in, in, 50);
-    }
+  // streamed layers are colorized tile by tile as they are drawn, and
+  // their tiles are cached per color, so there is nothing to do here
+  if (tile_source)
+    return;
 
-    // draw bold first/last columns the requested color on the image,
-    // so it's easier to see what's going on with its transform
-    out_row[0] = color.rgba();
-    out_row[image.width()-1] = color.rgba();
-  }
+  const ColorizedKey key(image.cacheKey(), color.rgba());
+  if (key == colorized_key && !pixmap.isNull())
+    return;
+  std::swap(colorized_key, previous_colorized_key);
+  std::swap(pixmap, previous_colorized_pixmap);
+  if (key == colorized_key && !pixmap.isNull())
+    return;
+
+  QImage colorized_image(image.size(), QImage::Format_ARGB32);
+  colorize::grayscale_to_argb(
+    image.constBits(),
+    image.bytesPerLine(),
+    reinterpret_cast<uint32_t*>(colorized_image.bits()),
+    colorized_image.bytesPerLine(),
+    image.width(),
+    image.height(),
+    color.rgba());
 
   pixmap = QPixmap::fromImage(colorized_image);
+  colorized_key = key;
+}
+
+void Layer::clear_colorized()
+{
+  colorized_key = previous_colorized_key = ColorizedKey(0, 0);
+  previous_colorized_pixmap = QPixmap();
 }
 
 void Layer::populate_property_editor(QTableWidget* property_editor) const
@@ -18,13 +18,17 @@
 #ifndef LAYER_H
 #define LAYER_H
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <QDir>
 #include <QPixmap>
 #include <yaml-cpp/yaml.h>
 
 #include "feature.hpp"
+#include "layer_tile_source.h"
 #include "transform.hpp"
 
 class QGraphicsScene;
@@ -51,16 +55,48 @@ public:
 
   Transform transform;
 
-  QImage image, colorized_image;
+  QImage image;
   QPixmap pixmap;
+
+  // `pixmap` is the image colorized with the current color. The one made
+  // with the color before it is kept too, so flipping back and forth
+  // between two colors doesn't re-run the colorizer. Only these two are
+  // kept, since each is as large as the whole floorplan.
+  typedef std::pair<qint64, QRgb> ColorizedKey;
+  ColorizedKey colorized_key{0, 0};  // of `pixmap`; cache keys are never 0
+  ColorizedKey previous_colorized_key{0, 0};
+  QPixmap previous_colorized_pixmap;
   QGraphicsPixmapItem* scene_item = nullptr;  // Borrowed pointer, not owned, don't delete
 
+  // Set instead of `image` for images too large to hold in memory. The
+  // pixels are then memory-mapped and drawn tile by tile.
+  std::shared_ptr<LayerTileSource> tile_source;
+
+  /// Height of the layer image in pixels, whether or not it is streamed
+  int image_height() const;
+
   std::vector<Feature> features;
 
-  bool from_yaml(const std::string& name, const YAML::Node& data);
+  /// Relative image filenames are resolved against `base_dir`, which
+  /// defaults to the current directory.
+  bool from_yaml(
+    const std::string& name,
+    const YAML::Node& data,
+    const QDir& base_dir = QDir());
   YAML::Node to_yaml() const;
 
+  /// Read and colorize the layer image, replacing any previous image.
   bool load_image();
+
+  /// Decode the layer image into `image` without creating any pixmaps, so
+  /// it is safe to call from worker threads. Reuses the image if it was
+  /// already decoded while parsing a legacy-format layer. Images above
+  /// LayerTileSource::streaming_threshold_pixels are opened as a
+  /// `tile_source` instead, leaving `image` empty.
+  bool decode_image(const QDir& base_dir = QDir());
+
+  /// Rebuild `pixmap` from `image`. Must be called from the GUI thread.
+  /// Streamed layers have no pixmap; their tiles are colorized on demand.
   void colorize_image();
 
   void draw(
@@ -91,6 +127,11 @@ public:
   void populate_property_editor(QTableWidget* property_editor) const;
 
   std::vector<std::pair<std::string, std::string>> transform_strings;
+
+private:
+  QSize probe_image_size(const QString& path);
+  bool open_tile_source(const QString& path);
+  void clear_colorized();
 };
 
 #endif
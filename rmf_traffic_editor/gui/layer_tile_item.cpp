@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "layer_tile_item.h"
+
+
+LayerTileItem::LayerTileItem(
+  std::shared_ptr<LayerTileSource> source,
+  const QColor& color)
+: _source(source),
+  _color(color.rgba())
+{
+  // we need exposedRect to only render the tiles that are in view
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QRectF LayerTileItem::boundingRect() const
+{
+  if (!_source)
+    return QRectF();
+  return QRectF(0, 0, _source->width(), _source->height());
+}
+
+void LayerTileItem::paint(
+  QPainter* painter,
+  const QStyleOptionGraphicsItem* option,
+  QWidget* /*widget*/)
+{
+  if (!_source)
+    return;
+
+  // Choose the coarsest power-of-two decimation that still provides at
+  // least one tile pixel per screen pixel at the current zoom level.
+  const double lod =
+    option->levelOfDetailFromTransform(painter->worldTransform());
+  int decimation = 1;
+  const int max_decimation = 1 << 12;
+  while (decimation < max_decimation && decimation * 2 * lod <= 1.0)
+    decimation *= 2;
+
+  const QRectF exposed = option->exposedRect.intersected(boundingRect());
+  if (exposed.isEmpty())
+    return;
+
+  const int span = LayerTileSource::tile_size * decimation;
+  const int tx0 = std::max(0, static_cast<int>(exposed.left()) / span);
+  const int ty0 = std::max(0, static_cast<int>(exposed.top()) / span);
+  const int tx1 = static_cast<int>(std::ceil(exposed.right())) / span;
+  const int ty1 = static_cast<int>(std::ceil(exposed.bottom())) / span;
+
+  for (int ty = ty0; ty <= ty1; ty++)
+  {
+    for (int tx = tx0; tx <= tx1; tx++)
+    {
+      const QImage tile = _source->tile(tx, ty, decimation, _color);
+      if (tile.isNull())
+        continue;
+
+      // the last row/column of tiles may be clipped by the image border
+      const double w = std::min(
+        static_cast<double>(tile.width() * decimation),
+        static_cast<double>(_source->width() - tx * span));
+      const double h = std::min(
+        static_cast<double>(tile.height() * decimation),
+        static_cast<double>(_source->height() - ty * span));
+
+      painter->drawImage(
+        QRectF(tx * span, ty * span, w, h),
+        tile);
+    }
+  }
+}
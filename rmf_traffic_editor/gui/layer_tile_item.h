@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef LAYER_TILE_ITEM_H
+#define LAYER_TILE_ITEM_H
+
+#include <memory>
+
+#include <QColor>
+#include <QGraphicsItem>
+
+#include "layer_tile_source.h"
+
+
+/// Scene item for a streamed layer image. Instead of holding a pixmap of
+/// the whole image, it asks its LayerTileSource for the tiles that
+/// intersect the exposed area, at a resolution matched to the current zoom.
+class LayerTileItem : public QGraphicsItem
+{
+public:
+  LayerTileItem(
+    std::shared_ptr<LayerTileSource> source,
+    const QColor& color);
+
+  enum { Type = UserType + 1 };
+  int type() const override { return Type; }
+
+  QRectF boundingRect() const override;
+
+  void paint(
+    QPainter* painter,
+    const QStyleOptionGraphicsItem* option,
+    QWidget* widget) override;
+
+private:
+  std::shared_ptr<LayerTileSource> _source;
+  QRgb _color;
+};
+
+#endif
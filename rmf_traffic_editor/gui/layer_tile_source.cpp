@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "colorize.h"
+#include "layer_tile_source.h"
+
+
+LayerTileSource::LayerTileSource()
+{
+}
+
+LayerTileSource::~LayerTileSource()
+{
+  if (_pixels)
+    _file.close();  // also unmaps
+}
+
+std::shared_ptr<LayerTileSource> LayerTileSource::open(
+  const std::string& filename,
+  const QImage& decoded)
+{
+  const QString qfilename = QString::fromStdString(filename);
+  std::shared_ptr<LayerTileSource> source(new LayerTileSource);
+
+  if (source->map_pgm(qfilename))
+  {
+    printf("streaming %s directly (%dx%d)\n",
+      filename.c_str(),
+      source->width(),
+      source->height());
+    return source;
+  }
+
+  // Not something we can map as-is, so convert it to a PGM in the cache
+  // directory. This costs one full decode the first time a given file
+  // (path, size and modification time) is seen, and nothing after that.
+  const QString cache_fn = cache_filename(qfilename);
+  if (cache_fn.isEmpty())
+    return nullptr;
+
+  if (!QFileInfo::exists(cache_fn))
+  {
+    QImage image = decoded;
+    if (image.isNull())
+    {
+      QImageReader image_reader(qfilename);
+      image_reader.setAutoTransform(true);
+      image = image_reader.read();
+      if (image.isNull())
+      {
+        qWarning("unable to read %s: %s",
+          qUtf8Printable(qfilename),
+          qUtf8Printable(image_reader.errorString()));
+        return nullptr;
+      }
+    }
+
+    image = image.convertToFormat(QImage::Format_Grayscale8);
+    if (!write_pgm(cache_fn, image))
+    {
+      qWarning("unable to write layer cache %s", qUtf8Printable(cache_fn));
+      return nullptr;
+    }
+  }
+
+  if (!source->map_pgm(cache_fn))
+    return nullptr;
+
+  printf("streaming %s through cache %s (%dx%d)\n",
+    filename.c_str(),
+    qUtf8Printable(cache_fn),
+    source->width(),
+    source->height());
+  return source;
+}
+
+bool LayerTileSource::map_pgm(const QString& filename)
+{
+  _file.setFileName(filename);
+  if (!_file.open(QIODevice::ReadOnly))
+    return false;
+
+  // Parse the PGM header: "P5" then width, height and maxval separated by
+  // whitespace (with optional '#' comments), then exactly one whitespace
+  // character before the binary pixel data.
+  const QByteArray head = _file.peek(1024);
+  if (head.size() < 2 || head[0] != 'P' || head[1] != '5')
+  {
+    _file.close();
+    return false;
+  }
+
+  int pos = 2;
+  long fields[3] = {0, 0, 0};
+  for (int field_idx = 0; field_idx < 3; field_idx++)
+  {
+    while (pos < head.size())
+    {
+      if (head[pos] == '#')
+      {
+        while (pos < head.size() && head[pos] != '\n')
+          pos++;
+      }
+      else if (std::isspace(static_cast<unsigned char>(head[pos])))
+        pos++;
+      else
+        break;
+    }
+
+    if (pos >= head.size() ||
+      !std::isdigit(static_cast<unsigned char>(head[pos])))
+    {
+      _file.close();
+      return false;
+    }
+
+    while (pos < head.size() &&
+      std::isdigit(static_cast<unsigned char>(head[pos])))
+    {
+      fields[field_idx] = fields[field_idx] * 10 + (head[pos] - '0');
+      pos++;
+    }
+  }
+  pos++;  // the single whitespace character after maxval
+
+  const long w = fields[0];
+  const long h = fields[1];
+  const long maxval = fields[2];
+
+  // only 8-bit images with the full range can be used without conversion
+  if (w <= 0 || h <= 0 || maxval != 255 ||
+    _file.size() < pos + static_cast<qint64>(w) * h)
+  {
+    _file.close();
+    return false;
+  }
+
+  const uchar* mapped = _file.map(0, _file.size());
+  if (!mapped)
+  {
+    _file.close();
+    return false;
+  }
+
+  _pixels = mapped + pos;
+  _width = static_cast<int>(w);
+  _height = static_cast<int>(h);
+  return true;
+}
+
+QString LayerTileSource::cache_filename(const QString& filename)
+{
+  const QFileInfo info(filename);
+  if (!info.exists())
+    return QString();
+
+  const QString dir_path =
+    QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+    "/layers";
+  if (!QDir().mkpath(dir_path))
+    return QString();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+
+  return dir_path + "/" + QString::fromLatin1(hash.result().toHex()) + ".pgm";
+}
+
+bool LayerTileSource::write_pgm(const QString& filename, const QImage& image)
+{
+  // QSaveFile writes to a uniquely named file next to `filename` and only
+  // renames it over `filename` once everything is written, so layers and
+  // buildings loading the same image at once never write into one file,
+  // and a failed write leaves nothing behind: the temporary file is
+  // removed when `f` goes out of scope without being committed.
+  QSaveFile f(filename);
+  if (!f.open(QIODevice::WriteOnly))
+    return false;
+
+  const QByteArray header = QString("P5\n%1 %2\n255\n")
+    .arg(image.width())
+    .arg(image.height())
+    .toLatin1();
+  if (f.write(header) != header.size())
+    return false;
+
+  for (int row_idx = 0; row_idx < image.height(); row_idx++)
+  {
+    const char* row =
+      reinterpret_cast<const char*>(image.constScanLine(row_idx));
+    if (f.write(row, image.width()) != image.width())
+      return false;
+  }
+  return f.commit();
+}
+
+QImage LayerTileSource::tile(
+  const int tile_x,
+  const int tile_y,
+  const int decimation,
+  const QRgb color)
+{
+  const TileKey key(tile_x, tile_y, decimation, color);
+  auto index_it = _tile_index.find(key);
+  if (index_it != _tile_index.end())
+  {
+    // move it to the front of the LRU list
+    _tiles.splice(_tiles.begin(), _tiles, index_it->second);
+    return index_it->second->second;
+  }
+
+  const QImage image = render_tile(tile_x, tile_y, decimation, color);
+  _tiles.emplace_front(key, image);
+  _tile_index[key] = _tiles.begin();
+  _tile_bytes += image.sizeInBytes();
+
+  // evict least-recently-used tiles until we are back under budget, but
+  // never the one we are about to return
+  while (_tile_bytes > tile_cache_budget_bytes && _tiles.size() > 1)
+  {
+    _tile_bytes -= _tiles.back().second.sizeInBytes();
+    _tile_index.erase(_tiles.back().first);
+    _tiles.pop_back();
+  }
+
+  return image;
+}
+
+void LayerTileSource::clear_tile_cache()
+{
+  _tiles.clear();
+  _tile_index.clear();
+  _tile_bytes = 0;
+}
+
+QImage LayerTileSource::render_tile(
+  const int tile_x,
+  const int tile_y,
+  const int decimation,
+  const QRgb color) const
+{
+  const int span = tile_size * decimation;  // source pixels per tile side
+  const int x0 = tile_x * span;
+  const int y0 = tile_y * span;
+  if (x0 >= _width || y0 >= _height || x0 < 0 || y0 < 0)
+    return QImage();
+
+  const int src_w = std::min(span, _width - x0);
+  const int src_h = std::min(span, _height - y0);
+  const int out_w = (src_w + decimation - 1) / decimation;
+  const int out_h = (src_h + decimation - 1) / decimation;
+
+  // When zoomed far out, looking at every source pixel would make each
+  // tile cost as much as the whole map. Sample at most a few pixels per
+  // axis of each block instead, which is plenty to keep walls visible.
+  const int max_samples = 4;
+  const int sample_step = std::max(1, decimation / max_samples);
+
+  QImage out(out_w, out_h, QImage::Format_ARGB32);
+  std::vector<uint8_t> gray(out_w);
+
+  for (int out_y = 0; out_y < out_h; out_y++)
+  {
+    const int sy0 = y0 + out_y * decimation;
+    const int sy1 = std::min(sy0 + decimation, _height);
+    const uint8_t* gray_row = nullptr;
+
+    if (decimation == 1)
+      gray_row = _pixels + static_cast<qint64>(sy0) * _width + x0;
+    else
+    {
+      std::fill(gray.begin(), gray.end(), 255);
+      for (int sy = sy0; sy < sy1; sy += sample_step)
+      {
+        const uint8_t* src_row = _pixels + static_cast<qint64>(sy) * _width;
+        for (int out_x = 0; out_x < out_w; out_x++)
+        {
+          const int sx0 = x0 + out_x * decimation;
+          const int sx1 = std::min(sx0 + decimation, _width);
+          uint8_t darkest = gray[out_x];
+          for (int sx = sx0; sx < sx1; sx += sample_step)
+            darkest = std::min(darkest, src_row[sx]);
+          gray[out_x] = darkest;
+        }
+      }
+      gray_row = gray.data();
+    }
+
+    // outline the image border, as Layer::colorize_image() does
+    const bool border_row = sy0 == 0 || sy1 >= _height;
+    uint32_t* out_row = reinterpret_cast<uint32_t*>(out.scanLine(out_y));
+    colorize::grayscale_row_to_argb(
+      gray_row,
+      out_row,
+      out_w,
+      color,
+      border_row);
+
+    if (x0 == 0)
+      out_row[0] = color;
+    if (x0 + src_w >= _width)
+      out_row[out_w - 1] = color;
+  }
+
+  return out;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef LAYER_TILE_SOURCE_H
+#define LAYER_TILE_SOURCE_H
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+#include <QFile>
+#include <QImage>
+
+
+/// Memory-mapped access to a (potentially enormous) 8-bit grayscale
+/// occupancy image, which hands out colorized tiles on demand.
+///
+/// Binary (P5) PGM files with maxval 255 are mapped directly. Anything
+/// else is decoded once and written to a PGM in the user's cache
+/// directory, which is then mapped. Either way, the pixels live in the
+/// page cache rather than in our heap, and only the tiles that have been
+/// drawn recently are kept around, up to a fixed byte budget.
+class LayerTileSource
+{
+public:
+  ~LayerTileSource();
+
+  /// Images with at least this many pixels are streamed, not loaded.
+  static const qint64 streaming_threshold_pixels = 8192LL * 8192LL;
+
+  /// Edge length of a tile, in output pixels
+  static const int tile_size = 256;
+
+  /// Open `filename` for streaming. If the caller already has the image
+  /// decoded, it can pass it in to avoid decoding it a second time when
+  /// a cache file needs to be written. Returns nullptr on failure.
+  static std::shared_ptr<LayerTileSource> open(
+    const std::string& filename,
+    const QImage& decoded = QImage());
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  /// Returns the colorized tile (tile_x, tile_y) at the requested
+  /// power-of-two decimation. A tile at decimation d covers
+  /// tile_size * d source pixels on each side. Each output pixel is the
+  /// darkest of the source pixels it covers, so thin walls survive
+  /// zooming out.
+  QImage tile(
+    const int tile_x,
+    const int tile_y,
+    const int decimation,
+    const QRgb color);
+
+  /// Drop all cached tiles (the mapping itself stays open)
+  void clear_tile_cache();
+
+private:
+  LayerTileSource();
+
+  bool map_pgm(const QString& filename);
+
+  static QString cache_filename(const QString& filename);
+  static bool write_pgm(const QString& filename, const QImage& image);
+
+  QImage render_tile(
+    const int tile_x,
+    const int tile_y,
+    const int decimation,
+    const QRgb color) const;
+
+  QFile _file;
+  const uint8_t* _pixels = nullptr;  // borrowed from the mapping
+  int _width = 0;
+  int _height = 0;
+
+  typedef std::tuple<int, int, int, QRgb> TileKey;
+  typedef std::list<std::pair<TileKey, QImage>> TileList;
+
+  TileList _tiles;  // most recently used at the front
+  std::map<TileKey, TileList::iterator> _tile_index;
+  qint64 _tile_bytes = 0;
+
+  static const qint64 tile_cache_budget_bytes = 64LL * 1024LL * 1024LL;
+};
+
+#endif
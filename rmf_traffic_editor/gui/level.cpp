@@ -16,8 +16,11 @@
 */
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
 
 #include "ceres/ceres.h"
@@ -34,7 +37,15 @@ using std::string;
 using std::vector;
 
 
+namespace {
+
+// shared by every level, so that no two revisions are ever the same
+std::atomic<std::size_t> next_revision_id(0);
+
+}  // namespace
+
 Level::Level()
+: revision_id(next_revision_id++)
 {
 }
 
@@ -44,7 +55,8 @@ Level::~Level()
 
 bool Level::from_yaml(
   const std::string& _name,
-  const YAML::Node& _data)
+  const YAML::Node& _data,
+  const QDir& base_dir)
 {
   printf("parsing level [%s]\n", _name.c_str());
   name = _name;
@@ -158,6 +170,7 @@ bool Level::from_yaml(
       polygons.push_back(p);
     }
   }
+  polygons_changed();
 
   if (_data["elevation"])
     elevation = _data["elevation"].as<double>();
@@ -168,7 +181,7 @@ bool Level::from_yaml(
     for (YAML::const_iterator it = yl.begin(); it != yl.end(); ++it)
     {
       Layer layer;
-      layer.from_yaml(it->first.as<string>(), it->second);
+      layer.from_yaml(it->first.as<string>(), it->second, base_dir);
       layers.push_back(layer);
     }
   }
@@ -176,7 +189,19 @@ bool Level::from_yaml(
   return true;
 }
 
-bool Level::load_drawing()
+bool Level::load_drawing(const QDir& base_dir)
+{
+  if (drawing_filename.empty())
+    return true;// nothing to load
+
+  QImage image;
+  if (!decode_drawing(image, base_dir))
+    return false;
+  floorplan_pixmap = QPixmap::fromImage(image);
+  return true;
+}
+
+bool Level::decode_drawing(QImage& image, const QDir& base_dir)
 {
   if (drawing_filename.empty())
     return true;// nothing to load
@@ -185,11 +210,12 @@ bool Level::load_drawing()
     name.c_str(),
     drawing_filename.c_str());
 
-  QString qfilename = QString::fromStdString(drawing_filename);
+  QString qfilename =
+    base_dir.filePath(QString::fromStdString(drawing_filename));
 
   QImageReader image_reader(qfilename);
   image_reader.setAutoTransform(true);
-  QImage image = image_reader.read();
+  image = image_reader.read();
   if (image.isNull())
   {
     qWarning("unable to read %s: %s",
@@ -198,9 +224,8 @@ bool Level::load_drawing()
     return false;
   }
   image = image.convertToFormat(QImage::Format_Grayscale8);
-  floorplan_pixmap = QPixmap::fromImage(image);
-  drawing_width = floorplan_pixmap.width();
-  drawing_height = floorplan_pixmap.height();
+  drawing_width = image.width();
+  drawing_height = image.height();
   return true;
 }
 
@@ -319,15 +344,10 @@ bool Level::can_delete_current_selection()
     }
   }
 
-  int selected_vertex_idx = -1;
-  for (int i = 0; i < static_cast<int>(vertices.size()); i++)
-  {
-    if (vertices[i].selected)
-    {
-      selected_vertex_idx = i;
-      break;  // just grab the index of the first selected vertex
-    }
-  }
+  // just grab the index of the first selected vertex
+  const std::set<int>& selected_vertices = selection().vertices;
+  const int selected_vertex_idx =
+    selected_vertices.empty() ? -1 : *selected_vertices.begin();
 
   if (selected_vertex_idx < 0)
     return true;
@@ -382,6 +402,7 @@ bool Level::delete_selected()
       polygons.end(),
       [](const Polygon& polygon) { return polygon.selected; }),
     polygons.end());
+  polygons_changed();
 
   constraints.erase(
     std::remove_if(
@@ -393,18 +414,11 @@ bool Level::delete_selected()
   // Vertices take a lot more care, because we have to check if a vertex
   // is used in an edge or a polygon before deleting it, and update all
   // higher-index vertex indices in the edges and polygon vertex lists.
-  // Since this is a potentially expensive operation, first we'll spin
-  // through the vertex list and see if any vertices are selected, and
-  // only then make a copy of the vertex list.
-  int selected_vertex_idx = -1;
-  for (int i = 0; i < static_cast<int>(vertices.size()); i++)
-  {
-    if (vertices[i].selected)
-    {
-      selected_vertex_idx = i;
-      break;  // just grab the index of the first selected vertex
-    }
-  }
+  // Since this is a potentially expensive operation, first we'll see if
+  // any vertices are selected, and just grab the first one.
+  const std::set<int>& selected_vertices = selection().vertices;
+  const int selected_vertex_idx =
+    selected_vertices.empty() ? -1 : *selected_vertices.begin();
   if (selected_vertex_idx >= 0)
   {
     // See if this vertex is used in any edges/polygons.
@@ -428,6 +442,7 @@ bool Level::delete_selected()
 
     // the vertex is not currently being used, so let's erase it
     vertices.erase(vertices.begin() + selected_vertex_idx);
+    vertices_changed();
 
     // now go through all edges and polygons to decrement any larger indices
     for (Edge& edge : edges)
@@ -489,79 +504,49 @@ bool Level::delete_selected()
 void Level::get_selected_items(
   std::vector<Level::SelectedItem>& items)
 {
-  for (std::size_t i = 0; i < edges.size(); i++)
-  {
-    if (edges[i].selected)
-    {
-      Level::SelectedItem item;
-      item.edge_idx = i;
-      items.push_back(item);
-    }
-  }
+  const Selection& sel = selection();
 
-  for (std::size_t i = 0; i < models.size(); i++)
+  for (const int i : sel.edges)
   {
-    if (models[i].selected)
-    {
-      Level::SelectedItem item;
-      item.model_idx = i;
-      items.push_back(item);
-    }
+    Level::SelectedItem item;
+    item.edge_idx = i;
+    items.push_back(item);
   }
 
-  for (std::size_t i = 0; i < vertices.size(); i++)
+  for (const int i : sel.models)
   {
-    if (vertices[i].selected)
-    {
-      Level::SelectedItem item;
-      item.vertex_idx = i;
-      items.push_back(item);
-    }
+    Level::SelectedItem item;
+    item.model_idx = i;
+    items.push_back(item);
   }
 
-  for (std::size_t i = 0; i < fiducials.size(); i++)
+  for (const int i : sel.vertices)
   {
-    if (fiducials[i].selected)
-    {
-      Level::SelectedItem item;
-      item.fiducial_idx = i;
-      items.push_back(item);
-    }
+    Level::SelectedItem item;
+    item.vertex_idx = i;
+    items.push_back(item);
   }
 
-  for (std::size_t i = 0; i < polygons.size(); i++)
+  for (const int i : sel.fiducials)
   {
-    if (polygons[i].selected)
-    {
-      Level::SelectedItem item;
-      item.polygon_idx = i;
-      items.push_back(item);
-    }
+    Level::SelectedItem item;
+    item.fiducial_idx = i;
+    items.push_back(item);
   }
 
-  for (std::size_t i = 0; i < floorplan_features.size(); i++)
+  for (const int i : sel.polygons)
   {
-    if (floorplan_features[i].selected())
-    {
-      Level::SelectedItem item;
-      item.feature_idx = i;
-      item.feature_layer_idx = 0;
-      items.push_back(item);
-    }
+    Level::SelectedItem item;
+    item.polygon_idx = i;
+    items.push_back(item);
   }
 
-  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
+  for (const auto& f : sel.features)
   {
-    for (std::size_t i = 0; i < layers[layer_idx].features.size(); i++)
-    {
-      if (layers[layer_idx].features[i].selected())
-      {
-        Level::SelectedItem item;
-        item.feature_idx = i;
-        item.feature_layer_idx = layer_idx + 1;
-        items.push_back(item);
-      }
-    }
+    Level::SelectedItem item;
+    item.feature_idx = f.second;
+    item.feature_layer_idx = f.first;
+    items.push_back(item);
   }
 
   for (std::size_t i = 0; i < constraints.size(); i++)
@@ -591,7 +576,7 @@ void Level::calculate_scale()
       const double distance_pixels = std::sqrt(dx*dx + dy*dy);
       // todo: a clean, strongly-typed parameter API for edges
       const double distance_meters =
-        edge.params[std::string("distance")].value_double;
+        edge.params[std::string("distance")].value_double();
       scale_sum += distance_meters / distance_pixels;
     }
   }
@@ -625,10 +610,13 @@ void Level::draw_lane(
     !opts.show_building_lanes[graph_idx])
     return;// don't render this lane
 
-  const auto& v_start = vertices[edge.start_idx];
-  const auto& v_end = vertices[edge.end_idx];
-  const double dx = v_end.x - v_start.x;
-  const double dy = v_end.y - v_start.y;
+  const VertexBuffers& vb = vertex_buffers();
+  const double x0 = vb.x[edge.start_idx];
+  const double y0 = vb.y[edge.start_idx];
+  const double x1 = vb.x[edge.end_idx];
+  const double y1 = vb.y[edge.end_idx];
+  const double dx = x1 - x0;
+  const double dy = y1 - y0;
   const double len = std::sqrt(dx*dx + dy*dy);
 
   // see if there is a default width for this graph_idx
@@ -670,8 +658,8 @@ void Level::draw_lane(
     for (double d = 0.0; d < len; d += arrow_spacing)
     {
       // first calculate the center vertex of this arrowhead
-      const double cx = v_start.x + d * norm_x;
-      const double cy = v_start.y + d * norm_y;
+      const double cx = x0 + d * norm_x;
+      const double cy = y0 + d * norm_y;
       // one edge vertex of arrowhead
       const double e1x = cx - arrow_w * norm_y;
       const double e1y = cy + arrow_w * norm_x;
@@ -708,18 +696,19 @@ void Level::draw_lane(
   color.setAlphaF(0.5);
 
   QGraphicsLineItem* lane_item = scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
+    x0, y0,
+    x1, y1,
     QPen(QBrush(color), lane_pen_width, Qt::SolidLine, Qt::RoundCap));
   lane_item->setZValue(edge.get_graph_idx() + 1.0);
 
   // draw the orientation icon, if specified
-  auto orientation_it = edge.params.find("orientation");
+  static const ParamKey orientation_key("orientation");
+  auto orientation_it = edge.params.find(orientation_key);
   if (orientation_it != edge.params.end())
   {
     // draw robot-outline box midway down this lane
-    const double mx = (v_start.x + v_end.x) / 2.0;
-    const double my = (v_start.y + v_end.y) / 2.0;
+    const double mx = (x0 + x1) / 2.0;
+    const double my = (y0 + y1) / 2.0;
     const double yaw = std::atan2(norm_y, norm_x);
 
     // robot-box half-dimensions in meters
@@ -761,7 +750,7 @@ void Level::draw_lane(
     pp.moveTo(QPointF(mx, my));
 
     QPen orientation_pen(Qt::white, 5.0);
-    if (orientation_it->second.value_string == "forward")
+    if (orientation_it->second.value_string() == "forward")
     {
       const double hix = mx + 1.0 * cos(yaw) / drawing_meters_per_pixel;
       const double hiy = my + 1.0 * sin(yaw) / drawing_meters_per_pixel;
@@ -769,7 +758,7 @@ void Level::draw_lane(
       QGraphicsPathItem* pi = scene->addPath(pp, orientation_pen);
       pi->setZValue(edge.get_graph_idx() + 1.1);
     }
-    else if (orientation_it->second.value_string == "backward")
+    else if (orientation_it->second.value_string() == "backward")
     {
       const double hix = mx - 1.0 * cos(yaw) / drawing_meters_per_pixel;
       const double hiy = my - 1.0 * sin(yaw) / drawing_meters_per_pixel;
@@ -782,15 +771,18 @@ void Level::draw_lane(
 
 void Level::draw_wall(QGraphicsScene* scene, const Edge& edge) const
 {
-  const auto& v_start = vertices[edge.start_idx];
-  const auto& v_end = vertices[edge.end_idx];
+  const VertexBuffers& vb = vertex_buffers();
+  const double x0 = vb.x[edge.start_idx];
+  const double y0 = vb.y[edge.start_idx];
+  const double x1 = vb.x[edge.end_idx];
+  const double y1 = vb.y[edge.end_idx];
 
   const double r = edge.selected ? 0.5 : 0.0;
   const double b = edge.selected ? 0.0 : 0.5;
 
   scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
+    x0, y0,
+    x1, y1,
     QPen(
       QBrush(QColor::fromRgbF(r, 0.0, b, 0.5)),
       0.2 / drawing_meters_per_pixel,
@@ -799,13 +791,16 @@ void Level::draw_wall(QGraphicsScene* scene, const Edge& edge) const
 
 void Level::draw_meas(QGraphicsScene* scene, const Edge& edge) const
 {
-  const auto& v_start = vertices[edge.start_idx];
-  const auto& v_end = vertices[edge.end_idx];
+  const VertexBuffers& vb = vertex_buffers();
+  const double x0 = vb.x[edge.start_idx];
+  const double y0 = vb.y[edge.start_idx];
+  const double x1 = vb.x[edge.end_idx];
+  const double y1 = vb.y[edge.end_idx];
   const double b = edge.selected ? 0.0 : 0.5;
 
   scene->addLine(
-    v_start.x, v_start.y,
-    v_end.x, v_end.y,
+    x0, y0,
+    x1, y1,
     QPen(
       QBrush(QColor::fromRgbF(0.5, 0, b, 0.5)),
       0.5 / drawing_meters_per_pixel,
@@ -820,25 +815,32 @@ void Level::draw_door(QGraphicsScene* scene, const Edge& edge) const
   const double door_thickness = 0.2;  // meters
   const double door_motion_thickness = 0.05;  // meters
 
-  auto door_axis_it = edge.params.find("motion_axis");
+  // looked up for every door on every redraw
+  static const ParamKey motion_axis_key("motion_axis");
+  static const ParamKey motion_degrees_key("motion_degrees");
+  static const ParamKey motion_direction_key("motion_direction");
+  static const ParamKey right_left_ratio_key("right_left_ratio");
+  static const ParamKey type_key("type");
+
+  auto door_axis_it = edge.params.find(motion_axis_key);
   std::string door_axis("start");
   if (door_axis_it != edge.params.end())
-    door_axis = door_axis_it->second.value_string;
+    door_axis = door_axis_it->second.value_string();
 
   double motion_degrees = 90;
-  auto motion_degrees_it = edge.params.find("motion_degrees");
+  auto motion_degrees_it = edge.params.find(motion_degrees_key);
   if (motion_degrees_it != edge.params.end())
-    motion_degrees = std::abs(motion_degrees_it->second.value_double);
+    motion_degrees = std::abs(motion_degrees_it->second.value_double());
 
   int motion_dir = 1;
-  auto motion_dir_it = edge.params.find("motion_direction");
+  auto motion_dir_it = edge.params.find(motion_direction_key);
   if (motion_dir_it != edge.params.end())
-    motion_dir = motion_dir_it->second.value_int;
+    motion_dir = motion_dir_it->second.value_int();
 
   double right_left_ratio = 1.0;
-  auto right_left_ratio_it = edge.params.find("right_left_ratio");
+  auto right_left_ratio_it = edge.params.find(right_left_ratio_key);
   if (right_left_ratio_it != edge.params.end())
-    right_left_ratio = right_left_ratio_it->second.value_double;
+    right_left_ratio = right_left_ratio_it->second.value_double();
 
   QPainterPath door_motion_path;
 
@@ -847,12 +849,12 @@ void Level::draw_door(QGraphicsScene* scene, const Edge& edge) const
   const double door_length = std::sqrt(door_dx * door_dx + door_dy * door_dy);
   const double door_angle = std::atan2(door_dy, door_dx);
 
-  auto door_type_it = edge.params.find("type");
+  auto door_type_it = edge.params.find(type_key);
   if (door_type_it != edge.params.end())
   {
     const double DEG2RAD = M_PI / 180.0;
 
-    const std::string& door_type = door_type_it->second.value_string;
+    const std::string& door_type = door_type_it->second.value_string();
     if (door_type == "hinged")
     {
       const double hinge_x = door_axis == "start" ? v_start.x : v_end.x;
@@ -1062,26 +1064,27 @@ void Level::draw_polygons(QGraphicsScene* scene) const
 
 void Level::clear_selection()
 {
-  for (auto& vertex : vertices)
-    vertex.selected = false;
-
-  for (auto& edge : edges)
-    edge.selected = false;
-
-  for (auto& model : models)
-    model.selected = false;
-
-  for (auto& polygon : polygons)
-    polygon.selected = false;
-
-  for (auto& fiducial : fiducials)
-    fiducial.selected = false;
-
-  for (auto& feature : floorplan_features)
-    feature.setSelected(false);
-
-  for (auto& layer : layers)
-    layer.clear_selection();
+  // only touch the flags of what is actually selected
+  const Selection& sel = selection();
+  const bool buffers = vertex_buffers_valid &&
+    vertex_buffer_cache.x.size() == vertices.size();
+  for (const int i : sel.vertices)
+  {
+    vertices[i].selected = false;
+    if (buffers)
+      vertex_buffer_cache.selected[i] = 0;
+  }
+  for (const int i : sel.edges)
+    edges[i].selected = false;
+  for (const int i : sel.models)
+    models[i].selected = false;
+  for (const int i : sel.polygons)
+    polygons[i].selected = false;
+  for (const int i : sel.fiducials)
+    fiducials[i].selected = false;
+  for (const auto& f : sel.features)
+    find_feature(f.first, f.second)->setSelected(false);
+  selection_cache = Selection();
 
   for (auto& constraint : constraints)
     constraint.setSelected(false);
@@ -1264,10 +1267,11 @@ bool Level::export_features(const std::string& /*filename*/) const
     y["name"] = layer->name;
     y["image_file"] = layer->filename;
 
-    QPixmap layer_pixmap = QPixmap::fromImage(
-      QImageReader(QString::fromStdString(layer->filename)).read());
-    y["size"].push_back(layer_pixmap.width());
-    y["size"].push_back(layer_pixmap.height());
+    // only the size is needed, which the reader gets without decoding
+    const QSize layer_size =
+      QImageReader(QString::fromStdString(layer->filename)).size();
+    y["size"].push_back(layer_size.width());
+    y["size"].push_back(layer_size.height());
     y["size"].SetStyle(YAML::EmitterStyle::Flow);
 
     YAML::Node transform;
@@ -1369,7 +1373,7 @@ double Level::point_to_line_segment_distance(
   const double x, const double y,
   const double x0, const double y0,
   const double x1, const double y1,
-  double& x_proj, double& y_proj)
+  double& x_proj, double& y_proj) const
 {
   // this portion figures out which edge is closest to (x, y) by repeatedly
   // testing the distance from the click to each edge in the polygon, using
@@ -1417,39 +1421,59 @@ Polygon::EdgeDragPolygon Level::polygon_edge_drag_press(
   if (polygon == nullptr || polygon->vertices.empty())
     return edp;
 
-  // cruise along all possible line segments and calculate the distance
-  // to this point
-
-  int min_idx = 0;
-  double min_dist = 1.0e9;
+  // find the line segment nearest to this point
+  const auto segment_distance =
+    [this, polygon, x, y](const int v0_idx, double& x_proj, double& y_proj)
+    {
+      const int v1_idx =
+        v0_idx < static_cast<int>(polygon->vertices.size()) - 1 ?
+        v0_idx + 1 : 0;
+      const Vertex& v0 = vertices[polygon->vertices[v0_idx]];
+      const Vertex& v1 = vertices[polygon->vertices[v1_idx]];
+      return point_to_line_segment_distance(
+        x, y, v0.x, v0.y, v1.x, v1.y, x_proj, y_proj);
+    };
 
-  for (std::size_t v0_idx = 0; v0_idx < polygon->vertices.size(); v0_idx++)
+  // the polygon index only knows about polygons in this level
+  int nearest = -1;
+  const std::less<const Polygon*> before;
+  if (!polygons.empty() &&
+    !before(polygon, polygons.data()) &&
+    before(polygon, polygons.data() + polygons.size()))
+  {
+    nearest = get_polygon_index().nearest_edge(
+      static_cast<int>(polygon - polygons.data()),
+      QPointF(x, y),
+      [&segment_distance](const int v0_idx)
+      {
+        double x_proj = 0, y_proj = 0;
+        return segment_distance(v0_idx, x_proj, y_proj);
+      });
+  }
+  else
   {
-    const std::size_t v1_idx =
-      v0_idx < polygon->vertices.size() - 1 ? v0_idx + 1 : 0;
-    const std::size_t v0 = polygon->vertices[v0_idx];
-    const std::size_t v1 = polygon->vertices[v1_idx];
-
-    const double x0 = vertices[v0].x;
-    const double y0 = vertices[v0].y;
-    const double x1 = vertices[v1].x;
-    const double y1 = vertices[v1].y;
-
-    double x_proj = 0, y_proj = 0;
-    const double dist = point_to_line_segment_distance(
-      x, y, x0, y0, x1, y1, x_proj, y_proj);
-
-    if (dist < min_dist)
+    double min_dist = 1.0e9;
+    for (int i = 0; i < static_cast<int>(polygon->vertices.size()); i++)
     {
-      min_idx = v0;
-      min_dist = dist;
-
-      // save the nearest projected point to help debug this visually
-      polygon_edge_proj_x = x_proj;
-      polygon_edge_proj_y = y_proj;
+      double x_proj = 0, y_proj = 0;
+      const double dist = segment_distance(i, x_proj, y_proj);
+      if (dist < min_dist)
+      {
+        nearest = i;
+        min_dist = dist;
+      }
     }
   }
 
+  int min_idx = 0;
+  if (nearest >= 0)
+  {
+    min_idx = polygon->vertices[nearest];
+
+    // save the nearest projected point to help debug this visually
+    segment_distance(nearest, polygon_edge_proj_x, polygon_edge_proj_y);
+  }
+
   // create the mouse motion polygon and insert a new edge
   QVector<QPointF> polygon_vertices;
   for (std::size_t i = 0; i < polygon->vertices.size(); i++)
@@ -1480,12 +1504,602 @@ bool Level::parse_vertices(const YAML::Node& _data)
       vertices.push_back(v);
     }
   }
+  vertices_changed();
   return true;
 }
 
 void Level::add_vertex(const double x, const double y)
 {
   vertices.push_back(Vertex(x, y));
+  vertices_changed();
+}
+
+const vector<int>& Level::vertices_with_param(const string& key) const
+{
+  static const vector<int> none;
+  if (!vertex_param_index.valid)
+    build_vertex_param_index();
+  const auto it = vertex_param_index.by_key.find(key);
+  return it == vertex_param_index.by_key.end() ? none : it->second;
+}
+
+const vector<int>& Level::vertices_with_param(
+  const string& key,
+  const string& value) const
+{
+  static const vector<int> none;
+  if (!vertex_param_index.valid)
+    build_vertex_param_index();
+  const auto it = vertex_param_index.by_value.find(std::make_pair(key, value));
+  return it == vertex_param_index.by_value.end() ? none : it->second;
+}
+
+void Level::changed()
+{
+  revision_id = next_revision_id++;
+}
+
+void Level::vertices_changed()
+{
+  changed();
+  vertex_param_index.valid = false;
+  vertex_buffers_valid = false;
+  vertex_grid_valid = false;
+  polygon_index_valid = false;
+  selection_valid = false;
+  selection_bvh_valid = false;
+}
+
+void Level::polygons_changed()
+{
+  changed();
+  polygon_index_valid = false;
+  selection_valid = false;
+}
+
+std::array<std::size_t, 6> Level::count_selectable() const
+{
+  std::size_t num_features = floorplan_features.size();
+  for (const Layer& layer : layers)
+    num_features += layer.features.size();
+  return {{
+    vertices.size(),
+    edges.size(),
+    models.size(),
+    polygons.size(),
+    fiducials.size(),
+    num_features
+  }};
+}
+
+const Feature* Level::find_feature(const int layer_idx, const int idx) const
+{
+  const vector<Feature>* features = nullptr;
+  if (layer_idx == 0)
+    features = &floorplan_features;
+  else if (layer_idx > 0 && layer_idx <= static_cast<int>(layers.size()))
+    features = &layers[layer_idx - 1].features;
+  if (!features || idx < 0 || idx >= static_cast<int>(features->size()))
+    return nullptr;
+  return &(*features)[idx];
+}
+
+Feature* Level::find_feature(const int layer_idx, const int idx)
+{
+  const Level* level = this;
+  return const_cast<Feature*>(level->find_feature(layer_idx, idx));
+}
+
+const Level::Selection& Level::selection() const
+{
+  if (!selection_valid || selection_counts != count_selectable())
+  {
+    rebuild_selection();
+    return selection_cache;
+  }
+
+  // Items can be removed and others added in their place without the
+  // counts changing. Whatever was in such a slot before is no longer
+  // flagged, which is cheap to check here.
+  const Selection& sel = selection_cache;
+  bool stale = false;
+  for (const int i : sel.vertices)
+    stale = stale || !vertices[i].selected;
+  for (const int i : sel.edges)
+    stale = stale || !edges[i].selected;
+  for (const int i : sel.models)
+    stale = stale || !models[i].selected;
+  for (const int i : sel.polygons)
+    stale = stale || !polygons[i].selected;
+  for (const int i : sel.fiducials)
+    stale = stale || !fiducials[i].selected;
+  for (const auto& f : sel.features)
+  {
+    const Feature* feature = find_feature(f.first, f.second);
+    stale = stale || !feature || !feature->selected();
+  }
+  if (stale)
+    rebuild_selection();
+  return selection_cache;
+}
+
+void Level::rebuild_selection() const
+{
+  Selection& sel = selection_cache;
+  sel = Selection();
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    if (vertices[i].selected)
+      sel.vertices.insert(sel.vertices.end(), i);
+  }
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    if (edges[i].selected)
+      sel.edges.insert(sel.edges.end(), i);
+  }
+  for (std::size_t i = 0; i < models.size(); i++)
+  {
+    if (models[i].selected)
+      sel.models.insert(sel.models.end(), i);
+  }
+  for (std::size_t i = 0; i < polygons.size(); i++)
+  {
+    if (polygons[i].selected)
+      sel.polygons.insert(sel.polygons.end(), i);
+  }
+  for (std::size_t i = 0; i < fiducials.size(); i++)
+  {
+    if (fiducials[i].selected)
+      sel.fiducials.insert(sel.fiducials.end(), i);
+  }
+  for (std::size_t i = 0; i < floorplan_features.size(); i++)
+  {
+    if (floorplan_features[i].selected())
+      sel.features.insert(
+        sel.features.end(),
+        std::make_pair(0, static_cast<int>(i)));
+  }
+  for (std::size_t layer_idx = 0; layer_idx < layers.size(); layer_idx++)
+  {
+    const vector<Feature>& features = layers[layer_idx].features;
+    for (std::size_t i = 0; i < features.size(); i++)
+    {
+      if (features[i].selected())
+        sel.features.insert(
+          sel.features.end(),
+          std::make_pair(
+            static_cast<int>(layer_idx + 1),
+            static_cast<int>(i)));
+    }
+  }
+  selection_counts = count_selectable();
+  selection_valid = true;
+}
+
+void Level::set_selected(
+  const ItemType type,
+  const int idx,
+  const bool selected)
+{
+  // bring the sets up to date before changing a flag behind their back
+  if (!selection_valid || selection_counts != count_selectable())
+    rebuild_selection();
+
+  std::set<int>* set = nullptr;
+  switch (type)
+  {
+    case VERTEX:
+      if (idx < 0 || idx >= static_cast<int>(vertices.size()))
+        return;
+      vertices[idx].selected = selected;
+      if (vertex_buffers_valid &&
+        vertex_buffer_cache.x.size() == vertices.size())
+        vertex_buffer_cache.selected[idx] = selected ? 1 : 0;
+      set = &selection_cache.vertices;
+      break;
+    case EDGE:
+      if (idx < 0 || idx >= static_cast<int>(edges.size()))
+        return;
+      edges[idx].selected = selected;
+      set = &selection_cache.edges;
+      break;
+    case MODEL:
+      if (idx < 0 || idx >= static_cast<int>(models.size()))
+        return;
+      models[idx].selected = selected;
+      set = &selection_cache.models;
+      break;
+    case POLYGON:
+      if (idx < 0 || idx >= static_cast<int>(polygons.size()))
+        return;
+      polygons[idx].selected = selected;
+      set = &selection_cache.polygons;
+      break;
+    case FIDUCIAL:
+      if (idx < 0 || idx >= static_cast<int>(fiducials.size()))
+        return;
+      fiducials[idx].selected = selected;
+      set = &selection_cache.fiducials;
+      break;
+    default:
+      return;
+  }
+  if (selected)
+    set->insert(idx);
+  else
+    set->erase(idx);
+}
+
+void Level::set_feature_selected(
+  const int layer_idx,
+  const int feature_idx,
+  const bool selected)
+{
+  if (!selection_valid || selection_counts != count_selectable())
+    rebuild_selection();
+
+  Feature* feature = find_feature(layer_idx, feature_idx);
+  if (!feature)
+    return;
+  feature->setSelected(selected);
+  if (selected)
+    selection_cache.features.insert(std::make_pair(layer_idx, feature_idx));
+  else
+    selection_cache.features.erase(std::make_pair(layer_idx, feature_idx));
+}
+
+void Level::update_selection_bvhs() const
+{
+  if (selection_bvh_valid && selection_bvh_edges == edges.size())
+    return;
+
+  const VertexBuffers& vb = vertex_buffers();
+  const int num_vertices = static_cast<int>(vb.x.size());
+  vector<Bvh::Box> boxes(vb.x.size());
+  for (std::size_t i = 0; i < vb.x.size(); i++)
+    boxes[i] = {vb.x[i], vb.y[i], vb.x[i], vb.y[i]};
+  vertex_bvh.build(boxes);
+
+  // edges with a bad vertex index are never selected or snapped to, so
+  // it doesn't matter where their boxes are
+  boxes.resize(edges.size());
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    const Edge& e = edges[i];
+    if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+      e.end_idx < 0 || e.end_idx >= num_vertices)
+    {
+      boxes[i] = {0.0, 0.0, 0.0, 0.0};
+      continue;
+    }
+    boxes[i] = {
+      std::min(vb.x[e.start_idx], vb.x[e.end_idx]),
+      std::min(vb.y[e.start_idx], vb.y[e.end_idx]),
+      std::max(vb.x[e.start_idx], vb.x[e.end_idx]),
+      std::max(vb.y[e.start_idx], vb.y[e.end_idx])
+    };
+  }
+  edge_bvh.build(boxes);
+  selection_bvh_edges = edges.size();
+  selection_bvh_valid = true;
+}
+
+std::size_t Level::select_region(
+  const QPolygonF& region,
+  const RenderingOptions& rendering_options)
+{
+  if (region.size() < 3)
+    return 0;
+
+  const QRectF r = region.boundingRect();
+  const Bvh::Box query{r.left(), r.top(), r.right(), r.bottom()};
+  const VertexBuffers& vb = vertex_buffers();
+  update_selection_bvhs();
+
+  std::size_t num_selected = 0;
+  vector<int> inside;  // vertex indices, sorted below
+  vertex_bvh.for_each_intersecting(
+    query,
+    [&](const int i)
+    {
+      if (region.containsPoint(QPointF(vb.x[i], vb.y[i]), Qt::OddEvenFill))
+        inside.push_back(i);
+    });
+  std::sort(inside.begin(), inside.end());
+  for (const int i : inside)
+  {
+    if (!vertices[i].selected)
+      num_selected++;
+    set_selected(VERTEX, i, true);
+  }
+
+  edge_bvh.for_each_intersecting(
+    query,
+    [&](const int i)
+    {
+      const Edge& e = edges[i];
+      if (e.type == Edge::LANE &&
+        e.get_graph_idx() != rendering_options.active_traffic_map_idx)
+        return;
+      if (e.selected ||
+        !std::binary_search(inside.begin(), inside.end(), e.start_idx) ||
+        !std::binary_search(inside.begin(), inside.end(), e.end_idx))
+        return;
+      set_selected(EDGE, i, true);
+      num_selected++;
+    });
+
+  // models move without telling the level, so they aren't indexed
+  if (rendering_options.show_models)
+  {
+    for (std::size_t i = 0; i < models.size(); i++)
+    {
+      const Model& m = models[i];
+      const QPointF p(m.state.x, m.state.y);
+      if (m.selected || !r.contains(p) ||
+        !region.containsPoint(p, Qt::OddEvenFill))
+        continue;
+      set_selected(MODEL, i, true);
+      num_selected++;
+    }
+  }
+
+  return num_selected;
+}
+
+const PolygonIndex& Level::get_polygon_index() const
+{
+  if (!polygon_index_valid || polygon_index.size() != polygons.size())
+  {
+    polygon_index.build(polygons, vertices);
+    polygon_index_valid = true;
+  }
+  return polygon_index;
+}
+
+const Level::VertexBuffers& Level::vertex_buffers() const
+{
+  VertexBuffers& b = vertex_buffer_cache;
+  if (vertex_buffers_valid && b.x.size() == vertices.size())
+    return b;
+
+  const std::size_t n = vertices.size();
+  b.x.resize(n);
+  b.y.resize(n);
+  b.selected.resize(n);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    b.x[i] = vertices[i].x;
+    b.y[i] = vertices[i].y;
+    b.selected[i] = vertices[i].selected ? 1 : 0;
+  }
+  vertex_buffers_valid = true;
+  return b;
+}
+
+void Level::move_vertex(const int idx, const double x, const double y)
+{
+  if (idx < 0 || idx >= static_cast<int>(vertices.size()))
+    return;
+  vertices[idx].x = x;
+  vertices[idx].y = y;
+  changed();
+  polygon_index_valid = false;
+  selection_bvh_valid = false;
+  vertex_grid_valid = false;
+  if (vertex_buffers_valid && vertex_buffer_cache.x.size() == vertices.size())
+  {
+    vertex_buffer_cache.x[idx] = x;
+    vertex_buffer_cache.y[idx] = y;
+  }
+}
+
+const VertexGrid& Level::vertex_grid(const double cell_size) const
+{
+  if (!vertex_grid_valid || vertex_grid_cache.cell_size() != cell_size)
+  {
+    const VertexBuffers& vb = vertex_buffers();
+    vertex_grid_cache.build(vb.x, vb.y, cell_size);
+    vertex_grid_valid = true;
+  }
+  return vertex_grid_cache;
+}
+
+std::size_t Level::merge_duplicate_vertices(const double tolerance)
+{
+  const int num_vertices = static_cast<int>(vertices.size());
+  if (num_vertices < 2 || !(tolerance > 0.0))
+    return 0;
+
+  // Each vertex that is kept claims the unclaimed vertices after it that
+  // are within the tolerance. Claimed vertices never claim any others, so
+  // a row of vertices just under the tolerance apart isn't merged into
+  // one.
+  const double radius = tolerance / drawing_meters_per_pixel;
+  const VertexGrid& grid = vertex_grid(radius);
+  vector<int> target(num_vertices);
+  for (int i = 0; i < num_vertices; i++)
+    target[i] = i;
+  std::size_t num_merged = 0;
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (target[i] != i)
+      continue;
+    grid.for_each_near(
+      QPointF(vertices[i].x, vertices[i].y),
+      radius,
+      [&](const int j)
+      {
+        if (j > i && target[j] == j)
+        {
+          target[j] = i;
+          num_merged++;
+        }
+      });
+  }
+  if (!num_merged)
+    return 0;
+
+  // the indices of the kept vertices once the others are removed
+  vector<int> new_idx(num_vertices, -1);
+  vector<Vertex> kept;
+  kept.reserve(num_vertices - num_merged);
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (target[i] != i)
+      continue;
+    new_idx[i] = static_cast<int>(kept.size());
+    kept.push_back(std::move(vertices[i]));
+  }
+  for (int i = 0; i < num_vertices; i++)
+  {
+    if (target[i] == i)
+      continue;
+    Vertex& v = kept[new_idx[target[i]]];
+    if (v.name.empty())
+      v.name = vertices[i].name;
+    for (const auto& param : vertices[i].params)
+    {
+      if (!v.params.count(param.first))
+        v.params[param.first] = param.second;
+    }
+  }
+  vertices = std::move(kept);
+  vertices_changed();
+
+  auto remap = [&](int& idx)
+    {
+      if (idx >= 0 && idx < num_vertices)
+        idx = new_idx[target[idx]];
+    };
+
+  std::size_t num_edges = 0;
+  for (std::size_t i = 0; i < edges.size(); i++)
+  {
+    Edge& e = edges[i];
+    const bool was_loop = e.start_idx == e.end_idx;
+    remap(e.start_idx);
+    remap(e.end_idx);
+    if (!was_loop && e.start_idx == e.end_idx)
+      continue;
+    if (num_edges != i)
+      edges[num_edges] = std::move(e);
+    num_edges++;
+  }
+  edges.resize(num_edges);
+
+  std::size_t num_polygons = 0;
+  for (std::size_t i = 0; i < polygons.size(); i++)
+  {
+    Polygon& polygon = polygons[i];
+    const std::size_t size_before = polygon.vertices.size();
+    vector<int> merged;
+    merged.reserve(size_before);
+    for (int idx : polygon.vertices)
+    {
+      remap(idx);
+      if (merged.empty() || merged.back() != idx)
+        merged.push_back(idx);
+    }
+    while (merged.size() > 1 && merged.back() == merged.front())
+      merged.pop_back();
+    if (size_before >= 3 && merged.size() < 3)
+      continue;
+    polygon.vertices = std::move(merged);
+    if (num_polygons != i)
+      polygons[num_polygons] = std::move(polygon);
+    num_polygons++;
+  }
+  polygons.resize(num_polygons);
+  polygons_changed();
+
+  return num_merged;
+}
+
+Level::Snap Level::snap(
+  const QPointF& p,
+  const double radius,
+  const int snap_types,
+  const double grid_spacing,
+  const RenderingOptions& rendering_options) const
+{
+  Snap snap;
+  snap.point = p;
+
+  if (snap_types & SNAP_VERTEX)
+  {
+    const int idx = vertex_grid(radius).nearest(p, radius);
+    if (idx >= 0)
+    {
+      snap.point = QPointF(vertices[idx].x, vertices[idx].y);
+      snap.type = SNAP_VERTEX;
+      snap.idx = idx;
+      return snap;
+    }
+  }
+
+  if (snap_types & SNAP_EDGE)
+  {
+    update_selection_bvhs();
+    const int num_vertices = static_cast<int>(vertices.size());
+    double best_dist = radius;
+    edge_bvh.for_each_intersecting(
+      {p.x() - radius, p.y() - radius, p.x() + radius, p.y() + radius},
+      [&](const int i)
+      {
+        const Edge& e = edges[i];
+        if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+          e.end_idx < 0 || e.end_idx >= num_vertices)
+          return;
+        if (e.type == Edge::LANE &&
+          e.get_graph_idx() != rendering_options.active_traffic_map_idx)
+          return;
+        const Vertex& a = vertices[e.start_idx];
+        const Vertex& b = vertices[e.end_idx];
+        double x_proj = 0.0, y_proj = 0.0;
+        const double dist = point_to_line_segment_distance(
+          p.x(), p.y(), a.x, a.y, b.x, b.y, x_proj, y_proj);
+        if (dist < best_dist || (dist == best_dist && i < snap.idx))
+        {
+          best_dist = dist;
+          snap.point = QPointF(x_proj, y_proj);
+          snap.type = SNAP_EDGE;
+          snap.idx = i;
+        }
+      });
+    if (snap.type == SNAP_EDGE)
+      return snap;
+  }
+
+  if ((snap_types & SNAP_GRID) && grid_spacing > 0.0)
+  {
+    const double spacing = grid_spacing / drawing_meters_per_pixel;
+    snap.point = QPointF(
+      std::round(p.x() / spacing) * spacing,
+      std::round(p.y() / spacing) * spacing);
+    snap.type = SNAP_GRID;
+  }
+
+  return snap;
+}
+
+void Level::build_vertex_param_index() const
+{
+  VertexParamIndex& index = vertex_param_index;
+  index.by_key.clear();
+  index.by_value.clear();
+  for (std::size_t i = 0; i < vertices.size(); i++)
+  {
+    for (const auto& param : vertices[i].params)
+    {
+      const int idx = static_cast<int>(i);
+      index.by_key[param.first.str()].push_back(idx);
+      index.by_value[std::make_pair(
+          param.first.str(),
+          param.second.to_qstring().toStdString())].push_back(idx);
+    }
+  }
+  index.valid = true;
 }
 
 std::size_t Level::get_vertex_by_id(QUuid vertex_id)
@@ -1856,9 +2470,9 @@ void Level::mouse_select_press(
   if (rendering_options.show_models &&
     ni.model_idx >= 0 &&
     ni.model_dist < model_dist_thresh)
-    models[ni.model_idx].selected = true;
+    set_selected(MODEL, ni.model_idx, true);
   else if (ni.vertex_idx >= 0 && ni.vertex_dist < vertex_dist_thresh)
-    vertices[ni.vertex_idx].selected = true;
+    set_selected(VERTEX, ni.vertex_idx, true);
   else if (ni.feature_idx >= 0 && ni.feature_dist < feature_dist_thresh)
   {
     //levels[level_idx].feature_sets[
@@ -1867,18 +2481,10 @@ void Level::mouse_select_press(
       ni.feature_idx,
       ni.feature_dist);
 
-    if (ni.feature_layer_idx == 0)
-    {
-      floorplan_features[ni.feature_idx].setSelected(true);
-    }
-    else
-    {
-      layers[ni.feature_layer_idx-1].
-      features[ni.feature_idx].setSelected(true);
-    }
+    set_feature_selected(ni.feature_layer_idx, ni.feature_idx, true);
   }
   else if (ni.fiducial_idx >= 0 && ni.fiducial_dist < 10.0)
-    fiducials[ni.fiducial_idx].selected = true;
+    set_selected(FIDUCIAL, ni.fiducial_idx, true);
   else
   {
     // use the QGraphics stuff to see if it's an edge segment or polygon
@@ -1909,18 +2515,23 @@ Level::NearestItem Level::nearest_items(const double x, const double y)
 {
   NearestItem ni;
 
-  for (std::size_t i = 0; i < vertices.size(); i++)
+  const VertexBuffers& vb = vertex_buffers();
+  const double* vx = vb.x.data();
+  const double* vy = vb.y.data();
+  double vertex_dist2 = ni.vertex_dist * ni.vertex_dist;
+  for (std::size_t i = 0; i < vb.x.size(); i++)
   {
-    const Vertex& p = vertices[i];
-    const double dx = x - p.x;
-    const double dy = y - p.y;
-    const double dist = sqrt(dx*dx + dy*dy);
-    if (dist < ni.vertex_dist)
+    const double dx = x - vx[i];
+    const double dy = y - vy[i];
+    const double dist2 = dx*dx + dy*dy;
+    if (dist2 < vertex_dist2)
     {
-      ni.vertex_dist = dist;
+      vertex_dist2 = dist2;
       ni.vertex_idx = i;
     }
   }
+  if (ni.vertex_idx >= 0)
+    ni.vertex_dist = sqrt(vertex_dist2);
 
   // search the floorplan features
   for (std::size_t i = 0; i < floorplan_features.size(); i++)
@@ -2000,11 +2611,11 @@ int Level::nearest_item_index_if_within_distance(
   int min_index = -1;
   if (item_type == VERTEX)
   {
-    for (std::size_t i = 0; i < vertices.size(); i++)
+    const VertexBuffers& vb = vertex_buffers();
+    for (std::size_t i = 0; i < vb.x.size(); i++)
     {
-      const Vertex& p = vertices[i];
-      const double dx = x - p.x;
-      const double dy = y - p.y;
+      const double dx = x - vb.x[i];
+      const double dy = y - vb.y[i];
       const double dist2 = dx*dx + dy*dy;  // no need for sqrt each time
       if (dist2 < min_dist)
       {
@@ -2064,8 +2675,9 @@ void Level::set_selected_line_item(
 
 
   // find if any of our lanes match those vertices
-  for (auto& edge : edges)
+  for (std::size_t i = 0; i < edges.size(); i++)
   {
+    const Edge& edge = edges[i];
     if ((edge.type == Edge::LANE) &&
       (edge.get_graph_idx() != rendering_options.active_traffic_map_idx))
       continue;
@@ -2084,7 +2696,7 @@ void Level::set_selected_line_item(
     const double thresh = 10.0;  // it should be really tiny if it matches
     if (v1_dist < thresh && v2_dist < thresh)
     {
-      edge.selected = true;
+      set_selected(EDGE, i, true);
       return;  // stop after first one is found, don't select multiple
     }
   }
@@ -2112,37 +2724,22 @@ void Level::set_selected_containing_polygon(
 {
   // holes are "higher" in our Z-stack (to make them clickable), so first
   // we need to make a list of all polygons that contain this point.
-  vector<Polygon*> containing_polygons;
-  for (std::size_t i = 0; i < polygons.size(); i++)
-  {
-    Polygon& polygon = polygons[i];
-    QVector<QPointF> polygon_vertices;
-    for (const auto& vertex_idx: polygon.vertices)
-    {
-      const Vertex& v = vertices[vertex_idx];
-      polygon_vertices.append(QPointF(v.x, v.y));
-    }
-    QPolygonF qpolygon(polygon_vertices);
-    if (qpolygon.containsPoint(QPoint(x, y), Qt::OddEvenFill))
-      containing_polygons.push_back(&polygons[i]);
-  }
+  const vector<int> containing_polygons =
+    get_polygon_index().polygons_containing(QPoint(x, y));
 
   // first search for holes
-  for (Polygon* p : containing_polygons)
+  for (const int i : containing_polygons)
   {
-    if (p->type == Polygon::HOLE)
+    if (polygons[i].type == Polygon::HOLE)
     {
-      p->selected = true;
+      set_selected(POLYGON, i, true);
       return;
     }
   }
 
   // if we get here, just return the first thing.
-  for (Polygon* p : containing_polygons)
-  {
-    p->selected = true;
-    return;
-  }
+  if (!containing_polygons.empty())
+    set_selected(POLYGON, containing_polygons.front(), true);
 }
 
 void Level::compute_layer_transforms()
@@ -2165,7 +2762,7 @@ void Level::compute_layer_transform(const std::size_t layer_idx)
   Transform ff_rmf;
   ff_rmf.setScale(ff_rmf_scale / layer.transform.scale());
 
-  const double ff_map_height = ff_rmf_scale * layer.image.height();
+  const double ff_map_height = ff_rmf_scale * layer.image_height();
 
   ff_rmf.setYaw(-(fmod(layer.transform.yaw() + M_PI, 2 * M_PI) - M_PI));
 
@@ -2205,10 +2802,10 @@ void Level::compute_layer_transform(const std::size_t layer_idx)
   gridcells_rmf.setYaw(fmod(layer.transform.yaw() + M_PI, 2 * M_PI) - M_PI);
   const double gx =
     (layer.transform.translation().x() +
-    layer.image.height() * gridcells_rmf.scale() * sin(gridcells_rmf.yaw()));
+    layer.image_height() * gridcells_rmf.scale() * sin(gridcells_rmf.yaw()));
   const double gy =
     (layer.transform.translation().y() +
-    layer.image.height() * gridcells_rmf.scale() * cos(gridcells_rmf.yaw()));
+    layer.image_height() * gridcells_rmf.scale() * cos(gridcells_rmf.yaw()));
   gridcells_rmf.setTranslation(QPointF(gx, gy));
 
   layer.transform_strings.push_back(
@@ -2233,26 +2830,24 @@ void Level::align_colinear()
 
   // build up a vector of selected vertex indices
   vector<SelectedVertex> selected_vertices;
-  for (size_t i = 0; i < vertices.size(); i++)
+  for (const int selected_idx : selection().vertices)
   {
-    if (vertices[i].selected)
-    {
-      SelectedVertex sv;
-      sv.index = i;
-      sv.expanded = false;
-
-      for (size_t j = 0; j < edges.size(); j++)
-      {
-        const size_t start_idx = static_cast<size_t>(edges[j].start_idx);
-        const size_t end_idx = static_cast<size_t>(edges[j].end_idx);
-        if (start_idx == i && vertices[end_idx].selected)
-          sv.connected_vertex_indices.push_back(end_idx);
-        else if (end_idx == i && vertices[start_idx].selected)
-          sv.connected_vertex_indices.push_back(start_idx);
-      }
+    const size_t i = static_cast<size_t>(selected_idx);
+    SelectedVertex sv;
+    sv.index = i;
+    sv.expanded = false;
 
-      selected_vertices.push_back(sv);
+    for (size_t j = 0; j < edges.size(); j++)
+    {
+      const size_t start_idx = static_cast<size_t>(edges[j].start_idx);
+      const size_t end_idx = static_cast<size_t>(edges[j].end_idx);
+      if (start_idx == i && vertices[end_idx].selected)
+        sv.connected_vertex_indices.push_back(end_idx);
+      else if (end_idx == i && vertices[start_idx].selected)
+        sv.connected_vertex_indices.push_back(start_idx);
     }
+
+    selected_vertices.push_back(sv);
   }
 
   printf("align_colinear() vertices:\n");
@@ -2394,9 +2989,59 @@ void Level::align_colinear()
   // project intermediate vertices onto this line
   for (size_t i = 1; i < chain.size() - 1; i++)
   {
-    Vertex& v = vertices[chain[i].index];
+    const Vertex& v = vertices[chain[i].index];
     const double t = ((v1.x - v.x) * ux) + ((v1.y - v.y) * uy);
-    v.x = v1.x - t * ux;
-    v.y = v1.y - t * uy;
+    move_vertex(
+      static_cast<int>(chain[i].index),
+      v1.x - t * ux,
+      v1.y - t * uy);
+  }
+}
+
+std::size_t Level::lane_graph_fingerprint() const
+{
+  std::size_t h = vertices.size() * 31 + edges.size();
+  auto mix = [&h](const std::size_t v)
+    {
+      h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    };
+  const std::hash<double> hash_double;
+  const std::hash<string> hash_string;
+
+  for (const Vertex& v : vertices)
+  {
+    mix(hash_double(v.x));
+    mix(hash_double(v.y));
+    mix(hash_string(v.name));
+
+    // lift cabins, chargers, dispensers and the like all matter
+    for (const auto& param : v.params)
+    {
+      mix(hash_string(param.first.str()));
+      mix(static_cast<std::size_t>(param.second.type()));
+      mix(static_cast<std::size_t>(param.second.value_int()));
+      mix(hash_double(param.second.value_double()));
+      mix(hash_string(param.second.value_string()));
+      mix(param.second.value_bool() ? 1 : 0);
+    }
+  }
+
+  for (const Edge& e : edges)
+  {
+    mix(static_cast<std::size_t>(e.start_idx));
+    mix(static_cast<std::size_t>(e.end_idx));
+    mix(static_cast<std::size_t>(e.type));
+    if (e.type == Edge::LANE || e.type == Edge::HUMAN_LANE)
+    {
+      mix(static_cast<std::size_t>(e.get_graph_idx()));
+      mix(e.is_bidirectional() ? 1 : 0);
+    }
+    else if (e.type == Edge::DOOR)
+    {
+      auto it = e.params.find("name");
+      if (it != e.params.end())
+        mix(hash_string(it->second.value_string()));
+    }
   }
+  return h;
 }
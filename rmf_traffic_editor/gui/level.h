@@ -19,8 +19,15 @@
 #define LEVEL_H
 
 #include <yaml-cpp/yaml.h>
+#include <cstdint>
+#include <array>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "bvh.h"
 #include "constraint.hpp"
 #include "edge.h"
 #include "editor_model.h"
@@ -30,11 +37,16 @@
 #include "layer.h"
 #include "model.h"
 #include "polygon.h"
+#include "polygon_index.h"
 #include "rendering_options.h"
 #include "vertex.h"
+#include "vertex_grid.h"
 
+#include <QDir>
+#include <QImage>
 #include <QPixmap>
 #include <QPainterPath>
+#include <QPolygonF>
 class QGraphicsScene;
 
 
@@ -65,6 +77,66 @@ public:
   void add_vertex(const double x, const double y);
   std::size_t get_vertex_by_id(QUuid vertex_id);
 
+  /// Indices of the vertices that have a param called `key`, in order.
+  /// These come from an index of every vertex param, which is rebuilt on
+  /// the first lookup after vertices_changed(), so lookups only cost the
+  /// size of the result. The reference is good until then too.
+  const std::vector<int>& vertices_with_param(const std::string& key) const;
+
+  /// Indices of the vertices whose param `key` has the value `value`, as
+  /// Param::to_qstring() would write it: "true" finds the chargers under
+  /// "is_charger", a lift name finds its cabin waypoints under
+  /// "lift_cabin", and so on.
+  const std::vector<int>& vertices_with_param(
+    const std::string& key,
+    const std::string& value) const;
+
+  /// Anything that adds, removes or reorders vertices, or changes their
+  /// params, positions or selection, without going through Level must
+  /// call this afterwards.
+  void vertices_changed();
+
+  /// A number that changes whenever the level may have been edited, and
+  /// is never reused, even by other levels, so views can tell whether
+  /// what they derived from a level is still current. It is advanced by
+  /// vertices_changed(), polygons_changed() and move_vertex(); anything
+  /// else that edits the level, like renaming a model, must call changed().
+  std::size_t revision() const { return revision_id; }
+  void changed();
+
+  /// The vertex coordinates and selection flags as contiguous arrays in
+  /// vertex order, for scans like nearest_items() that only need the
+  /// geometry and would otherwise stride through whole Vertex objects.
+  /// Rebuilt on the first call after vertices_changed(), and kept in sync
+  /// by move_vertex(), set_selected() and clear_selection().
+  struct VertexBuffers
+  {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<std::uint8_t> selected;
+  };
+  const VertexBuffers& vertex_buffers() const;
+
+  void move_vertex(const int idx, const double x, const double y);
+
+  /// Anything that adds, removes or reorders polygons, or changes which
+  /// vertices they have, without going through Level must call this
+  /// afterwards, so picking and edge dragging don't use stale outlines.
+  void polygons_changed();
+
+  /// The vertices hashed into cells `cell_size` pixels wide. Rebuilt on
+  /// the first call after vertices_changed() or move_vertex(), or when
+  /// asked for a different cell size.
+  const VertexGrid& vertex_grid(const double cell_size) const;
+
+  /// Merge every vertex that is within `tolerance` meters of an earlier
+  /// vertex that is kept into it, in one pass over the vertex grid. The
+  /// kept vertex picks up any name or params it didn't have. Edges and
+  /// polygons are pointed at the kept vertices; edges that end up going
+  /// from a vertex to itself are removed, as are polygons left with fewer
+  /// than three vertices. Returns how many vertices were removed.
+  std::size_t merge_duplicate_vertices(const double tolerance);
+
   std::string drawing_filename;
   int drawing_width = 0;
   int drawing_height = 0;
@@ -87,7 +159,12 @@ public:
 
   QPixmap floorplan_pixmap;
 
-  bool from_yaml(const std::string& name, const YAML::Node& data);
+  /// Relative drawing and layer filenames are resolved against
+  /// `base_dir`, which defaults to the current directory.
+  bool from_yaml(
+    const std::string& name,
+    const YAML::Node& data,
+    const QDir& base_dir = QDir());
   YAML::Node to_yaml() const;
 
   const Feature* find_feature(const QUuid& id) const;
@@ -98,7 +175,7 @@ public:
   void add_constraint(const QUuid& a, const QUuid& b);
   void remove_constraint(const QUuid& a, const QUuid& b);
 
-  enum ItemType { VERTEX=1, MODEL, FIDUCIAL };
+  enum ItemType { VERTEX=1, MODEL, FIDUCIAL, EDGE, POLYGON };
   struct NearestItem
   {
     double model_dist = 1e100;
@@ -119,6 +196,32 @@ public:
     const double x,
     const double y);
 
+  enum SnapType
+  {
+    SNAP_NONE = 0,
+    SNAP_VERTEX = 1,
+    SNAP_EDGE = 2,
+    SNAP_GRID = 4
+  };
+  struct Snap
+  {
+    QPointF point;
+    SnapType type = SNAP_NONE;
+    int idx = -1;  // of the vertex or edge snapped to
+  };
+
+  /// Where a point being drawn at `p` should go: onto the nearest vertex
+  /// within `radius` pixels, else onto the nearest edge within `radius`,
+  /// else onto a grid `grid_spacing` meters apart, trying only the kinds
+  /// in the `snap_types` mask. As when clicking, lanes of other traffic
+  /// maps are left out.
+  Snap snap(
+    const QPointF& p,
+    const double radius,
+    const int snap_types,
+    const double grid_spacing,
+    const RenderingOptions& rendering_options) const;
+
   int nearest_item_index_if_within_distance(
     const double x,
     const double y,
@@ -149,6 +252,41 @@ public:
   void calculate_scale();
   void clear_selection();
 
+  /// The indices of the selected vertices, edges, models, polygons,
+  /// fiducials and features, kept next to the `selected` flags the drawing
+  /// code reads, so that reading or clearing the selection only costs its
+  /// size. Select things with set_selected() or set_feature_selected() to
+  /// keep the two in step. After items are added, removed or reordered
+  /// (which shows up in their counts, vertices_changed() or
+  /// polygons_changed()) the sets are rebuilt from the flags the next time
+  /// they are needed, so that first read costs a pass over the level.
+  struct Selection
+  {
+    std::set<int> vertices;
+    std::set<int> edges;
+    std::set<int> models;
+    std::set<int> polygons;
+    std::set<int> fiducials;
+    // (layer, feature) pairs, where layer 0 is the floorplan and layer
+    // i > 0 is layers[i - 1], as in SelectedItem
+    std::set<std::pair<int, int>> features;
+  };
+  const Selection& selection() const;
+
+  void set_selected(const ItemType type, const int idx, const bool selected);
+  void set_feature_selected(
+    const int layer_idx,
+    const int feature_idx,
+    const bool selected);
+
+  /// Add the vertices and models inside `region` (in scene pixels) to the
+  /// selection, along with the edges that have both ends inside it. As
+  /// when clicking, lanes of other traffic maps and hidden models are
+  /// left out. Returns how many items were added.
+  std::size_t select_region(
+    const QPolygonF& region,
+    const RenderingOptions& rendering_options);
+
   void get_selected_items(std::vector<SelectedItem>& selected_items);
 
   void set_selected_line_item(
@@ -167,7 +305,12 @@ public:
 
   void clear_scene();
 
-  bool load_drawing();
+  bool load_drawing(const QDir& base_dir = QDir());
+
+  /// Decode the drawing into `image` and take the drawing size from it,
+  /// without creating any pixmaps, so it is safe to call from worker
+  /// threads. load_drawing() also builds `floorplan_pixmap` from it.
+  bool decode_drawing(QImage& image, const QDir& base_dir = QDir());
 
   void set_drawing_visible(bool value) { _drawing_visible = value; }
   bool get_drawing_visible() const { return _drawing_visible; }
@@ -182,6 +325,12 @@ public:
 
   void align_colinear();
 
+  /// Hash of everything the lane graphs of this level depend on: vertex
+  /// positions, names and parameters (lift cabins, chargers, ...), and the
+  /// endpoints, types and lane or door parameters of the edges. Used to
+  /// skip re-analyzing unchanged levels.
+  std::size_t lane_graph_fingerprint() const;
+
 private:
   double point_to_line_segment_distance(
     const double x,
@@ -191,7 +340,7 @@ private:
     const double x1,
     const double y1,
     double& x_proj,
-    double& y_proj);
+    double& y_proj) const;
 
   void load_yaml_edge_sequence(
     const YAML::Node& data,
@@ -200,6 +349,46 @@ private:
 
   bool parse_vertices(const YAML::Node& _data);
 
+  mutable VertexGrid vertex_grid_cache;
+  mutable bool vertex_grid_valid = false;
+
+  // vertex params to the vertices that have them, built lazily
+  struct VertexParamIndex
+  {
+    bool valid = false;
+    std::map<std::string, std::vector<int>> by_key;
+    std::map<std::pair<std::string, std::string>, std::vector<int>> by_value;
+  };
+  mutable VertexParamIndex vertex_param_index;
+  void build_vertex_param_index() const;
+
+  mutable VertexBuffers vertex_buffer_cache;
+  mutable bool vertex_buffers_valid = false;
+
+  // polygon outlines for picking, rebuilt lazily after vertices or
+  // polygons change
+  mutable PolygonIndex polygon_index;
+  mutable bool polygon_index_valid = false;
+  const PolygonIndex& get_polygon_index() const;
+
+  std::size_t revision_id;
+
+  mutable Selection selection_cache;
+  mutable bool selection_valid = false;
+  mutable std::array<std::size_t, 6> selection_counts;  // when rebuilt
+  std::array<std::size_t, 6> count_selectable() const;
+  void rebuild_selection() const;
+  const Feature* find_feature(const int layer_idx, const int idx) const;
+  Feature* find_feature(const int layer_idx, const int idx);
+
+  // the vertices and edges for select_region() and snap(), rebuilt
+  // lazily after vertices move or change, or the number of edges changes
+  mutable Bvh vertex_bvh;
+  mutable Bvh edge_bvh;
+  mutable bool selection_bvh_valid = false;
+  mutable std::size_t selection_bvh_edges = 0;
+  void update_selection_bvhs() const;
+
   bool _drawing_visible = true;
 
   void draw_lane(
@@ -17,7 +17,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 
+#include <QGraphicsItemGroup>
 #include <QGraphicsScene>
 #include <QGraphicsSimpleTextItem>
 
@@ -146,14 +148,37 @@ void Lift::draw(
   const double scale,
   const double translate_x,
   const double translate_y) const
+{
+  QGraphicsItemGroup* group = create_graphics(
+    meters_per_pixel,
+    level_name,
+    elevation,
+    apply_transformation,
+    scale,
+    translate_x,
+    translate_y);
+  if (group)
+    scene->addItem(group);
+}
+
+QGraphicsItemGroup* Lift::create_graphics(
+  const double meters_per_pixel,
+  const string& level_name,
+  const double elevation,
+  const bool apply_transformation,
+  const double scale,
+  const double translate_x,
+  const double translate_y) const
 {
   if (elevation > highest_elevation || elevation < lowest_elevation)
-    return;
+    return nullptr;
   const double cabin_w = width / meters_per_pixel;
   const double cabin_d = depth / meters_per_pixel;
   QPen cabin_pen(Qt::black);
   cabin_pen.setWidth(0.05 / meters_per_pixel);
 
+  QGraphicsItemGroup* group = new QGraphicsItemGroup;
+
   QGraphicsRectItem* cabin_rect = new QGraphicsRectItem(
     -cabin_w / 2.0,
     -cabin_d / 2.0,
@@ -165,23 +190,21 @@ void Lift::draw(
     cabin_rect->setBrush(QBrush(QColor::fromRgbF(1.0, 0.3, 0.3, 0.3)));
   else
     cabin_rect->setBrush(QBrush(QColor::fromRgbF(0.5, 1.0, 0.5, 0.5)));
-  scene->addItem(cabin_rect);
-
-  QList<QGraphicsItem*> items;
-  items.append(cabin_rect);
+  group->addToGroup(cabin_rect);
 
   if (!name.empty())
   {
     QFont font("Helvetica");
     font.setPointSize(0.2 / meters_per_pixel);
-    QGraphicsSimpleTextItem* text_item = scene->addSimpleText(
-      QString::fromStdString(name), font);
+    QGraphicsSimpleTextItem* text_item = new QGraphicsSimpleTextItem(
+      QString::fromStdString(name));
+    text_item->setFont(font);
     text_item->setBrush(QColor(255, 0, 0, 255));
     text_item->setPos(-cabin_w / 3.0, 0.0);
 
     // todo: set font size to something reasonable
     // todo: center-align text?
-    items.append(text_item);
+    group->addToGroup(text_item);
   }
 
   if (it != level_doors.end())
@@ -208,17 +231,64 @@ void Lift::draw(
       door_item->setPen(door_pen);
       door_item->setBrush(QBrush(QColor::fromRgbF(1.0, 0.0, 0.0, 0.5)));
 
-      items.append(door_item);
+      group->addToGroup(door_item);
     }
   }
 
-  QGraphicsItemGroup* group = scene->createItemGroup(items);
-
   if (apply_transformation)
   {
     group->setRotation(-180.0 / 3.1415926 * yaw);
     group->setPos(x * scale + translate_x, y * scale + translate_y);
   }
+  return group;
+}
+
+std::size_t Lift::graphics_signature(
+  const double meters_per_pixel,
+  const string& level_name,
+  const double elevation,
+  const double scale,
+  const double translate_x,
+  const double translate_y) const
+{
+  std::size_t h = doors.size();
+  auto mix = [&h](const std::size_t v)
+    {
+      h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    };
+  const std::hash<double> hash_double;
+  const std::hash<string> hash_string;
+
+  mix(hash_double(meters_per_pixel));
+  mix(hash_string(level_name));
+  mix(hash_double(scale));
+  mix(hash_double(translate_x));
+  mix(hash_double(translate_y));
+  mix(elevation > highest_elevation || elevation < lowest_elevation);
+
+  mix(hash_string(name));
+  mix(hash_double(x));
+  mix(hash_double(y));
+  mix(hash_double(yaw));
+  mix(hash_double(width));
+  mix(hash_double(depth));
+  for (const LiftDoor& door : doors)
+  {
+    mix(hash_string(door.name));
+    mix(hash_double(door.x));
+    mix(hash_double(door.y));
+    mix(hash_double(door.width));
+    mix(hash_double(door.motion_axis_orientation));
+  }
+
+  const auto it = level_doors.find(level_name);
+  mix(it != level_doors.end());
+  if (it != level_doors.end())
+  {
+    for (const string& door_name : it->second)
+      mix(hash_string(door_name));
+  }
+  return h;
 }
 
 bool Lift::level_door_opens(
@@ -18,6 +18,7 @@
 #ifndef LIFT_H
 #define LIFT_H
 
+class QGraphicsItemGroup;
 class QGraphicsScene;
 class QGraphicsView;
 
@@ -94,6 +95,27 @@ public:
     const double translate_x = 0.0,
     const double translate_y = 0.0) const;
 
+  /// The graphics draw() adds to the scene, as one group that isn't in
+  /// any scene yet, or nullptr if the lift doesn't reach this elevation.
+  QGraphicsItemGroup* create_graphics(
+    const double meters_per_pixel,
+    const std::string& level_name,
+    const double elevation,
+    const bool apply_transformation = true,
+    const double scale = 1.0,
+    const double translate_x = 0.0,
+    const double translate_y = 0.0) const;
+
+  /// Hash of everything create_graphics() depends on for these arguments,
+  /// so cached graphics can be reused for as long as it doesn't change.
+  std::size_t graphics_signature(
+    const double meters_per_pixel,
+    const std::string& level_name,
+    const double elevation,
+    const double scale,
+    const double translate_x,
+    const double translate_y) const;
+
   bool level_door_opens(
     const std::string& level_name,
     const std::string& door_name,
@@ -422,6 +422,11 @@ void LiftDialog::update_lift_wps()
   const QPointF from_point = QPointF(_lift.x, _lift.y);
   QPointF to_point;
 
+  // resolve the level lookups and transforms once, not once per level
+  const Building::TransformTable transforms = _building.transform_table();
+  const int reference_level_idx =
+    _building.find_level_idx(_lift.reference_floor_name);
+
   bool found = false;
   for (std::size_t level_idx = 0; level_idx < _level_names.size(); level_idx++)
   {
@@ -430,28 +435,23 @@ void LiftDialog::update_lift_wps()
     // a door opening on that level)
     if (_lift.level_doors[level_name].size() != 0)
     {
-      _building.transform_between_levels(
-        _lift.reference_floor_name,
-        from_point,
-        _building.levels[level_idx].name,
-        to_point);
+      const Building::Transform t =
+        transforms.get(reference_level_idx, level_idx);
+      Building::apply_transform(t, &from_point, &to_point, 1);
+      Level& level = _building.levels[level_idx];
       found = false;
 
-      for (auto& v : _building.levels[level_idx].vertices)
+      for (const int vertex_idx :
+        level.vertices_with_param("lift_cabin", _lift.name))
       {
-        auto it = v.params.find("lift_cabin");
-        if ((it != v.params.end()) && (it->second.value_string == _lift.name))
-        {
-          v.x = to_point.x();
-          v.y = to_point.y();
-          found = true;
-        }
+        level.move_vertex(vertex_idx, to_point.x(), to_point.y());
+        found = true;
       }
       if (!found)
       {
         _building.add_vertex(level_idx, to_point.x(), to_point.y());
-        _building.levels[level_idx].vertices.back().params["lift_cabin"] =
-          _lift.name;
+        level.vertices.back().params["lift_cabin"] = _lift.name;
+        level.vertices_changed();
       }
     }
   }
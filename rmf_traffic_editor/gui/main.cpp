@@ -15,6 +15,7 @@
  *
 */
 
+#include <cstring>
 #include <string>
 
 #include <QSettings>
@@ -23,13 +24,27 @@
 #include "glog/logging.h"
 
 #include "editor.h"
+#include "headless.h"
 #include "preferences_keys.h"
+#include "sim_runner.h"
 
 
 int main(int argc, char* argv[])
 {
   google::InitGoogleLogging(argv[0]);  // used later by Ceres
 
+  // batch and simulation modes never open a window, so they must not need
+  // a display either. This has to be decided before the QApplication is
+  // constructed.
+  bool batch = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--batch") || !strcmp(argv[i], "--simulate"))
+      batch = true;
+  }
+  if (batch && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
   QApplication app(argc, argv);
   app.setOrganizationName("open-robotics");
   app.setOrganizationDomain("openrobotics.org");
@@ -38,8 +53,90 @@ int main(int argc, char* argv[])
   QCommandLineParser parser;
   parser.addHelpOption();
   parser.addPositionalArgument("[building]", "Building YAML file to open");
+
+  QCommandLineOption batch_option(
+    "batch",
+    "Load and validate the given building files without opening the "
+    "editor, then exit.");
+  parser.addOption(batch_option);
+
+  QCommandLineOption save_option(
+    "save",
+    "In batch mode, re-save each building that passes validation.");
+  parser.addOption(save_option);
+
+  QCommandLineOption jobs_option(
+    QStringList() << "j" << "jobs",
+    "In batch or simulation mode, the number of files to process in "
+    "parallel.",
+    "count",
+    "0");
+  parser.addOption(jobs_option);
+
+  QCommandLineOption simulate_option(
+    "simulate",
+    "Run the simulation plugins over each of the given building files "
+    "without opening the editor, then exit.");
+  parser.addOption(simulate_option);
+
+  QCommandLineOption plugin_option(
+    "plugin",
+    "In simulation mode, a simulation plugin library to load. Can be "
+    "given more than once. Defaults to every plugin on the search path.",
+    "path");
+  parser.addOption(plugin_option);
+
+  QCommandLineOption duration_option(
+    "duration",
+    "In simulation mode, the simulated time to run each building for.",
+    "seconds",
+    "60");
+  parser.addOption(duration_option);
+
+  QCommandLineOption speed_option(
+    "speed",
+    "In simulation mode, how many times faster than realtime to run. "
+    "Zero runs as fast as possible.",
+    "factor",
+    "0");
+  parser.addOption(speed_option);
+
+  QCommandLineOption log_dir_option(
+    "log-dir",
+    "In simulation mode, write the trajectories and tick latencies of "
+    "each building to a binary log in this directory.",
+    "directory");
+  parser.addOption(log_dir_option);
+
+  QCommandLineOption log_every_option(
+    "log-every",
+    "In simulation mode, the number of ticks between logged frames.",
+    "ticks",
+    "10");
+  parser.addOption(log_every_option);
+
   parser.process(QCoreApplication::arguments());
 
+  if (parser.isSet(batch_option))
+  {
+    HeadlessOptions options;
+    options.save = parser.isSet(save_option);
+    options.num_threads = parser.value(jobs_option).toInt();
+    return run_headless(parser.positionalArguments(), options);
+  }
+
+  if (parser.isSet(simulate_option))
+  {
+    SimRunOptions options;
+    options.plugin_paths = parser.values(plugin_option);
+    options.duration = parser.value(duration_option).toDouble();
+    options.speed = parser.value(speed_option).toDouble();
+    options.num_threads = parser.value(jobs_option).toInt();
+    options.log_dir = parser.value(log_dir_option);
+    options.log_every = parser.value(log_every_option).toInt();
+    return run_simulations(parser.positionalArguments(), options);
+  }
+
   Editor editor;
   QSettings settings;
 
@@ -208,8 +208,7 @@ void Model::draw(
     pixmap_item->setZValue(100.0);  // just anything taller than 0
   }
 
-  pixmap_item->setPos(state.x, state.y);
-  pixmap_item->setRotation((-state.yaw + M_PI / 2.0) * 180.0 / M_PI);
+  set_scene_pose(state);
 
   // make the model "glow" if it is selected
   if (selected)
@@ -221,6 +220,14 @@ void Model::draw(
   }
 }
 
+void Model::set_scene_pose(const ModelState& pose)
+{
+  if (pixmap_item == nullptr)
+    return;
+  pixmap_item->setPos(pose.x, pose.y);
+  pixmap_item->setRotation((-pose.yaw + M_PI / 2.0) * 180.0 / M_PI);
+}
+
 void Model::clear_scene()
 {
   pixmap_item = nullptr;
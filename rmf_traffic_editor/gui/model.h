@@ -65,6 +65,10 @@ public:
     std::vector<EditorModel>& editor_models,
     const double meters_per_pixel);
 
+  /// Move the model's scene item to `pose` without changing `state`, to
+  /// show where a simulation has taken it. Does nothing until draw().
+  void set_scene_pose(const ModelState& pose);
+
   void clear_scene();
 };
 
@@ -0,0 +1,525 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+
+#include <QGraphicsEllipseItem>
+#include <QGraphicsLineItem>
+#include <QGraphicsScene>
+#include <QPen>
+
+#include "building.h"
+#include "nav_graph.h"
+
+using std::string;
+using std::vector;
+
+constexpr double NavGraph::lift_transfer_cost;
+
+
+void NavGraph::build_level(const Level& level, LevelGraph& graph)
+{
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  graph.x.resize(num_vertices);
+  graph.y.resize(num_vertices);
+  graph.lift_vertices.clear();
+  for (int i = 0; i < num_vertices; i++)
+  {
+    const Vertex& v = level.vertices[i];
+    graph.x[i] = v.x;
+    graph.y[i] = v.y;
+    auto it = v.params.find("lift_cabin");
+    if (it != v.params.end() && !it->second.value_string().empty())
+      graph.lift_vertices.push_back(
+        std::make_pair(i, it->second.value_string()));
+  }
+
+  // count the arcs leaving each vertex, then fill them in
+  graph.offsets.assign(num_vertices + 1, 0);
+  auto for_each_arc = [&](auto f)
+    {
+      for (std::size_t i = 0; i < level.edges.size(); i++)
+      {
+        const Edge& e = level.edges[i];
+        if (e.type != Edge::LANE && e.type != Edge::HUMAN_LANE)
+          continue;
+        if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+          e.end_idx < 0 || e.end_idx >= num_vertices)
+          continue;
+        const int key =
+          graph_key(e.type == Edge::HUMAN_LANE, e.get_graph_idx());
+        const int edge_idx = static_cast<int>(i);
+        f(e.start_idx, e.end_idx, key, edge_idx);
+        if (e.is_bidirectional())
+          f(e.end_idx, e.start_idx, key, edge_idx);
+      }
+    };
+
+  for_each_arc(
+    [&](const int from, const int, const int, const int)
+    {
+      graph.offsets[from + 1]++;
+    });
+  for (int i = 0; i < num_vertices; i++)
+    graph.offsets[i + 1] += graph.offsets[i];
+
+  const int num_arcs = graph.offsets[num_vertices];
+  graph.targets.resize(num_arcs);
+  graph.edges.resize(num_arcs);
+  graph.graph_keys.resize(num_arcs);
+  vector<int> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+  for_each_arc(
+    [&](const int from, const int to, const int key, const int edge_idx)
+    {
+      const int arc = fill[from]++;
+      graph.targets[arc] = to;
+      graph.edges[arc] = edge_idx;
+      graph.graph_keys[arc] = key;
+    });
+}
+
+bool NavGraph::update(Building& building)
+{
+  bool changed = false;
+  const int num_levels = static_cast<int>(building.levels.size());
+  level_graphs.resize(num_levels);
+  for (int i = 0; i < num_levels; i++)
+  {
+    LevelGraph& graph = level_graphs[i];
+    const std::size_t fp = building.levels[i].lane_graph_fingerprint();
+    if (!graph.valid || graph.fingerprint != fp)
+    {
+      build_level(building.levels[i], graph);
+      graph.fingerprint = fp;
+      graph.valid = true;
+      changed = true;
+    }
+  }
+
+  // Node positions go in the reference frame, in meters, so one straight
+  // line heuristic works on every level. Transforms can change without
+  // any lane changing, so this is redone every time.
+  node_base.resize(num_levels + 1);
+  node_base[0] = 0;
+  for (int i = 0; i < num_levels; i++)
+    node_base[i + 1] =
+      node_base[i] + static_cast<int>(level_graphs[i].x.size());
+  const int num_nodes = node_base[num_levels];
+  node_x.resize(num_nodes);
+  node_y.resize(num_nodes);
+  node_level.resize(num_nodes);
+  for (int i = 0; i < num_levels; i++)
+    std::fill(
+      node_level.begin() + node_base[i],
+      node_level.begin() + node_base[i + 1],
+      i);
+
+  if (num_levels > 0)
+  {
+    const Building::TransformTable transforms = building.transform_table();
+    const int ref_idx = building.get_reference_level_idx();
+    const double ref_meters_per_pixel =
+      building.levels[ref_idx].drawing_meters_per_pixel;
+    for (int i = 0; i < num_levels; i++)
+    {
+      const Building::Transform t = transforms.get(i, ref_idx);
+      const LevelGraph& graph = level_graphs[i];
+      double* x = node_x.data() + node_base[i];
+      double* y = node_y.data() + node_base[i];
+      for (std::size_t j = 0; j < graph.x.size(); j++)
+      {
+        x[j] = (t.scale * graph.x[j] + t.dx) * ref_meters_per_pixel;
+        y[j] = (t.scale * graph.y[j] + t.dy) * ref_meters_per_pixel;
+      }
+    }
+  }
+
+  node_lift.assign(num_nodes, -1);
+  lift_nodes.clear();
+  std::map<string, int> lift_indices;
+  for (int i = 0; i < num_levels; i++)
+  {
+    for (const auto& lift_vertex : level_graphs[i].lift_vertices)
+    {
+      auto it = lift_indices.find(lift_vertex.second);
+      if (it == lift_indices.end())
+      {
+        it = lift_indices.emplace(
+          lift_vertex.second, static_cast<int>(lift_nodes.size())).first;
+        lift_nodes.emplace_back();
+      }
+      const int node = node_base[i] + lift_vertex.first;
+      node_lift[node] = it->second;
+      lift_nodes[it->second].push_back(node);
+    }
+  }
+
+  return changed;
+}
+
+void NavGraph::clear()
+{
+  level_graphs.clear();
+  node_base.clear();
+  node_x.clear();
+  node_y.clear();
+  node_level.clear();
+  node_lift.clear();
+  lift_nodes.clear();
+  workspace = Workspace();
+}
+
+int NavGraph::node_index(const Node& node) const
+{
+  if (node.level_idx < 0 ||
+    node.level_idx >= static_cast<int>(level_graphs.size()))
+    return -1;
+  const int num_vertices =
+    node_base[node.level_idx + 1] - node_base[node.level_idx];
+  if (node.vertex_idx < 0 || node.vertex_idx >= num_vertices)
+    return -1;
+  return node_base[node.level_idx] + node.vertex_idx;
+}
+
+NavGraph::Node NavGraph::node_at(const int node_idx) const
+{
+  Node node;
+  node.level_idx = node_level[node_idx];
+  node.vertex_idx = node_idx - node_base[node.level_idx];
+  return node;
+}
+
+template<typename Heuristic, typename Done>
+void NavGraph::search(
+  const int start_node,
+  const int key,
+  Workspace& ws,
+  const Heuristic& heuristic,
+  const Done& done,
+  int& num_expanded) const
+{
+  const std::size_t num_nodes = node_x.size();
+  if (ws.cost.size() != num_nodes)
+  {
+    ws.cost.resize(num_nodes);
+    ws.came_from.resize(num_nodes);
+    ws.came_by.resize(num_nodes);
+    ws.stamp.assign(num_nodes, 0);
+    ws.closed.assign(num_nodes, 0);
+    ws.current_stamp = 0;
+  }
+  if (++ws.current_stamp == 0)
+  {
+    // the stamp wrapped around, so old entries could look current
+    std::fill(ws.stamp.begin(), ws.stamp.end(), 0);
+    std::fill(ws.closed.begin(), ws.closed.end(), 0);
+    ws.current_stamp = 1;
+  }
+  const std::uint32_t current = ws.current_stamp;
+
+  auto distance = [&](const int a, const int b)
+    {
+      return std::hypot(node_x[a] - node_x[b], node_y[a] - node_y[b]);
+    };
+
+  typedef std::pair<double, int> QueueEntry;  // (estimated total cost, node)
+  std::priority_queue<
+    QueueEntry,
+    vector<QueueEntry>,
+    std::greater<QueueEntry>> queue;
+
+  auto relax = [&](
+    const int from,
+    const int to,
+    const int edge_idx,
+    const double arc_cost)
+    {
+      if (ws.closed[to] == current)
+        return;
+      const double to_cost = ws.cost[from] + arc_cost;
+      if (ws.stamp[to] == current && ws.cost[to] <= to_cost)
+        return;
+      const double h = heuristic(to);
+      if (h == std::numeric_limits<double>::infinity())
+        return;
+      ws.stamp[to] = current;
+      ws.cost[to] = to_cost;
+      ws.came_from[to] = from;
+      ws.came_by[to] = edge_idx;
+      queue.push(QueueEntry(to_cost + h, to));
+    };
+
+  ws.stamp[start_node] = current;
+  ws.cost[start_node] = 0.0;
+  ws.came_from[start_node] = -1;
+  ws.came_by[start_node] = -1;
+  queue.push(QueueEntry(heuristic(start_node), start_node));
+
+  while (!queue.empty())
+  {
+    const int n = queue.top().second;
+    queue.pop();
+    if (ws.closed[n] == current)
+      continue;  // a stale entry; this node was reached more cheaply
+    ws.closed[n] = current;
+    num_expanded++;
+    if (done(n))
+      break;
+
+    const int level_idx = node_level[n];
+    const LevelGraph& graph = level_graphs[level_idx];
+    const int base = node_base[level_idx];
+    const int vertex_idx = n - base;
+    for (int arc = graph.offsets[vertex_idx];
+      arc < graph.offsets[vertex_idx + 1]; arc++)
+    {
+      if (graph.graph_keys[arc] != key)
+        continue;
+      const int to = base + graph.targets[arc];
+      relax(n, to, graph.edges[arc], distance(n, to));
+    }
+
+    // Lift cabin waypoints don't line up perfectly between levels, so the
+    // horizontal offset is charged too. That also keeps the A* heuristic
+    // from ever overestimating.
+    if (node_lift[n] >= 0)
+    {
+      for (const int to : lift_nodes[node_lift[n]])
+      {
+        if (node_level[to] != level_idx)
+          relax(n, to, -1, distance(n, to) + lift_transfer_cost);
+      }
+    }
+  }
+}
+
+NavGraph::Route NavGraph::trace_route(
+  const int goal_node,
+  const Workspace& ws) const
+{
+  Route route;
+  if (ws.closed[goal_node] != ws.current_stamp)
+    return route;
+
+  route.found = true;
+  route.length = ws.cost[goal_node];
+  for (int n = goal_node; n >= 0; n = ws.came_from[n])
+  {
+    route.nodes.push_back(node_at(n));
+    route.costs.push_back(ws.cost[n]);
+    if (ws.came_from[n] >= 0)
+      route.edges.push_back(ws.came_by[n]);
+  }
+  std::reverse(route.nodes.begin(), route.nodes.end());
+  std::reverse(route.costs.begin(), route.costs.end());
+  std::reverse(route.edges.begin(), route.edges.end());
+  return route;
+}
+
+NavGraph::Route NavGraph::find_route(
+  const Node& start,
+  const Node& goal,
+  const bool human_lanes,
+  const int graph_idx) const
+{
+  return find_route(start, goal, human_lanes, graph_idx, workspace);
+}
+
+NavGraph::Route NavGraph::find_route(
+  const Node& start,
+  const Node& goal,
+  const bool human_lanes,
+  const int graph_idx,
+  Workspace& ws) const
+{
+  const int start_node = node_index(start);
+  const int goal_node = node_index(goal);
+  if (start_node < 0 || goal_node < 0)
+    return Route();
+
+  const int goal_level = goal.level_idx;
+  const double goal_x = node_x[goal_node];
+  const double goal_y = node_y[goal_node];
+
+  // A route from another level has to reach a lift cabin on its own level
+  // first, then pay at least the transfer cost. Charging that (rather than
+  // just the straight line to the goal) keeps cross-level searches from
+  // flooding the start level. With no cabin at all, the goal is out of
+  // reach. It is still a consistent heuristic, so the first time a node
+  // is expanded it has its final cost.
+  struct Cabin
+  {
+    int node;
+    double to_goal;
+  };
+  vector<vector<Cabin>> level_cabins(level_graphs.size());
+  for (const vector<int>& cabins : lift_nodes)
+  {
+    for (const int c : cabins)
+    {
+      if (node_level[c] != goal_level)
+        level_cabins[node_level[c]].push_back(
+          Cabin{c, std::hypot(node_x[c] - goal_x, node_y[c] - goal_y)});
+    }
+  }
+
+  auto heuristic = [&](const int n)
+    {
+      if (node_level[n] == goal_level)
+        return std::hypot(node_x[n] - goal_x, node_y[n] - goal_y);
+      double h = std::numeric_limits<double>::infinity();
+      for (const Cabin& cabin : level_cabins[node_level[n]])
+        h = std::min(
+          h,
+          std::hypot(
+            node_x[n] - node_x[cabin.node],
+            node_y[n] - node_y[cabin.node]) + cabin.to_goal);
+      return h + lift_transfer_cost;
+    };
+
+  int num_expanded = 0;
+  search(
+    start_node,
+    graph_key(human_lanes, graph_idx),
+    ws,
+    heuristic,
+    [goal_node](const int n) { return n == goal_node; },
+    num_expanded);
+
+  Route route = trace_route(goal_node, ws);
+  route.num_expanded = num_expanded;
+  return route;
+}
+
+void NavGraph::find_routes(
+  const Node& start,
+  const vector<Node>& goals,
+  const bool human_lanes,
+  const int graph_idx,
+  Workspace& ws,
+  vector<Route>& routes) const
+{
+  routes.assign(goals.size(), Route());
+  const int start_node = node_index(start);
+  if (start_node < 0)
+    return;
+
+  // stop as soon as every goal has been reached
+  vector<int> goal_nodes;
+  goal_nodes.reserve(goals.size());
+  for (const Node& goal : goals)
+  {
+    const int goal_node = node_index(goal);
+    if (goal_node >= 0)
+      goal_nodes.push_back(goal_node);
+  }
+  std::sort(goal_nodes.begin(), goal_nodes.end());
+  goal_nodes.erase(
+    std::unique(goal_nodes.begin(), goal_nodes.end()),
+    goal_nodes.end());
+  std::size_t num_remaining = goal_nodes.size();
+
+  int num_expanded = 0;
+  search(
+    start_node,
+    graph_key(human_lanes, graph_idx),
+    ws,
+    [](const int) { return 0.0; },
+    [&](const int n)
+    {
+      if (std::binary_search(goal_nodes.begin(), goal_nodes.end(), n))
+        num_remaining--;
+      return num_remaining == 0;
+    },
+    num_expanded);
+
+  for (std::size_t i = 0; i < goals.size(); i++)
+  {
+    const int goal_node = node_index(goals[i]);
+    if (goal_node < 0)
+      continue;
+    routes[i] = trace_route(goal_node, ws);
+    routes[i].num_expanded = num_expanded;
+  }
+}
+
+void NavGraph::draw_route(
+  QGraphicsScene* scene,
+  const Route& route,
+  const Level& level,
+  const int level_idx)
+{
+  if (!route.found)
+    return;
+
+  const double radius = 0.4 / level.drawing_meters_per_pixel;
+  const QColor color = QColor::fromRgbF(0.0, 0.6, 1.0, 0.8);
+  const QPen route_pen(color, radius / 2.0, Qt::SolidLine, Qt::RoundCap);
+  const QPen marker_pen(color, radius / 4.0);
+  const QBrush marker_brush(QColor::fromRgbF(0.0, 0.6, 1.0, 0.3));
+  const int num_vertices = static_cast<int>(level.vertices.size());
+
+  auto on_level = [&](const Node& node)
+    {
+      return node.level_idx == level_idx &&
+        node.vertex_idx >= 0 && node.vertex_idx < num_vertices;
+    };
+  auto add_marker = [&](const Node& node, const QString& tooltip)
+    {
+      const Vertex& v = level.vertices[node.vertex_idx];
+      QGraphicsEllipseItem* item = scene->addEllipse(
+        v.x - radius,
+        v.y - radius,
+        2 * radius,
+        2 * radius,
+        marker_pen,
+        marker_brush);
+      item->setToolTip(tooltip);
+      item->setZValue(260.0);
+    };
+
+  const QString summary = QString("route: %1 m").arg(route.length, 0, 'f', 1);
+  for (std::size_t i = 0; i < route.nodes.size(); i++)
+  {
+    const Node& node = route.nodes[i];
+    if (!on_level(node))
+      continue;
+
+    if (i == 0)
+      add_marker(node, "route start; " + summary);
+    else if (i + 1 == route.nodes.size())
+      add_marker(node, "route goal; " + summary);
+    else if (route.nodes[i - 1].level_idx != level_idx ||
+      route.nodes[i + 1].level_idx != level_idx)
+      add_marker(node, "route changes levels here; " + summary);
+
+    if (i + 1 < route.nodes.size() && on_level(route.nodes[i + 1]))
+    {
+      const Vertex& start = level.vertices[node.vertex_idx];
+      const Vertex& end = level.vertices[route.nodes[i + 1].vertex_idx];
+      QGraphicsLineItem* item = scene->addLine(
+        start.x, start.y, end.x, end.y, route_pen);
+      item->setToolTip(summary);
+      item->setZValue(259.0);
+    }
+  }
+}
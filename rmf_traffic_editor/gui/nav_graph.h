@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef NAV_GRAPH_H
+#define NAV_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Building;
+class Level;
+class QGraphicsScene;
+
+
+/// A compact, read-only snapshot of the lane graphs of a building, for
+/// answering shortest-route queries fast enough to run on every redraw.
+///
+/// Each level's lanes are stored as a compressed-sparse-row adjacency
+/// list over its vertices, tagged with the graph they belong to, so one
+/// snapshot serves every graph. Cabin waypoints of the same lift are
+/// linked across levels. update() only rebuilds the levels whose lanes
+/// changed since the last call; the rest of its work is a linear pass
+/// over the vertices.
+class NavGraph
+{
+public:
+  /// A vertex of some level
+  struct Node
+  {
+    int level_idx = -1;
+    int vertex_idx = -1;
+
+    bool is_valid() const { return level_idx >= 0 && vertex_idx >= 0; }
+  };
+
+  struct Route
+  {
+    bool found = false;
+    std::vector<Node> nodes;  // from start to goal, inclusive
+    std::vector<double> costs;  // cost of reaching each of the nodes
+    // for each step nodes[i] -> nodes[i + 1], the index of the lane in
+    // its level's edges, or -1 for a lift ride
+    std::vector<int> edges;
+    double length = 0.0;  // meters, including lift transfer costs
+    int num_expanded = 0;  // nodes the search had to expand
+  };
+
+  /// Scratch space for searches. A default-constructed one is sized on
+  /// first use. Threads searching the same NavGraph concurrently each
+  /// need their own.
+  class Workspace
+  {
+  private:
+    friend class NavGraph;
+
+    // entries only count when their stamp matches the current search's
+    std::vector<double> cost;
+    std::vector<int> came_from;
+    std::vector<int> came_by;  // edge index, or -1 for a lift ride
+    std::vector<std::uint32_t> stamp;  // cost is set
+    std::vector<std::uint32_t> closed;  // expanded, cost is final
+    std::uint32_t current_stamp = 0;
+  };
+
+  /// Added to the cost of riding a lift, in meters, so routes only change
+  /// levels when they have to
+  static constexpr double lift_transfer_cost = 10.0;
+
+  /// Bring the snapshot up to date with the building. Returns true if
+  /// any level had to be rebuilt.
+  bool update(Building& building);
+
+  /// Drop everything, so the next update() rebuilds every level
+  void clear();
+
+  /// A* search over one graph, using the straight-line distance in the
+  /// reference level's frame as the heuristic. This overload uses a
+  /// workspace kept in the NavGraph, so it is not reentrant.
+  Route find_route(
+    const Node& start,
+    const Node& goal,
+    const bool human_lanes,
+    const int graph_idx) const;
+
+  Route find_route(
+    const Node& start,
+    const Node& goal,
+    const bool human_lanes,
+    const int graph_idx,
+    Workspace& workspace) const;
+
+  /// Dijkstra search from one start to many goals at once, which is much
+  /// cheaper than one A* search per goal when there are many. `routes` is
+  /// resized to match `goals`. Safe to call from several threads at once,
+  /// each with its own workspace.
+  void find_routes(
+    const Node& start,
+    const std::vector<Node>& goals,
+    const bool human_lanes,
+    const int graph_idx,
+    Workspace& workspace,
+    std::vector<Route>& routes) const;
+
+  /// Draw the part of a route that lies on one level, along with markers
+  /// where it starts, ends and changes levels
+  static void draw_route(
+    QGraphicsScene* scene,
+    const Route& route,
+    const Level& level,
+    const int level_idx);
+
+  std::size_t num_nodes() const { return node_x.size(); }
+
+private:
+  struct LevelGraph
+  {
+    std::size_t fingerprint = 0;
+    bool valid = false;
+
+    // CSR adjacency: the lanes leaving vertex v lead to
+    // targets[offsets[v]] ... targets[offsets[v + 1] - 1]
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> edges;  // index of each arc's lane in Level::edges
+    std::vector<int> graph_keys;  // see graph_key()
+
+    std::vector<double> x, y;  // vertex positions, in level pixels
+    std::vector<std::pair<int, std::string>> lift_vertices;
+  };
+
+  std::vector<LevelGraph> level_graphs;
+
+  // Everything below is rebuilt by every update(). Nodes are numbered
+  // level by level: node_base[level_idx] + vertex_idx
+  std::vector<int> node_base;
+  std::vector<double> node_x, node_y;  // meters, in the reference frame
+  std::vector<int> node_level;
+  std::vector<int> node_lift;  // index into lift_nodes, or -1
+  std::vector<std::vector<int>> lift_nodes;  // cabin waypoints of each lift
+
+  mutable Workspace workspace;
+
+  static int graph_key(const bool human_lanes, const int graph_idx)
+  {
+    return graph_idx * 2 + (human_lanes ? 1 : 0);
+  }
+
+  static void build_level(const Level& level, LevelGraph& graph);
+
+  int node_index(const Node& node) const;
+  Node node_at(const int node_idx) const;
+
+  /// Best-first search from start_node; `done` is called with each node
+  /// as it is expanded and returns true to stop the search.
+  template<typename Heuristic, typename Done>
+  void search(
+    const int start_node,
+    const int key,
+    Workspace& ws,
+    const Heuristic& heuristic,
+    const Done& done,
+    int& num_expanded) const;
+
+  Route trace_route(const int goal_node, const Workspace& ws) const;
+};
+
+#endif
@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include <QGraphicsPathItem>
+#include <QGraphicsScene>
+#include <QPainterPath>
+#include <QPen>
+
+#include "building.h"
+#include "navmesh_preview.h"
+
+using std::size_t;
+using std::vector;
+
+namespace {
+
+// Both of these are in meters, and match building_crowdsim's generator.
+// Where only two lanes meet, the hub polygon is padded out along them so
+// it isn't degenerate.
+const double hub_padding = 0.01;
+// Lanes run this far past a dead end, so agents can reach a goal on it.
+const double dead_end_extension = 0.1;
+
+// a lane leaving a vertex
+struct Spoke
+{
+  int edge_idx;
+  int other_idx;  // vertex at the other end
+  double width;  // pixels
+  QPointF dir;  // unit vector toward the other end
+  double angle;
+};
+
+double dot(const QPointF& a, const QPointF& b)
+{
+  return a.x() * b.x() + a.y() * b.y();
+}
+
+double cross(const QPointF& a, const QPointF& b)
+{
+  return a.x() * b.y() - a.y() * b.x();
+}
+
+QPointF normal(const QPointF& d)
+{
+  return QPointF(-d.y(), d.x());
+}
+
+// Where the edges of two lanes leaving p meet, in the area swept going
+// from d0 to d1 in the direction of increasing angle
+QPointF corner(
+  const QPointF& p,
+  const QPointF& d0,
+  const double w0,
+  const QPointF& d1,
+  const double w1)
+{
+  const double sin0 = dot(d0, normal(d1));
+  if (std::abs(sin0) < 0.05)
+  {
+    // nearly parallel: split the difference of the two widths
+    return p + 0.25 * (w0 + w1) * normal(d0);
+  }
+  const double a0 = 0.5 * w1 / std::abs(sin0);
+  const double a1 = 0.5 * w0 / std::abs(dot(d1, normal(d0)));
+  const QPointF c = a0 * d0 + a1 * d1;
+  return cross(d0, d1) < 0 ? p - c : p + c;
+}
+
+}  // namespace
+
+size_t NavmeshPreview::update(const Building& building, const int _level_idx)
+{
+  if (_level_idx != level_idx)
+  {
+    clear();
+    level_idx = _level_idx;
+  }
+  if (level_idx < 0 || level_idx >= static_cast<int>(building.levels.size()))
+  {
+    meshes.clear();
+    return 0;
+  }
+
+  const Level& level = building.levels[level_idx];
+  const int num_vertices = static_cast<int>(level.vertices.size());
+  const size_t num_edges = level.edges.size();
+  const double meters_per_pixel = level.drawing_meters_per_pixel;
+
+  // the human lanes of each graph, skipping any that have no direction
+  std::map<int, vector<int>> graph_edges;
+  for (size_t i = 0; i < num_edges; i++)
+  {
+    const Edge& e = level.edges[i];
+    if (e.type != Edge::HUMAN_LANE ||
+      e.start_idx < 0 || e.start_idx >= num_vertices ||
+      e.end_idx < 0 || e.end_idx >= num_vertices)
+      continue;
+    const Vertex& a = level.vertices[e.start_idx];
+    const Vertex& b = level.vertices[e.end_idx];
+    if (a.x == b.x && a.y == b.y)
+      continue;
+    graph_edges[e.get_graph_idx()].push_back(static_cast<int>(i));
+  }
+
+  for (auto it = meshes.begin(); it != meshes.end(); )
+  {
+    if (graph_edges.count(it->first))
+      ++it;
+    else
+      it = meshes.erase(it);
+  }
+
+  const std::hash<double> hash_double;
+  size_t num_regenerated = 0;
+  vector<int> offsets;
+  vector<Spoke> spokes;
+  vector<char> dirty;
+  vector<char> in_graph;
+
+  for (const auto& graph : graph_edges)
+  {
+    // the same lane width rules as Level::draw_lane()
+    double default_width = -1.0;
+    for (const Graph& g : building.graphs)
+    {
+      if (g.idx == graph.first)
+      {
+        default_width = g.default_lane_width;
+        break;
+      }
+    }
+
+    // the spokes around each vertex, grouped by vertex
+    offsets.assign(num_vertices + 1, 0);
+    for (const int edge_idx : graph.second)
+    {
+      const Edge& e = level.edges[edge_idx];
+      offsets[e.start_idx + 1]++;
+      offsets[e.end_idx + 1]++;
+    }
+    for (int v = 0; v < num_vertices; v++)
+      offsets[v + 1] += offsets[v];
+
+    spokes.resize(offsets[num_vertices]);
+    vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (const int edge_idx : graph.second)
+    {
+      const Edge& e = level.edges[edge_idx];
+      double width_meters = 1.0;
+      if (e.get_width() > 0)
+        width_meters = e.get_width();
+      else if (default_width > 0)
+        width_meters = default_width;
+      const double width = width_meters / meters_per_pixel;
+
+      spokes[fill[e.start_idx]++] = {edge_idx, e.end_idx, width, {}, 0.0};
+      spokes[fill[e.end_idx]++] = {edge_idx, e.start_idx, width, {}, 0.0};
+    }
+
+    Mesh& mesh = meshes[graph.first];
+    mesh.hubs.resize(num_vertices);
+    mesh.lanes.resize(num_edges);
+    dirty.assign(num_vertices, 0);
+
+    for (int v = 0; v < num_vertices; v++)
+    {
+      Hub& hub = mesh.hubs[v];
+      if (offsets[v] == offsets[v + 1])
+      {
+        if (!hub.lanes.empty())
+        {
+          hub = Hub();
+          dirty[v] = 1;
+        }
+        continue;
+      }
+
+      // everything this hub and the lane ends around it depend on
+      const Vertex& vertex = level.vertices[v];
+      size_t h = hash_double(meters_per_pixel);
+      auto mix = [&h](const size_t x)
+        {
+          h ^= x + 0x9e3779b9 + (h << 6) + (h >> 2);
+        };
+      mix(hash_double(vertex.x));
+      mix(hash_double(vertex.y));
+      for (int i = offsets[v]; i < offsets[v + 1]; i++)
+      {
+        const Vertex& other = level.vertices[spokes[i].other_idx];
+        mix(static_cast<size_t>(spokes[i].edge_idx));
+        mix(hash_double(other.x));
+        mix(hash_double(other.y));
+        mix(hash_double(spokes[i].width));
+      }
+      if (!hub.lanes.empty() && hub.signature == h)
+        continue;
+
+      hub.signature = h;
+      dirty[v] = 1;
+
+      const QPointF p(vertex.x, vertex.y);
+      Spoke* begin = spokes.data() + offsets[v];
+      Spoke* end = spokes.data() + offsets[v + 1];
+      for (Spoke* s = begin; s != end; ++s)
+      {
+        const Vertex& other = level.vertices[s->other_idx];
+        const double dx = other.x - vertex.x;
+        const double dy = other.y - vertex.y;
+        const double len = std::sqrt(dx * dx + dy * dy);
+        s->dir = QPointF(dx / len, dy / len);
+        s->angle = std::atan2(dy, dx);
+      }
+      std::sort(
+        begin,
+        end,
+        [](const Spoke& a, const Spoke& b) { return a.angle < b.angle; });
+
+      const int k = static_cast<int>(end - begin);
+      hub.lanes.resize(k);
+      hub.left.resize(k);
+      hub.right.resize(k);
+      hub.polygon.clear();
+      for (int i = 0; i < k; i++)
+        hub.lanes[i] = begin[i].edge_idx;
+
+      if (k == 1)
+      {
+        const QPointF base =
+          p - dead_end_extension / meters_per_pixel * begin[0].dir;
+        const QPointF side = 0.5 * begin[0].width * normal(begin[0].dir);
+        hub.left[0] = base + side;
+        hub.right[0] = base - side;
+        continue;
+      }
+
+      // corners[i] lies between lane i and lane i + 1
+      num_regenerated++;
+      vector<QPointF> corners(k);
+      for (int i = 0; i < k; i++)
+      {
+        const Spoke& s0 = begin[i];
+        const Spoke& s1 = begin[(i + 1) % k];
+        corners[i] = corner(p, s0.dir, s0.width, s1.dir, s1.width);
+      }
+      for (int i = 0; i < k; i++)
+      {
+        hub.left[i] = corners[i];
+        hub.right[i] = corners[(i + k - 1) % k];
+      }
+
+      if (k == 2)
+      {
+        const double padding = hub_padding / meters_per_pixel;
+        hub.left[0] += padding * begin[0].dir;
+        hub.left[1] += padding * begin[1].dir;
+        hub.polygon << hub.right[0] << hub.left[0]
+                    << hub.right[1] << hub.left[1];
+      }
+      else
+      {
+        for (const QPointF& c : corners)
+          hub.polygon << c;
+      }
+    }
+
+    // a lane only needs rebuilding if a hub at either end was
+    in_graph.assign(num_edges, 0);
+    for (const int edge_idx : graph.second)
+      in_graph[edge_idx] = 1;
+
+    for (size_t i = 0; i < num_edges; i++)
+    {
+      QPolygonF& polygon = mesh.lanes[i];
+      if (!in_graph[i])
+      {
+        polygon.clear();
+        continue;
+      }
+      const Edge& e = level.edges[i];
+      if (!polygon.isEmpty() && !dirty[e.start_idx] && !dirty[e.end_idx])
+        continue;
+
+      // each end, as seen from that end looking along the lane
+      const Hub& a = mesh.hubs[e.start_idx];
+      const Hub& b = mesh.hubs[e.end_idx];
+      const size_t ia =
+        std::find(a.lanes.begin(), a.lanes.end(), static_cast<int>(i)) -
+        a.lanes.begin();
+      const size_t ib =
+        std::find(b.lanes.begin(), b.lanes.end(), static_cast<int>(i)) -
+        b.lanes.begin();
+      polygon.clear();
+      polygon << a.right[ia] << a.left[ia] << b.right[ib] << b.left[ib];
+      num_regenerated++;
+    }
+  }
+
+  return num_regenerated;
+}
+
+void NavmeshPreview::clear()
+{
+  level_idx = -1;
+  meshes.clear();
+}
+
+void NavmeshPreview::draw(
+  QGraphicsScene* scene,
+  const RenderingOptions& opts) const
+{
+  QPainterPath hub_path;
+  QPainterPath lane_path;
+  for (const auto& mesh : meshes)
+  {
+    const int graph_idx = mesh.first;
+    if (graph_idx >= 0 &&
+      graph_idx < static_cast<int>(opts.show_building_lanes.size()) &&
+      !opts.show_building_lanes[graph_idx])
+      continue;
+
+    for (const Hub& hub : mesh.second.hubs)
+    {
+      if (hub.polygon.isEmpty())
+        continue;
+      hub_path.addPolygon(hub.polygon);
+      hub_path.closeSubpath();
+    }
+    for (const QPolygonF& polygon : mesh.second.lanes)
+    {
+      if (polygon.isEmpty())
+        continue;
+      lane_path.addPolygon(polygon);
+      lane_path.closeSubpath();
+    }
+  }
+
+  // above the floorplan, below the lanes
+  QPen pen(QColor::fromRgbF(0.1, 0.2, 0.6, 0.6));
+  pen.setCosmetic(true);
+  QGraphicsPathItem* lane_item = scene->addPath(
+    lane_path,
+    pen,
+    QBrush(QColor::fromRgbF(0.3, 0.6, 1.0, 0.25)));
+  lane_item->setZValue(0.5);
+  QGraphicsPathItem* hub_item = scene->addPath(
+    hub_path,
+    pen,
+    QBrush(QColor::fromRgbF(1.0, 0.6, 0.2, 0.35)));
+  hub_item->setZValue(0.5);
+}
+
+size_t NavmeshPreview::num_polygons() const
+{
+  size_t n = 0;
+  for (const auto& mesh : meshes)
+  {
+    for (const Hub& hub : mesh.second.hubs)
+    {
+      if (!hub.polygon.isEmpty())
+        n++;
+    }
+    for (const QPolygonF& polygon : mesh.second.lanes)
+    {
+      if (!polygon.isEmpty())
+        n++;
+    }
+  }
+  return n;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef NAVMESH_PREVIEW_H
+#define NAVMESH_PREVIEW_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <QPointF>
+#include <QPolygonF>
+
+class Building;
+class QGraphicsScene;
+class RenderingOptions;
+
+
+/// The crowd simulation navmesh of one level, built from its human lanes
+/// the same way building_crowdsim's navmesh generator does it, so it can
+/// be seen while the lanes are drawn.
+///
+/// Each human lane graph gets its own mesh. Every vertex where two or
+/// more lanes meet becomes a hub polygon, whose corners are where the
+/// edges of neighboring lanes (offset by half their width) intersect.
+/// Every lane becomes a quad between the hub corners at its ends, or
+/// runs a little past a dead end.
+///
+/// A hub only depends on its vertex, its lanes and the vertices at their
+/// other ends, and a lane only on the hubs at its ends. update() hashes
+/// those inputs per vertex and regenerates only the hubs whose hash
+/// changed and the lanes touching them, so dragging a vertex only costs
+/// the polygons around it.
+class NavmeshPreview
+{
+public:
+  /// Bring the mesh up to date with a level of the building, starting
+  /// over if it is a different level than last time. Returns how many
+  /// polygons had to be regenerated.
+  std::size_t update(const Building& building, const int level_idx);
+
+  void clear();
+
+  /// Draw the meshes of the human lane graphs that are shown
+  void draw(QGraphicsScene* scene, const RenderingOptions& opts) const;
+
+  std::size_t num_polygons() const;
+
+private:
+  struct Hub
+  {
+    std::size_t signature = 0;
+    std::vector<int> lanes;  // edge indices, sorted by direction
+    // corners on either side of each lane where it leaves this vertex,
+    // as seen looking along the lane
+    std::vector<QPointF> left, right;
+    QPolygonF polygon;  // empty at dead ends
+  };
+
+  struct Mesh
+  {
+    std::vector<Hub> hubs;  // one per level vertex
+    std::vector<QPolygonF> lanes;  // one per level edge
+  };
+
+  int level_idx = -1;
+  std::map<int, Mesh> meshes;  // by graph_idx
+};
+
+#endif
@@ -15,80 +15,148 @@
  *
 */
 
+#include <new>
+#include <utility>
+
 #include "param.h"
 using std::string;
 
 
 Param::Param()
-: type(UNDEFINED), value_int(0), value_double(0.0), value_bool(false)
+: _type(UNDEFINED), _double(0.0)
 {
 }
 
 Param::Param(const Type& t)
-: type(t), value_int(0), value_double(0.0), value_bool(false)
+: _type(UNDEFINED), _double(0.0)
 {
+  reset(t);
 }
 
 Param::Param(const std::string& s)
-: type(STRING),
-  value_int(0),
-  value_double(0.0),
-  value_string(s),
-  value_bool(false)
+: _type(STRING), _string(s)
 {
 }
 
 Param::Param(const int& i)
-: type(INT), value_int(i), value_double(0.0), value_bool(false)
+: _type(INT), _int(i)
 {
 }
 
 Param::Param(const double& d)
-: type(DOUBLE), value_int(0), value_double(d), value_bool(false)
+: _type(DOUBLE), _double(d)
 {
 }
 
 Param::Param(const bool& b)
-: type(BOOL), value_int(0), value_double(0.0), value_bool(b)
+: _type(BOOL), _bool(b)
+{
+}
+
+Param::Param(const Param& other)
+: _type(UNDEFINED), _double(0.0)
+{
+  *this = other;
+}
+
+Param::Param(Param&& other) noexcept
+: _type(UNDEFINED), _double(0.0)
 {
+  *this = std::move(other);
 }
 
 Param::~Param()
 {
+  reset(UNDEFINED);
+}
+
+Param& Param::operator=(const Param& other)
+{
+  if (this == &other)
+    return *this;
+  reset(other._type);
+  if (_type == STRING)
+    _string = other._string;
+  else if (_type == INT)
+    _int = other._int;
+  else if (_type == DOUBLE)
+    _double = other._double;
+  else if (_type == BOOL)
+    _bool = other._bool;
+  return *this;
+}
+
+Param& Param::operator=(Param&& other) noexcept
+{
+  if (this == &other)
+    return *this;
+  reset(other._type);
+  if (_type == STRING)
+    _string = std::move(other._string);
+  else if (_type == INT)
+    _int = other._int;
+  else if (_type == DOUBLE)
+    _double = other._double;
+  else if (_type == BOOL)
+    _bool = other._bool;
+  return *this;
+}
+
+void Param::reset(const Type t)
+{
+  if (_type == t)
+    return;
+  if (_type == STRING)
+    _string.~string();
+  _type = t;
+  if (t == STRING)
+    new (&_string) string();
+  else if (t == INT)
+    _int = 0;
+  else if (t == BOOL)
+    _bool = false;
+  else
+    _double = 0.0;
+}
+
+const std::string& Param::value_string() const
+{
+  static const std::string empty;
+  return _type == STRING ? _string : empty;
 }
 
 void Param::from_yaml(const YAML::Node& data)
 {
   if (!data.IsSequence())
     throw std::runtime_error("Param::from_yaml expected a YAML sequence");
-  type = static_cast<Type>(data[0].as<int>());
-  if (type == STRING)
-    value_string = data[1].as<string>();
-  else if (type == INT)
-    value_int = data[1].as<int>();
-  else if (type == DOUBLE)
-    value_double = data[1].as<double>();
-  else if (type == BOOL)
-    value_bool = data[1].as<bool>();
+  const Type t = static_cast<Type>(data[0].as<int>());
+  if (t == STRING)
+    *this = Param(data[1].as<string>());
+  else if (t == INT)
+    *this = Param(data[1].as<int>());
+  else if (t == DOUBLE)
+    *this = Param(data[1].as<double>());
+  else if (t == BOOL)
+    *this = Param(data[1].as<bool>());
   else
     throw std::runtime_error("Param::from_yaml found an unknown type");
 }
 
 YAML::Node Param::to_yaml() const
 {
-  if (type == UNDEFINED)
+  if (_type == UNDEFINED)
     return YAML::Node();
 
   YAML::Node y;
-  y.push_back(static_cast<int>(type));
-  if (type == STRING)
-    y.push_back(value_string);
-  else if (type == INT)
-    y.push_back(value_int);
-  else if (type == DOUBLE)
-    y.push_back(value_double);
-  else if (type == BOOL)
-    y.push_back(value_bool);
+  y.push_back(static_cast<int>(_type));
+  if (_type == STRING)
+    y.push_back(_string);
+  else if (_type == INT)
+    y.push_back(_int);
+  else if (_type == DOUBLE)
+    y.push_back(_double);
+  else if (_type == BOOL)
+    y.push_back(_bool);
   else
     throw std::runtime_error("Param::to_yaml found an unknown type");
   return y;
@@ -96,28 +164,28 @@ YAML::Node Param::to_yaml() const
 
 void Param::set(const std::string& value)
 {
-  if (type == INT)
-    value_int = stoi(value);
-  else if (type == DOUBLE)
-    value_double = stod(value);
-  else if (type == STRING)
-    value_string = value;
-  else if (type == BOOL)
-    value_bool = (value == "true") || (value == "True");
+  if (_type == INT)
+    _int = stoi(value);
+  else if (_type == DOUBLE)
+    _double = stod(value);
+  else if (_type == STRING)
+    _string = value;
+  else if (_type == BOOL)
+    _bool = (value == "true") || (value == "True");
   else
     throw std::runtime_error("Param::set() found an unknown type");
 }
 
 QString Param::to_qstring() const
 {
-  if (type == DOUBLE)
-    return QString::number(value_double);
-  else if (type == BOOL)
-    return value_bool ? QString("true") : QString("false");
-  else if (type == STRING)
-    return QString::fromStdString(value_string);
-  else if (type == INT)
-    return QString::number(value_int);
+  if (_type == DOUBLE)
+    return QString::number(_double);
+  else if (_type == BOOL)
+    return _bool ? QString("true") : QString("false");
+  else if (_type == STRING)
+    return QString::fromStdString(_string);
+  else if (_type == INT)
+    return QString::number(_int);
   else
     return QString("unknown type!");
 }
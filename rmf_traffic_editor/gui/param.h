@@ -24,6 +24,9 @@
 #include <QString>
 
 
+/// One typed parameter value. Only the member for its type is stored, so
+/// the value accessors return zero, false or an empty string when asked
+/// for any other type.
 class Param
 {
 public:
@@ -34,27 +37,45 @@ public:
     INT,
     DOUBLE,
     BOOL
-  } type;
+  };
 
   Param();
   ~Param();
+  Param(const Param& other);
+  Param(Param&& other) noexcept;
   Param(const std::string& s);
   Param(const int& i);
   Param(const double& d);
   Param(const bool& b);
   Param(const Type& t);
 
+  Param& operator=(const Param& other);
+  Param& operator=(Param&& other) noexcept;
+
   void from_yaml(const YAML::Node& data);
   YAML::Node to_yaml() const;
 
-  int value_int;
-  double value_double;
-  std::string value_string;
-  bool value_bool;
+  Type type() const { return _type; }
+  int value_int() const { return _type == INT ? _int : 0; }
+  double value_double() const { return _type == DOUBLE ? _double : 0.0; }
+  bool value_bool() const { return _type == BOOL ? _bool : false; }
+  const std::string& value_string() const;
 
   void set(const std::string& value);
 
   QString to_qstring() const;
+
+private:
+  Type _type;
+  union
+  {
+    int _int;
+    double _double;
+    bool _bool;
+    std::string _string;
+  };
+
+  void reset(const Type t);
 };
 
 #endif
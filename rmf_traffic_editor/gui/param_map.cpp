@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "param_map.h"
+
+namespace {
+
+const std::string* intern(const std::string& name)
+{
+  // the nodes of an unordered_set never move, so their strings can be
+  // handed out by pointer
+  static std::mutex mutex;
+  static std::unordered_set<std::string> names;
+  std::lock_guard<std::mutex> lock(mutex);
+  return &*names.insert(name).first;
+}
+
+}  // namespace
+
+ParamKey::ParamKey()
+: _name(intern(std::string()))
+{
+}
+
+ParamKey::ParamKey(const std::string& name)
+: _name(intern(name))
+{
+}
+
+ParamKey::ParamKey(const char* name)
+: _name(intern(std::string(name)))
+{
+}
+
+ParamMap::iterator ParamMap::find(const ParamKey& key)
+{
+  for (auto it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    if (it->first == key)
+      return it;
+  }
+  return _entries.end();
+}
+
+ParamMap::const_iterator ParamMap::find(const ParamKey& key) const
+{
+  for (auto it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    if (it->first == key)
+      return it;
+  }
+  return _entries.end();
+}
+
+std::size_t ParamMap::count(const ParamKey& key) const
+{
+  return find(key) == end() ? 0 : 1;
+}
+
+Param& ParamMap::at(const ParamKey& key)
+{
+  auto it = find(key);
+  if (it == end())
+    throw std::out_of_range("ParamMap::at() found no " + key.str());
+  return it->second;
+}
+
+const Param& ParamMap::at(const ParamKey& key) const
+{
+  auto it = find(key);
+  if (it == end())
+    throw std::out_of_range("ParamMap::at() found no " + key.str());
+  return it->second;
+}
+
+Param& ParamMap::operator[](const ParamKey& key)
+{
+  auto it = find(key);
+  if (it != end())
+    return it->second;
+
+  it = std::lower_bound(
+    _entries.begin(),
+    _entries.end(),
+    key,
+    [](const value_type& entry, const ParamKey& k)
+    {
+      return entry.first.str() < k.str();
+    });
+  return _entries.insert(it, value_type(key, Param()))->second;
+}
+
+std::size_t ParamMap::erase(const ParamKey& key)
+{
+  auto it = find(key);
+  if (it == end())
+    return 0;
+  _entries.erase(it);
+  return 1;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef PARAM_MAP_H
+#define PARAM_MAP_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "param.h"
+
+
+/// A parameter name, interned so that every key with the same text shares
+/// one string and keys compare by pointer. Interned strings live for the
+/// rest of the program; there are only ever a few dozen distinct names.
+///
+/// Constructing a key from text takes a lock and a hash lookup, so code
+/// that looks up the same name over and over (like the draw paths) keeps
+/// the key in a function-local static.
+class ParamKey
+{
+public:
+  ParamKey();
+  ParamKey(const std::string& name);
+  ParamKey(const char* name);
+
+  const std::string& str() const { return *_name; }
+  const char* c_str() const { return _name->c_str(); }
+  operator const std::string&() const { return *_name; }
+
+  bool operator==(const ParamKey& other) const { return _name == other._name; }
+  bool operator!=(const ParamKey& other) const { return _name != other._name; }
+
+private:
+  const std::string* _name;
+};
+
+/// The parameters of a vertex, edge or polygon. Most have none or a
+/// handful, so they are kept in one vector sorted by name (which keeps
+/// them in the same order as the std::map they replace, for the saved
+/// files and the property editor) and looked up by comparing interned
+/// key pointers.
+class ParamMap
+{
+public:
+  typedef std::pair<ParamKey, Param> value_type;
+  typedef std::vector<value_type>::iterator iterator;
+  typedef std::vector<value_type>::const_iterator const_iterator;
+
+  iterator begin() { return _entries.begin(); }
+  iterator end() { return _entries.end(); }
+  const_iterator begin() const { return _entries.begin(); }
+  const_iterator end() const { return _entries.end(); }
+
+  std::size_t size() const { return _entries.size(); }
+  bool empty() const { return _entries.empty(); }
+  void clear() { _entries.clear(); }
+
+  iterator find(const ParamKey& key);
+  const_iterator find(const ParamKey& key) const;
+  std::size_t count(const ParamKey& key) const;
+
+  /// Throws std::out_of_range if there is no such parameter
+  Param& at(const ParamKey& key);
+  const Param& at(const ParamKey& key) const;
+
+  /// Inserts an undefined parameter if there is no such parameter yet
+  Param& operator[](const ParamKey& key);
+
+  std::size_t erase(const ParamKey& key);
+
+private:
+  std::vector<value_type> _entries;  // sorted by name
+};
+
+#endif
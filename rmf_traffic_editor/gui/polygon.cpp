@@ -64,7 +64,7 @@ YAML::Node Polygon::to_yaml() const
   y["vertices"].SetStyle(YAML::EmitterStyle::Flow);
   y["parameters"] = YAML::Node(YAML::NodeType::Map);
   for (const auto& param : params)
-    y["parameters"][param.first] = param.second.to_yaml();
+    y["parameters"][param.first.str()] = param.second.to_yaml();
   y["parameters"].SetStyle(YAML::EmitterStyle::Flow);
   return y;
 }
@@ -135,6 +135,6 @@ void Polygon::create_param_if_needed(
   const T& param_value)
 {
   auto it = params.find(name);
-  if (it == params.end() || it->second.type != param_type)
+  if (it == params.end() || it->second.type() != param_type)
     params[name] = param_value;
 }
@@ -25,7 +25,7 @@
 
 #include <QPolygonF>
 
-#include "param.h"
+#include "param_map.h"
 
 
 class Polygon
@@ -34,7 +34,7 @@ public:
   std::vector<int> vertices;
   bool selected = false;
 
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   enum Type
   {
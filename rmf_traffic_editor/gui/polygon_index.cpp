@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include "polygon_index.h"
+
+using std::size_t;
+using std::vector;
+
+void PolygonIndex::build(
+  const vector<Polygon>& polygons,
+  const vector<Vertex>& vertices)
+{
+  outlines.clear();
+  outlines.resize(polygons.size());
+  vector<Bvh::Box> boxes(polygons.size());
+  for (size_t i = 0; i < polygons.size(); i++)
+  {
+    QPolygonF& polygon = outlines[i].polygon;
+    polygon.reserve(static_cast<int>(polygons[i].vertices.size()));
+    for (const int vertex_idx : polygons[i].vertices)
+    {
+      if (vertex_idx < 0 || vertex_idx >= static_cast<int>(vertices.size()))
+      {
+        polygon.clear();  // broken, so leave it out
+        break;
+      }
+      polygon.append(QPointF(vertices[vertex_idx].x, vertices[vertex_idx].y));
+    }
+    const QRectF r = polygon.boundingRect();
+    boxes[i] = Bvh::Box{r.left(), r.top(), r.right(), r.bottom()};
+  }
+  bvh.build(boxes);
+}
+
+vector<int> PolygonIndex::polygons_containing(const QPointF& p) const
+{
+  vector<int> result;
+  bvh.for_each_containing(
+    p,
+    [this, &p, &result](const int i)
+    {
+      if (outlines[i].polygon.containsPoint(p, Qt::OddEvenFill))
+        result.push_back(i);
+    });
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+int PolygonIndex::nearest_edge(
+  const int polygon_idx,
+  const QPointF& p,
+  const std::function<double(int)>& distance) const
+{
+  if (polygon_idx < 0 || polygon_idx >= static_cast<int>(outlines.size()))
+    return -1;
+  const Outline& outline = outlines[polygon_idx];
+  const int n = outline.polygon.size();
+  if (n == 0)
+    return -1;
+
+  if (outline.edges.empty())
+  {
+    vector<Bvh::Box> boxes(n);
+    for (int i = 0; i < n; i++)
+    {
+      const QPointF& a = outline.polygon[i];
+      const QPointF& b = outline.polygon[(i + 1) % n];
+      boxes[i] = Bvh::Box{
+        std::min(a.x(), b.x()),
+        std::min(a.y(), b.y()),
+        std::max(a.x(), b.x()),
+        std::max(a.y(), b.y())};
+    }
+    outline.edges.build(boxes);
+  }
+  return outline.edges.nearest(p, distance);
+}
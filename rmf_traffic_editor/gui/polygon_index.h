@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef POLYGON_INDEX_H
+#define POLYGON_INDEX_H
+
+#include <functional>
+#include <vector>
+
+#include <QPointF>
+#include <QPolygonF>
+
+#include "bvh.h"
+#include "polygon.h"
+#include "vertex.h"
+
+
+/// The outlines of the polygons of a level with their bounding boxes in a
+/// Bvh, so that clicking on a polygon or dragging one of its edges doesn't
+/// have to rebuild and test every polygon.
+///
+/// Each polygon also gets a Bvh of its edges for finding the edge
+/// nearest a point. Those are only built for the polygons that are asked
+/// about, since only the selected polygon's edges ever are.
+class PolygonIndex
+{
+public:
+  void build(
+    const std::vector<Polygon>& polygons,
+    const std::vector<Vertex>& vertices);
+
+  std::size_t size() const { return outlines.size(); }
+
+  /// Indices of the polygons that contain `p`, in increasing order
+  std::vector<int> polygons_containing(const QPointF& p) const;
+
+  /// The edge of polygon `polygon_idx` nearest to `p`, as an index into
+  /// its vertices of the vertex the edge starts at, or -1 if it has none.
+  /// `distance` gives the distance from `p` to each of its edges, where
+  /// edge i runs from vertex i to vertex i + 1. The first of any edges at
+  /// the same distance wins, as when walking the edges in order.
+  int nearest_edge(
+    const int polygon_idx,
+    const QPointF& p,
+    const std::function<double(int)>& distance) const;
+
+private:
+  struct Outline
+  {
+    QPolygonF polygon;
+    mutable Bvh edges;  // built on demand
+  };
+
+  std::vector<Outline> outlines;
+  Bvh bvh;
+};
+
+#endif
@@ -27,6 +27,9 @@ public:
   std::array<bool, NUM_BUILDING_LANES> show_building_lanes;
 
   bool show_models = true;
+  bool show_lane_graph_issues = true;
+  bool show_congestion = false;
+  bool show_navmesh = false;
   int active_traffic_map_idx = 0;
 
   RenderingOptions();
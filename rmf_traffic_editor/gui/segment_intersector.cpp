@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <numeric>
+
+#include "level.h"
+#include "segment_intersector.h"
+
+using std::vector;
+
+
+SegmentIntersector::SegmentIntersector(const vector<Segment>& segments)
+: _stamp(segments.size(), 0)
+{
+  if (segments.empty())
+    return;
+
+  double max_x = segments[0].x1;
+  double max_y = segments[0].y1;
+  _min_x = max_x;
+  _min_y = max_y;
+  for (const Segment& s : segments)
+  {
+    _min_x = std::min({_min_x, s.x1, s.x2});
+    _min_y = std::min({_min_y, s.y1, s.y2});
+    max_x = std::max({max_x, s.x1, s.x2});
+    max_y = std::max({max_y, s.y1, s.y2});
+  }
+
+  // aim for roughly one segment per cell
+  const double w = std::max(max_x - _min_x, 1.0);
+  const double h = std::max(max_y - _min_y, 1.0);
+  const double cell_size = std::sqrt(w * h / segments.size());
+  const int max_cells_per_axis = 4096;
+  _nx = std::max(1, std::min(max_cells_per_axis,
+    static_cast<int>(std::ceil(w / cell_size))));
+  _ny = std::max(1, std::min(max_cells_per_axis,
+    static_cast<int>(std::ceil(h / cell_size))));
+  _cell_w = w / _nx;
+  _cell_h = h / _ny;
+
+  // two passes to build a compressed (CSR) cell -> segments table
+  _cell_start.assign(_nx * _ny + 1, 0);
+  for (const Segment& s : segments)
+    for_each_cell(s, [this](const int cell) { _cell_start[cell + 1]++; });
+  std::partial_sum(_cell_start.begin(), _cell_start.end(), _cell_start.begin());
+
+  _cell_items.resize(_cell_start.back());
+  vector<int> fill(_cell_start.begin(), _cell_start.end() - 1);
+  for (std::size_t i = 0; i < segments.size(); i++)
+  {
+    for_each_cell(
+      segments[i],
+      [&](const int cell)
+      {
+        _cell_items[fill[cell]++] = static_cast<int>(i);
+      });
+  }
+}
+
+// which side of the line p->q the point r is on: -1, 0 or 1
+static int orientation(
+  const double px, const double py,
+  const double qx, const double qy,
+  const double rx, const double ry)
+{
+  const double ax = qx - px;
+  const double ay = qy - py;
+  const double bx = rx - px;
+  const double by = ry - py;
+  const double cross = ax * by - ay * bx;
+  const double tolerance = 1e-9 * (ax * ax + ay * ay + bx * bx + by * by);
+  if (cross > tolerance)
+    return 1;
+  if (cross < -tolerance)
+    return -1;
+  return 0;
+}
+
+static bool on_segment(
+  const SegmentIntersector::Segment& s,
+  const double x,
+  const double y)
+{
+  return orientation(s.x1, s.y1, s.x2, s.y2, x, y) == 0 &&
+    x >= std::min(s.x1, s.x2) && x <= std::max(s.x1, s.x2) &&
+    y >= std::min(s.y1, s.y2) && y <= std::max(s.y1, s.y2);
+}
+
+bool SegmentIntersector::segments_cross(const Segment& a, const Segment& b)
+{
+  const int o1 = orientation(a.x1, a.y1, a.x2, a.y2, b.x1, b.y1);
+  const int o2 = orientation(a.x1, a.y1, a.x2, a.y2, b.x2, b.y2);
+  const int o3 = orientation(b.x1, b.y1, b.x2, b.y2, a.x1, a.y1);
+  const int o4 = orientation(b.x1, b.y1, b.x2, b.y2, a.x2, a.y2);
+  return o1 * o2 < 0 && o3 * o4 < 0;
+}
+
+bool SegmentIntersector::segments_touch(const Segment& a, const Segment& b)
+{
+  if (segments_cross(a, b))
+    return true;
+  return on_segment(a, b.x1, b.y1) || on_segment(a, b.x2, b.y2) ||
+    on_segment(b, a.x1, a.y1) || on_segment(b, a.x2, a.y2);
+}
+
+bool SegmentIntersector::segments_overlap(const Segment& a, const Segment& b)
+{
+  const double dx = a.x2 - a.x1;
+  const double dy = a.y2 - a.y1;
+  const double len = std::sqrt(dx * dx + dy * dy);
+  if (len <= 0)
+    return false;
+  const double tolerance = 1e-3 * len;
+
+  // both endpoints of b must lie on the line through a
+  const double d1 = (dx * (b.y1 - a.y1) - dy * (b.x1 - a.x1)) / len;
+  const double d2 = (dx * (b.y2 - a.y1) - dy * (b.x2 - a.x1)) / len;
+  if (std::abs(d1) > tolerance || std::abs(d2) > tolerance)
+    return false;
+
+  // then their projections onto a must overlap by more than a point
+  const double t1 = (dx * (b.x1 - a.x1) + dy * (b.y1 - a.y1)) / len;
+  const double t2 = (dx * (b.x2 - a.x1) + dy * (b.y2 - a.y1)) / len;
+  const double lo = std::max(0.0, std::min(t1, t2));
+  const double hi = std::min(len, std::max(t1, t2));
+  return hi - lo > tolerance;
+}
+
+void SegmentIntersector::intersection_point(
+  const Segment& a,
+  const Segment& b,
+  double& x,
+  double& y)
+{
+  const double ax = a.x2 - a.x1;
+  const double ay = a.y2 - a.y1;
+  const double bx = b.x2 - b.x1;
+  const double by = b.y2 - b.y1;
+  const double denominator = ax * by - ay * bx;
+  if (std::abs(denominator) < 1e-12 * (ax * ax + ay * ay + bx * bx + by * by))
+  {
+    const Segment& shorter = (ax * ax + ay * ay < bx * bx + by * by) ? a : b;
+    x = 0.5 * (shorter.x1 + shorter.x2);
+    y = 0.5 * (shorter.y1 + shorter.y2);
+    return;
+  }
+  const double t = ((b.x1 - a.x1) * by - (b.y1 - a.y1) * bx) / denominator;
+  x = a.x1 + t * ax;
+  y = a.y1 + t * ay;
+}
+
+vector<SegmentIntersector::EdgeCrossing>
+SegmentIntersector::find_edge_crossings(const Level& level)
+{
+  const int num_vertices = static_cast<int>(level.vertices.size());
+
+  // index lanes, walls and doors together, then look around each lane
+  vector<int> edge_indices;
+  vector<Segment> segments;
+  vector<char> is_lane;
+  for (std::size_t i = 0; i < level.edges.size(); i++)
+  {
+    const Edge& e = level.edges[i];
+    if (e.type != Edge::LANE && e.type != Edge::HUMAN_LANE &&
+      e.type != Edge::WALL && e.type != Edge::DOOR)
+      continue;
+    if (e.start_idx < 0 || e.start_idx >= num_vertices ||
+      e.end_idx < 0 || e.end_idx >= num_vertices ||
+      e.start_idx == e.end_idx)
+      continue;
+
+    const Vertex& start = level.vertices[e.start_idx];
+    const Vertex& end = level.vertices[e.end_idx];
+    edge_indices.push_back(static_cast<int>(i));
+    segments.push_back(Segment{start.x, start.y, end.x, end.y});
+    is_lane.push_back(e.type == Edge::LANE || e.type == Edge::HUMAN_LANE);
+  }
+
+  SegmentIntersector index(segments);
+  vector<EdgeCrossing> crossings;
+  for (std::size_t i = 0; i < segments.size(); i++)
+  {
+    if (!is_lane[i])
+      continue;
+
+    index.query(
+      segments[i],
+      [&](const int j)
+      {
+        // report each pair of lanes only once
+        if (is_lane[j] && j <= static_cast<int>(i))
+          return;
+
+        const Edge& other = level.edges[edge_indices[j]];
+        EdgeCrossing crossing;
+        if (other.type == Edge::DOOR)
+        {
+          if (!segments_touch(segments[i], segments[j]))
+            return;
+          crossing.type = LANE_DOOR;
+        }
+        else
+        {
+          if (!segments_cross(segments[i], segments[j]))
+            return;
+          crossing.type = is_lane[j] ? LANE_LANE : LANE_WALL;
+        }
+        crossing.edge_idx = edge_indices[i];
+        crossing.other_edge_idx = edge_indices[j];
+        intersection_point(segments[i], segments[j], crossing.x, crossing.y);
+        crossings.push_back(crossing);
+      });
+  }
+  return crossings;
+}
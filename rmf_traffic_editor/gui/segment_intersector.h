@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SEGMENT_INTERSECTOR_H
+#define SEGMENT_INTERSECTOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+class Level;
+
+
+/// Spatial index over 2D line segments, for finding the segments that
+/// might intersect a given one without testing every pair.
+///
+/// Segments are bucketed into a uniform grid sized for roughly one segment
+/// per cell. Each segment is entered only into the cells it actually passes
+/// through (not every cell of its bounding box), so long diagonal walls
+/// don't flood the grid. Building the index and querying it are both
+/// linear in the number of segments and cells involved.
+class SegmentIntersector
+{
+public:
+  struct Segment
+  {
+    double x1, y1, x2, y2;
+  };
+
+  /// Which kinds of edges cross, in EdgeCrossing
+  enum CrossingType
+  {
+    LANE_LANE,
+    LANE_WALL,
+    LANE_DOOR,
+  };
+
+  struct EdgeCrossing
+  {
+    CrossingType type;
+    int edge_idx;  // always a lane
+    int other_edge_idx;  // a lane, wall or door
+    double x, y;  // where they cross
+  };
+
+  SegmentIntersector() {}
+  explicit SegmentIntersector(const std::vector<Segment>& segments);
+
+  /// Calls f(idx) once for every indexed segment sharing a grid cell with
+  /// `s`. These are only candidates; use the predicates below to check.
+  template<typename F>
+  void query(const Segment& s, F f);
+
+  /// The interiors of the segments cross. Touching doesn't count, so two
+  /// segments that share an endpoint do not cross.
+  static bool segments_cross(const Segment& a, const Segment& b);
+
+  /// The segments have at least one point in common
+  static bool segments_touch(const Segment& a, const Segment& b);
+
+  /// The segments are collinear and share more than a single point
+  static bool segments_overlap(const Segment& a, const Segment& b);
+
+  /// Where the lines through the segments meet. Falls back to the midpoint
+  /// of the shorter segment if they are parallel.
+  static void intersection_point(
+    const Segment& a,
+    const Segment& b,
+    double& x,
+    double& y);
+
+  /// Find every lane-lane, lane-wall and lane-door crossing on a level.
+  /// Lanes crossing each other or walls must cross properly (not merely
+  /// share a vertex), whereas any contact between a lane and a door counts.
+  static std::vector<EdgeCrossing> find_edge_crossings(const Level& level);
+
+private:
+  double _min_x = 0, _min_y = 0;
+  double _cell_w = 1, _cell_h = 1;
+  int _nx = 0, _ny = 0;
+  std::vector<int> _cell_start;  // CSR offsets into _cell_items
+  std::vector<int> _cell_items;
+  std::vector<int> _stamp;  // last query that reported each segment
+  int _query_id = 0;
+
+  int cell_x(const double x) const
+  {
+    return std::max(0, std::min(_nx - 1,
+      static_cast<int>(std::floor((x - _min_x) / _cell_w))));
+  }
+
+  int cell_y(const double y) const
+  {
+    return std::max(0, std::min(_ny - 1,
+      static_cast<int>(std::floor((y - _min_y) / _cell_h))));
+  }
+
+  template<typename F>
+  void for_each_cell(const Segment& s, F f) const;
+};
+
+template<typename F>
+void SegmentIntersector::for_each_cell(const Segment& s, F f) const
+{
+  // walk the rows of cells the segment spans, and in each row visit only
+  // the columns covered by the part of the segment inside that row
+  // pad a little, so that segments meeting exactly on a cell boundary
+  // always end up sharing a cell despite rounding
+  const double pad_x = 1e-6 * _cell_w;
+  const double pad_y = 1e-6 * _cell_h;
+  const int cy0 = cell_y(std::min(s.y1, s.y2) - pad_y);
+  const int cy1 = cell_y(std::max(s.y1, s.y2) + pad_y);
+  const double dy = s.y2 - s.y1;
+  for (int cy = cy0; cy <= cy1; cy++)
+  {
+    double xa = std::min(s.x1, s.x2);
+    double xb = std::max(s.x1, s.x2);
+    if (cy0 != cy1 && dy != 0.0)
+    {
+      const double row_y0 = _min_y + cy * _cell_h - pad_y;
+      const double row_y1 = row_y0 + _cell_h + 2 * pad_y;
+      const double t0 =
+        std::max(0.0, std::min(1.0, (row_y0 - s.y1) / dy));
+      const double t1 =
+        std::max(0.0, std::min(1.0, (row_y1 - s.y1) / dy));
+      const double x0 = s.x1 + t0 * (s.x2 - s.x1);
+      const double x1 = s.x1 + t1 * (s.x2 - s.x1);
+      xa = std::min(x0, x1);
+      xb = std::max(x0, x1);
+    }
+    const int cx0 = cell_x(xa - pad_x);
+    const int cx1 = cell_x(xb + pad_x);
+    for (int cx = cx0; cx <= cx1; cx++)
+      f(cy * _nx + cx);
+  }
+}
+
+template<typename F>
+void SegmentIntersector::query(const Segment& s, F f)
+{
+  if (_cell_items.empty())
+    return;
+  _query_id++;
+  for_each_cell(
+    s,
+    [&](const int cell)
+    {
+      for (int i = _cell_start[cell]; i < _cell_start[cell + 1]; i++)
+      {
+        const int idx = _cell_items[i];
+        if (_stamp[idx] == _query_id)
+          continue;
+        _stamp[idx] = _query_id;
+        f(idx);
+      }
+    });
+}
+
+#endif
@@ -0,0 +1,500 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Trajectory log format. All values are little-endian, strings are a
+// uint16 length followed by that many bytes, and there is no padding.
+//
+//   header   "RMFSIM01"
+//            float64  tick period, in seconds
+//            uint32   ticks between frames
+//            uint32   number of levels, then each level's name (string)
+//            uint32   number of models, then for each model its
+//                     instance name (string) and model name (string)
+//   records  uint8    'F' for a frame:
+//                       uint64  tick number
+//                       then for each model:
+//                         float32 x, float32 y (level pixels),
+//                         float32 yaw (radians), uint16 level index
+//            uint8    'H' for the tick latency histogram, written last:
+//                       uint32  number of buckets, then for each one
+//                         uint64 upper bound (ns), uint64 count
+//                       only buckets with a nonzero count are written
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QLibrary>
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
+#include "plugins/simulation.h"
+#include "sim_runner.h"
+#include "sim_thread.h"
+
+using std::string;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+
+namespace {
+
+/// Log-linear histogram of durations: eight buckets per power of two, so
+/// every bucket is within 12.5% of its neighbors
+class LatencyHistogram
+{
+public:
+  static const int sub_bits = 3;
+  static const int num_buckets = 384;
+
+  LatencyHistogram()
+  : counts(num_buckets, 0)
+  {
+  }
+
+  void add(const uint64_t ns)
+  {
+    counts[bucket(ns)]++;
+    total_count++;
+    total_ns += ns;
+    max_ns = std::max(max_ns, ns);
+  }
+
+  uint64_t count() const { return total_count; }
+  uint64_t max() const { return max_ns; }
+
+  double mean() const
+  {
+    return total_count ? static_cast<double>(total_ns) / total_count : 0.0;
+  }
+
+  /// The upper bound of the bucket holding the given fraction of samples
+  uint64_t percentile(const double fraction) const
+  {
+    const uint64_t rank = static_cast<uint64_t>(
+      std::ceil(fraction * total_count));
+    uint64_t seen = 0;
+    for (int i = 0; i < num_buckets; i++)
+    {
+      seen += counts[i];
+      if (seen >= rank && seen > 0)
+        return std::min(upper_bound(i), max_ns);
+    }
+    return max_ns;
+  }
+
+  uint64_t bucket_count(const int idx) const { return counts[idx]; }
+
+  static uint64_t upper_bound(const int idx)
+  {
+    const int sub_count = 1 << sub_bits;
+    if (idx < sub_count)
+      return idx + 1;
+    const int shift = (idx - sub_count) / sub_count;
+    const uint64_t mantissa = sub_count + (idx - sub_count) % sub_count;
+    return (mantissa + 1) << shift;
+  }
+
+private:
+  vector<uint64_t> counts;
+  uint64_t total_count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+
+  static int bucket(const uint64_t ns)
+  {
+    const int sub_count = 1 << sub_bits;
+    if (ns < static_cast<uint64_t>(sub_count))
+      return static_cast<int>(ns);
+
+    int msb = 0;
+    for (uint64_t v = ns; v > 1; v >>= 1)
+      msb++;
+    const int shift = msb - sub_bits;
+    const int mantissa = static_cast<int>(ns >> shift) - sub_count;
+    return std::min(
+      sub_count + shift * sub_count + mantissa,
+      num_buckets - 1);
+  }
+};
+
+/// Buffered writer for the format described at the top of this file
+class TrajectoryLog
+{
+public:
+  ~TrajectoryLog()
+  {
+    close();
+  }
+
+  bool open(
+    const string& path,
+    const Building& building,
+    const int log_every)
+  {
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+      return false;
+
+    static const char magic[] = "RMFSIM01";
+    buffer.reserve(flush_size + 4096);
+    buffer.insert(buffer.end(), magic, magic + 8);
+    put<double>(SimThread::tick_period);
+    put<uint32_t>(log_every);
+
+    put<uint32_t>(building.levels.size());
+    for (const Level& level : building.levels)
+      put_string(level.name);
+
+    uint32_t num_models = 0;
+    for (const Level& level : building.levels)
+      num_models += level.models.size();
+    put<uint32_t>(num_models);
+    for (const Level& level : building.levels)
+    {
+      for (const Model& model : level.models)
+      {
+        put_string(model.instance_name);
+        put_string(model.model_name);
+      }
+    }
+    return true;
+  }
+
+  void write_frame(const uint64_t tick, const Building& building)
+  {
+    buffer.push_back('F');
+    put<uint64_t>(tick);
+    for (std::size_t i = 0; i < building.levels.size(); i++)
+    {
+      for (const Model& model : building.levels[i].models)
+      {
+        // plugins move models between levels by renaming their level
+        int model_level_idx = building.find_level_idx(model.state.level_name);
+        if (model_level_idx < 0)
+          model_level_idx = static_cast<int>(i);
+
+        put<float>(model.state.x);
+        put<float>(model.state.y);
+        put<float>(model.state.yaw);
+        put<uint16_t>(model_level_idx);
+      }
+    }
+    if (buffer.size() >= flush_size)
+      flush();
+  }
+
+  void write_histogram(const LatencyHistogram& histogram)
+  {
+    buffer.push_back('H');
+    uint32_t num_used = 0;
+    for (int i = 0; i < LatencyHistogram::num_buckets; i++)
+      num_used += histogram.bucket_count(i) ? 1 : 0;
+    put<uint32_t>(num_used);
+    for (int i = 0; i < LatencyHistogram::num_buckets; i++)
+    {
+      if (!histogram.bucket_count(i))
+        continue;
+      put<uint64_t>(LatencyHistogram::upper_bound(i));
+      put<uint64_t>(histogram.bucket_count(i));
+    }
+  }
+
+  /// Returns the size of the log, or zero if it couldn't all be written
+  uint64_t close()
+  {
+    if (!file)
+      return 0;
+    flush();
+    const bool ok = !ferror(file);
+    fclose(file);
+    file = nullptr;
+    return ok ? bytes_written : 0;
+  }
+
+private:
+  static const std::size_t flush_size = 1 << 20;
+
+  FILE* file = nullptr;
+  vector<char> buffer;
+  uint64_t bytes_written = 0;
+
+  // the layout of the host's types is the layout of the log; every
+  // platform the editor builds on is little-endian
+  template<typename T>
+  void put(const T value)
+  {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+  }
+
+  void put_string(const string& s)
+  {
+    const uint16_t length = std::min<std::size_t>(s.size(), UINT16_MAX);
+    put<uint16_t>(length);
+    buffer.insert(buffer.end(), s.begin(), s.begin() + length);
+  }
+
+  void flush()
+  {
+    if (buffer.empty())
+      return;
+    bytes_written += fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+  }
+};
+
+struct Scenario
+{
+  string filename;
+  string log_filename;
+  string error;  // empty if it ran to the end
+  uint64_t num_ticks = 0;
+  double wall_s = 0.0;
+  uint64_t log_bytes = 0;
+  LatencyHistogram latency;
+};
+
+void run_scenario(
+  Scenario& scenario,
+  const vector<SimulationFactory>& factories,
+  const SimRunOptions& options)
+{
+  Building building;
+  if (!building.load(scenario.filename, Building::LOAD_HEADLESS))
+  {
+    scenario.error = "unable to load";
+    return;
+  }
+
+  // the plugins read their settings from the building file, as in the GUI
+  YAML::Node config;
+  try
+  {
+    config = YAML::LoadFile(scenario.filename);
+  }
+  catch (const YAML::Exception& e)
+  {
+    scenario.error = string("unable to read settings: ") + e.what();
+    return;
+  }
+
+  TrajectoryLog log;
+  const bool logging = !scenario.log_filename.empty();
+  if (logging && !log.open(scenario.log_filename, building, options.log_every))
+  {
+    scenario.error = "unable to open " + scenario.log_filename;
+    return;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const uint64_t num_ticks = static_cast<uint64_t>(
+    std::llround(options.duration / SimThread::tick_period));
+  const auto tick_wall_period = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(
+      options.speed > 0.0 ? SimThread::tick_period / options.speed : 0.0));
+  const auto max_lag = std::chrono::milliseconds(100);
+
+  QElapsedTimer wall_timer;
+  wall_timer.start();
+  try
+  {
+    vector<std::unique_ptr<Simulation>> simulations;
+    for (const SimulationFactory factory : factories)
+    {
+      simulations.emplace_back(factory());
+      simulations.back()->load(config);
+      simulations.back()->reset(building);
+    }
+
+    Clock::time_point next_tick = Clock::now();
+    for (uint64_t tick = 0; tick < num_ticks; tick++)
+    {
+      if (options.speed > 0.0)
+      {
+        const Clock::time_point now = Clock::now();
+        if (now < next_tick)
+          std::this_thread::sleep_until(next_tick);
+        else if (now - next_tick > max_lag)
+          next_tick = now;  // too slow to keep up; don't try to catch up
+        next_tick += tick_wall_period;
+      }
+
+      const Clock::time_point start = Clock::now();
+      for (const auto& simulation : simulations)
+        simulation->tick(building);
+      scenario.latency.add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - start).count());
+      scenario.num_ticks++;
+
+      if (logging && scenario.num_ticks % options.log_every == 0)
+        log.write_frame(scenario.num_ticks, building);
+    }
+  }
+  catch (const std::exception& e)
+  {
+    scenario.error = string("plugin failed: ") + e.what();
+  }
+  scenario.wall_s = wall_timer.nsecsElapsed() / 1e9;
+
+  if (logging)
+  {
+    log.write_histogram(scenario.latency);
+    scenario.log_bytes = log.close();
+    if (!scenario.log_bytes && scenario.error.empty())
+      scenario.error = "unable to write " + scenario.log_filename;
+  }
+}
+
+}  // namespace
+
+int run_simulations(
+  const QStringList& filenames,
+  const SimRunOptions& options)
+{
+  if (filenames.isEmpty())
+  {
+    printf("no building files given\n");
+    return 1;
+  }
+  if (options.log_every <= 0)
+  {
+    printf("the log interval must be at least one tick\n");
+    return 1;
+  }
+
+  const QStringList plugin_paths = options.plugin_paths.isEmpty() ?
+    SimThread::plugin_paths() : options.plugin_paths;
+
+  // the libraries stay loaded until every scenario is done with them
+  vector<std::unique_ptr<QLibrary>> libraries;
+  vector<SimulationFactory> factories;
+  for (const QString& path : plugin_paths)
+  {
+    libraries.emplace_back(new QLibrary(QFileInfo(path).absoluteFilePath()));
+    const SimulationFactory factory =
+      SimThread::load_factory(*libraries.back());
+    if (!factory)
+      return 1;
+    factories.push_back(factory);
+    printf("loaded simulation plugin %s\n", qUtf8Printable(path));
+  }
+  if (factories.empty())
+  {
+    printf("no simulation plugins found; pass them with --plugin or add "
+      "their directories to RMF_TRAFFIC_EDITOR_PLUGIN_PATH\n");
+    return 1;
+  }
+
+  if (!options.log_dir.isEmpty() && !QDir().mkpath(options.log_dir))
+  {
+    printf("unable to create %s\n", qUtf8Printable(options.log_dir));
+    return 1;
+  }
+
+  // report every scenario by its full path
+  vector<Scenario> scenarios(filenames.size());
+  for (int i = 0; i < filenames.size(); i++)
+  {
+    const QFileInfo file_info(filenames[i]);
+    scenarios[i].filename = file_info.absoluteFilePath().toStdString();
+    if (!options.log_dir.isEmpty())
+    {
+      // the third file, "a.building.yaml", logs to "a_2.simlog", so
+      // buildings of the same name from different layouts don't collide
+      scenarios[i].log_filename = QDir(options.log_dir).absoluteFilePath(
+        file_info.fileName().section('.', 0, 0) +
+        QString("_%1.simlog").arg(i)).toStdString();
+    }
+  }
+
+  int num_threads = options.num_threads;
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min(num_threads, static_cast<int>(scenarios.size()));
+
+  QElapsedTimer total_timer;
+  total_timer.start();
+
+  std::atomic<std::size_t> next_idx(0);
+  vector<std::thread> workers;
+  for (int i = 0; i < num_threads; i++)
+  {
+    workers.emplace_back(
+      [&]()
+      {
+        std::size_t idx;
+        while ((idx = next_idx++) < scenarios.size())
+          run_scenario(scenarios[idx], factories, options);
+      });
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  const double total_s = total_timer.nsecsElapsed() / 1e9;
+
+  int num_failed = 0;
+  printf("\n                   tick latency (us)\n");
+  printf("       ticks    mean     p50     p99     max  x realtime\n");
+  for (const Scenario& s : scenarios)
+  {
+    const bool ok = s.error.empty();
+    if (!ok)
+      num_failed++;
+
+    const double sim_s = s.num_ticks * SimThread::tick_period;
+    printf("%s %7llu %7.1f %7.1f %7.1f %7.1f %11.1f  %s\n",
+      ok ? "  OK" : "FAIL",
+      static_cast<unsigned long long>(s.num_ticks),
+      s.latency.mean() / 1e3,
+      s.latency.percentile(0.5) / 1e3,
+      s.latency.percentile(0.99) / 1e3,
+      s.latency.max() / 1e3,
+      s.wall_s > 0 ? sim_s / s.wall_s : 0.0,
+      s.filename.c_str());
+
+    if (!ok)
+      printf("        %s\n", s.error.c_str());
+    if (s.log_bytes)
+      printf("        %.1f kB logged to %s\n",
+        s.log_bytes / 1e3,
+        s.log_filename.c_str());
+  }
+
+  printf(
+    "\nran %d scenarios of %.1f s in %.2f s on %d threads, %d failed\n",
+    static_cast<int>(scenarios.size()),
+    options.duration,
+    total_s,
+    num_threads,
+    num_failed);
+
+  return num_failed == 0 ? 0 : 1;
+}
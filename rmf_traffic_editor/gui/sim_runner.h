@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SIM_RUNNER_H
+#define SIM_RUNNER_H
+
+#include <QString>
+#include <QStringList>
+
+
+/// Options for running simulation plugins without the editor window
+struct SimRunOptions
+{
+  QStringList plugin_paths;  // empty means SimThread::plugin_paths()
+  double duration = 60.0;  // simulated seconds per scenario
+  double speed = 0.0;  // times realtime; zero means as fast as possible
+  int num_threads = 0;  // zero means one per core
+
+  // if set, each scenario writes a trajectory log into this directory
+  QString log_dir;
+  int log_every = 10;  // ticks between logged frames
+};
+
+/// Run the simulation plugins over each building in `filenames`, one
+/// scenario per building, spreading the scenarios across worker threads so
+/// layouts can be compared side by side. Each scenario gets its own
+/// instance of every plugin, ticked at SimThread::tick_period.
+///
+/// Prints, for each scenario, how long the ticks took (mean, percentiles
+/// and maximum) and how much faster than realtime it ran. With a log
+/// directory, the model trajectories and the tick latency histogram of
+/// each scenario are also written to <file name>_<index>.simlog, in the
+/// binary format described in sim_runner.cpp.
+///
+/// Returns zero if every scenario ran to the end.
+int run_simulations(
+  const QStringList& filenames,
+  const SimRunOptions& options);
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <chrono>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QLibrary>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include "ament_index_cpp/get_package_prefix.hpp"
+
+#include "sim_thread.h"
+
+using std::size_t;
+
+constexpr double SimThread::tick_period;
+constexpr int SimThread::fresh_bit;
+
+
+SimThread::SimThread()
+: QThread()
+{
+}
+
+SimThread::~SimThread()
+{
+  stop();
+
+  // the plugins may have something on the scene, which is gone by now
+  plugins.clear();
+}
+
+QStringList SimThread::plugin_paths()
+{
+  QStringList dirs = QString::fromLocal8Bit(
+    qgetenv("RMF_TRAFFIC_EDITOR_PLUGIN_PATH")).split(
+    ':',
+    QString::SkipEmptyParts);
+
+  try
+  {
+    dirs.append(
+      QString::fromStdString(
+        ament_index_cpp::get_package_prefix("rmf_traffic_editor")) +
+      "/lib/rmf_traffic_editor/plugins");
+  }
+  catch (const ament_index_cpp::PackageNotFoundError&)
+  {
+    // running from a build tree; only the environment variable counts
+  }
+
+  QStringList paths;
+  for (const QString& dir : dirs)
+  {
+    const QFileInfoList entries =
+      QDir(dir).entryInfoList(QDir::Files | QDir::Readable, QDir::Name);
+    for (const QFileInfo& entry : entries)
+    {
+      if (QLibrary::isLibrary(entry.fileName()))
+        paths.append(entry.absoluteFilePath());
+    }
+  }
+  return paths;
+}
+
+SimulationFactory SimThread::load_factory(QLibrary& library)
+{
+  // fail here, rather than partway through a simulation, if the plugin
+  // needs something the editor doesn't have
+  library.setLoadHints(QLibrary::ResolveAllSymbolsHint);
+  if (!library.load())
+  {
+    qWarning("couldn't load simulation plugin %s: %s",
+      qUtf8Printable(library.fileName()),
+      qUtf8Printable(library.errorString()));
+    return nullptr;
+  }
+
+  const SimulationFactory factory = reinterpret_cast<SimulationFactory>(
+    library.resolve(TRAFFIC_EDITOR_SIMULATION_FACTORY));
+  if (!factory)
+  {
+    qWarning("%s doesn't export " TRAFFIC_EDITOR_SIMULATION_FACTORY "()",
+      qUtf8Printable(library.fileName()));
+    library.unload();
+  }
+  return factory;
+}
+
+int SimThread::load_plugins()
+{
+  int num_loaded = 0;
+  for (const QString& path : plugin_paths())
+  {
+    if (load_plugin(path))
+      num_loaded++;
+  }
+  return num_loaded;
+}
+
+bool SimThread::load_plugin(const QString& path)
+{
+  std::unique_ptr<QLibrary> library(new QLibrary(path));
+  const SimulationFactory factory = load_factory(*library);
+  if (!factory)
+    return false;
+
+  Plugin plugin;
+  plugin.simulation.reset(factory());
+  plugin.library = std::move(library);
+  if (!plugin.simulation)
+    return false;
+
+  printf("loaded simulation plugin %s\n", qUtf8Printable(path));
+
+  QMutexLocker locker(&mutex);
+  plugins.push_back(std::move(plugin));
+  return true;
+}
+
+void SimThread::reset(const Building& building, const YAML::Node& config)
+{
+  running = false;
+
+  QMutexLocker locker(&mutex);
+  pending_steps = 0;
+
+  sim_building = building;
+  sim_building.clear_scene();  // those items belong to the GUI
+
+  for (Plugin& plugin : plugins)
+  {
+    plugin.simulation->load(config);
+    plugin.simulation->reset(sim_building);
+  }
+
+  sim_time = 0.0;
+  publish_frame();
+
+  if (!isRunning())
+  {
+    quit = false;
+    start();
+  }
+}
+
+void SimThread::set_running(const bool _running)
+{
+  QMutexLocker locker(&mutex);
+  running = _running;
+  wake.wakeAll();
+}
+
+void SimThread::set_speed(const double _speed)
+{
+  QMutexLocker locker(&mutex);
+  speed = _speed;
+  wake.wakeAll();  // so a long sleep at the old speed is cut short
+}
+
+void SimThread::step(const int num_ticks)
+{
+  QMutexLocker locker(&mutex);
+  pending_steps += num_ticks;
+  wake.wakeAll();
+}
+
+void SimThread::stop()
+{
+  {
+    QMutexLocker locker(&mutex);
+    quit = true;
+    running = false;
+    wake.wakeAll();
+  }
+  wait();
+}
+
+const SimThread::Frame* SimThread::take_frame()
+{
+  if (!(latest.load() & fresh_bit))
+    return nullptr;
+
+  read_idx = latest.exchange(read_idx) & ~fresh_bit;
+  return &frames[read_idx];
+}
+
+void SimThread::scene_update(
+  QGraphicsScene* scene,
+  Building& building,
+  const int level_idx)
+{
+  for (Plugin& plugin : plugins)
+    plugin.simulation->scene_update(scene, building, level_idx);
+}
+
+void SimThread::scene_clear()
+{
+  for (Plugin& plugin : plugins)
+    plugin.simulation->scene_clear();
+}
+
+void SimThread::run()
+{
+  using Clock = std::chrono::steady_clock;
+
+  // If the plugins can't keep up, give up on the missed ticks rather
+  // than running a burst of them to catch up.
+  const auto max_lag = std::chrono::milliseconds(100);
+
+  Clock::time_point next_tick = Clock::now();
+
+  QMutexLocker locker(&mutex);
+  while (!quit)
+  {
+    if (pending_steps > 0)
+    {
+      pending_steps--;
+      tick();
+      yield(locker);
+      next_tick = Clock::now();
+      continue;
+    }
+
+    if (!running)
+    {
+      wake.wait(&mutex);
+      next_tick = Clock::now();
+      continue;
+    }
+
+    const double current_speed = speed;
+    if (current_speed > 0.0)
+    {
+      const auto now = Clock::now();
+      if (now < next_tick)
+      {
+        // the mutex is released while waiting, so the GUI can get in
+        const auto remaining =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+          next_tick - now).count();
+        wake.wait(&mutex, static_cast<unsigned long>(remaining / 1000 + 1));
+        continue;
+      }
+
+      if (now - next_tick > max_lag)
+        next_tick = now;
+      next_tick += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(tick_period / current_speed));
+    }
+
+    tick();
+    yield(locker);
+  }
+}
+
+void SimThread::yield(QMutexLocker& locker)
+{
+  // QMutex isn't fair: without this, a thread ticking back to back could
+  // keep the GUI from ever getting the mutex to pause it
+  locker.unlock();
+  QThread::yieldCurrentThread();
+  locker.relock();
+}
+
+void SimThread::tick()
+{
+  for (Plugin& plugin : plugins)
+    plugin.simulation->tick(sim_building);
+
+  sim_time = sim_time + tick_period;
+  publish_frame();
+}
+
+void SimThread::publish_frame()
+{
+  Frame& frame = frames[write_idx];
+  frame.sim_time = sim_time;
+
+  // assigning into the existing elements reuses their storage, so
+  // steady-state ticks don't allocate
+  frame.level_offsets.resize(sim_building.levels.size() + 1);
+  size_t num_models = 0;
+  for (size_t i = 0; i < sim_building.levels.size(); i++)
+  {
+    frame.level_offsets[i] = num_models;
+    num_models += sim_building.levels[i].models.size();
+  }
+  frame.level_offsets.back() = num_models;
+
+  frame.model_states.resize(num_models);
+  size_t model_idx = 0;
+  for (const Level& level : sim_building.levels)
+  {
+    for (const Model& model : level.models)
+      frame.model_states[model_idx++] = model.state;
+  }
+
+  write_idx = latest.exchange(write_idx | fresh_bit) & ~fresh_bit;
+}
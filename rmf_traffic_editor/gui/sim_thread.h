@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "building.h"
+#include "model_state.h"
+#include "plugins/simulation.h"
+
+class QGraphicsScene;
+class QLibrary;
+
+
+/// Hosts the simulation plugins and ticks them on a thread of its own, at
+/// a fixed simulated rate, so a slow plugin never stalls the GUI.
+///
+/// The plugins work on a private copy of the building, made by reset().
+/// After every tick the model states of that copy are published as a
+/// Frame, which the GUI thread picks up with take_frame() whenever it
+/// redraws. Frames are handed over through three buffers: the simulation
+/// always has one to write, the GUI always has one to read, and the third
+/// holds the newest complete frame, so neither side ever waits for the
+/// other. Frames the GUI is too slow to pick up are simply skipped.
+class SimThread : public QThread
+{
+  Q_OBJECT
+
+public:
+  static constexpr double tick_period = Simulation::tick_period;
+
+  struct Frame
+  {
+    double sim_time = 0.0;
+
+    // the states of the models of level i are
+    // model_states[level_offsets[i]] ... model_states[level_offsets[i+1]-1]
+    std::vector<std::size_t> level_offsets;
+    std::vector<ModelState> model_states;
+  };
+
+  SimThread();
+  ~SimThread();
+
+  /// Every library found in the directories listed in the
+  /// RMF_TRAFFIC_EDITOR_PLUGIN_PATH environment variable (separated by
+  /// colons), then in the plugin directory of the installed package
+  static QStringList plugin_paths();
+
+  /// Load a plugin library and find its simulation factory. Returns
+  /// nullptr, with a warning, if either fails.
+  static SimulationFactory load_factory(QLibrary& library);
+
+  /// Load every library in plugin_paths(). Returns how many were loaded.
+  int load_plugins();
+
+  /// Load one plugin library. Returns false if it can't be loaded or it
+  /// doesn't export a simulation factory.
+  bool load_plugin(const QString& path);
+
+  std::size_t num_plugins() const { return plugins.size(); }
+
+  /// Pause, take a fresh copy of the building, hand `config` to the
+  /// plugins and reset them. Blocks until the current tick is finished.
+  void reset(const Building& building, const YAML::Node& config);
+
+  void set_running(const bool running);
+  bool is_running() const { return running.load(); }
+
+  /// Simulated seconds per wall-clock second. Zero or less runs the
+  /// ticks back to back, as fast as the plugins allow.
+  void set_speed(const double speed);
+  double get_speed() const { return speed.load(); }
+
+  /// Run `num_ticks` ticks as fast as possible, even while paused
+  void step(const int num_ticks);
+
+  /// Stop ticking and let run() return. Blocks until it has.
+  void stop();
+
+  double get_sim_time() const { return sim_time.load(); }
+
+  /// Returns the newest frame if one was published since the last call,
+  /// or nullptr. The frame stays valid until the next call. Only the GUI
+  /// thread may call this.
+  const Frame* take_frame();
+
+  /// Let the plugins draw on the scene. Only the GUI thread may call
+  /// these.
+  void scene_update(
+    QGraphicsScene* scene,
+    Building& building,
+    const int level_idx);
+  void scene_clear();
+
+protected:
+  void run() override;
+
+private:
+  struct Plugin
+  {
+    // declared first so it is destroyed last, after the simulation
+    std::unique_ptr<QLibrary> library;
+    std::unique_ptr<Simulation> simulation;
+  };
+  std::vector<Plugin> plugins;
+
+  Building sim_building;
+
+  // everything the simulation touches is guarded by the mutex; the
+  // thread sleeps on the wait condition between ticks and while paused
+  QMutex mutex;
+  QWaitCondition wake;
+  bool quit = false;
+  int pending_steps = 0;
+
+  std::atomic<bool> running {false};
+  std::atomic<double> speed {1.0};
+  std::atomic<double> sim_time {0.0};
+
+  // Triple buffer. frames[write_idx] belongs to the simulation and
+  // frames[read_idx] to the GUI. latest holds the index of the third,
+  // plus fresh_bit while it holds a frame the GUI hasn't taken yet.
+  static constexpr int fresh_bit = 4;
+  Frame frames[3];
+  int write_idx = 0;
+  int read_idx = 1;
+  std::atomic<int> latest {2};
+
+  void tick();
+  void publish_frame();  // needs the mutex
+  static void yield(QMutexLocker& locker);
+};
+
+#endif
@@ -94,7 +94,7 @@ YAML::Node Vertex::to_yaml() const
   {
     YAML::Node params_node(YAML::NodeType::Map);
     for (const auto& param : params)
-      params_node[param.first] = param.second.to_yaml();
+      params_node[param.first.str()] = param.second.to_yaml();
     vertex_node.push_back(params_node);
   }
   return vertex_node;
@@ -260,54 +260,60 @@ void Vertex::set_param(const std::string& param_name, const std::string& value)
 
 bool Vertex::is_parking_point() const
 {
-  const auto it = params.find("is_parking_spot");
+  static const ParamKey key("is_parking_spot");
+  const auto it = params.find(key);
   if (it == params.end())
     return false;
 
-  return it->second.value_bool;
+  return it->second.value_bool();
 }
 
 bool Vertex::is_holding_point() const
 {
-  const auto it = params.find("is_holding_point");
+  static const ParamKey key("is_holding_point");
+  const auto it = params.find(key);
   if (it == params.end())
     return false;
 
-  return it->second.value_bool;
+  return it->second.value_bool();
 }
 
 bool Vertex::is_charger() const
 {
-  const auto it = params.find("is_charger");
+  static const ParamKey key("is_charger");
+  const auto it = params.find(key);
   if (it == params.end())
     return false;
 
-  return it->second.value_bool;
+  return it->second.value_bool();
 }
 
 bool Vertex::is_cleaning_zone() const
 {
-  const auto it = params.find("is_cleaning_zone");
+  static const ParamKey key("is_cleaning_zone");
+  const auto it = params.find(key);
   if (it == params.end())
     return false;
 
-  return it->second.value_bool;
+  return it->second.value_bool();
 }
 
 std::string Vertex::dropoff_ingestor() const
 {
-  const auto it = params.find("dropoff_ingestor");
+  static const ParamKey key("dropoff_ingestor");
+  const auto it = params.find(key);
   if (it == params.end())
     return "";
 
-  return it->second.value_string;
+  return it->second.value_string();
 }
 
 std::string Vertex::pickup_dispenser() const
 {
-  const auto it = params.find("pickup_dispenser");
+  static const ParamKey key("pickup_dispenser");
+  const auto it = params.find(key);
   if (it == params.end())
     return "";
 
-  return it->second.value_string;
+  return it->second.value_string();
 }
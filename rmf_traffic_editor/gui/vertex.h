@@ -26,7 +26,7 @@
 
 #include <QColor>
 
-#include "param.h"
+#include "param_map.h"
 
 class QGraphicsScene;
 
@@ -41,7 +41,7 @@ public:
   bool selected;
 
   QUuid uuid;
-  std::map<std::string, Param> params;
+  ParamMap params;
 
   Vertex();
   Vertex(double _x, double _y, const std::string& _name = std::string());
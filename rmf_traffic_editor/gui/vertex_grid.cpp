@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "vertex_grid.h"
+
+using std::size_t;
+using std::vector;
+
+std::int64_t VertexGrid::cell_coordinate(const double v) const
+{
+  return static_cast<std::int64_t>(std::floor(v / cell_width));
+}
+
+std::uint64_t VertexGrid::key(const std::int64_t cx, const std::int64_t cy)
+{
+  return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) |
+    static_cast<std::uint32_t>(cy);
+}
+
+void VertexGrid::build(
+  const vector<double>& x,
+  const vector<double>& y,
+  const double cell_size)
+{
+  clear();
+  if (!(cell_size > 0.0))
+    return;
+  cell_width = cell_size;
+
+  // count the points in each cell, then hand out their ranges of `items`
+  const size_t n = std::min(x.size(), y.size());
+  points.resize(n);
+  vector<std::uint64_t> keys(n);
+  vector<char> hashed(n, 0);
+  cells.reserve(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    points[i] = QPointF(x[i], y[i]);
+    if (!std::isfinite(x[i]) || !std::isfinite(y[i]))
+      continue;
+    keys[i] = key(cell_coordinate(x[i]), cell_coordinate(y[i]));
+    hashed[i] = 1;
+    cells[keys[i]].second++;
+  }
+
+  int first = 0;
+  for (auto& cell : cells)
+  {
+    cell.second.first = first;
+    first += cell.second.second;
+    cell.second.second = 0;
+  }
+
+  items.resize(first);
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!hashed[i])
+      continue;
+    std::pair<int, int>& cell = cells[keys[i]];
+    items[cell.first + cell.second++] = static_cast<int>(i);
+  }
+}
+
+void VertexGrid::clear()
+{
+  cell_width = 0.0;
+  points.clear();
+  cells.clear();
+  items.clear();
+}
+
+void VertexGrid::for_each_near(
+  const QPointF& p,
+  const double radius,
+  const std::function<void(int)>& f) const
+{
+  if (items.empty() || !(radius >= 0.0) ||
+    !std::isfinite(p.x()) || !std::isfinite(p.y()))
+    return;
+
+  const double radius_squared = radius * radius;
+  auto visit = [&](const std::pair<int, int>& cell)
+    {
+      for (int j = cell.first; j < cell.first + cell.second; j++)
+      {
+        const QPointF d = points[items[j]] - p;
+        if (d.x() * d.x() + d.y() * d.y() <= radius_squared)
+          f(items[j]);
+      }
+    };
+
+  // a radius much wider than the cells would look up mostly empty ones
+  const double span = 2.0 * radius / cell_width + 2.0;
+  if (!std::isfinite(radius) || span * span > cells.size())
+  {
+    for (const auto& cell : cells)
+      visit(cell.second);
+    return;
+  }
+
+  const std::int64_t x0 = cell_coordinate(p.x() - radius);
+  const std::int64_t x1 = cell_coordinate(p.x() + radius);
+  const std::int64_t y0 = cell_coordinate(p.y() - radius);
+  const std::int64_t y1 = cell_coordinate(p.y() + radius);
+  for (std::int64_t cx = x0; cx <= x1; cx++)
+  {
+    for (std::int64_t cy = y0; cy <= y1; cy++)
+    {
+      const auto it = cells.find(key(cx, cy));
+      if (it != cells.end())
+        visit(it->second);
+    }
+  }
+}
+
+int VertexGrid::nearest(const QPointF& p, const double radius) const
+{
+  int best = -1;
+  double best_distance = std::numeric_limits<double>::infinity();
+  for_each_near(
+    p,
+    radius,
+    [&](const int i)
+    {
+      const QPointF d = points[i] - p;
+      const double dist = d.x() * d.x() + d.y() * d.y();
+      if (dist < best_distance || (dist == best_distance && i < best))
+      {
+        best = i;
+        best_distance = dist;
+      }
+    });
+  return best;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef VERTEX_GRID_H
+#define VERTEX_GRID_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QPointF>
+
+
+/// A spatial hash of points into square cells, so that finding the points
+/// near a position only costs the points in the cells around it. Level
+/// keeps one over its vertices, with cells as wide as the distance it is
+/// asked about, for merging duplicate vertices and snapping to them.
+class VertexGrid
+{
+public:
+  /// Hash the points (x[i], y[i]) into cells `cell_size` wide. Points
+  /// that aren't finite are left out.
+  void build(
+    const std::vector<double>& x,
+    const std::vector<double>& y,
+    const double cell_size);
+  void clear();
+  bool empty() const { return items.empty(); }
+  double cell_size() const { return cell_width; }
+
+  /// Calls f with the index of every point within `radius` of `p`, in no
+  /// particular order
+  void for_each_near(
+    const QPointF& p,
+    const double radius,
+    const std::function<void(int)>& f) const;
+
+  /// The index of the point nearest to `p` that is within `radius` of
+  /// it, or -1 if there are none. The lowest index wins ties.
+  int nearest(const QPointF& p, const double radius) const;
+
+private:
+  double cell_width = 0.0;
+  std::vector<QPointF> points;
+  // cell key to the range of `items` holding the points in that cell
+  std::unordered_map<std::uint64_t, std::pair<int, int>> cells;
+  std::vector<int> items;
+
+  std::int64_t cell_coordinate(const double v) const;
+  static std::uint64_t key(const std::int64_t cx, const std::int64_t cy);
+};
+
+#endif
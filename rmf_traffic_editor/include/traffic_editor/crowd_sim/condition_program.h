@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef CROWD_SIM_CONDITION_PROGRAM__H
+#define CROWD_SIM_CONDITION_PROGRAM__H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <traffic_editor/crowd_sim/condition.h>
+
+namespace crowd_sim {
+
+/*
+ * What a condition looks at, for one agent or for arrays of agents
+ */
+struct ConditionInputs
+{
+  // distance to the agent's goal, or infinity if it has none
+  const double* goal_distance = nullptr;
+  // seconds since the agent entered its current state
+  const double* state_time = nullptr;
+  std::size_t count = 0;
+};
+
+/*
+ * A Condition tree compiled into a flat postfix instruction array, which
+ * is evaluated with a small stack instead of virtual calls and shared_ptr
+ * chasing. The batched evaluate() runs each instruction over a block of
+ * agents at a time, which has no branches per agent and vectorizes.
+ *
+ * Compiling doesn't keep any reference to the tree. Conditions that
+ * aren't valid (the default "base" condition, or an and/or/not with a
+ * missing operand) evaluate to false, as does goal_reached for an agent
+ * without a goal.
+ */
+class ConditionProgram
+{
+public:
+  enum class OpCode : std::uint8_t
+  {
+    FALSE_CONST,
+    GOAL,  // goal_distance <= value
+    TIMER,  // state_time >= value
+    AND,
+    OR,
+    NOT
+  };
+
+  struct Instruction
+  {
+    OpCode op;
+    double value;
+  };
+
+  ConditionProgram();
+
+  static ConditionProgram compile(const Condition& root);
+
+  /// Evaluate for one agent
+  bool evaluate(const double goal_distance, const double state_time) const;
+
+  /// Evaluate for inputs.count agents, writing 1 or 0 to results[i]
+  void evaluate(const ConditionInputs& inputs, std::uint8_t* results) const;
+
+  const std::vector<Instruction>& instructions() const { return _code; }
+  std::size_t stack_depth() const { return _stack_depth; }
+
+private:
+  static const std::size_t block_size = 256;
+
+  std::vector<Instruction> _code;
+  std::size_t _stack_depth;
+
+  void _compile(const Condition& condition);
+};
+
+} //namespace crowd_sim
+
+#endif
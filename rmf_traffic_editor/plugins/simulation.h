@@ -18,13 +18,33 @@
 #ifndef PLUGINS_SIMULATION_H
 #define PLUGINS_SIMULATION_H
 
-#include "traffic_editor/building.h"
+#include <yaml-cpp/yaml.h>
+
+#include "building.h"
 
 class QGraphicsScene;
 
+/// Interface of the simulation plugins that the editor can load from
+/// shared libraries (see SimThread). Each library defines one subclass
+/// and exports a factory for it with TRAFFIC_EDITOR_SIMULATION_PLUGIN.
+///
+/// load(), reset() and tick() are never called at the same time, and get
+/// the simulation's own copy of the building. Plugins move things around
+/// by updating the ModelState of the models in that copy; the editor
+/// picks up the new states after each tick. Other state, such as agents
+/// that aren't models, is the plugin's to draw in scene_update().
+///
+/// scene_update() and scene_clear() are called on the GUI thread, with
+/// the editor's building, while tick() may be running at the same time.
+/// Anything the plugin shares between the two must be protected by the
+/// plugin itself. scene_clear() is called after the scene was cleared,
+/// so the plugin's items are already gone.
 class Simulation
 {
 public:
+  /// Simulated seconds that pass with each tick()
+  static constexpr double tick_period = 0.01;
+
   virtual ~Simulation() = default;
 
   virtual void load(const YAML::Node& config_data) = 0;
@@ -39,4 +59,16 @@ public:
   virtual void scene_clear() = 0;
 };
 
+/// Name of the factory function that plugin libraries export
+#define TRAFFIC_EDITOR_SIMULATION_FACTORY "traffic_editor_create_simulation"
+
+typedef Simulation* (* SimulationFactory)();
+
+/// Use once in a plugin library, with its Simulation subclass
+#define TRAFFIC_EDITOR_SIMULATION_PLUGIN(class_name) \
+  extern "C" Simulation* traffic_editor_create_simulation() \
+  { \
+    return new class_name(); \
+  }
+
 #endif
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+
+/// Microseconds per call of f(round), over `rounds` calls
+template<typename F>
+double time_us(const int rounds, F f)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++)
+    f(round);
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+    rounds;
+}
+
+#endif
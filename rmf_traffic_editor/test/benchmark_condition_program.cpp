@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Compares evaluating crowd_sim conditions by walking the tree with
+// evaluating their compiled ConditionProgram, one agent at a time and
+// batched, for 10k agents. Fails if any of them disagree.
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <traffic_editor/crowd_sim/condition.h>
+#include <traffic_editor/crowd_sim/condition_program.h>
+
+#include "benchmark.h"
+
+using crowd_sim::BoolCondition;
+using crowd_sim::Condition;
+using crowd_sim::ConditionInputs;
+using crowd_sim::ConditionProgram;
+using crowd_sim::ConditionPtr;
+using crowd_sim::LeafCondition;
+using std::size_t;
+using std::vector;
+
+namespace {
+
+const size_t num_agents = 10000;
+const int num_rounds = 200;
+
+ConditionPtr goal(const double distance)
+{
+  return std::make_shared<LeafCondition>(
+    "goal_reached", Condition::GOAL, distance);
+}
+
+ConditionPtr timer(const double seconds)
+{
+  return std::make_shared<LeafCondition>("timer", Condition::TIMER, seconds);
+}
+
+ConditionPtr op(
+  const Condition::TYPE type,
+  const ConditionPtr& c1,
+  const ConditionPtr& c2 = nullptr)
+{
+  return std::make_shared<BoolCondition>(
+    type == Condition::AND ? "and" : type == Condition::OR ? "or" : "not",
+    type, c1, c2);
+}
+
+// the same rules as the crowd preview used before conditions were compiled
+bool evaluate_tree(
+  const Condition& condition,
+  const double goal_distance,
+  const double state_time)
+{
+  switch (condition.get_type())
+  {
+    case Condition::GOAL:
+      return goal_distance <=
+        static_cast<const LeafCondition&>(condition).get_value();
+    case Condition::TIMER:
+      return state_time >=
+        static_cast<const LeafCondition&>(condition).get_value();
+    case Condition::AND:
+    case Condition::OR:
+    case Condition::NOT:
+    {
+      const BoolCondition& b = static_cast<const BoolCondition&>(condition);
+      const ConditionPtr c1 = b.get_condition(1);
+      if (!c1)
+        return false;
+      const bool v1 = evaluate_tree(*c1, goal_distance, state_time);
+      if (condition.get_type() == Condition::NOT)
+        return !v1;
+      const ConditionPtr c2 = b.get_condition(2);
+      if (!c2)
+        return false;
+      if (condition.get_type() == Condition::AND)
+        return v1 && evaluate_tree(*c2, goal_distance, state_time);
+      return v1 || evaluate_tree(*c2, goal_distance, state_time);
+    }
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  struct Case
+  {
+    const char* name;
+    ConditionPtr condition;
+  };
+
+  const vector<Case> cases = {
+    {"goal or timer", op(Condition::OR, goal(0.5), timer(30.0))},
+    {"not timer and goal",
+      op(Condition::AND, op(Condition::NOT, timer(10.0)), goal(1.0))},
+    {"nested",
+      op(
+        Condition::OR,
+        op(
+          Condition::AND,
+          op(Condition::OR, goal(0.2), goal(2.0)),
+          op(Condition::NOT, timer(5.0))),
+        op(
+          Condition::AND,
+          timer(20.0),
+          op(Condition::NOT, op(Condition::AND, goal(4.0), timer(40.0)))))},
+    {"missing operand", op(Condition::AND, goal(1.0))},
+  };
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> distance(0.0, 5.0);
+  std::uniform_real_distribution<double> seconds(0.0, 60.0);
+  vector<double> goal_distance(num_agents), state_time(num_agents);
+  for (size_t i = 0; i < num_agents; i++)
+  {
+    // some agents have no goal
+    goal_distance[i] = i % 10 == 0 ?
+      std::numeric_limits<double>::infinity() : distance(rng);
+    state_time[i] = seconds(rng);
+  }
+
+  ConditionInputs inputs;
+  inputs.goal_distance = goal_distance.data();
+  inputs.state_time = state_time.data();
+  inputs.count = num_agents;
+
+  printf(
+    "%zu agents, microseconds per pass\n"
+    "%-20s %10s %10s %10s %8s\n",
+    num_agents, "condition", "tree", "program", "batched", "speedup");
+
+  int failures = 0;
+  for (const Case& c : cases)
+  {
+    const ConditionProgram program = ConditionProgram::compile(*c.condition);
+    vector<std::uint8_t> tree_results(num_agents);
+    vector<std::uint8_t> program_results(num_agents);
+    vector<std::uint8_t> batched_results(num_agents);
+
+    const double tree_us = time_us(
+      num_rounds,
+      [&](int)
+      {
+        for (size_t i = 0; i < num_agents; i++)
+          tree_results[i] =
+            evaluate_tree(*c.condition, goal_distance[i], state_time[i]);
+      });
+    const double program_us = time_us(
+      num_rounds,
+      [&](int)
+      {
+        for (size_t i = 0; i < num_agents; i++)
+          program_results[i] =
+            program.evaluate(goal_distance[i], state_time[i]);
+      });
+    const double batched_us = time_us(
+      num_rounds,
+      [&](int)
+      {
+        program.evaluate(inputs, batched_results.data());
+      });
+
+    printf(
+      "%-20s %10.1f %10.1f %10.1f %7.1fx\n",
+      c.name, tree_us, program_us, batched_us, tree_us / batched_us);
+
+    if (program_results != tree_results || batched_results != tree_results)
+    {
+      printf("  results differ from the tree evaluation\n");
+      failures++;
+    }
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Times finding the chargers of a 200k-vertex level through
+// EntityTableModel, which asks the level's vertex param index, against
+// scanning every vertex for the param, and times the name filter and
+// sorting. Fails if the model and the scan find different vertices.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <QApplication>
+
+#include "../gui/building.h"
+#include "../gui/entity_table_model.h"
+#include "benchmark.h"
+
+using std::size_t;
+using std::vector;
+
+namespace {
+
+const int num_vertices = 200000;
+const int num_rounds = 20;
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+
+  // every 100th vertex is a charger, and every 10th has the param
+  Building building;
+  building.levels.resize(1);
+  Level& level = building.levels[0];
+  for (int i = 0; i < num_vertices; i++)
+  {
+    level.add_vertex(i % 1000 * 20.0, i / 1000 * 20.0);
+    Vertex& v = level.vertices.back();
+    v.name = "v" + std::to_string(i);
+    if (i % 10 == 0)
+      v.params["is_charger"] = Param(i % 100 == 0);
+  }
+  level.vertices_changed();
+
+  vector<int> scanned;
+  const double scan_us = time_us(
+    num_rounds,
+    [&](int)
+    {
+      scanned.clear();
+      for (size_t i = 0; i < level.vertices.size(); i++)
+      {
+        const auto it = level.vertices[i].params.find("is_charger");
+        if (it != level.vertices[i].params.end() &&
+          it->second.value_bool())
+          scanned.push_back(static_cast<int>(i));
+      }
+    });
+
+  EntityTableModel model;
+  model.update(building, 0);
+  const double first_us = time_us(
+    1,
+    [&](int)
+    {
+      model.set_param_filter("is_charger", "true");
+    });
+  const double model_us = time_us(
+    num_rounds,
+    [&](int)
+    {
+      model.refresh();
+    });
+
+  vector<int> found(model.rowCount());
+  for (int row = 0; row < model.rowCount(); row++)
+    found[row] = model.entity_index(row);
+  std::sort(found.begin(), found.end());
+
+  model.set_param_filter(std::string(), std::string());
+  const double name_us = time_us(
+    num_rounds,
+    [&](int)
+    {
+      model.set_name_filter("99");
+    });
+  const int name_rows = model.rowCount();
+  model.set_name_filter(QString());
+  const double sort_us = time_us(
+    1,
+    [&](int)
+    {
+      model.sort(EntityTableModel::NAME, Qt::DescendingOrder);
+    });
+
+  printf(
+    "%d vertices, %zu chargers, microseconds\n"
+    "%10s %10s %10s %8s\n"
+    "%10.1f %10.1f %10.1f %7.1fx\n"
+    "(name filter: %.1f for %d rows, sorting all by name: %.1f)\n",
+    num_vertices, scanned.size(),
+    "scan", "index", "first", "speedup",
+    scan_us, model_us, first_us, scan_us / model_us,
+    name_us, name_rows, sort_us);
+
+  if (found != scanned)
+  {
+    printf("the model found %zu chargers, the scan %zu\n",
+      found.size(), scanned.size());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Compares the memory and lookup cost of vertex and edge parameters kept
+// in a std::map of strings to a Param holding every type of value at once
+// (the way they used to be) with the interned-key ParamMap and the
+// tagged-union Param, for a 200k-vertex building. Fails if the two ever
+// disagree.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../gui/edge.h"
+#include "benchmark.h"
+
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace {
+
+// heap bytes currently allocated through operator new
+size_t live_bytes = 0;
+
+const size_t num_vertices = 200000;
+const size_t num_edges = 300000;
+const int num_rounds = 50;
+
+// what Param looked like before it became a tagged union
+struct LegacyParam
+{
+  Param::Type type = Param::UNDEFINED;
+  int value_int = 0;
+  double value_double = 0.0;
+  string value_string;
+  bool value_bool = false;
+};
+
+typedef std::map<string, LegacyParam> LegacyParams;
+
+LegacyParam legacy(const Param& p)
+{
+  LegacyParam l;
+  l.type = p.type();
+  l.value_int = p.value_int();
+  l.value_double = p.value_double();
+  l.value_string = p.value_string();
+  l.value_bool = p.value_bool();
+  return l;
+}
+
+// the parameters of a typical vertex and edge of a large site map
+void vertex_params(const size_t i, ParamMap& params)
+{
+  if (i % 4 == 0)
+    params["is_parking_spot"] = Param(i % 8 == 0);
+  if (i % 20 == 0)
+    params["is_charger"] = Param(true);
+  if (i % 50 == 0)
+    params["lift_cabin"] = Param(string("lift_") + std::to_string(i % 7));
+}
+
+void edge_params(const size_t i, ParamMap& params)
+{
+  params["bidirectional"] = Param(i % 3 != 0);
+  params["graph_idx"] = Param(static_cast<int>(i % 3));
+  params["orientation"] = Param(string(i % 2 ? "forward" : ""));
+  if (i % 5 == 0)
+    params["speed_limit"] = Param(0.5);
+  if (i % 5 == 1)
+    params["width"] = Param(1.5);
+}
+
+// the old Edge::get_graph_idx(), get_width() and is_bidirectional()
+int legacy_graph_idx(const LegacyParams& params)
+{
+  auto it = params.find("graph_idx");
+  if (it == params.end() || it->second.type != Param::INT)
+    return 0;
+  return it->second.value_int;
+}
+
+double legacy_width(const LegacyParams& params)
+{
+  auto it = params.find("width");
+  if (it == params.end() || it->second.type != Param::DOUBLE)
+    return -1.0;
+  return it->second.value_double;
+}
+
+bool legacy_bidirectional(const LegacyParams& params)
+{
+  auto it = params.find("bidirectional");
+  if (it == params.end() || it->second.type != Param::BOOL)
+    return false;
+  return it->second.value_bool;
+}
+
+}  // namespace
+
+// count live heap bytes, keeping each block's size in a header in front
+// of it
+const size_t header = sizeof(std::max_align_t);
+
+void* operator new(size_t size)
+{
+  char* block = static_cast<char*>(std::malloc(size + header));
+  if (!block)
+    throw std::bad_alloc();
+  *reinterpret_cast<size_t*>(block) = size;
+  live_bytes += size;
+  return block + header;
+}
+
+void operator delete(void* p) noexcept
+{
+  if (!p)
+    return;
+  const std::uintptr_t block = reinterpret_cast<std::uintptr_t>(p) - header;
+  live_bytes -= *reinterpret_cast<size_t*>(block);
+  std::free(reinterpret_cast<void*>(block));
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+int main()
+{
+  // intern the keys up front so they aren't counted against either side
+  {
+    ParamMap params;
+    vertex_params(0, params);
+    edge_params(0, params);
+  }
+
+  // the containers themselves are allocated up front and added on
+  // afterwards, so what is measured is only what their params take
+  vector<ParamMap> vertex_maps(num_vertices);
+  vector<LegacyParams> legacy_vertex_maps(num_vertices);
+  vector<Edge> edges(num_edges);
+  vector<LegacyParams> legacy_edge_maps(num_edges);
+
+  size_t start = live_bytes;
+  for (size_t i = 0; i < num_vertices; i++)
+    vertex_params(i, vertex_maps[i]);
+  const size_t new_vertex_bytes = live_bytes - start;
+
+  start = live_bytes;
+  for (size_t i = 0; i < num_edges; i++)
+  {
+    edges[i].type = Edge::HUMAN_LANE;
+    edge_params(i, edges[i].params);
+  }
+  const size_t new_edge_bytes = live_bytes - start;
+
+  start = live_bytes;
+  for (size_t i = 0; i < num_vertices; i++)
+  {
+    for (const auto& param : vertex_maps[i])
+      legacy_vertex_maps[i][param.first.str()] = legacy(param.second);
+  }
+  const size_t legacy_vertex_bytes = live_bytes - start;
+
+  start = live_bytes;
+  for (size_t i = 0; i < num_edges; i++)
+  {
+    for (const auto& param : edges[i].params)
+      legacy_edge_maps[i][param.first.str()] = legacy(param.second);
+  }
+  const size_t legacy_edge_bytes = live_bytes - start;
+
+  printf(
+    "bytes of params per entity, including the container itself\n"
+    "%-10s %10s %10s\n"
+    "%-10s %10.1f %10.1f\n"
+    "%-10s %10.1f %10.1f\n",
+    "", "std::map", "ParamMap",
+    "vertex",
+    static_cast<double>(legacy_vertex_bytes) / num_vertices +
+    sizeof(LegacyParams),
+    static_cast<double>(new_vertex_bytes) / num_vertices +
+    sizeof(ParamMap),
+    "edge",
+    static_cast<double>(legacy_edge_bytes) / num_edges +
+    sizeof(LegacyParams),
+    static_cast<double>(new_edge_bytes) / num_edges + sizeof(ParamMap));
+  printf("sizeof(Param) %zu, was %zu\n", sizeof(Param), sizeof(LegacyParam));
+
+  // what drawing the lanes of the level looks up
+  double legacy_sum = 0.0;
+  double new_sum = 0.0;
+  const double legacy_us = time_us(
+    num_rounds,
+    [&](int)
+    {
+      for (const LegacyParams& params : legacy_edge_maps)
+        legacy_sum += legacy_graph_idx(params) + legacy_width(params) +
+        legacy_bidirectional(params);
+    });
+  const double new_us = time_us(
+    num_rounds,
+    [&](int)
+    {
+      for (const Edge& e : edges)
+        new_sum += e.get_graph_idx() + e.get_width() + e.is_bidirectional();
+    });
+  printf(
+    "%zu edges, microseconds per pass of graph_idx, width, bidirectional\n"
+    "%10s %10s %8s\n"
+    "%10.1f %10.1f %7.1fx\n",
+    num_edges, "std::map", "ParamMap", "speedup",
+    legacy_us, new_us, legacy_us / new_us);
+
+  if (legacy_sum != new_sum)
+  {
+    printf("lookups differ from the std::map lookups\n");
+    return 1;
+  }
+  return 0;
+}
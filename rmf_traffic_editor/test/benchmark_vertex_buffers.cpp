@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Times Level::nearest_items() on a 200k-vertex level, which scans the
+// contiguous vertex buffers, against the same scan over the Vertex
+// objects, and times Level::draw() of that level. Fails if the two scans
+// ever pick different vertices.
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <QApplication>
+#include <QGraphicsScene>
+
+#include "../gui/level.h"
+#include "benchmark.h"
+
+using std::size_t;
+using std::vector;
+
+namespace {
+
+const int grid_size = 450;  // vertices on each side, about 200k in all
+const int num_queries = 200;
+const int num_draws = 3;
+
+// the same scan, over the Vertex objects
+int nearest_vertex(const Level& level, const double x, const double y)
+{
+  double min_dist = 1e100;
+  int min_idx = -1;
+  for (size_t i = 0; i < level.vertices.size(); i++)
+  {
+    const Vertex& p = level.vertices[i];
+    const double dx = x - p.x;
+    const double dy = y - p.y;
+    const double dist2 = dx*dx + dy*dy;
+    if (dist2 < min_dist)
+    {
+      min_dist = dist2;
+      min_idx = i;
+    }
+  }
+  return min_idx;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+
+  // a grid of lanes and walls, a meter apart
+  Level level;
+  level.drawing_meters_per_pixel = 0.05;
+  level.x_meters = grid_size;
+  level.y_meters = grid_size;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> jitter(-2.0, 2.0);
+  for (int row = 0; row < grid_size; row++)
+  {
+    for (int col = 0; col < grid_size; col++)
+      level.add_vertex(col * 20.0 + jitter(rng), row * 20.0 + jitter(rng));
+  }
+  for (int row = 0; row < grid_size; row++)
+  {
+    for (int col = 0; col + 1 < grid_size; col++)
+    {
+      const int i = row * grid_size + col;
+      level.edges.push_back(
+        Edge(i, i + 1, row % 10 == 0 ? Edge::WALL : Edge::LANE));
+      level.edges.back().set_graph_idx(row % 3);
+    }
+  }
+  const size_t num_vertices = level.vertices.size();
+
+  std::uniform_real_distribution<double> coordinate(0.0, grid_size * 20.0);
+  vector<double> qx(num_queries), qy(num_queries);
+  for (int i = 0; i < num_queries; i++)
+  {
+    qx[i] = coordinate(rng);
+    qy[i] = coordinate(rng);
+  }
+
+  vector<int> object_results(num_queries), buffer_results(num_queries);
+  const double build_us = time_us(
+    1,
+    [&](int)
+    {
+      level.vertices_changed();
+      level.vertex_buffers();
+    });
+  const double object_us = time_us(
+    num_queries,
+    [&](const int i)
+    {
+      object_results[i] = nearest_vertex(level, qx[i], qy[i]);
+    });
+  const double buffer_us = time_us(
+    num_queries,
+    [&](const int i)
+    {
+      buffer_results[i] = level.nearest_items(qx[i], qy[i]).vertex_idx;
+    });
+
+  printf(
+    "%zu vertices, microseconds per nearest_items()\n"
+    "%10s %10s %8s\n"
+    "%10.1f %10.1f %7.1fx\n"
+    "(building the buffers took %.1f microseconds)\n",
+    num_vertices, "objects", "buffers", "speedup",
+    object_us, buffer_us, object_us / buffer_us, build_us);
+
+  vector<EditorModel> editor_models;
+  const RenderingOptions rendering_options;
+  const vector<Graph> graphs;
+  const double draw_us = time_us(
+    num_draws,
+    [&](int)
+    {
+      QGraphicsScene scene;
+      level.draw(&scene, editor_models, rendering_options, graphs);
+    });
+  printf(
+    "%zu edges, milliseconds per Level::draw(): %.1f\n",
+    level.edges.size(), draw_us / 1000.0);
+
+  if (object_results != buffer_results)
+  {
+    printf("nearest_items() differs from the scan over the vertices\n");
+    return 1;
+  }
+  return 0;
+}
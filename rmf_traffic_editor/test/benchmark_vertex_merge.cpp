@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2021 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Times Level::merge_duplicate_vertices() on levels of 12.5k to 800k
+// vertices, where a quarter of the vertices have a near-duplicate drawn
+// on top of them, to show it grows linearly. Fails if it merges
+// differently from a brute-force pass over every pair of vertices, or
+// leaves an edge or polygon pointing at the wrong place.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <QApplication>
+
+#include "../gui/level.h"
+#include "benchmark.h"
+
+using std::size_t;
+using std::vector;
+
+namespace {
+
+const double tolerance = 0.05;  // meters
+
+// A grid of vertices 1 m apart, then a copy 1 cm off every fourth one.
+// Lanes run along the rows, using the copy for every other end they
+// can, plus a lane from each vertex to its copy. Each copy also gets a
+// triangle with its original, which collapses, and a quad, which doesn't.
+void make_level(Level& level, const int side)
+{
+  level.drawing_meters_per_pixel = 0.05;
+  const double step = 1.0 / level.drawing_meters_per_pixel;
+  const double offset = 0.01 / level.drawing_meters_per_pixel;
+  const int n = side * side;
+  vector<int> copy(n, -1);
+  for (int i = 0; i < n; i++)
+    level.add_vertex(i % side * step, i / side * step);
+  for (int i = 0; i < n; i += 4)
+  {
+    copy[i] = static_cast<int>(level.vertices.size());
+    level.add_vertex(
+      level.vertices[i].x + offset,
+      level.vertices[i].y + offset);
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    if (i % side + 1 < side)
+    {
+      const int end = copy[i + 1] >= 0 && i % 2 ? copy[i + 1] : i + 1;
+      level.edges.push_back(Edge(i, end, Edge::LANE));
+    }
+    if (copy[i] < 0)
+      continue;
+    level.edges.push_back(Edge(i, copy[i], Edge::LANE));
+    if (i + side + 1 < n)
+    {
+      Polygon triangle;
+      triangle.vertices = {i, copy[i], i + side};
+      level.polygons.push_back(triangle);
+      Polygon quad;
+      quad.vertices = {copy[i], i + 1, i + side + 1, i + side};
+      level.polygons.push_back(quad);
+    }
+  }
+  level.vertices_changed();
+  level.polygons_changed();
+}
+
+// the vertices a greedy pass over every pair would keep
+vector<QPointF> brute_force_merge(const Level& level)
+{
+  const double radius = tolerance / level.drawing_meters_per_pixel;
+  const size_t n = level.vertices.size();
+  vector<char> merged(n, 0);
+  vector<QPointF> kept;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (merged[i])
+      continue;
+    const Vertex& a = level.vertices[i];
+    kept.push_back(QPointF(a.x, a.y));
+    for (size_t j = i + 1; j < n; j++)
+    {
+      const Vertex& b = level.vertices[j];
+      if (!merged[j] && std::hypot(a.x - b.x, a.y - b.y) <= radius)
+        merged[j] = 1;
+    }
+  }
+  return kept;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+
+  int failures = 0;
+  printf("%10s %10s %12s %12s\n",
+    "vertices", "merged", "total ms", "ns/vertex");
+  for (const int side : {100, 200, 400, 800})
+  {
+    Level level;
+    make_level(level, side);
+    const size_t num_vertices = level.vertices.size();
+    const size_t num_edges = level.edges.size();
+    const size_t num_polygons = level.polygons.size();
+
+    vector<QPointF> expected;
+    if (side == 100)
+      expected = brute_force_merge(level);
+
+    size_t num_merged = 0;
+    const double ms = time_us(
+      1,
+      [&](int)
+      {
+        num_merged = level.merge_duplicate_vertices(tolerance);
+      }) / 1000.0;
+    printf("%10zu %10zu %12.1f %12.1f\n",
+      num_vertices, num_merged, ms, 1e6 * ms / num_vertices);
+
+    // every copy goes, along with the lanes and triangles joining it to
+    // its original
+    const size_t side_sq = static_cast<size_t>(side) * side;
+    const size_t num_copies = num_vertices - side_sq;
+    const size_t num_quads = num_polygons / 2;
+    bool ok = num_merged == num_copies &&
+      level.vertices.size() == side_sq &&
+      level.edges.size() == num_edges - num_copies &&
+      level.polygons.size() == num_quads;
+    for (const Edge& e : level.edges)
+    {
+      ok = ok && e.start_idx >= 0 && e.end_idx == e.start_idx + 1 &&
+        e.end_idx < static_cast<int>(side_sq);
+    }
+    for (const Polygon& polygon : level.polygons)
+      ok = ok && polygon.vertices.size() == 4;
+    if (!expected.empty())
+    {
+      ok = ok && expected.size() == level.vertices.size();
+      for (size_t i = 0; ok && i < expected.size(); i++)
+      {
+        ok = expected[i].x() == level.vertices[i].x &&
+          expected[i].y() == level.vertices[i].y;
+      }
+    }
+    if (!ok)
+    {
+      printf("  the merged level is wrong\n");
+      failures++;
+    }
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -1,7 +1,100 @@
 #include <QtWidgets>
 #include <QTest>
 
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <traffic_editor/crowd_sim/condition.h>
+#include <traffic_editor/crowd_sim/condition_program.h>
+
+#include "../gui/building.h"
 #include "../gui/editor.h"
+#include "../gui/lane_graph_validator.h"
+#include "../gui/nav_graph.h"
+#include "../gui/param_map.h"
+#include "../gui/segment_intersector.h"
+#include "../gui/vertex_grid.h"
+
+using crowd_sim::BoolCondition;
+using crowd_sim::Condition;
+using crowd_sim::ConditionPtr;
+using crowd_sim::LeafCondition;
+
+namespace {
+
+ConditionPtr goal(const double distance)
+{
+  return std::make_shared<LeafCondition>(
+    "goal_reached", Condition::GOAL, distance);
+}
+
+ConditionPtr timer(const double seconds)
+{
+  return std::make_shared<LeafCondition>("timer", Condition::TIMER, seconds);
+}
+
+ConditionPtr op(
+  const Condition::TYPE type,
+  const ConditionPtr& c1,
+  const ConditionPtr& c2 = nullptr)
+{
+  return std::make_shared<BoolCondition>(
+    type == Condition::AND ? "and" : type == Condition::OR ? "or" : "not",
+    type, c1, c2);
+}
+
+// the rules the crowd preview used before conditions were compiled
+bool evaluate_tree(
+  const Condition& condition,
+  const double goal_distance,
+  const double state_time)
+{
+  switch (condition.get_type())
+  {
+    case Condition::GOAL:
+      return goal_distance <=
+        static_cast<const LeafCondition&>(condition).get_value();
+    case Condition::TIMER:
+      return state_time >=
+        static_cast<const LeafCondition&>(condition).get_value();
+    case Condition::AND:
+    case Condition::OR:
+    case Condition::NOT:
+    {
+      const BoolCondition& b = static_cast<const BoolCondition&>(condition);
+      const ConditionPtr c1 = b.get_condition(1);
+      if (!c1)
+        return false;
+      const bool v1 = evaluate_tree(*c1, goal_distance, state_time);
+      if (condition.get_type() == Condition::NOT)
+        return !v1;
+      const ConditionPtr c2 = b.get_condition(2);
+      if (!c2)
+        return false;
+      if (condition.get_type() == Condition::AND)
+        return v1 && evaluate_tree(*c2, goal_distance, state_time);
+      return v1 || evaluate_tree(*c2, goal_distance, state_time);
+    }
+    default:
+      return false;
+  }
+}
+
+Edge lane(const int start, const int end, const bool bidirectional)
+{
+  Edge e(start, end, Edge::LANE);
+  e.params["bidirectional"] = Param(bidirectional);
+  return e;
+}
+
+}  // namespace
 
 class TestGui : public QObject
 {
@@ -20,6 +113,372 @@ private slots:
   {
     //QCOMPARE("a", "b");
   }
+  void testLaneGraphValidator()
+  {
+    // 0 -> 1 <-> 2, so vertex 0 can be left but never reached
+    Building building;
+    building.levels.resize(1);
+    Level& level = building.levels[0];
+    level.name = "L1";
+    level.add_vertex(0.0, 0.0);
+    level.add_vertex(100.0, 0.0);
+    level.add_vertex(200.0, 0.0);
+    level.edges.push_back(lane(0, 1, false));
+    level.edges.push_back(lane(1, 2, true));
+
+    LaneGraphValidator validator;
+    QVERIFY(validator.update(building));
+    std::vector<LaneGraphValidator::Issue> issues = validator.issues();
+    QCOMPARE(issues.size(), std::size_t(1));
+    QCOMPARE(issues[0].type, LaneGraphValidator::Issue::UNREACHABLE_VERTEX);
+    QCOMPARE(issues[0].vertex_idx, 0);
+
+    // nothing changed, so nothing is analyzed again
+    QVERIFY(!validator.update(building));
+
+    // a lane crossing the others, in a graph of its own
+    level.edges[0].params["bidirectional"] = Param(true);
+    level.add_vertex(150.0, -50.0);
+    level.add_vertex(150.0, 50.0);
+    level.edges.push_back(lane(3, 4, true));
+    QVERIFY(validator.update(building));
+    issues = validator.issues();
+    QCOMPARE(issues.size(), std::size_t(2));
+    std::set<int> types;
+    for (const auto& issue : issues)
+      types.insert(issue.type);
+    QCOMPARE(
+      types,
+      std::set<int>({
+        LaneGraphValidator::Issue::LANES_CROSS,
+        LaneGraphValidator::Issue::DISCONNECTED_COMPONENT}));
+  }
+  void testSegmentIntersector()
+  {
+    typedef SegmentIntersector::Segment Segment;
+    const Segment a{0, 0, 10, 10};
+    const Segment b{0, 10, 10, 0};
+    const Segment c{10, 10, 20, 0};
+    const Segment d{5, 5, 15, 15};
+    QVERIFY(SegmentIntersector::segments_cross(a, b));
+    QVERIFY(!SegmentIntersector::segments_cross(a, c));
+    QVERIFY(SegmentIntersector::segments_touch(a, c));
+    QVERIFY(SegmentIntersector::segments_overlap(a, d));
+    QVERIFY(!SegmentIntersector::segments_overlap(a, b));
+
+    // every pair that touches is among the candidates of a query
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> coordinate(0.0, 100.0);
+    std::uniform_real_distribution<double> offset(-15.0, 15.0);
+    std::vector<Segment> segments(500);
+    for (Segment& s : segments)
+    {
+      s.x1 = coordinate(rng);
+      s.y1 = coordinate(rng);
+      s.x2 = s.x1 + offset(rng);
+      s.y2 = s.y1 + offset(rng);
+    }
+    SegmentIntersector intersector(segments);
+    for (const Segment& s : segments)
+    {
+      std::set<int> candidates;
+      intersector.query(
+        s, [&candidates](const int idx) { candidates.insert(idx); });
+      for (std::size_t i = 0; i < segments.size(); i++)
+      {
+        if (SegmentIntersector::segments_touch(s, segments[i]))
+          QVERIFY(candidates.count(static_cast<int>(i)));
+      }
+    }
+  }
+  void testNavGraph()
+  {
+    // a 5 m square of two-way lanes, with a one-way diagonal from 0 to 2
+    Building building;
+    building.levels.resize(1);
+    Level& level = building.levels[0];
+    level.name = "L1";
+    level.drawing_meters_per_pixel = 0.05;
+    level.add_vertex(0.0, 0.0);
+    level.add_vertex(100.0, 0.0);
+    level.add_vertex(100.0, 100.0);
+    level.add_vertex(0.0, 100.0);
+    for (int i = 0; i < 4; i++)
+      level.edges.push_back(lane(i, (i + 1) % 4, true));
+    level.edges.push_back(lane(0, 2, false));
+
+    NavGraph nav_graph;
+    QVERIFY(nav_graph.update(building));
+    QCOMPARE(nav_graph.num_nodes(), std::size_t(4));
+    QVERIFY(!nav_graph.update(building));
+
+    NavGraph::Node n[4];
+    for (int i = 0; i < 4; i++)
+    {
+      n[i].level_idx = 0;
+      n[i].vertex_idx = i;
+    }
+
+    const NavGraph::Route there = nav_graph.find_route(n[0], n[2], false, 0);
+    QVERIFY(there.found);
+    QCOMPARE(there.nodes.size(), std::size_t(2));
+    QCOMPARE(there.edges, std::vector<int>({4}));
+    QVERIFY(std::abs(there.length - 5.0 * std::sqrt(2.0)) < 1e-9);
+
+    // the diagonal only goes one way
+    const NavGraph::Route back = nav_graph.find_route(n[2], n[0], false, 0);
+    QVERIFY(back.found);
+    QCOMPARE(back.nodes.size(), std::size_t(3));
+    QVERIFY(std::abs(back.length - 10.0) < 1e-9);
+
+    QVERIFY(!nav_graph.find_route(n[0], n[2], false, 1).found);
+    QVERIFY(!nav_graph.find_route(n[0], n[2], true, 0).found);
+
+    // one search to many goals agrees with a search per goal
+    NavGraph::Workspace workspace;
+    std::vector<NavGraph::Route> routes;
+    nav_graph.find_routes(
+      n[2], {n[0], n[1], n[3]}, false, 0, workspace, routes);
+    QCOMPARE(routes.size(), std::size_t(3));
+    for (const NavGraph::Route& route : routes)
+    {
+      const NavGraph::Route single =
+        nav_graph.find_route(n[2], route.nodes.back(), false, 0);
+      QVERIFY(route.found);
+      QVERIFY(std::abs(route.length - single.length) < 1e-9);
+    }
+  }
+  void testConditionProgram()
+  {
+    const std::vector<ConditionPtr> conditions = {
+      op(Condition::OR, goal(0.5), timer(30.0)),
+      op(Condition::AND, op(Condition::NOT, timer(10.0)), goal(1.0)),
+      op(
+        Condition::OR,
+        op(
+          Condition::AND,
+          op(Condition::OR, goal(0.2), goal(2.0)),
+          op(Condition::NOT, timer(5.0))),
+        op(Condition::AND, timer(20.0), op(Condition::NOT, goal(4.0)))),
+      op(Condition::AND, goal(1.0)),  // missing an operand
+    };
+
+    // more agents than one block of the batched evaluation, some of them
+    // without a goal
+    const std::size_t num_agents = 1000;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> distance(0.0, 5.0);
+    std::uniform_real_distribution<double> seconds(0.0, 60.0);
+    std::vector<double> goal_distance(num_agents), state_time(num_agents);
+    for (std::size_t i = 0; i < num_agents; i++)
+    {
+      goal_distance[i] = i % 10 == 0 ?
+        std::numeric_limits<double>::infinity() : distance(rng);
+      state_time[i] = seconds(rng);
+    }
+    crowd_sim::ConditionInputs inputs;
+    inputs.goal_distance = goal_distance.data();
+    inputs.state_time = state_time.data();
+    inputs.count = num_agents;
+
+    for (const ConditionPtr& condition : conditions)
+    {
+      const crowd_sim::ConditionProgram program =
+        crowd_sim::ConditionProgram::compile(*condition);
+      std::vector<std::uint8_t> batched(num_agents);
+      program.evaluate(inputs, batched.data());
+      for (std::size_t i = 0; i < num_agents; i++)
+      {
+        const bool expected =
+          evaluate_tree(*condition, goal_distance[i], state_time[i]);
+        QCOMPARE(program.evaluate(goal_distance[i], state_time[i]), expected);
+        QCOMPARE(batched[i] != 0, expected);
+      }
+    }
+  }
+  void testParamMap()
+  {
+    ParamMap params;
+    std::map<std::string, int> expected;
+    std::mt19937 rng(2);
+    std::uniform_int_distribution<int> key(0, 29);
+    for (int i = 0; i < 300; i++)
+    {
+      const std::string name = "param_" + std::to_string(key(rng));
+      if (i % 3 == 2)
+      {
+        QCOMPARE(params.erase(name), expected.erase(name));
+        continue;
+      }
+      params[name] = Param(i);
+      expected[name] = i;
+    }
+
+    // kept in name order, like the std::map the params used to be
+    QCOMPARE(params.size(), expected.size());
+    auto it = expected.begin();
+    for (const auto& param : params)
+    {
+      QCOMPARE(param.first.str(), it->first);
+      QCOMPARE(param.second.value_int(), it->second);
+      ++it;
+    }
+    for (int k = 0; k < 30; k++)
+    {
+      const std::string name = "param_" + std::to_string(k);
+      QCOMPARE(params.count(name), expected.count(name));
+      QCOMPARE(params.find(name) != params.end(), expected.count(name) > 0);
+    }
+  }
+  void testSelection()
+  {
+    Level level;
+    for (int i = 0; i < 4; i++)
+      level.add_vertex(i * 10.0, 0.0);
+    level.set_selected(Level::VERTEX, 1, true);
+    level.set_selected(Level::VERTEX, 3, true);
+    QCOMPARE(level.selection().vertices, std::set<int>({1, 3}));
+    level.set_selected(Level::VERTEX, 1, false);
+    QCOMPARE(level.selection().vertices, std::set<int>({3}));
+
+    // rebuilt from the flags once the vertices are reordered
+    level.vertices.erase(level.vertices.begin());
+    level.vertices_changed();
+    QCOMPARE(level.selection().vertices, std::set<int>({2}));
+
+    level.clear_selection();
+    QVERIFY(level.selection().vertices.empty());
+    QVERIFY(!level.vertices[2].selected);
+  }
+  void testLevelRevision()
+  {
+    Level level;
+    level.add_vertex(0.0, 0.0);
+    const std::size_t added = level.revision();
+    level.move_vertex(0, 1.0, 0.0);
+    QVERIFY(level.revision() != added);
+
+    // copies share the revision until either is edited
+    Level copy(level);
+    QCOMPARE(copy.revision(), level.revision());
+    copy.changed();
+    level.changed();
+    QVERIFY(copy.revision() != level.revision());
+    QVERIFY(Level().revision() != level.revision());
+  }
+  void testVertexGrid()
+  {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> coordinate(-50.0, 50.0);
+    std::vector<double> x(2000), y(2000);
+    for (std::size_t i = 0; i < x.size(); i++)
+    {
+      x[i] = coordinate(rng);
+      y[i] = coordinate(rng);
+    }
+    const double radius = 3.0;
+    VertexGrid grid;
+    grid.build(x, y, radius);
+
+    for (int q = 0; q < 200; q++)
+    {
+      const QPointF p(coordinate(rng), coordinate(rng));
+      std::set<int> near;
+      grid.for_each_near(p, radius, [&near](const int i) { near.insert(i); });
+
+      std::set<int> expected;
+      int nearest = -1;
+      double nearest_distance = radius;
+      for (std::size_t i = 0; i < x.size(); i++)
+      {
+        const double d = std::hypot(x[i] - p.x(), y[i] - p.y());
+        if (d > radius)
+          continue;
+        expected.insert(static_cast<int>(i));
+        if (nearest < 0 || d < nearest_distance)
+        {
+          nearest = static_cast<int>(i);
+          nearest_distance = d;
+        }
+      }
+      QCOMPARE(near, expected);
+      QCOMPARE(grid.nearest(p, radius), nearest);
+    }
+  }
+  void testMergeDuplicateVertices()
+  {
+    // clusters of points, merged the way a greedy pass over every pair of
+    // them would
+    Level level;
+    level.drawing_meters_per_pixel = 0.05;
+    const double tolerance = 0.05;
+    const double radius = tolerance / level.drawing_meters_per_pixel;
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<double> coordinate(0.0, 40.0);
+    for (int i = 0; i < 500; i++)
+      level.add_vertex(coordinate(rng), coordinate(rng));
+
+    std::vector<QPointF> expected;
+    std::vector<char> merged(level.vertices.size(), 0);
+    for (std::size_t i = 0; i < level.vertices.size(); i++)
+    {
+      if (merged[i])
+        continue;
+      const Vertex& a = level.vertices[i];
+      expected.push_back(QPointF(a.x, a.y));
+      for (std::size_t j = i + 1; j < level.vertices.size(); j++)
+      {
+        const Vertex& b = level.vertices[j];
+        if (!merged[j] && std::hypot(a.x - b.x, a.y - b.y) <= radius)
+          merged[j] = 1;
+      }
+    }
+
+    const std::size_t num_merged = level.merge_duplicate_vertices(tolerance);
+    QCOMPARE(num_merged, merged.size() - expected.size());
+    QCOMPARE(level.vertices.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++)
+    {
+      QCOMPARE(level.vertices[i].x, expected[i].x());
+      QCOMPARE(level.vertices[i].y, expected[i].y());
+    }
+  }
+  void testMergeDuplicateVerticesRemaps()
+  {
+    // vertex 1 sits on top of vertex 0
+    Level level;
+    level.drawing_meters_per_pixel = 0.05;
+    level.add_vertex(0.0, 0.0);
+    level.add_vertex(0.5, 0.0);
+    level.add_vertex(100.0, 0.0);
+    level.add_vertex(100.0, 100.0);
+    level.vertices[1].name = "b";
+    level.edges.push_back(lane(0, 1, true));
+    level.edges.push_back(lane(1, 2, true));
+    level.edges.push_back(lane(2, 3, true));
+    Polygon quad;
+    quad.vertices = {0, 1, 2, 3};
+    level.polygons.push_back(quad);
+    Polygon triangle;
+    triangle.vertices = {0, 1, 2};
+    level.polygons.push_back(triangle);
+    level.polygons_changed();
+
+    QCOMPARE(level.merge_duplicate_vertices(0.05), std::size_t(1));
+    QCOMPARE(level.vertices.size(), std::size_t(3));
+    QCOMPARE(level.vertices[0].name, std::string("b"));
+
+    // the lane between the two is gone, the others follow vertex 1
+    QCOMPARE(level.edges.size(), std::size_t(2));
+    QCOMPARE(level.edges[0].start_idx, 0);
+    QCOMPARE(level.edges[0].end_idx, 1);
+    QCOMPARE(level.edges[1].start_idx, 1);
+    QCOMPARE(level.edges[1].end_idx, 2);
+
+    // the triangle collapsed, the quad became a triangle
+    QCOMPARE(level.polygons.size(), std::size_t(1));
+    QCOMPARE(level.polygons[0].vertices, std::vector<int>({0, 1, 2}));
+  }
   void cleanupTestCase()
   {
     printf("cleanupTestCase()\n");